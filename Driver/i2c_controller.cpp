@@ -1,147 +1,1477 @@
 #include "i2c_controller.h"
 #include "i2c_driver.h"
+#include "i2c_util.h"
+#include "i2c_dma.h"
 #include <drivers/device_manager.h>
 #include <PCI.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #define INTEL_VENDOR_ID 0x8086
 #define TIGER_LAKE_I2C_CONTROLLER_0 0xa0e8
 #define TIGER_LAKE_I2C_CONTROLLER_1 0xa0e9
 
-// Registri del controller I2C (esempio, potrebbero variare a seconda del controller specifico)
-#define I2C_CON         0x00 // Control Register
-#define I2C_TAR         0x04 // Target Address Register
-#define I2C_DATA_CMD    0x10 // Data Command Register
-#define I2C_SS_SCL_HCNT 0x14 // Standard Speed SCL High Count Register
-#define I2C_SS_SCL_LCNT 0x18 // Standard Speed SCL Low Count Register
-#define I2C_FS_SCL_HCNT 0x1C // Fast Speed SCL High Count Register
-#define I2C_FS_SCL_LCNT 0x20 // Fast Speed SCL Low Count Register
-#define I2C_INTR_STAT   0x2C // Interrupt Status Register
-#define I2C_INTR_MASK   0x30 // Interrupt Mask Register
-#define I2C_RAW_INTR_STAT 0x34 // Raw Interrupt Status Register
-#define I2C_RX_TL       0x38 // Receive FIFO Threshold Register
-#define I2C_TX_TL       0x3C // Transmit FIFO Threshold Register
-#define I2C_CLR_INTR    0x40 // Clear Combined and Individual Interrupt Register
-#define I2C_STATUS      0x70 // Status Register
-
 static pci_module_info* sPCIModule;
+// Tabella dei controller, allocata una volta sola al probe: i puntatori restano
+// validi fino a free_i2c_devices e l'indice è quello del nome ("i2c/<indice>")
 static i2c_device_info* sDeviceList = NULL;
 static uint32 sDeviceCount = 0;
 
+static bool is_supported_controller(const pci_info& info) {
+    return info.vendor_id == INTEL_VENDOR_ID
+        && (info.device_id == TIGER_LAKE_I2C_CONTROLLER_0
+            || info.device_id == TIGER_LAKE_I2C_CONTROLLER_1);
+}
+
 status_t probe_i2c_devices() {
+    status_t status = get_module(B_PCI_MODULE_NAME, (module_info**)&sPCIModule);
+    if (status != B_OK) {
+        dprintf(DRIVER_NAME ": Failed to get PCI module\n");
+        return status;
+    }
+
+    // Prima si contano i controller: l'array viene allocato una volta sola,
+    // l'handler di interrupt tiene il puntatore al proprio dispositivo
     pci_info info;
-    uint32 index = 0;
+    uint32 count = 0;
+    for (uint32 index = 0; sPCIModule->get_nth_pci_info(index, &info) == B_OK; index++) {
+        if (is_supported_controller(info)) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        dprintf(DRIVER_NAME ": No compatible I2C controllers found\n");
+        put_module(B_PCI_MODULE_NAME);
+        sPCIModule = NULL;
+        return B_ERROR;
+    }
 
-    while (sPCIModule->get_nth_pci_info(index++, &info) == B_OK) {
-        if (info.vendor_id == INTEL_VENDOR_ID &&
-            (info.device_id == TIGER_LAKE_I2C_CONTROLLER_0 ||
-             info.device_id == TIGER_LAKE_I2C_CONTROLLER_1)) {
-            
-            i2c_device_info* new_devices = (i2c_device_info*)realloc(sDeviceList, (sDeviceCount + 1) * sizeof(i2c_device_info));
-            if (new_devices == NULL) {
-                dprintf(DRIVER_NAME ": Failed to allocate memory for new device\n");
-                return B_NO_MEMORY;
-            }
-            
-            sDeviceList = new_devices;
-            i2c_device_info* device = &sDeviceList[sDeviceCount];
-            
-            device->base_addr = info.u.h0.base_registers[0];
-            device->irq = info.u.h0.interrupt_line;
-            device->vendor_id = info.vendor_id;
-            device->device_id = info.device_id;
-            
-            status_t status = init_i2c_controller(device);
-            if (status != B_OK) {
-                dprintf(DRIVER_NAME ": Failed to initialize I2C controller\n");
-                return status;
-            }
-            
-            sDeviceCount++;
-            
-            dprintf(DRIVER_NAME ": Found I2C controller at %02x:%02x.%x\n",
+    sDeviceList = (i2c_device_info*)calloc(count, sizeof(i2c_device_info));
+    if (sDeviceList == NULL) {
+        dprintf(DRIVER_NAME ": Failed to allocate memory for new device\n");
+        put_module(B_PCI_MODULE_NAME);
+        sPCIModule = NULL;
+        return B_NO_MEMORY;
+    }
+
+    for (uint32 index = 0; sDeviceCount < count
+            && sPCIModule->get_nth_pci_info(index, &info) == B_OK; index++) {
+        if (!is_supported_controller(info)) {
+            continue;
+        }
+
+        i2c_device_info* device = &sDeviceList[sDeviceCount];
+        device->base_addr = info.u.h0.base_registers[0];
+        device->irq = info.u.h0.interrupt_line;
+        device->vendor_id = info.vendor_id;
+        device->device_id = info.device_id;
+
+        // Un controller che non si inizializza non nasconde gli altri
+        status = init_i2c_controller(device);
+        if (status != B_OK) {
+            dprintf(DRIVER_NAME ": Failed to initialize I2C controller at %02x:%02x.%x\n",
                     info.bus, info.device, info.function);
+            memset(device, 0, sizeof(i2c_device_info));
+            continue;
         }
+
+        snprintf(device->name, sizeof(device->name), I2C_CONTROLLER_NAME_PREFIX "%" B_PRIu32,
+                 sDeviceCount);
+        sDeviceCount++;
+
+        dprintf(DRIVER_NAME ": Found I2C controller %s at %02x:%02x.%x\n",
+                device->name, info.bus, info.device, info.function);
     }
 
     if (sDeviceCount == 0) {
-        dprintf(DRIVER_NAME ": No compatible I2C controllers found\n");
-        return B_ERROR;
+        free(sDeviceList);
+        sDeviceList = NULL;
+        put_module(B_PCI_MODULE_NAME);
+        sPCIModule = NULL;
+        return status;
     }
-
     return B_OK;
 }
 
+// Profondità dei FIFO e velocità massima dai parametri di sintesi; se il
+// registro non è implementato (legge 0 o tutti 1) si usano quelle dei
+// controller supportati
+static void i2c_read_comp_params(i2c_device_info* device) {
+    uint32 param = IC_COMP_PARAM_1::read(device->mapped_registers);
+    if (param == 0 || param == 0xFFFFFFFF) {
+        device->tx_fifo_depth = I2C_TIGER_LAKE_FIFO_DEPTH;
+        device->rx_fifo_depth = I2C_TIGER_LAKE_FIFO_DEPTH;
+        device->max_speed_mode = IC_CON::SPEED_FAST;
+        return;
+    }
+    device->tx_fifo_depth = IC_COMP_PARAM_1::TX_BUFFER_DEPTH::get(param) + 1;
+    device->rx_fifo_depth = IC_COMP_PARAM_1::RX_BUFFER_DEPTH::get(param) + 1;
+    device->max_speed_mode = IC_COMP_PARAM_1::MAX_SPEED_MODE::get(param);
+}
+
+static status_t i2c_apply_config(i2c_device_info* device, const i2c_controller_config* config);
+static status_t i2c_resume_locked(i2c_device_info* device);
+
+// Programmazione completa dei registri, all'avvio e dopo un reset del
+// controller: al ritorno è acceso, con gli interrupt mascherati e I2C_TAR da
+// programmare
+static status_t i2c_program_controller(i2c_device_info* device,
+                                       const i2c_controller_config* config) {
+    void* base = device->mapped_registers;
+    device->target = I2C_TARGET_NONE;
+    device->abort_stop_pending = false;
+    device->intr_mask = 0;
+
+    // Il controller si configura solo da disabilitato
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::clear());
+    IC_CON::write(base, IC_CON::MASTER_MODE::set()
+        | IC_CON::SPEED::set(IC_CON::SPEED_STANDARD)
+        | IC_CON::IC_RESTART_EN::set()
+        | IC_CON::IC_SLAVE_DISABLE::set()
+        | IC_CON::RX_FIFO_FULL_HLD_CTRL::set() // Con il RX FIFO pieno il bus attende
+        | IC_CON::BUS_CLEAR_FEATURE_CTRL::set());
+    // Il bit resta a 1 solo se il bus clear è stato sintetizzato
+    device->bus_clear = IC_CON::BUS_CLEAR_FEATURE_CTRL::read(base);
+    IC_INTR_MASK::write(base, 0); // Disabilita tutti gli interrupt
+    IC_CLR_INTR::read(base);
+
+    // TX_EMPTY con il FIFO a metà: c'è tempo per riempirlo prima che si svuoti;
+    // RX_FULL con mezzo FIFO pieno, il resto viene letto allo STOP
+    IC_TX_TL::write(base, device->tx_fifo_depth / 2);
+    IC_RX_TL::write(base, device->rx_fifo_depth / 2 - 1);
+
+    // Temporizzazione di SCL: riaccende il controller
+    return i2c_apply_config(device, config);
+}
+
 status_t init_i2c_controller(i2c_device_info* device) {
-    device->register_area = map_physical_memory("i2c_regs", device->base_addr, 
-                                                B_PAGE_SIZE, B_IO_MEMORY,
+    device->register_area = map_physical_memory("i2c_regs", device->base_addr,
+                                                B_PAGE_SIZE, B_ANY_KERNEL_ADDRESS | B_MTR_UC,
+                                                B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA,
                                                 (void**)&device->mapped_registers);
     if (device->register_area < B_OK) {
         dprintf(DRIVER_NAME ": Failed to map I2C registers\n");
         return device->register_area;
     }
 
-    // Inizializzazione del controller I2C
-    // Questo è un esempio e potrebbe dover essere adattato al tuo controller specifico
-    write32(device->mapped_registers + I2C_CON, 0x0); // Disabilita il controller
-    write32(device->mapped_registers + I2C_SS_SCL_HCNT, 0x190); // Configura la temporizzazione
-    write32(device->mapped_registers + I2C_SS_SCL_LCNT, 0x1D6);
-    write32(device->mapped_registers + I2C_FS_SCL_HCNT, 0x3C);
-    write32(device->mapped_registers + I2C_FS_SCL_LCNT, 0x82);
-    write32(device->mapped_registers + I2C_INTR_MASK, 0); // Disabilita tutti gli interrupt
-    write32(device->mapped_registers + I2C_CON, 0x1); // Abilita il controller
+    device->bus_waiters = 0;
+    device->bus_sem = create_sem(0, "i2c bus");
+    if (device->bus_sem < B_OK) {
+        delete_area(device->register_area);
+        device->register_area = -1;
+        return device->bus_sem;
+    }
+    device->transfer_sem = -1;
+    device->transfer_active = false;
+    device->suspended = false;
+    device->autosuspend_delay = 0;
+    device->last_activity = system_time();
+    // Nessun touchpad finché init_touchpad non riesce: uninit_touchpad non fa nulla
+    device->pm_lock = -1;
+    device->pm_sem = -1;
+    device->pm_thread = -1;
+    device->touchpad_node = NULL;
+    device->clock_rate = I2C_TIGER_LAKE_CLOCK_RATE;
+    i2c_read_comp_params(device);
+
+    i2c_controller_config config;
+    config.speed = I2C_SPEED_DEFAULT;
+    config.addressing_mode = I2C_ADDRESSING_7BIT;
+    config.duty_cycle = 0;
+    config.scl_rise_time = 0;
+    config.scl_fall_time = 0;
+    status_t status = i2c_program_controller(device, &config);
+    if (status != B_OK) {
+        dprintf(DRIVER_NAME ": Failed to configure the bus timing\n");
+        delete_sem(device->bus_sem);
+        delete_area(device->register_area);
+        device->register_area = -1;
+        return status;
+    }
+
+    // Senza interrupt i trasferimenti restano a polling
+    if (i2c_controller_setup_interrupt(device) != B_OK) {
+        dprintf(DRIVER_NAME ": Interrupt not available, using polled transfers\n");
+    }
+
+    // Senza DMA tutti i trasferimenti restano in PIO
+    status = i2c_dma_init(device);
+    if (status != B_OK && status != B_NOT_SUPPORTED) {
+        dprintf(DRIVER_NAME ": DMA not available, using PIO transfers\n");
+    }
+
+    return B_OK;
+}
+
+void uninit_i2c_controller(i2c_device_info* device) {
+    // I registri del DMA e degli interrupt sono raggiungibili solo fuori dal reset
+    if (device->suspended) {
+        i2c_resume_locked(device);
+    }
+    i2c_dma_uninit(device);
+    if (device->transfer_sem >= B_OK) {
+        IC_INTR_MASK::write(device->mapped_registers, 0);
+        remove_io_interrupt_handler(device->irq, i2c_interrupt_handler, device);
+        delete_sem(device->transfer_sem);
+        device->transfer_sem = -1;
+    }
+    if (device->bus_sem >= B_OK) {
+        delete_sem(device->bus_sem);
+        device->bus_sem = -1;
+    }
+    if (device->register_area >= B_OK) {
+        delete_area(device->register_area);
+        device->register_area = -1;
+    }
+}
+
+status_t i2c_controller_setup_interrupt(i2c_device_info* device) {
+    // 0 e 0xFF: nessuna linea assegnata dal BIOS
+    if (device->irq == 0 || device->irq == 0xFF) {
+        return B_NOT_SUPPORTED;
+    }
+
+    void* base = device->mapped_registers;
+    IC_INTR_MASK::write(base, 0);
+    IC_CLR_INTR::read(base);
+
+    device->transfer_sem = create_sem(0, "i2c transfer");
+    if (device->transfer_sem < B_OK) {
+        return device->transfer_sem;
+    }
+    B_INITIALIZE_SPINLOCK(&device->transfer_lock);
+
+    // La linea può essere condivisa: l'handler riconosce i propri interrupt
+    status_t status = install_io_interrupt_handler(device->irq, i2c_interrupt_handler,
+                                                   device, 0);
+    if (status != B_OK) {
+        delete_sem(device->transfer_sem);
+        device->transfer_sem = -1;
+        return status;
+    }
+    return B_OK;
+}
+
+// Spegne il controller e attende che IC_ENABLE_STATUS lo confermi; se il bus
+// non si libera in tempo lo riaccende
+static status_t i2c_disable(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::clear());
+    for (int i = 0; IC_ENABLE_STATUS::IC_EN::read(base); i++) {
+        if (i == I2C_DISABLE_POLL_COUNT) {
+            IC_ENABLE::write(base, IC_ENABLE::ENABLE::set());
+            return B_BUSY;
+        }
+        spin(I2C_DISABLE_POLL_INTERVAL);
+    }
+    return B_OK;
+}
+
+// I2C_TAR si può cambiare solo a controller spento. Il modo a 10 bit è sia in
+// I2C_TAR sia in I2C_CON: dipende dalla sintesi quale dei due conta.
+static status_t i2c_set_target(i2c_device_info* device, uint16 addr, bool ten_bit) {
+    uint16 target = addr | (ten_bit ? I2C_TARGET_TEN_BIT : 0);
+    if (device->target == target) {
+        return B_OK;
+    }
+
+    status_t status = i2c_disable(device);
+    if (status != B_OK) {
+        return status;
+    }
+
+    void* base = device->mapped_registers;
+    IC_CON::update(base, IC_CON::IC_10BITADDR_MASTER::set(ten_bit ? 1 : 0));
+    IC_TAR::write(base, IC_TAR::ADDRESS::set(addr)
+        | IC_TAR::IC_10BITADDR_MASTER::set(ten_bit ? 1 : 0));
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::set());
+    device->target = target;
+    return B_OK;
+}
+
+// Dopo un TX_ABRT il controller manda ancora lo STOP: prima del trasferimento
+// successivo si attende che il bus sia libero e si scarta il suo STOP_DET, che
+// altrimenti chiuderebbe il nuovo trasferimento
+static status_t i2c_wait_abort_stop(i2c_device_info* device) {
+    if (!device->abort_stop_pending) {
+        return B_OK;
+    }
+
+    void* base = device->mapped_registers;
+    for (int i = 0; IC_STATUS::ACTIVITY::read(base); i++) {
+        if (i == I2C_DISABLE_POLL_COUNT) {
+            return B_BUSY;
+        }
+        spin(I2C_DISABLE_POLL_INTERVAL);
+    }
+    IC_CLR_STOP_DET::read(base);
+    device->abort_stop_pending = false;
+    return B_OK;
+}
+
+// Un trasferimento alla volta per controller, controller diversi in parallelo.
+// Chi trova il bus occupato si accoda sul semaforo, che lo sveglia in ordine
+// di arrivo; senza contesa bastano le operazioni atomiche (benaphore).
+static status_t i2c_lock_bus(i2c_device_info* device) {
+    if (atomic_add(&device->bus_waiters, 1) > 0) {
+        status_t status = acquire_sem(device->bus_sem);
+        if (status != B_OK) {
+            atomic_add(&device->bus_waiters, -1);
+            return status;
+        }
+    }
+    return B_OK;
+}
+
+static void i2c_unlock_bus(i2c_device_info* device) {
+    if (atomic_add(&device->bus_waiters, -1) > 1) {
+        release_sem(device->bus_sem);
+    }
+}
+
+// Ripresa implicita di un controller sospeso, con il bus preso
+static inline status_t i2c_wake(i2c_device_info* device) {
+    return device->suspended ? i2c_resume_locked(device) : B_OK;
+}
+
+static void i2c_start_messages(i2c_device_info* device, i2c_message* msgs, size_t count) {
+    device->msgs = msgs;
+    device->msg_count = count;
+    device->cmd_msg = 0;
+    device->cmd_pos = 0;
+    device->rx_msg = 0;
+    device->rx_pos = 0;
+    device->reads_pending = 0;
+}
+
+static inline bool i2c_messages_done(const i2c_device_info* device) {
+    return device->cmd_msg == device->msg_count && device->reads_pending == 0;
+}
+
+// Il prossimo comando può partire: una scrittura sempre, una lettura solo se
+// c'è posto nel RX FIFO per il suo byte
+static inline bool i2c_can_queue(const i2c_device_info* device) {
+    return device->cmd_msg < device->msg_count
+        && ((device->msgs[device->cmd_msg].flags & I2C_MESSAGE_READ) == 0
+            || device->reads_pending < device->rx_fifo_depth);
+}
+
+// Comando per il byte 'pos' del messaggio 'msg': il primo comando di ogni
+// messaggio dopo il primo porta RESTART, l'ultimo dell'ultimo messaggio STOP
+// (STOP_DET segna la fine della transazione)
+static inline i2c_fields<IC_DATA_CMD> i2c_message_command(const i2c_message* msgs, size_t count,
+                                                          size_t msg, size_t pos) {
+    i2c_fields<IC_DATA_CMD> command = IC_DATA_CMD::CMD::set();
+    if ((msgs[msg].flags & I2C_MESSAGE_READ) == 0) {
+        command = IC_DATA_CMD::DAT::set(msgs[msg].buf[pos]);
+    }
+    if (pos == 0 && msg > 0) {
+        command = command | IC_DATA_CMD::RESTART::set();
+    }
+    if (pos == msgs[msg].len - 1u && msg == count - 1) {
+        command = command | IC_DATA_CMD::STOP::set();
+    }
+    return command;
+}
+
+// Accoda comandi finché c'è posto nel TX FIFO: una lettura di I2C_TXFLR dà lo
+// spazio libero, poi i comandi partono uno dopo l'altro senza altri controlli.
+// Con l'handler installato va chiamata con transfer_lock preso.
+static void i2c_fill_tx(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    if (device->cmd_msg == device->msg_count) {
+        return;
+    }
+
+    uint32 level = IC_TXFLR::read(base);
+    uint32 space = level < device->tx_fifo_depth ? device->tx_fifo_depth - level : 0;
+    for (; space > 0 && i2c_can_queue(device); space--) {
+        const i2c_message& msg = device->msgs[device->cmd_msg];
+        if ((msg.flags & I2C_MESSAGE_READ) != 0) {
+            device->reads_pending++;
+        }
+        IC_DATA_CMD::write(base, i2c_message_command(device->msgs, device->msg_count,
+                                                     device->cmd_msg, device->cmd_pos));
+
+        if (++device->cmd_pos == msg.len) {
+            device->cmd_msg++;
+            device->cmd_pos = 0;
+        }
+    }
+}
+
+// Svuota il RX FIFO con una sola lettura di I2C_RXFLR per tutti i byte presenti
+static void i2c_drain_rx(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    if (device->reads_pending == 0) {
+        return;
+    }
+
+    uint32 level = IC_RXFLR::read(base);
+    for (; level > 0 && device->reads_pending > 0; level--) {
+        // Con letture in sospeso c'è un messaggio di lettura da qui in avanti
+        while ((device->msgs[device->rx_msg].flags & I2C_MESSAGE_READ) == 0) {
+            device->rx_msg++;
+        }
+        i2c_message& msg = device->msgs[device->rx_msg];
+        msg.buf[device->rx_pos] = IC_DATA_CMD::DAT::read(base);
+        device->reads_pending--;
+        if (++device->rx_pos == msg.len) {
+            device->rx_msg++;
+            device->rx_pos = 0;
+        }
+    }
+}
+
+// TX_EMPTY solo se ci sono comandi che possono partire, altrimenti con il FIFO
+// vuoto l'interrupt resterebbe sempre attivo
+static void i2c_update_mask(i2c_device_info* device) {
+    uint32 mask = I2C_INTR_DEFAULT_MASK;
+    if (i2c_can_queue(device)) {
+        mask |= IC_INTR_MASK::TX_EMPTY::mask;
+    }
+    if (mask != device->intr_mask) {
+        IC_INTR_MASK::write(device->mapped_registers, mask);
+        device->intr_mask = mask;
+    }
+}
+
+// Causa di un TX_ABRT in I2C_TX_ABRT_SOURCE. I NACK e i comandi rifiutati
+// lasciano bus e controller in ordine; l'arbitraggio perso si può ripetere
+// subito; SDA bloccato e l'abort chiesto dopo un timeout passano dal recupero.
+static status_t i2c_decode_abort(uint32 source) {
+    typedef IC_TX_ABRT_SOURCE S;
+    if ((source & (S::ABRT_7B_ADDR_NOACK::mask | S::ABRT_10ADDR1_NOACK::mask
+            | S::ABRT_10ADDR2_NOACK::mask | S::ABRT_GCALL_NOACK::mask)) != 0) {
+        return B_DEVICE_NOT_FOUND;
+    }
+    if (S::ABRT_TXDATA_NOACK::is_set(source) || S::ABRT_HS_ACKDET::is_set(source)) {
+        return B_IO_ERROR;
+    }
+    if (S::ARB_LOST::is_set(source) || S::ABRT_SDA_STUCK_AT_LOW::is_set(source)) {
+        return B_BUSY;
+    }
+    if (S::ABRT_USER_ABRT::is_set(source)) {
+        return B_TIMED_OUT;
+    }
+    // Comandi non ammessi dalla configurazione: lettura in general call, START
+    // byte o high speed senza RESTART, controller non master
+    return B_NOT_ALLOWED;
+}
+
+// Esito di un TX_ABRT; la causa resta in abort_source. Il controller ha
+// svuotato il TX FIFO e lo tiene vuoto fino alla lettura di I2C_CLR_TX_ABRT:
+// con il DMA le richieste vanno spente prima, altrimenti il canale TX
+// riempirebbe il FIFO con il resto dei comandi.
+static status_t i2c_abort_status(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    if (device->transfer_dma) {
+        IC_DMA_CR::write(base, 0);
+    }
+    uint32 source = IC_TX_ABRT_SOURCE::read(base);
+    IC_CLR_TX_ABRT::read(base);
+    device->abort_stop_pending = true;
+    device->abort_source = source;
+    return i2c_decode_abort(source);
+}
+
+// Un'attesa a polling che non avanza: finisce con un TX_ABRT o, scaduto
+// 'deadline', interrompendo la transazione sul bus
+static status_t i2c_check_stalled(i2c_device_info* device, bigtime_t deadline) {
+    void* base = device->mapped_registers;
+    if (IC_RAW_INTR_STAT::TX_ABRT::read(base)) {
+        return i2c_abort_status(device);
+    }
+    if (is_timeout(deadline)) {
+        if (device->transfer_dma) {
+            IC_DMA_CR::write(base, 0);
+        }
+        IC_ENABLE::update(base, IC_ENABLE::ABORT::set());
+        return B_TIMED_OUT;
+    }
+    return B_OK;
+}
+
+// Fine di una transazione senza handler, da I2C_RAW_INTR_STAT: STOP_DET dopo
+// l'ultimo comando, o TX_ABRT se l'ultimo byte scritto non ha avuto ACK
+static status_t i2c_wait_stop_polled(i2c_device_info* device, bigtime_t deadline,
+                                     bigtime_t interval) {
+    void* base = device->mapped_registers;
+    for (;;) {
+        if (IC_RAW_INTR_STAT::STOP_DET::read(base)) {
+            // Un TX_ABRT arriva prima del suo STOP
+            if (IC_RAW_INTR_STAT::TX_ABRT::read(base)) {
+                return i2c_abort_status(device);
+            }
+            IC_CLR_STOP_DET::read(base);
+            return B_OK;
+        }
+        status_t status = i2c_check_stalled(device, deadline);
+        if (status != B_OK) {
+            return status;
+        }
+        snooze(interval);
+    }
+}
+
+// Senza handler: stesso riempimento e svuotamento dei FIFO, a polling. Un
+// TX_ABRT si cerca solo quando i FIFO non avanzano: dopo un abort le letture
+// accodate non arriverebbero mai.
+static status_t i2c_transfer_polled(i2c_device_info* device, bigtime_t deadline) {
+    while (!i2c_messages_done(device)) {
+        size_t queued = device->cmd_msg;
+        size_t position = device->cmd_pos;
+        size_t pending = device->reads_pending;
+        i2c_fill_tx(device);
+        i2c_drain_rx(device);
+        if (device->cmd_msg == queued && device->cmd_pos == position
+            && device->reads_pending == pending) {
+            status_t status = i2c_check_stalled(device, deadline);
+            if (status != B_OK) {
+                return status;
+            }
+            snooze(1);
+        }
+    }
+    return i2c_wait_stop_polled(device, deadline, 1);
+}
+
+static status_t i2c_push_command(i2c_device_info* device, i2c_fields<IC_DATA_CMD> command,
+                                 bigtime_t deadline) {
+    while (!IC_STATUS::TFNF::read(device->mapped_registers)) { // Attendi che il TX FIFO non sia pieno
+        status_t status = i2c_check_stalled(device, deadline);
+        if (status != B_OK) {
+            return status;
+        }
+        snooze(1);
+    }
+    IC_DATA_CMD::write(device->mapped_registers, command);
+    return B_OK;
+}
+
+static status_t i2c_read_byte(i2c_device_info* device, bool restart, uint8* value,
+                              bigtime_t deadline) {
+    i2c_fields<IC_DATA_CMD> command = IC_DATA_CMD::CMD::set() // Comando di lettura
+        | IC_DATA_CMD::RESTART::set(restart ? 1 : 0);
+    status_t status = i2c_push_command(device, command, deadline);
+    if (status != B_OK) {
+        return status;
+    }
+
+    while (!IC_STATUS::RFNE::read(device->mapped_registers)) { // Attendi che il RX FIFO non sia vuoto
+        status = i2c_check_stalled(device, deadline);
+        if (status != B_OK) {
+            return status;
+        }
+        snooze(1);
+    }
+    *value = IC_DATA_CMD::DAT::read(device->mapped_registers);
+    return B_OK;
+}
+
+// Fine del trasferimento: interrupt mascherati e thread in attesa svegliato
+static void i2c_complete_transfer(i2c_device_info* device, status_t status) {
+    IC_INTR_MASK::write(device->mapped_registers, 0);
+    device->intr_mask = 0;
+    device->transfer_status = status;
+    device->transfer_active = false;
+    release_sem_etc(device->transfer_sem, 1, B_DO_NOT_RESCHEDULE);
+}
+
+int32 i2c_interrupt_handler(void* data) {
+    i2c_device_info* device = (i2c_device_info*)data;
+    void* base = device->mapped_registers;
+
+    // Linea condivisa: con il controller nel reset l'interrupt è di un altro
+    if (device->suspended) {
+        return B_UNHANDLED_INTERRUPT;
+    }
+
+    // Linea condivisa: nessun bit attivo, l'interrupt non è nostro
+    uint32 status = IC_INTR_STAT::read(base);
+    if (status == 0) {
+        return B_UNHANDLED_INTERRUPT;
+    }
+
+    acquire_spinlock(&device->transfer_lock);
+    if (!device->transfer_active) {
+        // Trasferimento già chiuso (timeout): si spegne tutto
+        IC_INTR_MASK::write(base, 0);
+        device->intr_mask = 0;
+        IC_CLR_INTR::read(base);
+        release_spinlock(&device->transfer_lock);
+        return B_HANDLED_INTERRUPT;
+    }
+
+    if (IC_INTR_STAT::TX_ABRT::is_set(status)) {
+        i2c_complete_transfer(device, i2c_abort_status(device));
+        release_spinlock(&device->transfer_lock);
+        return B_INVOKE_SCHEDULER;
+    }
+
+    if (device->transfer_dma) {
+        // I FIFO sono del DMA: resta solo da riconoscere la fine
+        if (IC_INTR_STAT::STOP_DET::is_set(status)) {
+            IC_CLR_STOP_DET::read(base);
+            i2c_complete_transfer(device, B_OK);
+            release_spinlock(&device->transfer_lock);
+            return B_INVOKE_SCHEDULER;
+        }
+        release_spinlock(&device->transfer_lock);
+        return B_HANDLED_INTERRUPT;
+    }
+
+    // I dati arrivati liberano posto per altre letture
+    i2c_drain_rx(device);
+
+    if (IC_INTR_STAT::STOP_DET::is_set(status)) {
+        IC_CLR_STOP_DET::read(base);
+        i2c_complete_transfer(device, i2c_messages_done(device) ? B_OK : B_IO_ERROR);
+        release_spinlock(&device->transfer_lock);
+        return B_INVOKE_SCHEDULER;
+    }
+
+    // TX_EMPTY e RX_FULL si azzerano da soli quando cambia il livello del FIFO
+    i2c_fill_tx(device);
+    i2c_update_mask(device);
+    release_spinlock(&device->transfer_lock);
+    return B_HANDLED_INTERRUPT;
+}
+
+static inline bigtime_t i2c_transfer_timeout(const i2c_device_info* device, size_t count,
+                                             size_t bytes) {
+    return I2C_TRANSFER_TIMEOUT + (count + bytes) * device->byte_time;
+}
+
+// Attesa della fine di un trasferimento avviato con transfer_active: se scade
+// il timeout il trasferimento viene chiuso qui e interrotto sul bus
+static status_t i2c_wait_transfer(i2c_device_info* device, bigtime_t timeout) {
+    void* base = device->mapped_registers;
+    if (acquire_sem_etc(device->transfer_sem, 1, B_RELATIVE_TIMEOUT, timeout) == B_OK) {
+        return device->transfer_status;
+    }
+
+    cpu_status state = disable_interrupts();
+    acquire_spinlock(&device->transfer_lock);
+    bool expired = device->transfer_active;
+    if (expired) {
+        device->transfer_active = false;
+        IC_INTR_MASK::write(base, 0);
+        device->intr_mask = 0;
+        if (device->transfer_dma) {
+            IC_DMA_CR::write(base, 0);
+        }
+        IC_ENABLE::update(base, IC_ENABLE::ABORT::set());
+    }
+    release_spinlock(&device->transfer_lock);
+    restore_interrupts(state);
+
+    if (expired) {
+        return B_TIMED_OUT;
+    }
+    // L'handler ha completato dopo il timeout: il semaforo è già stato rilasciato
+    acquire_sem(device->transfer_sem);
+    return device->transfer_status;
+}
+
+// Trasferimento a interrupt: il FIFO viene riempito qui, poi l'handler lo
+// alimenta e svuota il RX FIFO; il thread dorme fino a STOP_DET o TX_ABRT
+static status_t i2c_transfer_interrupt(i2c_device_info* device, i2c_message* msgs,
+                                       size_t count, size_t bytes) {
+    void* base = device->mapped_registers;
+
+    cpu_status state = disable_interrupts();
+    acquire_spinlock(&device->transfer_lock);
+    i2c_start_messages(device, msgs, count);
+    device->transfer_status = B_OK;
+    device->transfer_active = true;
+    IC_CLR_INTR::read(base);
+    i2c_fill_tx(device);
+    i2c_update_mask(device);
+    release_spinlock(&device->transfer_lock);
+    restore_interrupts(state);
+
+    return i2c_wait_transfer(device, i2c_transfer_timeout(device, count, bytes));
+}
+
+// Trasferimento DMA: i comandi vengono preparati nel bounce buffer, il canale
+// TX li scrive in I2C_DATA_CMD quando il controller chiede dati (I2C_DMA_TDLR)
+// e il canale RX raccoglie i byte ricevuti (I2C_DMA_RDLR). La CPU interviene
+// solo all'inizio e a STOP_DET, che arriva dopo l'ultimo comando.
+static status_t i2c_transfer_dma(i2c_device_info* device, i2c_message* msgs, size_t count,
+                                 size_t bytes) {
+    void* base = device->mapped_registers;
+    const i2c_dma_ops* ops = device->dma_ops;
+    uint32* commands = (uint32*)device->dma_buffer;
+
+    size_t reads = 0;
+    size_t command = 0;
+    for (size_t i = 0; i < count; i++) {
+        if ((msgs[i].flags & I2C_MESSAGE_READ) != 0) {
+            reads += msgs[i].len;
+        }
+        for (size_t j = 0; j < msgs[i].len; j++) {
+            commands[command++] = i2c_message_command(msgs, count, i, j).value;
+        }
+    }
+
+    IC_DMA_TDLR::write(base, device->tx_fifo_depth - I2C_DMA_TX_BURST);
+    IC_DMA_RDLR::write(base, 0);
+
+    status_t status = B_OK;
+    if (reads > 0) {
+        status = ops->start(device, I2C_DMA_RX, device->dma_physical + I2C_DMA_RX_OFFSET, reads);
+    }
+    if (status == B_OK) {
+        status = ops->start(device, I2C_DMA_TX, device->dma_physical, command);
+        if (status != B_OK && reads > 0) {
+            ops->stop(device, I2C_DMA_RX);
+        }
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    i2c_fields<IC_DMA_CR> requests = IC_DMA_CR::TDMAE::set()
+        | IC_DMA_CR::RDMAE::set(reads > 0 ? 1 : 0);
+    bigtime_t timeout = i2c_transfer_timeout(device, count, bytes);
+    if (device->transfer_sem >= B_OK) {
+        cpu_status state = disable_interrupts();
+        acquire_spinlock(&device->transfer_lock);
+        device->transfer_dma = true;
+        device->transfer_status = B_OK;
+        device->transfer_active = true;
+        IC_CLR_INTR::read(base);
+        IC_INTR_MASK::write(base, I2C_INTR_DMA_MASK);
+        device->intr_mask = I2C_INTR_DMA_MASK;
+        IC_DMA_CR::write(base, requests);
+        release_spinlock(&device->transfer_lock);
+        restore_interrupts(state);
+
+        status = i2c_wait_transfer(device, timeout);
+    } else {
+        device->transfer_dma = true;
+        IC_CLR_INTR::read(base);
+        IC_DMA_CR::write(base, requests);
+        // Senza handler la fine si legge da I2C_RAW_INTR_STAT, un controllo a byte
+        status = i2c_wait_stop_polled(device, calculate_timeout(timeout), device->byte_time);
+    }
+
+    // Allo STOP gli ultimi byte possono essere ancora nel RX FIFO
+    if (status == B_OK && reads > 0) {
+        bigtime_t deadline = calculate_timeout(device->byte_time);
+        while ((status = ops->status(device, I2C_DMA_RX)) == B_BUSY) {
+            if (is_timeout(deadline)) {
+                status = B_TIMED_OUT;
+                break;
+            }
+            spin(1);
+        }
+    }
+
+    IC_DMA_CR::write(base, 0);
+    device->transfer_dma = false;
+    ops->stop(device, I2C_DMA_TX);
+    if (reads > 0) {
+        ops->stop(device, I2C_DMA_RX);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    const uint8* received = device->dma_buffer + I2C_DMA_RX_OFFSET;
+    for (size_t i = 0; i < count; i++) {
+        if ((msgs[i].flags & I2C_MESSAGE_READ) != 0) {
+            memcpy(msgs[i].buf, received, msgs[i].len);
+            received += msgs[i].len;
+        }
+    }
+    return B_OK;
+}
+
+// Livello 1 del recupero: spegnere il controller chiude la transazione in
+// corso con uno STOP e svuota i FIFO. Un ENABLE.ABORT si azzera da solo quando
+// l'abort è finito; se non finisce il bus è bloccato.
+static status_t i2c_flush(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    for (int i = 0; IC_ENABLE::ABORT::read(base); i++) {
+        if (i == I2C_DISABLE_POLL_COUNT) {
+            return B_BUSY;
+        }
+        spin(I2C_DISABLE_POLL_INTERVAL);
+    }
+    status_t status = i2c_disable(device);
+    if (status != B_OK) {
+        return status;
+    }
+    IC_CLR_INTR::read(base);
+    device->abort_stop_pending = false;
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::set());
+    return B_OK;
+}
+
+// Livello 2: bus clear. Uno slave fermo a metà di un byte tiene SDA basso; il
+// controller manda impulsi su SCL finché SDA non si libera, poi uno STOP, e
+// azzera SDA_STUCK_RECOVERY_ENABLE alla fine.
+static status_t i2c_bus_clear(i2c_device_info* device) {
+    if (!device->bus_clear) {
+        return B_NOT_SUPPORTED;
+    }
+
+    void* base = device->mapped_registers;
+    IC_ENABLE::update(base, IC_ENABLE::ENABLE::set()
+        | IC_ENABLE::SDA_STUCK_RECOVERY_ENABLE::set());
+    bigtime_t deadline = calculate_timeout(I2C_BUS_CLEAR_BYTES * device->byte_time);
+    while (IC_ENABLE::SDA_STUCK_RECOVERY_ENABLE::read(base)) {
+        if (is_timeout(deadline)) {
+            return B_TIMED_OUT;
+        }
+        spin(1);
+    }
+    if (IC_STATUS::SDA_STUCK_NOT_RECOVERED::read(base)) {
+        return B_BUSY;
+    }
+    return i2c_flush(device);
+}
+
+// Livello 3: reset della funzione LPSS e nuova programmazione con la
+// configurazione attuale. L'handler di interrupt e il DMA restano installati.
+static status_t i2c_reinit(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    i2c_controller_config config;
+    i2c_controller_get_config(device, &config);
+
+    // Scritture esplicite: FUNC può leggere 0 anche fuori dal reset
+    uint32 resets = LPSS_RESETS::read(base) & ~LPSS_RESETS::FUNC::mask;
+    LPSS_RESETS::write(base, resets);
+    LPSS_RESETS::write(base, resets | LPSS_RESETS::FUNC::set(3).value);
+    status_t status = i2c_program_controller(device, &config);
+    if (status != B_OK) {
+        return status;
+    }
+    return IC_STATUS::ACTIVITY::read(base) ? B_BUSY : B_OK;
+}
+
+// Ripristino dopo un errore che lascia controller o bus in uno stato incerto:
+// dal livello più rapido al più lento, fermandosi al primo che riesce. Con
+// SDA bloccato lo spegnimento non può finire: si parte dal bus clear.
+static status_t i2c_recover(i2c_device_info* device) {
+    bool sda_stuck = IC_TX_ABRT_SOURCE::ABRT_SDA_STUCK_AT_LOW::is_set(device->abort_source);
+    if (!sda_stuck && i2c_flush(device) == B_OK) {
+        device->flushes++;
+        return B_OK;
+    }
+    if (i2c_bus_clear(device) == B_OK) {
+        device->bus_clears++;
+        return B_OK;
+    }
+    status_t status = i2c_reinit(device);
+    device->reinits++;
+    if (status != B_OK) {
+        dprintf(DRIVER_NAME ": %s: bus still busy after a controller reset\n", device->name);
+    }
+    return status;
+}
+
+// Dopo una transazione fallita: true se va ripetuta. Solo l'arbitraggio perso
+// si ripete; un TX_ABRT decodificato lascia il controller in ordine, tranne
+// SDA bloccato e l'abort chiesto dal driver; il resto (timeout, bus che non
+// si libera, dati incoerenti) passa da i2c_recover.
+static bool i2c_handle_failure(i2c_device_info* device, uint32 attempt) {
+    typedef IC_TX_ABRT_SOURCE S;
+    uint32 source = device->abort_source;
+    if (S::ARB_LOST::is_set(source)) {
+        if (attempt >= I2C_ARBITRATION_RETRIES) {
+            return false;
+        }
+        device->retries++;
+        return true;
+    }
+    if (source == 0 || S::ABRT_SDA_STUCK_AT_LOW::is_set(source)
+        || S::ABRT_USER_ABRT::is_set(source)) {
+        i2c_recover(device);
+    }
+    return false;
+}
+
+// Una transazione verso un solo indirizzo
+static status_t i2c_transfer_transaction(i2c_device_info* device, i2c_message* msgs,
+                                         size_t count, size_t bytes) {
+    status_t status = i2c_wait_abort_stop(device);
+    if (status == B_OK) {
+        status = i2c_set_target(device, msgs[0].addr,
+            (msgs[0].flags & I2C_MESSAGE_TEN_BIT) != 0);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+    // Il DMA solo per i trasferimenti lunghi: i brevi restano in PIO
+    if (device->dma_ops != NULL && bytes >= I2C_DMA_THRESHOLD
+        && bytes <= I2C_DMA_MAX_LENGTH) {
+        return i2c_transfer_dma(device, msgs, count, bytes);
+    }
+    if (device->transfer_sem >= B_OK) {
+        return i2c_transfer_interrupt(device, msgs, count, bytes);
+    }
+    IC_CLR_INTR::read(device->mapped_registers);
+    i2c_start_messages(device, msgs, count);
+    return i2c_transfer_polled(device,
+        calculate_timeout(i2c_transfer_timeout(device, count, bytes)));
+}
 
+// Va chiamata con il bus del controller preso
+static status_t i2c_transfer_messages(i2c_device_info* device, i2c_message* msgs,
+                                      size_t count) {
+    // Una transazione per ogni sequenza di messaggi allo stesso indirizzo
+    size_t first = 0;
+    while (first < count) {
+        size_t end = first + 1;
+        while (end < count && msgs[end].addr == msgs[first].addr
+            && ((msgs[end].flags ^ msgs[first].flags) & I2C_MESSAGE_TEN_BIT) == 0) {
+            end++;
+        }
+
+        size_t bytes = 0;
+        for (size_t i = first; i < end; i++) {
+            bytes += msgs[i].len;
+        }
+
+        status_t status;
+        for (uint32 attempt = 0; ; attempt++) {
+            device->abort_source = 0;
+            status = i2c_transfer_transaction(device, msgs + first, end - first, bytes);
+            if (status == B_OK || !i2c_handle_failure(device, attempt)) {
+                break;
+            }
+        }
+        if (status != B_OK) {
+            return status;
+        }
+        first = end;
+    }
     return B_OK;
 }
 
+status_t i2c_transfer(i2c_device_info* device, i2c_message* msgs, size_t count) {
+    if (!device || (!msgs && count > 0)) {
+        return B_BAD_VALUE;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint16 max = (msgs[i].flags & I2C_MESSAGE_TEN_BIT) != 0 ? 0x3FF : 0x7F;
+        if (msgs[i].buf == NULL || msgs[i].addr > max) {
+            return B_BAD_VALUE;
+        }
+        if (msgs[i].len == 0) {
+            return B_NOT_SUPPORTED;
+        }
+    }
+
+    status_t status = i2c_lock_bus(device);
+    if (status != B_OK) {
+        return status;
+    }
+    status = i2c_wake(device);
+    if (status == B_OK) {
+        status = i2c_transfer_messages(device, msgs, count);
+    }
+    device->last_activity = system_time();
+    i2c_unlock_bus(device);
+    return status;
+}
+
 status_t i2c_transfer(i2c_device_info* device, int addr, const uint8* write_buf, size_t write_len, uint8* read_buf, size_t read_len) {
-    if (!device || (!write_buf && write_len > 0) || (!read_buf && read_len > 0)) {
+    if (!device || (!write_buf && write_len > 0) || (!read_buf && read_len > 0)
+        || write_len > 0xFFFF || read_len > 0xFFFF) {
         return B_BAD_VALUE;
     }
 
-    // Imposta l'indirizzo del dispositivo slave
-    write32(device->mapped_registers + I2C_TAR, addr);
+    // Scrittura e lettura con RESTART in mezzo, senza STOP
+    uint16 flags = device->addressing_mode == I2C_ADDRESSING_10BIT ? I2C_MESSAGE_TEN_BIT : 0;
+    i2c_message msgs[2];
+    size_t count = 0;
+    if (write_len > 0) {
+        msgs[count].addr = addr;
+        msgs[count].flags = flags;
+        msgs[count].len = write_len;
+        msgs[count].buf = const_cast<uint8*>(write_buf);
+        count++;
+    }
+    if (read_len > 0) {
+        msgs[count].addr = addr;
+        msgs[count].flags = flags | I2C_MESSAGE_READ;
+        msgs[count].len = read_len;
+        msgs[count].buf = read_buf;
+        count++;
+    }
+    return i2c_transfer(device, msgs, count);
+}
+
+static status_t i2c_transfer_block_once(i2c_device_info* device, int addr,
+                                        const uint8* write_buf, size_t write_len,
+                                        uint8* read_buf, size_t extra) {
+    status_t status = i2c_wait_abort_stop(device);
+    if (status == B_OK) {
+        status = i2c_set_target(device, addr, false);
+    }
+    if (status != B_OK) {
+        return status;
+    }
 
-    // Scrittura
+    void* base = device->mapped_registers;
+    IC_CLR_INTR::read(base);
+    bigtime_t deadline = calculate_timeout(i2c_transfer_timeout(device, 2,
+        write_len + I2C_SMBUS_BLOCK_MAX + extra));
     for (size_t i = 0; i < write_len; i++) {
-        while (!(read32(device->mapped_registers + I2C_STATUS) & 0x2)) { // Attendi che il TX FIFO non sia pieno
-            snooze(1);
+        status = i2c_push_command(device, IC_DATA_CMD::DAT::set(write_buf[i]), deadline);
+        if (status != B_OK) {
+            return status;
         }
-        write32(device->mapped_registers + I2C_DATA_CMD, write_buf[i]);
     }
 
-    // Lettura
-    for (size_t i = 0; i < read_len; i++) {
-        while (!(read32(device->mapped_registers + I2C_STATUS) & 0x2)) { // Attendi che il TX FIFO non sia pieno
-            snooze(1);
+    // Il primo byte è il conteggio: decide quanti byte leggere ancora
+    status = i2c_read_byte(device, write_len > 0, &read_buf[0], deadline);
+    if (status != B_OK) {
+        return status;
+    }
+    if (read_buf[0] == 0 || read_buf[0] > I2C_SMBUS_BLOCK_MAX) {
+        // La lettura è ancora aperta: la chiude l'abort, il resto il recupero
+        IC_ENABLE::update(base, IC_ENABLE::ABORT::set());
+        return B_BAD_DATA;
+    }
+
+    // Il resto continua la stessa lettura, con lo STOP sull'ultimo byte
+    i2c_message tail;
+    tail.addr = addr;
+    tail.flags = I2C_MESSAGE_READ;
+    tail.len = read_buf[0] + extra - 1;
+    tail.buf = read_buf + 1;
+    i2c_start_messages(device, &tail, 1);
+    return i2c_transfer_polled(device, deadline);
+}
+
+// Va chiamata con il bus del controller preso
+static status_t i2c_transfer_block_locked(i2c_device_info* device, int addr,
+                                          const uint8* write_buf, size_t write_len,
+                                          uint8* read_buf, size_t extra) {
+    status_t status;
+    for (uint32 attempt = 0; ; attempt++) {
+        device->abort_source = 0;
+        status = i2c_transfer_block_once(device, addr, write_buf, write_len, read_buf, extra);
+        if (status == B_OK || !i2c_handle_failure(device, attempt)) {
+            return status;
         }
-        write32(device->mapped_registers + I2C_DATA_CMD, 0x100); // Comando di lettura
+    }
+}
 
-        while (!(read32(device->mapped_registers + I2C_STATUS) & 0x8)) { // Attendi che il RX FIFO non sia vuoto
-            snooze(1);
+status_t i2c_transfer_block(i2c_device_info* device, int addr, const uint8* write_buf, size_t write_len, uint8* read_buf, size_t extra) {
+    if (!device || (!write_buf && write_len > 0) || !read_buf || extra < 1 || addr > 0x7F) {
+        return B_BAD_VALUE;
+    }
+
+    status_t status = i2c_lock_bus(device);
+    if (status != B_OK) {
+        return status;
+    }
+    status = i2c_wake(device);
+    if (status == B_OK) {
+        status = i2c_transfer_block_locked(device, addr, write_buf, write_len, read_buf, extra);
+    }
+    device->last_activity = system_time();
+    i2c_unlock_bus(device);
+    return status;
+}
+
+status_t i2c_read_register(i2c_device_info* device, uint8 slave_addr, uint8 reg_addr, uint8* data, size_t length) {
+    return i2c_transfer(device, slave_addr, &reg_addr, 1, data, length);
+}
+
+status_t i2c_write_register(i2c_device_info* device, uint8 slave_addr, uint8 reg_addr, const uint8* data, size_t length) {
+    if (!device || (!data && length > 0) || length > 0xFFFF - 1) {
+        return B_BAD_VALUE;
+    }
+
+    // Registro e dati nello stesso messaggio: una scrittura sola, senza RESTART
+    uint8 local[I2C_SMBUS_BLOCK_MAX + 1];
+    uint8* buffer = local;
+    if (length + 1 > sizeof(local)) {
+        buffer = (uint8*)malloc(length + 1);
+        if (buffer == NULL) {
+            return B_NO_MEMORY;
         }
-        read_buf[i] = read32(device->mapped_registers + I2C_DATA_CMD) & 0xFF;
     }
+    buffer[0] = reg_addr;
+    if (length > 0) {
+        memcpy(buffer + 1, data, length);
+    }
+
+    status_t status = i2c_transfer(device, slave_addr, buffer, length + 1, NULL, 0);
+    if (buffer != local) {
+        free(buffer);
+    }
+    return status;
+}
+
+// Tempi della specifica I2C per ogni modalità (ns): minimi di SCL alto e
+// basso, massimi di salita e discesa (usati se la configurazione non indica
+// quelli della scheda) e durata dei disturbi da filtrare sugli ingressi
+typedef struct {
+    uint32 max_speed;
+    uint32 con_speed;       // valore di IC_CON::SPEED
+    uint32 high_min;
+    uint32 low_min;
+    uint32 rise_max;
+    uint32 fall_max;
+    uint32 spike_max;
+} i2c_speed_mode;
+
+static const i2c_speed_mode sSpeedModes[] = {
+    { I2C_SPEED_STANDARD,  IC_CON::SPEED_STANDARD, 4000, 4700, 1000, 300, 50 },
+    { I2C_SPEED_FAST,      IC_CON::SPEED_FAST,      600, 1300,  300, 300, 50 },
+    { I2C_SPEED_FAST_PLUS, IC_CON::SPEED_FAST,      260,  500,  120, 120, 50 },
+    { I2C_SPEED_HIGH,      IC_CON::SPEED_HIGH,       60,  160,   40,  40, 10 },
+};
+
+typedef struct {
+    uint32 hcnt;
+    uint32 lcnt;
+    uint32 spklen;
+    uint32 period;          // periodo risultante di SCL (ns)
+} i2c_scl_timing;
+
+static const i2c_speed_mode* i2c_find_speed_mode(uint32 speed) {
+    for (size_t i = 0; i < sizeof(sSpeedModes) / sizeof(sSpeedModes[0]); i++) {
+        if (speed <= sSpeedModes[i].max_speed) {
+            return &sSpeedModes[i];
+        }
+    }
+    return NULL;
+}
+
+static inline uint32 i2c_ns_to_cycles(uint32 clock_rate, uint32 ns) {
+    return (uint32)(((uint64)clock_rate * ns + 999999999) / 1000000000);
+}
+
+// Conteggi di SCL per 'speed'. Dal databook SCL resta alto HCNT + SPKLEN + 7
+// cicli di ic_clk, contati da quando il controller lo vede alto, cioè dopo la
+// salita, e basso LCNT + 1 cicli, discesa compresa. Il periodo meno la salita
+// va quindi diviso tra alto e basso: prima i minimi della specifica (al basso
+// si aggiunge la discesa), poi il resto in proporzione ai minimi o secondo
+// 'duty'. Se i minimi non ci stanno la frequenza resta sotto quella chiesta.
+static status_t i2c_compute_scl(const i2c_device_info* device, uint32 speed,
+                                const i2c_speed_mode* mode, uint32 rise, uint32 fall,
+                                uint32 duty, i2c_scl_timing* timing) {
+    uint32 clock = device->clock_rate;
+    uint32 period = (1000000000 + speed - 1) / speed;
+    uint32 available = period > rise ? period - rise : 0;
+    uint32 high_min = mode->high_min;
+    uint32 low_min = mode->low_min + fall;
+
+    uint32 high = high_min;
+    if (available > high_min + low_min) {
+        if (duty != 0) {
+            high = available * duty / 100;
+        } else {
+            high += (uint32)((uint64)(available - high_min - low_min) * mode->high_min
+                / (mode->high_min + mode->low_min));
+        }
+        if (high < high_min) {
+            high = high_min;
+        } else if (available - high < low_min) {
+            high = available - low_min;
+        }
+    }
+    uint32 low = available > high + low_min ? available - high : low_min;
+
+    // I disturbi filtrati non devono superare spike_max
+    uint32 spklen = (uint32)((uint64)clock * mode->spike_max / 1000000000);
+    if (spklen < 1) {
+        spklen = 1;
+    }
+
+    // Minimi del controller: HCNT >= SPKLEN + 5, LCNT >= SPKLEN + 7
+    uint32 high_cycles = i2c_ns_to_cycles(clock, high);
+    uint32 low_cycles = i2c_ns_to_cycles(clock, low);
+    timing->hcnt = high_cycles > 2 * spklen + 12 ? high_cycles - spklen - 7 : spklen + 5;
+    timing->lcnt = low_cycles > spklen + 8 ? low_cycles - 1 : spklen + 7;
+    timing->spklen = spklen;
+    if (timing->hcnt > 0xFFFF || timing->lcnt > 0xFFFF || spklen > 0xFF) {
+        return B_BAD_VALUE;
+    }
+
+    uint64 cycles = timing->hcnt + spklen + 7 + timing->lcnt + 1;
+    timing->period = (uint32)((cycles * 1000000000 + clock - 1) / clock) + rise;
+    return B_OK;
+}
+
+// Corpo di i2c_controller_set_config, senza il bus: serve anche al recupero
+static status_t i2c_apply_config(i2c_device_info* device, const i2c_controller_config* config) {
+    if (config->speed < I2C_SPEED_MIN
+        || config->duty_cycle > 99
+        || (config->addressing_mode != I2C_ADDRESSING_7BIT
+            && config->addressing_mode != I2C_ADDRESSING_10BIT)) {
+        return B_BAD_VALUE;
+    }
+    const i2c_speed_mode* mode = i2c_find_speed_mode(config->speed);
+    if (mode == NULL || mode->con_speed > device->max_speed_mode) {
+        return B_NOT_SUPPORTED;
+    }
+
+    uint32 rise = config->scl_rise_time != 0 ? config->scl_rise_time : mode->rise_max;
+    uint32 fall = config->scl_fall_time != 0 ? config->scl_fall_time : mode->fall_max;
+    i2c_scl_timing timing;
+    status_t status = i2c_compute_scl(device, config->speed, mode, rise, fall,
+                                      config->duty_cycle, &timing);
+    if (status != B_OK) {
+        return status;
+    }
+
+    // In high speed il codice master viene mandato in fast mode: servono anche
+    // i conteggi dei 400 kHz
+    i2c_scl_timing fast;
+    if (mode->con_speed == IC_CON::SPEED_HIGH) {
+        const i2c_speed_mode* fastMode = i2c_find_speed_mode(I2C_SPEED_FAST);
+        status = i2c_compute_scl(device, I2C_SPEED_FAST, fastMode,
+            config->scl_rise_time != 0 ? config->scl_rise_time : fastMode->rise_max,
+            config->scl_fall_time != 0 ? config->scl_fall_time : fastMode->fall_max,
+            0, &fast);
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    status = i2c_disable(device);
+    if (status != B_OK) {
+        return status;
+    }
+
+    void* base = device->mapped_registers;
+    IC_CON::update(base, IC_CON::SPEED::set(mode->con_speed));
+    switch (mode->con_speed) {
+        case IC_CON::SPEED_STANDARD:
+            IC_SS_SCL_HCNT::write(base, timing.hcnt);
+            IC_SS_SCL_LCNT::write(base, timing.lcnt);
+            IC_FS_SPKLEN::write(base, IC_FS_SPKLEN::SPKLEN::set(timing.spklen));
+            break;
+        case IC_CON::SPEED_FAST:
+            IC_FS_SCL_HCNT::write(base, timing.hcnt);
+            IC_FS_SCL_LCNT::write(base, timing.lcnt);
+            IC_FS_SPKLEN::write(base, IC_FS_SPKLEN::SPKLEN::set(timing.spklen));
+            break;
+        case IC_CON::SPEED_HIGH:
+            IC_FS_SCL_HCNT::write(base, fast.hcnt);
+            IC_FS_SCL_LCNT::write(base, fast.lcnt);
+            IC_FS_SPKLEN::write(base, IC_FS_SPKLEN::SPKLEN::set(fast.spklen));
+            IC_HS_SCL_HCNT::write(base, timing.hcnt);
+            IC_HS_SCL_LCNT::write(base, timing.lcnt);
+            IC_HS_SPKLEN::write(base, IC_HS_SPKLEN::SPKLEN::set(timing.spklen));
+            break;
+    }
+
+    // SDA cambia dopo la discesa di SCL, e prima della fine del periodo basso
+    uint32 hold = i2c_ns_to_cycles(device->clock_rate, fall);
+    if (hold > timing.lcnt - 2) {
+        hold = timing.lcnt - 2;
+    }
+    IC_SDA_HOLD::update(base, IC_SDA_HOLD::SDA_TX_HOLD::set(hold > 0 ? hold : 1));
+
+    // Senza bus clear il controller non rileva SDA bloccato: i valori di reset
+    // restano
+    if (device->bus_clear) {
+        uint32 byte_ns = 9 * timing.period;
+        IC_SCL_STUCK_AT_LOW_TIMEOUT::write(base, i2c_ns_to_cycles(device->clock_rate,
+            I2C_SCL_STUCK_TIMEOUT_BYTES * byte_ns));
+        IC_SDA_STUCK_AT_LOW_TIMEOUT::write(base, i2c_ns_to_cycles(device->clock_rate,
+            I2C_SDA_STUCK_TIMEOUT_BYTES * byte_ns));
+    }
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::set());
+
+    device->bus_speed = config->speed;
+    device->addressing_mode = config->addressing_mode;
+    device->duty_cycle = config->duty_cycle;
+    device->scl_rise_time = config->scl_rise_time;
+    device->scl_fall_time = config->scl_fall_time;
+    // Nove periodi per byte, arrotondati al µs successivo
+    device->byte_time = (9 * (bigtime_t)timing.period + 999) / 1000;
 
+    dprintf(DRIVER_NAME ": Bus at %" B_PRIu32 " Hz (SCL period %" B_PRIu32 " ns, "
+            "HCNT %" B_PRIu32 ", LCNT %" B_PRIu32 ")\n", config->speed, timing.period,
+            timing.hcnt, timing.lcnt);
+    return B_OK;
+}
+
+status_t i2c_controller_set_config(i2c_device_info* device, i2c_controller_config* config) {
+    if (device == NULL || config == NULL) {
+        return B_BAD_VALUE;
+    }
+    status_t status = i2c_lock_bus(device);
+    if (status != B_OK) {
+        return status;
+    }
+    status = i2c_wake(device);
+    if (status == B_OK) {
+        status = i2c_apply_config(device, config);
+    }
+    i2c_unlock_bus(device);
+    return status;
+}
+
+status_t i2c_controller_get_config(i2c_device_info* device, i2c_controller_config* config) {
+    if (device == NULL || config == NULL) {
+        return B_BAD_VALUE;
+    }
+    config->speed = device->bus_speed;
+    config->addressing_mode = device->addressing_mode;
+    config->duty_cycle = device->duty_cycle;
+    config->scl_rise_time = device->scl_rise_time;
+    config->scl_fall_time = device->scl_fall_time;
+    return B_OK;
+}
+
+// Sospensione: controller spento e funzione LPSS tenuta nel reset, che ferma
+// il clock del blocco. Il reset azzera i registri di configurazione: quelli che
+// servono vengono salvati prima e riscritti alla ripresa, senza ricalcolare i
+// conteggi di SCL né rileggere i parametri di sintesi.
+static status_t i2c_suspend_locked(i2c_device_info* device) {
+    status_t status = i2c_wait_abort_stop(device);
+    if (status == B_OK) {
+        status = i2c_disable(device);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    void* base = device->mapped_registers;
+    IC_INTR_MASK::write(base, 0);
+    device->intr_mask = 0;
+
+    i2c_controller_context* context = &device->saved_context;
+    context->con = IC_CON::read(base);
+    context->tar = IC_TAR::read(base);
+    context->ss_scl_hcnt = IC_SS_SCL_HCNT::read(base);
+    context->ss_scl_lcnt = IC_SS_SCL_LCNT::read(base);
+    context->fs_scl_hcnt = IC_FS_SCL_HCNT::read(base);
+    context->fs_scl_lcnt = IC_FS_SCL_LCNT::read(base);
+    context->hs_scl_hcnt = IC_HS_SCL_HCNT::read(base);
+    context->hs_scl_lcnt = IC_HS_SCL_LCNT::read(base);
+    context->fs_spklen = IC_FS_SPKLEN::read(base);
+    context->hs_spklen = IC_HS_SPKLEN::read(base);
+    context->sda_hold = IC_SDA_HOLD::read(base);
+    context->scl_stuck_timeout = IC_SCL_STUCK_AT_LOW_TIMEOUT::read(base);
+    context->sda_stuck_timeout = IC_SDA_STUCK_AT_LOW_TIMEOUT::read(base);
+    context->tx_tl = IC_TX_TL::read(base);
+    context->rx_tl = IC_RX_TL::read(base);
+
+    // Solo FUNC: il reset del DMA resta com'è e i suoi canali programmati
+    LPSS_RESETS::write(base, LPSS_RESETS::read(base) & ~LPSS_RESETS::FUNC::mask);
+    device->suspended = true;
+    device->suspends++;
+    return B_OK;
+}
+
+// Ripresa: fuori dal reset i registri salvati vengono riscritti nell'ordine
+// della programmazione completa, e il controller torna acceso con lo stesso
+// I2C_TAR, che quindi non va riprogrammato al primo trasferimento
+static status_t i2c_resume_locked(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    LPSS_RESETS::write(base, LPSS_RESETS::read(base) | LPSS_RESETS::FUNC::set(3).value);
+
+    const i2c_controller_context* context = &device->saved_context;
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::clear());
+    IC_CON::write(base, context->con);
+    IC_TAR::write(base, context->tar);
+    IC_SS_SCL_HCNT::write(base, context->ss_scl_hcnt);
+    IC_SS_SCL_LCNT::write(base, context->ss_scl_lcnt);
+    IC_FS_SCL_HCNT::write(base, context->fs_scl_hcnt);
+    IC_FS_SCL_LCNT::write(base, context->fs_scl_lcnt);
+    IC_HS_SCL_HCNT::write(base, context->hs_scl_hcnt);
+    IC_HS_SCL_LCNT::write(base, context->hs_scl_lcnt);
+    IC_FS_SPKLEN::write(base, context->fs_spklen);
+    IC_HS_SPKLEN::write(base, context->hs_spklen);
+    IC_SDA_HOLD::write(base, context->sda_hold);
+    IC_SCL_STUCK_AT_LOW_TIMEOUT::write(base, context->scl_stuck_timeout);
+    IC_SDA_STUCK_AT_LOW_TIMEOUT::write(base, context->sda_stuck_timeout);
+    IC_TX_TL::write(base, context->tx_tl);
+    IC_RX_TL::write(base, context->rx_tl);
+    IC_INTR_MASK::write(base, 0);
+    IC_CLR_INTR::read(base);
+    IC_ENABLE::write(base, IC_ENABLE::ENABLE::set());
+
+    device->abort_stop_pending = false;
+    device->suspended = false;
+    device->resumes++;
+    return B_OK;
+}
+
+status_t i2c_controller_suspend(i2c_device_info* device) {
+    if (device == NULL) {
+        return B_BAD_VALUE;
+    }
+    status_t status = i2c_lock_bus(device);
+    if (status != B_OK) {
+        return status;
+    }
+    if (!device->suspended) {
+        status = i2c_suspend_locked(device);
+    }
+    i2c_unlock_bus(device);
+    return status;
+}
+
+status_t i2c_controller_resume(i2c_device_info* device) {
+    if (device == NULL) {
+        return B_BAD_VALUE;
+    }
+    status_t status = i2c_lock_bus(device);
+    if (status != B_OK) {
+        return status;
+    }
+    status = i2c_wake(device);
+    device->last_activity = system_time();
+    i2c_unlock_bus(device);
+    return status;
+}
+
+status_t i2c_controller_set_autosuspend(i2c_device_info* device, bigtime_t delay) {
+    if (device == NULL || delay < 0) {
+        return B_BAD_VALUE;
+    }
+    device->autosuspend_delay = delay;
     return B_OK;
 }
 
 void free_i2c_devices() {
     for (uint32 i = 0; i < sDeviceCount; i++) {
-        if (sDeviceList[i].register_area >= B_OK) {
-            delete_area(sDeviceList[i].register_area);
-        }
+        uninit_i2c_controller(&sDeviceList[i]);
     }
     free(sDeviceList);
     sDeviceList = NULL;
     sDeviceCount = 0;
+    if (sPCIModule != NULL) {
+        put_module(B_PCI_MODULE_NAME);
+        sPCIModule = NULL;
+    }
 }
 
 i2c_device_info* find_i2c_device(const char* name) {
-    // Per ora, restituisci semplicemente il primo dispositivo
-    // In futuro, potresti voler implementare una logica più sofisticata
-    if (sDeviceCount > 0) {
-        return &sDeviceList[0];
+    // "i2c/<indice>": l'indice è la posizione nella tabella, nessuna ricerca
+    size_t prefix = strlen(I2C_CONTROLLER_NAME_PREFIX);
+    if (name == NULL || strncmp(name, I2C_CONTROLLER_NAME_PREFIX, prefix) != 0) {
+        return NULL;
     }
-    return NULL;
+    const char* digits = name + prefix;
+    if (digits[0] == '\0' || (digits[0] == '0' && digits[1] != '\0')) {
+        return NULL;
+    }
+    uint32 index = 0;
+    for (; *digits != '\0'; digits++) {
+        if (*digits < '0' || *digits > '9') {
+            return NULL;
+        }
+        index = index * 10 + (*digits - '0');
+        if (index >= sDeviceCount) {
+            return NULL;
+        }
+    }
+    return &sDeviceList[index];
 }
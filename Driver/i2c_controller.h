@@ -9,40 +9,133 @@
 #define TIGER_LAKE_I2C_CONTROLLER_0 0xa0e8
 #define TIGER_LAKE_I2C_CONTROLLER_1 0xa0e9
 
+// Dati massimi di un blocco SMBus (conteggio escluso)
+#define I2C_SMBUS_BLOCK_MAX 32
+
+#define I2C_CONTROLLER_NAME_PREFIX "i2c/"
+
+// Profondità dei FIFO dei controller LPSS di Tiger Lake
+#define I2C_TIGER_LAKE_FIFO_DEPTH 64
+// Clock di ingresso (ic_clk) dei controller LPSS di Tiger Lake, in Hz
+#define I2C_TIGER_LAKE_CLOCK_RATE 216000000
+
+// Velocità del bus in Hz: massimi di ogni modalità della specifica I2C
+#define I2C_SPEED_STANDARD  100000
+#define I2C_SPEED_FAST      400000
+#define I2C_SPEED_FAST_PLUS 1000000
+#define I2C_SPEED_HIGH      3400000
+// Minimo accettato da i2c_controller_set_config (SMBus)
+#define I2C_SPEED_MIN       10000
+// Velocità all'avvio: il fast mode è supportato da quasi tutti i dispositivi,
+// il Fast-mode Plus va chiesto con i2c_controller_set_config
+#define I2C_SPEED_DEFAULT   I2C_SPEED_FAST
+
+#define I2C_ADDRESSING_7BIT  7
+#define I2C_ADDRESSING_10BIT 10
+
+// Attesa massima di un trasferimento a interrupt (µs): una parte fissa più il
+// tempo di un byte alla velocità del bus (byte_time) per ogni byte
+#define I2C_TRANSFER_TIMEOUT 100000
+
+// Messaggio di un trasferimento: scrittura o lettura di 'len' byte (almeno uno,
+// il controller non genera trasferimenti vuoti) verso 'addr'
+typedef struct i2c_message {
+    uint16 addr;
+    uint16 flags;
+    uint16 len;
+    uint8* buf;
+} i2c_message;
+
+#define I2C_MESSAGE_READ    0x0001
+#define I2C_MESSAGE_TEN_BIT 0x0010  // indirizzo a 10 bit
+
+// Nessun indirizzo ancora programmato in I2C_TAR
+#define I2C_TARGET_NONE 0xFFFF
+// In device->target: l'indirizzo programmato è a 10 bit
+#define I2C_TARGET_TEN_BIT 0x8000
+
+// Attesa dello spegnimento del controller prima di cambiare I2C_TAR: al più
+// qualche periodo di SCL a 100 kHz
+#define I2C_DISABLE_POLL_INTERVAL 25
+#define I2C_DISABLE_POLL_COUNT    40
+
+// Ripetizioni di una transazione che ha perso l'arbitraggio del bus
+#define I2C_ARBITRATION_RETRIES 2
+// Attesa del bus clear, in byte alla velocità del bus: nove impulsi di SCL e
+// lo STOP, con margine
+#define I2C_BUS_CLEAR_BYTES 3
+// Con il bus clear: SDA basso per questi byte chiude il trasferimento con
+// ABRT_SDA_STUCK_AT_LOW, senza attendere il timeout. SCL può restare basso
+// più a lungo per il clock stretching: il suo limite alza solo un interrupt.
+#define I2C_SDA_STUCK_TIMEOUT_BYTES 4
+#define I2C_SCL_STUCK_TIMEOUT_BYTES 256
+
 // Prototipi delle funzioni
 status_t probe_i2c_devices();
 status_t init_i2c_controller(i2c_device_info* device);
+// Rimuove l'handler e libera le risorse di init_i2c_controller
+void uninit_i2c_controller(i2c_device_info* device);
 status_t i2c_transfer(i2c_device_info* device, int addr, const uint8* write_buf, size_t write_len, uint8* read_buf, size_t read_len);
+// Gli indirizzi sono a 7 bit, a 10 bit con I2C_MESSAGE_TEN_BIT; la variante con
+// 'addr' usa la modalità scelta con i2c_controller_set_config.
+// Messaggi consecutivi verso lo stesso indirizzo formano una sola transazione:
+// RESTART all'inizio di ogni messaggio, STOP solo dopo l'ultimo. Quando
+// l'indirizzo cambia la transazione si chiude e I2C_TAR viene riprogrammato.
+// Errori dal bus: B_DEVICE_NOT_FOUND se l'indirizzo non ha ACK, B_IO_ERROR se
+// non l'ha un byte scritto, B_BUSY se l'arbitraggio resta perso dopo
+// I2C_ARBITRATION_RETRIES ripetizioni o SDA resta basso, B_TIMED_OUT. Dopo un
+// timeout o un bus bloccato il controller è già stato ripristinato.
+status_t i2c_transfer(i2c_device_info* device, i2c_message* msgs, size_t count);
+// Lettura a blocco SMBus: read_buf[0] riceve il conteggio inviato dal dispositivo,
+// poi i dati. 'extra' conta i byte oltre ai dati, conteggio compreso (1, o 2 con
+// il PEC); read_buf deve contenere I2C_SMBUS_BLOCK_MAX + extra byte.
+status_t i2c_transfer_block(i2c_device_info* device, int addr, const uint8* write_buf, size_t write_len, uint8* read_buf, size_t extra);
 void free_i2c_devices();
+// I controller si chiamano "i2c/0", "i2c/1", ... nell'ordine del probe; il
+// puntatore resta valido fino a free_i2c_devices. I trasferimenti sullo stesso
+// controller sono serializzati, quelli su controller diversi procedono insieme.
 i2c_device_info* find_i2c_device(const char* name);
 
-// Funzioni di utilità per l'accesso ai registri
-static inline uint32 read32(const void* address) {
-    return *(volatile uint32*)address;
-}
-
-static inline void write32(void* address, uint32 value) {
-    *(volatile uint32*)address = value;
-}
-
 // Struttura per la configurazione del controller I2C
 typedef struct {
     uint32 speed;         // Velocità del bus in Hz
-    uint8 addressing_mode; // 7-bit o 10-bit
-    uint8 duty_cycle;     // Per la modalità Fast Plus (opzionale)
+    uint8 addressing_mode; // I2C_ADDRESSING_7BIT o I2C_ADDRESSING_10BIT
+    uint8 duty_cycle;     // Percentuale del periodo con SCL alto, 0: dai minimi della specifica
+    uint16 scl_rise_time; // Tempi di salita e discesa di SCL sulla scheda (ns),
+    uint16 scl_fall_time; // 0: i massimi della specifica per la velocità
 } i2c_controller_config;
 
-// Funzioni aggiuntive per la gestione del controller
+// Funzioni aggiuntive per la gestione del controller. I conteggi di SCL sono
+// calcolati dal clock del controller e dai tempi di salita e discesa; sopra i
+// 400 kHz si usa il Fast-mode Plus, sopra 1 MHz l'high speed se il controller
+// lo supporta (altrimenti B_NOT_SUPPORTED). Va chiamata senza trasferimenti in
+// corso.
 status_t i2c_controller_set_config(i2c_device_info* device, i2c_controller_config* config);
 status_t i2c_controller_get_config(i2c_device_info* device, i2c_controller_config* config);
 
+// Risparmio energetico. Con il controller sospeso la funzione LPSS resta nel
+// reset; i trasferimenti e i2c_controller_set_config lo riprendono da soli,
+// riscrivendo i registri salvati. I trasferimenti aggiornano last_activity: chi
+// gestisce l'autosospensione confronta l'inattività con autosuspend_delay.
+status_t i2c_controller_suspend(i2c_device_info* device);
+status_t i2c_controller_resume(i2c_device_info* device);
+// Inattività prima della sospensione automatica (µs), 0 la disattiva. Il
+// controller si limita a conservarla: la applica solo il thread del touchpad
+// (touchpad_autosuspend), quindi senza touchpad non ha effetto. Non si usa un
+// timer: gira in contesto di interrupt e non può prendere il semaforo del bus.
+status_t i2c_controller_set_autosuspend(i2c_device_info* device, bigtime_t delay);
+
 // Funzioni per operazioni I2C di alto livello
 status_t i2c_read_register(i2c_device_info* device, uint8 slave_addr, uint8 reg_addr, uint8* data, size_t length);
 status_t i2c_write_register(i2c_device_info* device, uint8 slave_addr, uint8 reg_addr, const uint8* data, size_t length);
 
-// Definizioni per la gestione delle interruzioni
-#define I2C_INTR_DEFAULT_MASK 0x24  // Esempio: abilita interruzioni per completamento TX e RX
+// Definizioni per la gestione delle interruzioni: RX_FULL, TX_ABRT e STOP_DET
+// durante un trasferimento, più TX_EMPTY finché restano comandi da accodare
+#define I2C_INTR_DEFAULT_MASK 0x244
+// Con il DMA i FIFO non passano dalla CPU: solo TX_ABRT e STOP_DET
+#define I2C_INTR_DMA_MASK 0x240
 
+// Installa l'handler; se fallisce i trasferimenti restano a polling
 status_t i2c_controller_setup_interrupt(i2c_device_info* device);
 int32 i2c_interrupt_handler(void* data);
 
@@ -2,45 +2,28 @@
 #define I2C_DEVICE_H
 
 #include <OS.h>
+#include <drivers/KernelExport.h>
 #include <drivers/PCI.h>
+#include "i2c_driver.h"
 //#include <drivers/Drivers.h>
 //#include <drivers/module.h>
 
-// Struttura per le informazioni del dispositivo I2C
-typedef struct i2c_device_info {
-    uint32 base_addr;
-    area_id register_area;
-    void* mapped_registers;
-    uint8 irq;
-    uint16 vendor_id;
-    uint16 device_id;
-    uint8 slave_addr;
-    
-    // Funzioni per le operazioni del dispositivo
-    status_t (*read)(struct i2c_device_info* device, off_t position, void* buffer, size_t* numBytes);
-    status_t (*write)(struct i2c_device_info* device, off_t position, const void* buffer, size_t* numBytes);
-    status_t (*control)(struct i2c_device_info* device, uint32 op, void* arg, size_t len);
-} i2c_device_info;
-
-// Struttura per i trasferimenti I2C
+// Struttura per i trasferimenti I2C: scrittura seguita da lettura, con RESTART
+// in mezzo. i2c_device_transfer invia tutto l'array in una sola transazione.
 typedef struct {
     const uint8* send_buffer;
     size_t send_length;
     uint8* recv_buffer;
     size_t recv_length;
-} i2c_transfer;
+} i2c_transfer_info;
 
 // Prototipi delle funzioni
-status_t probe_i2c_devices();
-void free_i2c_devices();
-i2c_device_info* find_i2c_device(const char* name);
-
 status_t i2c_device_init(i2c_device_info* device, uint8 slave_address);
 status_t i2c_device_read(i2c_device_info* device, uint8* buffer, size_t length);
 status_t i2c_device_write(i2c_device_info* device, const uint8* buffer, size_t length);
 status_t i2c_device_read_register(i2c_device_info* device, uint8 reg, uint8* value);
 status_t i2c_device_write_register(i2c_device_info* device, uint8 reg, uint8 value);
-status_t i2c_device_transfer(i2c_device_info* device, i2c_transfer* transfers, size_t count);
+status_t i2c_device_transfer(i2c_device_info* device, i2c_transfer_info* transfers, size_t count);
 
 // Definizioni per i comandi IOCTL generici dei dispositivi I2C
 enum {
@@ -0,0 +1,244 @@
+#include "i2c_dma.h"
+#include "i2c_controller.h"
+#include "i2c_util.h"
+#include <drivers/KernelExport.h>
+
+// Registri privati del blocco LPSS, dopo quelli del controller (LPSS_PRIV_RESETS
+// è in i2c_util.h)
+#define LPSS_PRIV_REMAP_ADDR 0x240
+#define LPSS_PRIV_CAPS       0x2FC
+
+// iDMA64: registri dei canali, poi quelli comuni
+#define LPSS_IDMA64_OFFSET 0x800
+#define IDMA64_CH_LENGTH   0x58
+#define IDMA64_CHANNELS    2
+
+// Attesa dello spegnimento di un canale (µs)
+#define IDMA64_DISABLE_POLL_COUNT 100
+
+struct LPSS_REMAP_LO : i2c_register<LPSS_REMAP_LO, LPSS_PRIV_REMAP_ADDR> {};
+struct LPSS_REMAP_HI : i2c_register<LPSS_REMAP_HI, LPSS_PRIV_REMAP_ADDR + 4> {};
+
+struct LPSS_CAPS : i2c_register<LPSS_CAPS, LPSS_PRIV_CAPS> {
+    typedef i2c_field<LPSS_CAPS, 4, 4> TYPE;
+    typedef i2c_field<LPSS_CAPS, 8> NO_IDMA;
+};
+
+// Registri di un canale, relativi alla sua base
+struct IDMA64_SAR_LO : i2c_register<IDMA64_SAR_LO, 0x00> {};
+struct IDMA64_SAR_HI : i2c_register<IDMA64_SAR_HI, 0x04> {};
+struct IDMA64_DAR_LO : i2c_register<IDMA64_DAR_LO, 0x08> {};
+struct IDMA64_DAR_HI : i2c_register<IDMA64_DAR_HI, 0x0C> {};
+struct IDMA64_LLP : i2c_register<IDMA64_LLP, 0x10> {};
+
+struct IDMA64_CTL_LO : i2c_register<IDMA64_CTL_LO, 0x18> {
+    typedef i2c_field<IDMA64_CTL_LO, 0> INT_EN;
+    typedef i2c_field<IDMA64_CTL_LO, 1, 3> DST_WIDTH;  // log2 dei byte per elemento
+    typedef i2c_field<IDMA64_CTL_LO, 4, 3> SRC_WIDTH;
+    typedef i2c_field<IDMA64_CTL_LO, 8> DST_FIX;       // indirizzo fisso (FIFO)
+    typedef i2c_field<IDMA64_CTL_LO, 10> SRC_FIX;
+    typedef i2c_field<IDMA64_CTL_LO, 11, 3> DST_MSIZE; // burst: 0 = 1, 1 = 4, 2 = 8, 3 = 16
+    typedef i2c_field<IDMA64_CTL_LO, 14, 3> SRC_MSIZE;
+    typedef i2c_field<IDMA64_CTL_LO, 20, 3> TT_FC;
+
+    // Valori di TT_FC
+    enum {
+        FC_M2P = 1,
+        FC_P2M = 2
+    };
+};
+
+struct IDMA64_CTL_HI : i2c_register<IDMA64_CTL_HI, 0x1C> {
+    typedef i2c_field<IDMA64_CTL_HI, 0, 17> BLOCK_TS;  // elementi della sorgente
+    typedef i2c_field<IDMA64_CTL_HI, 17> DONE;
+};
+
+struct IDMA64_CFG_LO : i2c_register<IDMA64_CFG_LO, 0x40> {
+    typedef i2c_field<IDMA64_CFG_LO, 0> DST_BURST_ALIGN;
+    typedef i2c_field<IDMA64_CFG_LO, 1> SRC_BURST_ALIGN;
+};
+
+struct IDMA64_CFG_HI : i2c_register<IDMA64_CFG_HI, 0x44> {
+    typedef i2c_field<IDMA64_CFG_HI, 0, 4> SRC_PER;    // linea di richiesta
+    typedef i2c_field<IDMA64_CFG_HI, 4, 4> DST_PER;
+};
+
+// Registri comuni: un bit per canale, le maschere e l'abilitazione dei canali
+// hanno nei bit 8-15 l'abilitazione alla scrittura dei bit 0-7
+#define IDMA64_COMMON(offset) (LPSS_IDMA64_OFFSET + (offset))
+struct IDMA64_RAW_XFER : i2c_register<IDMA64_RAW_XFER, IDMA64_COMMON(0x2C0)> {};
+struct IDMA64_RAW_ERROR : i2c_register<IDMA64_RAW_ERROR, IDMA64_COMMON(0x2E0)> {};
+struct IDMA64_MASK_XFER : i2c_register<IDMA64_MASK_XFER, IDMA64_COMMON(0x310)> {};
+struct IDMA64_MASK_BLOCK : i2c_register<IDMA64_MASK_BLOCK, IDMA64_COMMON(0x318)> {};
+struct IDMA64_MASK_SRC_TRAN : i2c_register<IDMA64_MASK_SRC_TRAN, IDMA64_COMMON(0x320)> {};
+struct IDMA64_MASK_DST_TRAN : i2c_register<IDMA64_MASK_DST_TRAN, IDMA64_COMMON(0x328)> {};
+struct IDMA64_MASK_ERROR : i2c_register<IDMA64_MASK_ERROR, IDMA64_COMMON(0x330)> {};
+struct IDMA64_CLEAR_XFER : i2c_register<IDMA64_CLEAR_XFER, IDMA64_COMMON(0x338)> {};
+struct IDMA64_CLEAR_BLOCK : i2c_register<IDMA64_CLEAR_BLOCK, IDMA64_COMMON(0x340)> {};
+struct IDMA64_CLEAR_SRC_TRAN : i2c_register<IDMA64_CLEAR_SRC_TRAN, IDMA64_COMMON(0x348)> {};
+struct IDMA64_CLEAR_DST_TRAN : i2c_register<IDMA64_CLEAR_DST_TRAN, IDMA64_COMMON(0x350)> {};
+struct IDMA64_CLEAR_ERROR : i2c_register<IDMA64_CLEAR_ERROR, IDMA64_COMMON(0x358)> {};
+
+struct IDMA64_CFG : i2c_register<IDMA64_CFG, IDMA64_COMMON(0x398)> {
+    typedef i2c_field<IDMA64_CFG, 0> DMA_EN;
+};
+
+struct IDMA64_CH_EN : i2c_register<IDMA64_CH_EN, IDMA64_COMMON(0x3A0)> {};
+
+static inline void* idma64_channel(i2c_device_info* device, uint32 channel) {
+    return (uint8*)device->mapped_registers + LPSS_IDMA64_OFFSET + channel * IDMA64_CH_LENGTH;
+}
+
+static void idma64_clear(void* base, uint32 channel) {
+    uint32 bit = 1 << channel;
+    IDMA64_CLEAR_XFER::write(base, bit);
+    IDMA64_CLEAR_BLOCK::write(base, bit);
+    IDMA64_CLEAR_SRC_TRAN::write(base, bit);
+    IDMA64_CLEAR_DST_TRAN::write(base, bit);
+    IDMA64_CLEAR_ERROR::write(base, bit);
+}
+
+static status_t idma64_start(i2c_device_info* device, uint32 channel, phys_addr_t memory,
+                             size_t count) {
+    if (channel >= IDMA64_CHANNELS || count == 0
+        || count > IDMA64_CTL_HI::BLOCK_TS::mask >> IDMA64_CTL_HI::BLOCK_TS::shift) {
+        return B_BAD_VALUE;
+    }
+
+    void* base = device->mapped_registers;
+    void* regs = idma64_channel(device, channel);
+    phys_addr_t fifo = device->base_addr + I2C_DATA_CMD;
+    idma64_clear(base, channel);
+
+    // Un solo blocco, senza lista di descrittori
+    if (channel == I2C_DMA_TX) {
+        IDMA64_SAR_LO::write(regs, (uint32)memory);
+        IDMA64_SAR_HI::write(regs, (uint32)((uint64)memory >> 32));
+        IDMA64_DAR_LO::write(regs, (uint32)fifo);
+        IDMA64_DAR_HI::write(regs, (uint32)((uint64)fifo >> 32));
+        IDMA64_CTL_LO::write(regs, IDMA64_CTL_LO::DST_WIDTH::set(2)
+            | IDMA64_CTL_LO::SRC_WIDTH::set(2)
+            | IDMA64_CTL_LO::DST_FIX::set()
+            | IDMA64_CTL_LO::DST_MSIZE::set(2)
+            | IDMA64_CTL_LO::SRC_MSIZE::set(2)
+            | IDMA64_CTL_LO::TT_FC::set(IDMA64_CTL_LO::FC_M2P));
+    } else {
+        // Un byte per richiesta: il controller la alza con un solo byte nel FIFO
+        IDMA64_SAR_LO::write(regs, (uint32)fifo);
+        IDMA64_SAR_HI::write(regs, (uint32)((uint64)fifo >> 32));
+        IDMA64_DAR_LO::write(regs, (uint32)memory);
+        IDMA64_DAR_HI::write(regs, (uint32)((uint64)memory >> 32));
+        IDMA64_CTL_LO::write(regs, IDMA64_CTL_LO::DST_WIDTH::set(0)
+            | IDMA64_CTL_LO::SRC_WIDTH::set(0)
+            | IDMA64_CTL_LO::SRC_FIX::set()
+            | IDMA64_CTL_LO::DST_MSIZE::set(0)
+            | IDMA64_CTL_LO::SRC_MSIZE::set(0)
+            | IDMA64_CTL_LO::TT_FC::set(IDMA64_CTL_LO::FC_P2M));
+    }
+    IDMA64_CTL_HI::write(regs, IDMA64_CTL_HI::BLOCK_TS::set(count));
+    IDMA64_LLP::write(regs, 0);
+
+    IDMA64_CH_EN::write(base, (1 << (channel + 8)) | (1 << channel));
+    return B_OK;
+}
+
+static status_t idma64_status(i2c_device_info* device, uint32 channel) {
+    void* base = device->mapped_registers;
+    if ((IDMA64_RAW_ERROR::read(base) & (1 << channel)) != 0) {
+        return B_IO_ERROR;
+    }
+    return (IDMA64_RAW_XFER::read(base) & (1 << channel)) != 0 ? B_OK : B_BUSY;
+}
+
+static void idma64_stop(i2c_device_info* device, uint32 channel) {
+    void* base = device->mapped_registers;
+    IDMA64_CH_EN::write(base, 1 << (channel + 8));
+    for (int i = 0; (IDMA64_CH_EN::read(base) & (1 << channel)) != 0
+            && i < IDMA64_DISABLE_POLL_COUNT; i++) {
+        spin(1);
+    }
+    idma64_clear(base, channel);
+}
+
+const i2c_dma_ops gI2CIdma64Ops = {
+    idma64_start,
+    idma64_status,
+    idma64_stop
+};
+
+status_t i2c_dma_init(i2c_device_info* device) {
+    void* base = device->mapped_registers;
+    device->dma_ops = NULL;
+    device->dma_area = -1;
+    device->dma_buffer = NULL;
+    device->dma_physical = 0;
+    device->transfer_dma = false;
+
+    // Serve l'interfaccia di handshake del controller e il DMA privato LPSS
+    uint32 param = IC_COMP_PARAM_1::read(base);
+    uint32 caps = LPSS_CAPS::read(base);
+    if (param == 0xFFFFFFFF || !IC_COMP_PARAM_1::HAS_DMA::is_set(param)
+        || caps == 0xFFFFFFFF || LPSS_CAPS::NO_IDMA::is_set(caps)
+        || device->tx_fifo_depth <= I2C_DMA_TX_BURST) {
+        return B_NOT_SUPPORTED;
+    }
+
+    // Il bounce buffer viene allocato una volta sola: nessuna allocazione e
+    // nessuna traduzione degli indirizzi durante i trasferimenti
+    void* buffer;
+    area_id area = create_area("i2c dma buffer", &buffer, B_ANY_KERNEL_ADDRESS,
+                               I2C_DMA_AREA_SIZE, B_CONTIGUOUS,
+                               B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+    if (area < B_OK) {
+        return area;
+    }
+    physical_entry entry;
+    status_t status = get_memory_map(buffer, I2C_DMA_AREA_SIZE, &entry, 1);
+    if (status != B_OK) {
+        delete_area(area);
+        return status;
+    }
+
+    // iDMA64 fuori dal reset; vede i registri del controller all'indirizzo del BAR
+    LPSS_RESETS::update(base, LPSS_RESETS::FUNC::set(3) | LPSS_RESETS::IDMA::set());
+    LPSS_REMAP_LO::write(base, device->base_addr);
+    LPSS_REMAP_HI::write(base, 0);
+
+    // Nessun interrupt dal DMA: la fine del trasferimento la segnala STOP_DET
+    uint32 channels = (1 << IDMA64_CHANNELS) - 1;
+    IDMA64_MASK_XFER::write(base, channels << 8);
+    IDMA64_MASK_BLOCK::write(base, channels << 8);
+    IDMA64_MASK_SRC_TRAN::write(base, channels << 8);
+    IDMA64_MASK_DST_TRAN::write(base, channels << 8);
+    IDMA64_MASK_ERROR::write(base, channels << 8);
+    IDMA64_CH_EN::write(base, channels << 8);
+
+    for (uint32 channel = 0; channel < IDMA64_CHANNELS; channel++) {
+        void* regs = idma64_channel(device, channel);
+        IDMA64_CFG_LO::write(regs, IDMA64_CFG_LO::DST_BURST_ALIGN::set()
+            | IDMA64_CFG_LO::SRC_BURST_ALIGN::set());
+        IDMA64_CFG_HI::write(regs, IDMA64_CFG_HI::SRC_PER::set(I2C_DMA_RX)
+            | IDMA64_CFG_HI::DST_PER::set(I2C_DMA_TX));
+        idma64_clear(base, channel);
+    }
+    IDMA64_CFG::write(base, IDMA64_CFG::DMA_EN::set());
+
+    device->dma_area = area;
+    device->dma_buffer = (uint8*)buffer;
+    device->dma_physical = entry.address;
+    device->dma_ops = &gI2CIdma64Ops;
+    return B_OK;
+}
+
+void i2c_dma_uninit(i2c_device_info* device) {
+    if (device->dma_ops == &gI2CIdma64Ops) {
+        IDMA64_CH_EN::write(device->mapped_registers, ((1 << IDMA64_CHANNELS) - 1) << 8);
+        IDMA64_CFG::write(device->mapped_registers, 0);
+    }
+    device->dma_ops = NULL;
+    if (device->dma_area >= B_OK) {
+        delete_area(device->dma_area);
+        device->dma_area = -1;
+        device->dma_buffer = NULL;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef I2C_DMA_H
+#define I2C_DMA_H
+
+#include <OS.h>
+#include "i2c_driver.h"
+
+// Canali del DMA privato LPSS: le linee di handshake del controller sono fisse,
+// richiesta 0 per il TX FIFO e 1 per il RX FIFO
+#define I2C_DMA_TX 0
+#define I2C_DMA_RX 1
+
+// Elementi per richiesta del canale TX: il controller chiede dati quando nel TX
+// FIFO c'è posto per un burst intero (I2C_DMA_TDLR = profondità - burst)
+#define I2C_DMA_TX_BURST 8
+
+// Trasferimenti serviti dal DMA: sotto la soglia il PIO costa meno della
+// programmazione dei canali, sopra il massimo non basta il bounce buffer
+#define I2C_DMA_THRESHOLD  64
+#define I2C_DMA_MAX_LENGTH 4096
+
+// Bounce buffer: una parola di I2C_DATA_CMD per comando, poi i byte ricevuti
+#define I2C_DMA_RX_OFFSET  (I2C_DMA_MAX_LENGTH * sizeof(uint32))
+#define I2C_DMA_AREA_SIZE  \
+    ((I2C_DMA_RX_OFFSET + I2C_DMA_MAX_LENGTH + B_PAGE_SIZE - 1) & ~(B_PAGE_SIZE - 1))
+
+// Canale DMA tra il bounce buffer e I2C_DATA_CMD. Il canale TX scrive 'count'
+// parole di comando da 'memory', il canale RX legge 'count' byte in 'memory';
+// entrambi si muovono solo sulle richieste del controller (I2C_DMA_CR). Un
+// modello software del controller può sostituire le operazioni di
+// device->dma_ops dopo init_i2c_controller.
+typedef struct i2c_dma_ops {
+    status_t (*start)(struct i2c_device_info* device, uint32 channel, phys_addr_t memory,
+                      size_t count);
+    // B_OK a trasferimento completo, B_BUSY se è ancora in corso
+    status_t (*status)(struct i2c_device_info* device, uint32 channel);
+    void (*stop)(struct i2c_device_info* device, uint32 channel);
+} i2c_dma_ops;
+
+// Rileva il DMA privato, lo configura e alloca il bounce buffer; senza DMA
+// (B_NOT_SUPPORTED) dma_ops resta NULL e i trasferimenti restano in PIO
+status_t i2c_dma_init(i2c_device_info* device);
+void i2c_dma_uninit(i2c_device_info* device);
+
+// Canali iDMA64 del blocco LPSS
+extern const i2c_dma_ops gI2CIdma64Ops;
+
+#endif // I2C_DMA_H
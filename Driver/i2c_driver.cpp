@@ -4,6 +4,7 @@
 #include "i2c_driver.h"
 #include "i2c_controller.h"
 #include "i2c_touchpad.h"
+#include <stdio.h>
 #include <string.h>
 #include <KernelExport.h>
 #include <os/drivers/bus/PCI.h>  // oppure #include <os/drivers/PCI.h>
@@ -59,6 +60,17 @@ status_t init_driver(device_node* node)
 void uninit_driver(device_node* node, void* cookie)
 {
     dprintf(DRIVER_NAME ": uninit_driver()\n");
+    // Prima i touchpad: il thread di autosospensione usa il controller e i
+    // semafori nella sua struttura, che free_i2c_devices libera
+    for (uint32 index = 0;; index++) {
+        char name[16];
+        snprintf(name, sizeof(name), I2C_CONTROLLER_NAME_PREFIX "%" B_PRIu32, index);
+        i2c_device_info* device = find_i2c_device(name);
+        if (device == NULL) {
+            break;
+        }
+        uninit_touchpad(device);
+    }
     free_i2c_devices();
     put_module(B_PCI_BUS_MODULE_NAME);
 }
@@ -3,10 +3,36 @@
 
 #include <drivers/Drivers.h>
 #include <drivers/module.h>
- 
+#include <drivers/KernelExport.h>
+#include <drivers/device_manager.h>
+
+#ifndef DRIVER_NAME
+#define DRIVER_NAME "i2c_touchpad"
+#endif
+
+// Registri del controller azzerati dal reset della funzione LPSS: salvati alla
+// sospensione e riscritti alla ripresa (i2c_controller_suspend/resume)
+typedef struct {
+    uint32 con;
+    uint32 tar;
+    uint32 ss_scl_hcnt;
+    uint32 ss_scl_lcnt;
+    uint32 fs_scl_hcnt;
+    uint32 fs_scl_lcnt;
+    uint32 hs_scl_hcnt;
+    uint32 hs_scl_lcnt;
+    uint32 fs_spklen;
+    uint32 hs_spklen;
+    uint32 sda_hold;
+    uint32 scl_stuck_timeout;
+    uint32 sda_stuck_timeout;
+    uint32 tx_tl;
+    uint32 rx_tl;
+} i2c_controller_context;
 
 // Struttura per le informazioni del dispositivo I2C
 typedef struct i2c_device_info {
+    char name[16];              // "i2c/<indice>", per find_i2c_device
     uint32 base_addr;
     area_id register_area;
     void* mapped_registers;
@@ -14,7 +40,78 @@ typedef struct i2c_device_info {
     uint16 vendor_id;
     uint16 device_id;
     uint8 slave_addr;
-    
+    bool smbus_pec;     // Packet Error Checking sulle transazioni SMBus
+    device_node* node;  // nodo del device manager, genitore del touchpad
+
+    // Un trasferimento alla volta per controller (benaphore): chi trova il bus
+    // occupato attende in ordine su bus_sem
+    int32 bus_waiters;
+    sem_id bus_sem;
+
+    // Motore di trasferimento a interrupt (i2c_controller.cpp)
+    sem_id transfer_sem;        // rilasciato dall'handler a fine trasferimento
+    spinlock transfer_lock;     // protegge i campi seguenti dall'handler
+    bool transfer_active;
+    status_t transfer_status;
+    uint32 intr_mask;           // copia di I2C_INTR_MASK, evita le letture
+    uint32 tx_fifo_depth;
+    uint32 rx_fifo_depth;
+    uint16 target;              // indirizzo programmato in I2C_TAR (I2C_TARGET_*)
+    bool abort_stop_pending;    // lo STOP di un TX_ABRT può essere ancora sul bus
+    struct i2c_message* msgs;   // messaggi del trasferimento in corso
+    size_t msg_count;
+    size_t cmd_msg;             // prossimo comando da accodare: messaggio e byte
+    size_t cmd_pos;
+    size_t rx_msg;              // prossimo byte da ricevere: messaggio e byte
+    size_t rx_pos;
+    size_t reads_pending;       // letture accodate e non ancora ricevute
+
+    // Temporizzazione del bus (i2c_controller_set_config)
+    uint32 clock_rate;          // ic_clk in Hz
+    uint32 max_speed_mode;      // IC_CON::SPEED massimo dai parametri di sintesi
+    uint32 bus_speed;           // velocità richiesta in Hz
+    uint8 addressing_mode;
+    uint8 duty_cycle;
+    uint16 scl_rise_time;
+    uint16 scl_fall_time;
+    bigtime_t byte_time;        // durata di un byte sul bus (µs), per i timeout
+
+    // Trasferimenti DMA (i2c_dma.cpp)
+    const struct i2c_dma_ops* dma_ops;  // NULL: solo PIO
+    area_id dma_area;           // bounce buffer fisicamente contiguo
+    uint8* dma_buffer;
+    phys_addr_t dma_physical;
+    bool transfer_dma;          // il trasferimento in corso è servito dal DMA
+
+    // Errori e recupero (i2c_controller.cpp)
+    uint32 abort_source;        // I2C_TX_ABRT_SOURCE dell'ultimo TX_ABRT, 0 se nessuno
+    bool bus_clear;             // il controller sa liberare SDA (SDA_STUCK_RECOVERY)
+    uint32 retries;             // transazioni ripetute dopo un arbitraggio perso
+    uint32 flushes;             // recuperi riusciti per livello: FIFO svuotati,
+    uint32 bus_clears;          // bus clear, reset del controller
+    uint32 reinits;
+
+    // Risparmio energetico del controller (i2c_controller.cpp)
+    bool suspended;             // nel reset LPSS, registri in saved_context
+    i2c_controller_context saved_context;
+    bigtime_t last_activity;    // fine dell'ultimo trasferimento
+    bigtime_t autosuspend_delay; // inattività prima della sospensione, 0: mai
+    uint32 suspends;
+    uint32 resumes;
+
+    // Touchpad HID (i2c_touchpad.cpp)
+    device_node* touchpad_node; // registrato da init_touchpad, NULL se nessuno
+    uint16 input_register;      // wInputRegister e wMaxInputLength del descrittore
+    uint16 max_input_length;
+    sem_id pm_lock;             // serializza sospensione e ripresa del touchpad
+    sem_id pm_sem;              // sveglia il thread di autosospensione
+    thread_id pm_thread;
+    bool pm_quit;
+    bool touchpad_sleeping;     // HID_SET_POWER in SLEEP
+    bigtime_t resume_start;     // lettura che ha riattivato il touchpad, 0 se nessuna
+    bigtime_t resume_latency;   // da resume_start al primo report consegnato (µs)
+    bigtime_t resume_latency_max;
+
     // Funzioni per le operazioni del dispositivo
     status_t (*read)(struct i2c_device_info* device, off_t position, void* buffer, size_t* numBytes);
     status_t (*write)(struct i2c_device_info* device, off_t position, const void* buffer, size_t* numBytes);
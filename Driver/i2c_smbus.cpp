@@ -0,0 +1,193 @@
+#include "i2c_smbus.h"
+#include "i2c_controller.h"
+#include "i2c_pec.h"
+#include <string.h>
+
+// Il buffer ha sempre un byte libero in coda per il PEC
+static status_t smbus_write(i2c_device_info* device, uint8* buffer, size_t length) {
+    if (device->smbus_pec) {
+        buffer[length] = i2c_pec_update(i2c_pec_address(0, device->slave_addr, false),
+                                        buffer, length);
+        length++;
+    }
+    return i2c_transfer(device, device->slave_addr, buffer, length, NULL, 0);
+}
+
+// Il PEC di una lettura copre il comando inviato, il secondo byte di indirizzo e i
+// dati ricevuti; il byte di PEC segue i dati
+static bool smbus_pec_valid(i2c_device_info* device, const uint8* command, size_t command_length,
+                            const uint8* received, size_t received_length) {
+    uint8 crc = 0;
+    if (command_length > 0) {
+        crc = i2c_pec_address(crc, device->slave_addr, false);
+        crc = i2c_pec_update(crc, command, command_length);
+    }
+    crc = i2c_pec_address(crc, device->slave_addr, true);
+    crc = i2c_pec_update(crc, received, received_length);
+    return crc == received[received_length];
+}
+
+static status_t smbus_read(i2c_device_info* device, const uint8* command, size_t command_length,
+                           uint8* buffer, size_t length) {
+    uint8 received[I2C_SMBUS_BLOCK_MAX + 1];
+    if (length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+
+    status_t status = i2c_transfer(device, device->slave_addr, command, command_length,
+                                   received, length + (device->smbus_pec ? 1 : 0));
+    if (status != B_OK) {
+        return status;
+    }
+    if (device->smbus_pec
+        && !smbus_pec_valid(device, command, command_length, received, length)) {
+        return B_BAD_DATA;
+    }
+
+    memcpy(buffer, received, length);
+    return B_OK;
+}
+
+static status_t smbus_read_block(i2c_device_info* device, const uint8* command,
+                                 size_t command_length, uint8* buffer, size_t* length) {
+    // Conteggio, dati e PEC
+    uint8 received[1 + I2C_SMBUS_BLOCK_MAX + 1];
+    status_t status = i2c_transfer_block(device, device->slave_addr, command, command_length,
+                                         received, device->smbus_pec ? 2 : 1);
+    if (status != B_OK) {
+        return status;
+    }
+
+    size_t count = received[0];
+    if (device->smbus_pec
+        && !smbus_pec_valid(device, command, command_length, received, count + 1)) {
+        return B_BAD_DATA;
+    }
+
+    memcpy(buffer, received + 1, count);
+    *length = count;
+    return B_OK;
+}
+
+status_t i2c_smbus_receive_byte(i2c_device_info* device, uint8* value) {
+    if (device == NULL || value == NULL) {
+        return B_BAD_VALUE;
+    }
+    return smbus_read(device, NULL, 0, value, 1);
+}
+
+status_t i2c_smbus_send_byte(i2c_device_info* device, uint8 value) {
+    if (device == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[2] = {value};
+    return smbus_write(device, buffer, 1);
+}
+
+status_t i2c_smbus_read_byte_data(i2c_device_info* device, uint8 command, uint8* value) {
+    if (device == NULL || value == NULL) {
+        return B_BAD_VALUE;
+    }
+    return smbus_read(device, &command, 1, value, 1);
+}
+
+status_t i2c_smbus_write_byte_data(i2c_device_info* device, uint8 command, uint8 value) {
+    if (device == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[3] = {command, value};
+    return smbus_write(device, buffer, 2);
+}
+
+status_t i2c_smbus_read_word_data(i2c_device_info* device, uint8 command, uint16* value) {
+    if (device == NULL || value == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 data[2];
+    status_t status = smbus_read(device, &command, 1, data, 2);
+    if (status == B_OK) {
+        *value = (uint16)(data[0] | (data[1] << 8));
+    }
+    return status;
+}
+
+status_t i2c_smbus_write_word_data(i2c_device_info* device, uint8 command, uint16 value) {
+    if (device == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[4] = {command, (uint8)value, (uint8)(value >> 8)};
+    return smbus_write(device, buffer, 3);
+}
+
+status_t i2c_smbus_process_call(i2c_device_info* device, uint8 command, uint16 value, uint16* result) {
+    if (device == NULL || result == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[3] = {command, (uint8)value, (uint8)(value >> 8)};
+    uint8 data[2];
+    status_t status = smbus_read(device, buffer, 3, data, 2);
+    if (status == B_OK) {
+        *result = (uint16)(data[0] | (data[1] << 8));
+    }
+    return status;
+}
+
+status_t i2c_smbus_read_block_data(i2c_device_info* device, uint8 command, uint8* buffer, size_t* length) {
+    if (device == NULL || buffer == NULL || length == NULL) {
+        return B_BAD_VALUE;
+    }
+    return smbus_read_block(device, &command, 1, buffer, length);
+}
+
+status_t i2c_smbus_write_block_data(i2c_device_info* device, uint8 command, const uint8* data, size_t length) {
+    if (device == NULL || (data == NULL && length > 0) || length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+
+    // Comando, conteggio, dati e PEC
+    uint8 buffer[2 + I2C_SMBUS_BLOCK_MAX + 1];
+    buffer[0] = command;
+    buffer[1] = (uint8)length;
+    if (length > 0) {
+        memcpy(buffer + 2, data, length);
+    }
+    return smbus_write(device, buffer, length + 2);
+}
+
+status_t i2c_smbus_block_process_call(i2c_device_info* device, uint8 command, const uint8* data, size_t length, uint8* buffer, size_t* read_length) {
+    if (device == NULL || (data == NULL && length > 0) || length > I2C_SMBUS_BLOCK_MAX
+        || buffer == NULL || read_length == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 request[2 + I2C_SMBUS_BLOCK_MAX];
+    request[0] = command;
+    request[1] = (uint8)length;
+    if (length > 0) {
+        memcpy(request + 2, data, length);
+    }
+    return smbus_read_block(device, request, length + 2, buffer, read_length);
+}
+
+status_t i2c_smbus_read_i2c_block_data(i2c_device_info* device, uint8 command, uint8* buffer, size_t length) {
+    if (device == NULL || buffer == NULL || length == 0 || length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+    return i2c_transfer(device, device->slave_addr, &command, 1, buffer, length);
+}
+
+status_t i2c_smbus_write_i2c_block_data(i2c_device_info* device, uint8 command, const uint8* data, size_t length) {
+    if (device == NULL || data == NULL || length == 0 || length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[1 + I2C_SMBUS_BLOCK_MAX];
+    buffer[0] = command;
+    memcpy(buffer + 1, data, length);
+    return i2c_transfer(device, device->slave_addr, buffer, length + 1, NULL, 0);
+}
@@ -0,0 +1,29 @@
+#ifndef I2C_SMBUS_H
+#define I2C_SMBUS_H
+
+#include <OS.h>
+#include "i2c_driver.h"
+
+// Protocollo SMBus sopra i2c_transfer. Con device->smbus_pec attivo ogni
+// transazione porta il PEC (CRC-8) e le letture con PEC errato restituiscono
+// B_BAD_DATA. I blocchi I2C non hanno PEC. Il quick command non è disponibile:
+// il controller DesignWare non genera trasferimenti senza dati.
+status_t i2c_smbus_receive_byte(i2c_device_info* device, uint8* value);
+status_t i2c_smbus_send_byte(i2c_device_info* device, uint8 value);
+
+status_t i2c_smbus_read_byte_data(i2c_device_info* device, uint8 command, uint8* value);
+status_t i2c_smbus_write_byte_data(i2c_device_info* device, uint8 command, uint8 value);
+
+status_t i2c_smbus_read_word_data(i2c_device_info* device, uint8 command, uint16* value);
+status_t i2c_smbus_write_word_data(i2c_device_info* device, uint8 command, uint16 value);
+status_t i2c_smbus_process_call(i2c_device_info* device, uint8 command, uint16 value, uint16* result);
+
+// buffer deve contenere I2C_SMBUS_BLOCK_MAX byte; *length riceve il conteggio
+status_t i2c_smbus_read_block_data(i2c_device_info* device, uint8 command, uint8* buffer, size_t* length);
+status_t i2c_smbus_write_block_data(i2c_device_info* device, uint8 command, const uint8* data, size_t length);
+status_t i2c_smbus_block_process_call(i2c_device_info* device, uint8 command, const uint8* data, size_t length, uint8* buffer, size_t* read_length);
+
+status_t i2c_smbus_read_i2c_block_data(i2c_device_info* device, uint8 command, uint8* buffer, size_t length);
+status_t i2c_smbus_write_i2c_block_data(i2c_device_info* device, uint8 command, const uint8* data, size_t length);
+
+#endif // I2C_SMBUS_H
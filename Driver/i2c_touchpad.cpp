@@ -3,6 +3,7 @@
 #include "i2c_device.h"
 #include <drivers/device_manager.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define HID_DESCRIPTOR_REG 0x01
@@ -13,11 +14,15 @@
 #define HID_GET_REPORT_COMMAND 0x0200
 #define HID_SET_POWER_COMMAND 0x0800
 
+// Dimensione del buffer per i report di input sullo stack; quelli più grandi
+// usano la memoria dinamica
+#define TOUCHPAD_REPORT_LOCAL 64
+
+static status_t touchpad_init_power(i2c_device_info* device, const hid_descriptor& desc);
+
 #define DEVICE_NAME "I2C Touchpad"
 #define DEVICE_PATH "input/touchpad/i2c/0"
 
-static device_manager_info* sDeviceManager;
-
 status_t init_touchpad(i2c_device_info* device) {
     status_t status;
     
@@ -25,7 +30,7 @@ status_t init_touchpad(i2c_device_info* device) {
 
     // Reset del touchpad
     uint16 reset_command = HID_RESET_COMMAND;
-    status = i2c_device_write_register(device, HID_COMMAND_REG, (uint8*)&reset_command, 2);
+    status = i2c_write_register(device, device->slave_addr, HID_COMMAND_REG, (uint8*)&reset_command, 2);
     if (status != B_OK) {
         dprintf(DRIVER_NAME ": Failed to reset touchpad\n");
         return status;
@@ -34,7 +39,7 @@ status_t init_touchpad(i2c_device_info* device) {
 
     // Leggi il descrittore HID
     hid_descriptor desc;
-    status = i2c_device_read_register(device, HID_DESCRIPTOR_REG, (uint8*)&desc, sizeof(hid_descriptor));
+    status = i2c_read_register(device, device->slave_addr, HID_DESCRIPTOR_REG, (uint8*)&desc, sizeof(hid_descriptor));
     if (status != B_OK) {
         dprintf(DRIVER_NAME ": Failed to read HID descriptor\n");
         return status;
@@ -44,8 +49,7 @@ status_t init_touchpad(i2c_device_info* device) {
             desc.wHIDDescLength, desc.bcdVersion);
 
     // Accendi il touchpad
-    uint16 power_on = HID_SET_POWER_COMMAND;
-    status = i2c_device_write_register(device, HID_COMMAND_REG, (uint8*)&power_on, 2);
+    status = touchpad_set_power(device, HID_POWER_ON);
     if (status != B_OK) {
         dprintf(DRIVER_NAME ": Failed to power on touchpad\n");
         return status;
@@ -73,6 +77,14 @@ status_t init_touchpad(i2c_device_info* device) {
         return status;
     }
 
+    // Il nodo si pubblica per ultimo, con l'autosospensione già pronta: chi
+    // lo apre trova pm_lock valido
+    status = touchpad_init_power(device, desc);
+    if (status != B_OK) {
+        dprintf(DRIVER_NAME ": Failed to set up power management\n");
+        return status;
+    }
+
     // Registra il dispositivo con il device manager
     device_attr attrs[] = {
         { B_DEVICE_PRETTY_NAME, B_STRING_TYPE, { string: DEVICE_NAME } },
@@ -80,9 +92,20 @@ status_t init_touchpad(i2c_device_info* device) {
         { NULL }
     };
 
-    status = sDeviceManager->register_node(device->node, DRIVER_NAME, attrs, NULL, NULL);
+    device_manager_info* manager;
+    status = get_module(B_DEVICE_MANAGER_MODULE_NAME, (module_info**)&manager);
+    if (status != B_OK) {
+        dprintf(DRIVER_NAME ": Failed to get device manager\n");
+        uninit_touchpad(device);
+        return status;
+    }
+    status = manager->register_node(device->node, DRIVER_NAME, attrs, NULL,
+                                    &device->touchpad_node);
+    put_module(B_DEVICE_MANAGER_MODULE_NAME);
     if (status != B_OK) {
         dprintf(DRIVER_NAME ": Failed to register device node\n");
+        device->touchpad_node = NULL;
+        uninit_touchpad(device);
         return status;
     }
 
@@ -90,21 +113,210 @@ status_t init_touchpad(i2c_device_info* device) {
     return B_OK;
 }
 
+void uninit_touchpad(i2c_device_info* device) {
+    // Prima il nodo, così nessuno apre più il touchpad, poi il thread
+    if (device->touchpad_node != NULL) {
+        device_manager_info* manager;
+        if (get_module(B_DEVICE_MANAGER_MODULE_NAME, (module_info**)&manager) == B_OK) {
+            manager->unregister_node(device->touchpad_node);
+            put_module(B_DEVICE_MANAGER_MODULE_NAME);
+        }
+        device->touchpad_node = NULL;
+    }
+    if (device->pm_lock < B_OK) {
+        return;
+    }
+    if (device->pm_thread >= B_OK) {
+        device->pm_quit = true;
+        release_sem(device->pm_sem);
+        status_t result;
+        wait_for_thread(device->pm_thread, &result);
+        device->pm_thread = -1;
+    }
+    delete_sem(device->pm_sem);
+    delete_sem(device->pm_lock);
+    device->pm_sem = -1;
+    device->pm_lock = -1;
+}
+
+status_t touchpad_set_power(i2c_device_info* device, uint8 state) {
+    uint16 command = HID_SET_POWER_COMMAND | state;
+    return i2c_write_register(device, device->slave_addr, HID_COMMAND_REG,
+                              (uint8*)&command, 2);
+}
+
+// Riattiva controller e touchpad, con pm_lock preso. Il controller si
+// riprenderebbe anche da solo al primo trasferimento; la ripresa esplicita
+// tiene fuori dalla latenza il tempo d'attesa del bus.
+static status_t touchpad_wake(i2c_device_info* device) {
+    status_t status = i2c_controller_resume(device);
+    if (status == B_OK) {
+        status = touchpad_set_power(device, HID_POWER_ON);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+    device->touchpad_sleeping = false;
+    // Il thread dorme senza timeout mentre il touchpad è a riposo
+    release_sem(device->pm_sem);
+    return B_OK;
+}
+
+bigtime_t touchpad_autosuspend(i2c_device_info* device) {
+    if (acquire_sem(device->pm_lock) != B_OK) {
+        return B_INFINITE_TIMEOUT;
+    }
+    bigtime_t delay = device->autosuspend_delay;
+    bigtime_t remaining = B_INFINITE_TIMEOUT;
+    if (!device->touchpad_sleeping && delay != 0) {
+        bigtime_t idle = system_time() - device->last_activity;
+        if (idle < delay) {
+            remaining = delay - idle;
+        } else if (touchpad_set_power(device, HID_POWER_SLEEP) == B_OK) {
+            device->touchpad_sleeping = true;
+            // Un controller che non si sospende resta solo acceso
+            i2c_controller_suspend(device);
+        } else {
+            remaining = delay;
+        }
+    }
+    release_sem(device->pm_lock);
+    return remaining;
+}
+
+// Thread di autosospensione: dorme fino alla scadenza dell'inattività, o
+// finché la ripresa o un nuovo ritardo non lo risvegliano
+static status_t touchpad_pm_thread(void* data) {
+    i2c_device_info* device = (i2c_device_info*)data;
+    bigtime_t timeout = touchpad_autosuspend(device);
+    while (!device->pm_quit) {
+        status_t status = acquire_sem_etc(device->pm_sem, 1, B_RELATIVE_TIMEOUT, timeout);
+        if (status != B_OK && status != B_TIMED_OUT) {
+            break;
+        }
+        if (device->pm_quit) {
+            break;
+        }
+        timeout = touchpad_autosuspend(device);
+    }
+    return B_OK;
+}
+
+static status_t touchpad_init_power(i2c_device_info* device, const hid_descriptor& desc) {
+    device->input_register = desc.wInputRegister;
+    device->max_input_length = desc.wMaxInputLength;
+    device->touchpad_sleeping = false;
+    device->resume_start = 0;
+    device->resume_latency = 0;
+    device->resume_latency_max = 0;
+    device->pm_quit = false;
+    device->pm_thread = -1;
+    i2c_controller_set_autosuspend(device, TOUCHPAD_AUTOSUSPEND_DELAY);
+
+    device->pm_lock = create_sem(1, "touchpad pm lock");
+    if (device->pm_lock < B_OK) {
+        return device->pm_lock;
+    }
+    device->pm_sem = create_sem(0, "touchpad pm");
+    if (device->pm_sem < B_OK) {
+        delete_sem(device->pm_lock);
+        device->pm_lock = -1;
+        return device->pm_sem;
+    }
+
+    // Senza il thread l'autosospensione resta a chi chiama touchpad_autosuspend
+    device->pm_thread = spawn_kernel_thread(touchpad_pm_thread, "touchpad autosuspend",
+                                            B_LOW_PRIORITY, device);
+    if (device->pm_thread < B_OK) {
+        dprintf(DRIVER_NAME ": No autosuspend thread, touchpad stays powered\n");
+        return B_OK;
+    }
+    resume_thread(device->pm_thread);
+    return B_OK;
+}
+
+status_t touchpad_read_report(i2c_device_info* device, void* buffer, size_t* numBytes) {
+    if (device == NULL || buffer == NULL || numBytes == NULL) {
+        return B_BAD_VALUE;
+    }
+    // Il report comincia con la sua lunghezza su due byte, compresa
+    size_t length = device->max_input_length;
+    if (length < 2) {
+        return B_NOT_SUPPORTED;
+    }
+
+    uint8 local[TOUCHPAD_REPORT_LOCAL];
+    uint8* report = local;
+    if (length > sizeof(local)) {
+        report = (uint8*)malloc(length);
+        if (report == NULL) {
+            return B_NO_MEMORY;
+        }
+    }
+
+    status_t status = acquire_sem(device->pm_lock);
+    if (status != B_OK) {
+        if (report != local) {
+            free(report);
+        }
+        return status;
+    }
+    if (device->touchpad_sleeping) {
+        device->resume_start = system_time();
+        status = touchpad_wake(device);
+    }
+    if (status == B_OK) {
+        status = i2c_read_register(device, device->slave_addr, device->input_register,
+                                   report, length);
+    }
+
+    size_t size = 0;
+    if (status == B_OK) {
+        size_t reportLength = report[0] | (report[1] << 8);
+        if (reportLength != 0 && (reportLength < 2 || reportLength > length)) {
+            status = B_BAD_DATA;
+        } else if (reportLength != 0) {
+            size = min_c(reportLength - 2, *numBytes);
+            status = user_memcpy(buffer, report + 2, size);
+        }
+    }
+
+    // Latenza della ripresa: fino al primo report consegnato dopo il risveglio
+    if (status == B_OK && size > 0 && device->resume_start != 0) {
+        device->resume_latency = system_time() - device->resume_start;
+        device->resume_start = 0;
+        if (device->resume_latency > device->resume_latency_max) {
+            device->resume_latency_max = device->resume_latency;
+        }
+        if (device->resume_latency > TOUCHPAD_RESUME_LATENCY_MAX) {
+            dprintf(DRIVER_NAME ": Slow resume, first report after %" B_PRId64 " us\n",
+                    device->resume_latency);
+        }
+    }
+    release_sem(device->pm_lock);
+
+    if (report != local) {
+        free(report);
+    }
+    *numBytes = status == B_OK ? size : 0;
+    return status;
+}
+
 status_t get_hid_report(i2c_device_info* device, uint8* report, uint16 length) {
     uint16 get_report = HID_GET_REPORT_COMMAND;
-    status_t status = i2c_device_write_register(device, HID_COMMAND_REG, (uint8*)&get_report, 2);
+    status_t status = i2c_write_register(device, device->slave_addr, HID_COMMAND_REG, (uint8*)&get_report, 2);
     if (status != B_OK) {
         return status;
     }
 
-    return i2c_device_read_register(device, HID_DATA_REG, report, length);
+    return i2c_read_register(device, device->slave_addr, HID_DATA_REG, report, length);
 }
 
 status_t parse_report_descriptor(uint8* report_descriptor, uint16 length) {
     dprintf(DRIVER_NAME ": Parsing report descriptor (length: %d)\n", length);
     
     // Esempio: stampa i primi byte del descrittore del report
-    for (int i = 0; i < min(length, 16); i++) {
+    for (int i = 0; i < min_c(length, 16); i++) {
         dprintf("%02x ", report_descriptor[i]);
     }
     dprintf("\n");
@@ -133,9 +345,7 @@ status_t touchpad_free(void* cookie) {
 
 status_t touchpad_read(void* cookie, off_t position, void* buffer, size_t* numBytes) {
     i2c_device_info* device = (i2c_device_info*)cookie;
-    // Implementa la lettura dei dati del touchpad
-    // Questo potrebbe coinvolgere la lettura di un report di input dal touchpad
-    return B_OK;
+    return touchpad_read_report(device, buffer, numBytes);
 }
 
 status_t touchpad_write(void* cookie, off_t position, const void* buffer, size_t* numBytes) {
@@ -144,7 +354,38 @@ status_t touchpad_write(void* cookie, off_t position, const void* buffer, size_t
 }
 
 status_t touchpad_control(void* cookie, uint32 op, void* arg, size_t len) {
-    // Implementa qui eventuali operazioni di controllo specifiche del touchpad
+    i2c_device_info* device = (i2c_device_info*)cookie;
+    switch (op) {
+        case TOUCHPAD_IOCTL_SET_AUTOSUSPEND: {
+            bigtime_t delay;
+            if (arg == NULL || len < sizeof(delay)) {
+                return B_BAD_VALUE;
+            }
+            if (user_memcpy(&delay, arg, sizeof(delay)) != B_OK) {
+                return B_BAD_ADDRESS;
+            }
+            status_t status = i2c_controller_set_autosuspend(device, delay);
+            if (status == B_OK) {
+                // Il thread ricalcola la sua attesa con il nuovo ritardo
+                release_sem(device->pm_sem);
+            }
+            return status;
+        }
+        case TOUCHPAD_IOCTL_GET_POWER_INFO: {
+            touchpad_power_info info;
+            if (arg == NULL || len < sizeof(info)) {
+                return B_BAD_VALUE;
+            }
+            info.autosuspend_delay = device->autosuspend_delay;
+            info.sleeping = device->touchpad_sleeping;
+            info.suspends = device->suspends;
+            info.resumes = device->resumes;
+            info.resume_latency = device->resume_latency;
+            info.resume_latency_max = device->resume_latency_max;
+            return user_memcpy(arg, &info, sizeof(info)) == B_OK ? B_OK : B_BAD_ADDRESS;
+        }
+    }
+    // Implementa qui eventuali altre operazioni di controllo specifiche del touchpad
     return B_OK;
 }
 
@@ -156,49 +397,3 @@ device_hooks gTouchpadHooks = {
     touchpad_read,
     touchpad_write
 };
-
-status_t init_hardware() {
-    return B_OK;
-}
-
-status_t init_driver() {
-    return get_module(B_DEVICE_MANAGER_MODULE_NAME, (module_info**)&sDeviceManager);
-}
-
-void uninit_driver() {
-    put_module(B_DEVICE_MANAGER_MODULE_NAME);
-}
-
-const char** publish_devices() {
-    static const char* devices[] = {
-        DEVICE_PATH,
-        NULL
-    };
-    return devices;
-}
-
-device_hooks* find_device(const char* name) {
-    if (!strcmp(name, DEVICE_PATH)) {
-        return &gTouchpadHooks;
-    }
-    return NULL;
-}
-
-struct driver_module_info gI2CTouchpadDriverModule = {
-    {
-        DRIVER_NAME,
-        0,
-        NULL
-    },
-    init_hardware,
-    init_driver,
-    uninit_driver,
-    publish_devices,
-    find_device,
-    NULL
-};
-
-module_info* modules[] = {
-    (module_info*)&gI2CTouchpadDriverModule,
-    NULL
-};
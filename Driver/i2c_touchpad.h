@@ -35,8 +35,24 @@ typedef struct {
     // Aggiungi altri parametri specifici del touchpad secondo necessità
 } touchpad_info;
 
+// Stati di HID_SET_POWER, nel byte basso del comando
+#define HID_POWER_ON    0x00
+#define HID_POWER_SLEEP 0x01
+
+// Inattività prima che touchpad e controller vadano a riposo (µs)
+#define TOUCHPAD_AUTOSUSPEND_DELAY 2000000
+// Latenza attesa tra la lettura a touchpad sospeso e il primo report
+// consegnato (µs): ripresa del controller, SET_POWER ON e lettura dell'input
+// register, con il bus almeno a 100 kHz. Oltre questo limite la ripresa viene
+// segnalata nel log.
+#define TOUCHPAD_RESUME_LATENCY_MAX 5000
+
 // Prototipi delle funzioni
 status_t init_touchpad(i2c_device_info* device);
+// Toglie il nodo registrato da init_touchpad e ferma il thread di
+// autosospensione. Da chiamare prima di free_i2c_devices; senza touchpad
+// inizializzato non fa nulla
+void uninit_touchpad(i2c_device_info* device);
 status_t get_hid_report(i2c_device_info* device, uint8* report, uint16 length);
 status_t parse_report_descriptor(uint8* report_descriptor, uint16 length);
 
@@ -56,6 +72,8 @@ status_t touchpad_device_read(void* cookie, off_t position, void* buffer, size_t
 enum {
     TOUCHPAD_IOCTL_GET_INFO = B_DEVICE_OP_CODES_END + 1000,
     TOUCHPAD_IOCTL_SET_PARAMETERS,
+    TOUCHPAD_IOCTL_SET_AUTOSUSPEND,     // bigtime_t, µs; 0 disattiva
+    TOUCHPAD_IOCTL_GET_POWER_INFO,      // touchpad_power_info
     // Aggiungi altri codici IOCTL secondo necessità
 };
 
@@ -67,11 +85,32 @@ typedef struct {
     // Aggiungi altri parametri configurabili secondo necessità
 } touchpad_parameters;
 
+// Stato del risparmio energetico, per TOUCHPAD_IOCTL_GET_POWER_INFO
+typedef struct {
+    bigtime_t autosuspend_delay;
+    bool sleeping;
+    uint32 suspends;
+    uint32 resumes;
+    bigtime_t resume_latency;       // ultima ripresa (µs)
+    bigtime_t resume_latency_max;
+} touchpad_power_info;
+
 // Funzioni di utilità
 status_t touchpad_set_parameters(i2c_device_info* device, touchpad_parameters* params);
 status_t touchpad_get_parameters(i2c_device_info* device, touchpad_parameters* params);
 status_t touchpad_reset(i2c_device_info* device);
 
+// Risparmio energetico: HID_SET_POWER con HID_POWER_ON o HID_POWER_SLEEP
+status_t touchpad_set_power(i2c_device_info* device, uint8 state);
+// Se il touchpad è inattivo da autosuspend_delay lo mette in SLEEP e sospende
+// il controller. Restituisce l'attesa prima del prossimo controllo,
+// B_INFINITE_TIMEOUT se è già a riposo o l'autosospensione è disattivata.
+bigtime_t touchpad_autosuspend(i2c_device_info* device);
+// Legge un report di input, riattivando touchpad e controller se sono a riposo.
+// In *numBytes la dimensione di 'buffer', al ritorno i byte del report (0 se
+// il touchpad non ne ha); 'buffer' può essere nello spazio utente.
+status_t touchpad_read_report(i2c_device_info* device, void* buffer, size_t* numBytes);
+
 // Funzioni per la gestione degli eventi
 void process_touchpad_event(i2c_device_info* device, uint8* event_data, size_t event_size);
 
@@ -24,6 +24,8 @@
 #define I2C_SS_SCL_LCNT 0x18 // Standard Speed I2C Clock SCL Low Count Register
 #define I2C_FS_SCL_HCNT 0x1C // Fast Speed I2C Clock SCL High Count Register
 #define I2C_FS_SCL_LCNT 0x20 // Fast Speed I2C Clock SCL Low Count Register
+#define I2C_HS_SCL_HCNT 0x24 // High Speed I2C Clock SCL High Count Register
+#define I2C_HS_SCL_LCNT 0x28 // High Speed I2C Clock SCL Low Count Register
 #define I2C_INTR_STAT   0x2C // Interrupt Status Register
 #define I2C_INTR_MASK   0x30 // Interrupt Mask Register
 #define I2C_RAW_INTR_STAT 0x34 // Raw Interrupt Status Register
@@ -46,25 +48,284 @@
 #define I2C_RXFLR       0x78 // Receive FIFO Level Register
 #define I2C_SDA_HOLD    0x7C // SDA Hold Time Length Register
 #define I2C_TX_ABRT_SOURCE 0x80 // Transmit Abort Source Register
+#define I2C_DMA_CR      0x88 // DMA Control Register
+#define I2C_DMA_TDLR    0x8C // DMA Transmit Data Level Register
+#define I2C_DMA_RDLR    0x90 // DMA Receive Data Level Register
+#define I2C_ENABLE_STATUS 0x9C // Enable Status Register
+#define I2C_FS_SPKLEN   0xA0 // SS, FS and FM+ Spike Suppression Limit Register
+#define I2C_HS_SPKLEN   0xA4 // HS Spike Suppression Limit Register
+#define I2C_SCL_STUCK_AT_LOW_TIMEOUT 0xAC // SCL Stuck at Low Timeout Register
+#define I2C_SDA_STUCK_AT_LOW_TIMEOUT 0xB0 // SDA Stuck at Low Timeout Register
+#define I2C_COMP_PARAM_1 0xF4 // Component Parameter Register 1
+#define I2C_COMP_VERSION 0xF8 // Component Version Register
 
-// Macro per accesso ai registri
-#define READ_REG32(base, reg) (*((volatile uint32 *)((base) + (reg))))
-#define WRITE_REG32(base, reg, value) (*((volatile uint32 *)((base) + (reg))) = (value))
+// Registri privati del blocco LPSS, dopo quelli del controller
+#define LPSS_PRIV_RESETS 0x204
 
-// Funzioni di utilità
-static inline void i2c_set_bit(void* base, uint32 reg, uint32 bit) {
-    uint32 value = READ_REG32(base, reg);
-    WRITE_REG32(base, reg, value | (1 << bit));
-}
+// Descrittori dei registri. Ogni registro è un tipo con il suo offset, ogni
+// campo un tipo con maschera e shift calcolati a tempo di compilazione: un
+// campo di un registro non può essere scritto in un altro. I valori di più
+// campi dello stesso registro si combinano con | e vengono applicati con una
+// sola scrittura (write) o con una lettura e una scrittura (update).
+template<typename Register>
+struct i2c_fields {
+    uint32 mask;    // bit toccati
+    uint32 value;   // nuovo valore dei bit toccati
 
-static inline void i2c_clear_bit(void* base, uint32 reg, uint32 bit) {
-    uint32 value = READ_REG32(base, reg);
-    WRITE_REG32(base, reg, value & ~(1 << bit));
-}
+    constexpr i2c_fields(uint32 field_mask, uint32 field_value)
+        : mask(field_mask), value(field_value) {}
 
-static inline bool i2c_is_bit_set(void* base, uint32 reg, uint32 bit) {
-    return (READ_REG32(base, reg) & (1 << bit)) != 0;
-}
+    constexpr i2c_fields operator|(i2c_fields other) const {
+        return i2c_fields(mask | other.mask, (value & ~other.mask) | other.value);
+    }
+};
+
+#ifdef I2C_HOST_MMIO
+// Harness host (host/): gli accessi ai registri vanno al dispositivo simulato
+// a cui è mappato l'indirizzo
+uint32 host_mmio_read(volatile void* address);
+void host_mmio_write(volatile void* address, uint32 value);
+#endif
+
+template<typename Register, uint32 Offset>
+struct i2c_register {
+    static const uint32 offset = Offset;
+
+    static inline uint32 read(void* base) {
+#ifdef I2C_HOST_MMIO
+        return host_mmio_read((uint8*)base + Offset);
+#else
+        return *(volatile uint32*)((uint8*)base + Offset);
+#endif
+    }
+
+    static inline void write(void* base, uint32 value) {
+#ifdef I2C_HOST_MMIO
+        host_mmio_write((uint8*)base + Offset, value);
+#else
+        *(volatile uint32*)((uint8*)base + Offset) = value;
+#endif
+    }
+
+    // I bit non indicati vanno a zero: nessuna lettura
+    static inline void write(void* base, i2c_fields<Register> fields) {
+        write(base, fields.value);
+    }
+
+    // Lettura-modifica-scrittura di tutti i campi in una volta; se il valore
+    // non cambia la scrittura viene evitata
+    static inline void update(void* base, i2c_fields<Register> fields) {
+        uint32 value = read(base);
+        uint32 updated = (value & ~fields.mask) | fields.value;
+        if (updated != value) {
+            write(base, updated);
+        }
+    }
+};
+
+template<typename Register, uint32 Shift, uint32 Width = 1>
+struct i2c_field {
+    static_assert(Width > 0 && Shift + Width <= 32, "campo fuori dal registro");
+
+    static const uint32 shift = Shift;
+    static const uint32 mask = (uint32)((1ull << Width) - 1) << Shift;
+
+    static constexpr i2c_fields<Register> set(uint32 value = 1) {
+        return i2c_fields<Register>(mask, (value << Shift) & mask);
+    }
+
+    static constexpr i2c_fields<Register> clear() {
+        return i2c_fields<Register>(mask, 0);
+    }
+
+    // Estrazione da un valore già letto: più campi con un solo accesso
+    static constexpr uint32 get(uint32 register_value) {
+        return (register_value & mask) >> Shift;
+    }
+
+    static constexpr bool is_set(uint32 register_value) {
+        return (register_value & mask) != 0;
+    }
+
+    static inline uint32 read(void* base) {
+        return get(Register::read(base));
+    }
+};
+
+// Bit comuni a IC_INTR_STAT, IC_INTR_MASK e IC_RAW_INTR_STAT
+template<typename Register>
+struct i2c_interrupt_fields {
+    typedef i2c_field<Register, 0> RX_UNDER;
+    typedef i2c_field<Register, 1> RX_OVER;
+    typedef i2c_field<Register, 2> RX_FULL;
+    typedef i2c_field<Register, 3> TX_OVER;
+    typedef i2c_field<Register, 4> TX_EMPTY;
+    typedef i2c_field<Register, 5> RD_REQ;
+    typedef i2c_field<Register, 6> TX_ABRT;
+    typedef i2c_field<Register, 7> RX_DONE;
+    typedef i2c_field<Register, 8> ACTIVITY;
+    typedef i2c_field<Register, 9> STOP_DET;
+    typedef i2c_field<Register, 10> START_DET;
+    typedef i2c_field<Register, 11> GEN_CALL;
+};
+
+struct IC_CON : i2c_register<IC_CON, I2C_CON> {
+    typedef i2c_field<IC_CON, 0> MASTER_MODE;
+    typedef i2c_field<IC_CON, 1, 2> SPEED;
+    typedef i2c_field<IC_CON, 3> IC_10BITADDR_SLAVE;
+    typedef i2c_field<IC_CON, 4> IC_10BITADDR_MASTER;
+    typedef i2c_field<IC_CON, 5> IC_RESTART_EN;
+    typedef i2c_field<IC_CON, 6> IC_SLAVE_DISABLE;
+    typedef i2c_field<IC_CON, 7> STOP_DET_IFADDRESSED;
+    typedef i2c_field<IC_CON, 8> TX_EMPTY_CTRL;
+    typedef i2c_field<IC_CON, 9> RX_FIFO_FULL_HLD_CTRL;
+    typedef i2c_field<IC_CON, 11> BUS_CLEAR_FEATURE_CTRL;
+
+    // Valori di SPEED
+    enum {
+        SPEED_STANDARD = 1,
+        SPEED_FAST = 2,
+        SPEED_HIGH = 3
+    };
+};
+
+struct IC_TAR : i2c_register<IC_TAR, I2C_TAR> {
+    typedef i2c_field<IC_TAR, 0, 10> ADDRESS;
+    typedef i2c_field<IC_TAR, 10> GC_OR_START;
+    typedef i2c_field<IC_TAR, 11> SPECIAL;
+    typedef i2c_field<IC_TAR, 12> IC_10BITADDR_MASTER;
+};
+
+struct IC_DATA_CMD : i2c_register<IC_DATA_CMD, I2C_DATA_CMD> {
+    typedef i2c_field<IC_DATA_CMD, 0, 8> DAT;
+    typedef i2c_field<IC_DATA_CMD, 8> CMD;      // 1 = lettura
+    typedef i2c_field<IC_DATA_CMD, 9> STOP;
+    typedef i2c_field<IC_DATA_CMD, 10> RESTART;
+};
+
+struct IC_SS_SCL_HCNT : i2c_register<IC_SS_SCL_HCNT, I2C_SS_SCL_HCNT> {};
+struct IC_SS_SCL_LCNT : i2c_register<IC_SS_SCL_LCNT, I2C_SS_SCL_LCNT> {};
+struct IC_FS_SCL_HCNT : i2c_register<IC_FS_SCL_HCNT, I2C_FS_SCL_HCNT> {};
+struct IC_FS_SCL_LCNT : i2c_register<IC_FS_SCL_LCNT, I2C_FS_SCL_LCNT> {};
+struct IC_HS_SCL_HCNT : i2c_register<IC_HS_SCL_HCNT, I2C_HS_SCL_HCNT> {};
+struct IC_HS_SCL_LCNT : i2c_register<IC_HS_SCL_LCNT, I2C_HS_SCL_LCNT> {};
+
+// Durata massima (in cicli di ic_clk) dei disturbi ignorati sugli ingressi
+struct IC_FS_SPKLEN : i2c_register<IC_FS_SPKLEN, I2C_FS_SPKLEN> {
+    typedef i2c_field<IC_FS_SPKLEN, 0, 8> SPKLEN;
+};
+struct IC_HS_SPKLEN : i2c_register<IC_HS_SPKLEN, I2C_HS_SPKLEN> {
+    typedef i2c_field<IC_HS_SPKLEN, 0, 8> SPKLEN;
+};
+// Cicli di ic_clk; al reset valgono 0xFFFFFFFF (parecchi secondi)
+struct IC_SCL_STUCK_AT_LOW_TIMEOUT
+    : i2c_register<IC_SCL_STUCK_AT_LOW_TIMEOUT, I2C_SCL_STUCK_AT_LOW_TIMEOUT> {};
+struct IC_SDA_STUCK_AT_LOW_TIMEOUT
+    : i2c_register<IC_SDA_STUCK_AT_LOW_TIMEOUT, I2C_SDA_STUCK_AT_LOW_TIMEOUT> {};
+
+struct IC_INTR_STAT : i2c_register<IC_INTR_STAT, I2C_INTR_STAT>,
+    i2c_interrupt_fields<IC_INTR_STAT> {};
+struct IC_INTR_MASK : i2c_register<IC_INTR_MASK, I2C_INTR_MASK>,
+    i2c_interrupt_fields<IC_INTR_MASK> {};
+struct IC_RAW_INTR_STAT : i2c_register<IC_RAW_INTR_STAT, I2C_RAW_INTR_STAT>,
+    i2c_interrupt_fields<IC_RAW_INTR_STAT> {};
+
+struct IC_RX_TL : i2c_register<IC_RX_TL, I2C_RX_TL> {};
+struct IC_TX_TL : i2c_register<IC_TX_TL, I2C_TX_TL> {};
+
+// Registri che azzerano l'interrupt corrispondente quando vengono letti
+struct IC_CLR_INTR : i2c_register<IC_CLR_INTR, I2C_CLR_INTR> {};
+struct IC_CLR_RX_UNDER : i2c_register<IC_CLR_RX_UNDER, I2C_CLR_RX_UNDER> {};
+struct IC_CLR_RX_OVER : i2c_register<IC_CLR_RX_OVER, I2C_CLR_RX_OVER> {};
+struct IC_CLR_TX_OVER : i2c_register<IC_CLR_TX_OVER, I2C_CLR_TX_OVER> {};
+struct IC_CLR_RD_REQ : i2c_register<IC_CLR_RD_REQ, I2C_CLR_RD_REQ> {};
+struct IC_CLR_TX_ABRT : i2c_register<IC_CLR_TX_ABRT, I2C_CLR_TX_ABRT> {};
+struct IC_CLR_RX_DONE : i2c_register<IC_CLR_RX_DONE, I2C_CLR_RX_DONE> {};
+struct IC_CLR_ACTIVITY : i2c_register<IC_CLR_ACTIVITY, I2C_CLR_ACTIVITY> {};
+struct IC_CLR_STOP_DET : i2c_register<IC_CLR_STOP_DET, I2C_CLR_STOP_DET> {};
+struct IC_CLR_START_DET : i2c_register<IC_CLR_START_DET, I2C_CLR_START_DET> {};
+struct IC_CLR_GEN_CALL : i2c_register<IC_CLR_GEN_CALL, I2C_CLR_GEN_CALL> {};
+
+struct IC_ENABLE : i2c_register<IC_ENABLE, I2C_ENABLE> {
+    typedef i2c_field<IC_ENABLE, 0> ENABLE;
+    typedef i2c_field<IC_ENABLE, 1> ABORT;
+    typedef i2c_field<IC_ENABLE, 3> SDA_STUCK_RECOVERY_ENABLE;  // bus clear
+};
+
+struct IC_STATUS : i2c_register<IC_STATUS, I2C_STATUS> {
+    typedef i2c_field<IC_STATUS, 0> ACTIVITY;
+    typedef i2c_field<IC_STATUS, 1> TFNF;          // TX FIFO non pieno
+    typedef i2c_field<IC_STATUS, 2> TFE;           // TX FIFO vuoto
+    typedef i2c_field<IC_STATUS, 3> RFNE;          // RX FIFO non vuoto
+    typedef i2c_field<IC_STATUS, 4> RFF;           // RX FIFO pieno
+    typedef i2c_field<IC_STATUS, 5> MST_ACTIVITY;
+    typedef i2c_field<IC_STATUS, 6> SLV_ACTIVITY;
+    typedef i2c_field<IC_STATUS, 11> SDA_STUCK_NOT_RECOVERED;
+};
+
+struct IC_ENABLE_STATUS : i2c_register<IC_ENABLE_STATUS, I2C_ENABLE_STATUS> {
+    typedef i2c_field<IC_ENABLE_STATUS, 0> IC_EN;
+    typedef i2c_field<IC_ENABLE_STATUS, 1> SLV_DISABLED_WHILE_BUSY;
+    typedef i2c_field<IC_ENABLE_STATUS, 2> SLV_RX_DATA_LOST;
+};
+
+// Numero di voci presenti nei FIFO
+struct IC_TXFLR : i2c_register<IC_TXFLR, I2C_TXFLR> {};
+struct IC_RXFLR : i2c_register<IC_RXFLR, I2C_RXFLR> {};
+
+struct IC_SDA_HOLD : i2c_register<IC_SDA_HOLD, I2C_SDA_HOLD> {
+    typedef i2c_field<IC_SDA_HOLD, 0, 16> SDA_TX_HOLD;
+    typedef i2c_field<IC_SDA_HOLD, 16, 8> SDA_RX_HOLD;
+};
+
+struct IC_TX_ABRT_SOURCE : i2c_register<IC_TX_ABRT_SOURCE, I2C_TX_ABRT_SOURCE> {
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 0> ABRT_7B_ADDR_NOACK;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 1> ABRT_10ADDR1_NOACK;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 2> ABRT_10ADDR2_NOACK;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 3> ABRT_TXDATA_NOACK;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 4> ABRT_GCALL_NOACK;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 5> ABRT_GCALL_READ;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 6> ABRT_HS_ACKDET;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 7> ABRT_SBYTE_ACKDET;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 8> ABRT_HS_NORSTRT;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 9> ABRT_SBYTE_NORSTRT;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 10> ABRT_10B_RD_NORSTRT;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 11> ABRT_MASTER_DIS;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 12> ARB_LOST;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 13> ABRT_SLVFLUSH_TXFIFO;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 14> ABRT_SLV_ARBLOST;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 15> ABRT_SLVRD_INTX;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 16> ABRT_USER_ABRT;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 17> ABRT_SDA_STUCK_AT_LOW;
+    typedef i2c_field<IC_TX_ABRT_SOURCE, 23, 9> TX_FLUSH_CNT;
+};
+
+struct IC_DMA_CR : i2c_register<IC_DMA_CR, I2C_DMA_CR> {
+    typedef i2c_field<IC_DMA_CR, 0> RDMAE;
+    typedef i2c_field<IC_DMA_CR, 1> TDMAE;
+};
+
+// Soglie delle richieste DMA: TX con TXFLR <= TDLR, RX con RXFLR > RDLR
+struct IC_DMA_TDLR : i2c_register<IC_DMA_TDLR, I2C_DMA_TDLR> {};
+struct IC_DMA_RDLR : i2c_register<IC_DMA_RDLR, I2C_DMA_RDLR> {};
+
+// Parametri di sintesi del controller: le profondità sono memorizzate meno uno
+struct IC_COMP_PARAM_1 : i2c_register<IC_COMP_PARAM_1, I2C_COMP_PARAM_1> {
+    typedef i2c_field<IC_COMP_PARAM_1, 0, 2> APB_DATA_WIDTH;
+    typedef i2c_field<IC_COMP_PARAM_1, 2, 2> MAX_SPEED_MODE;
+    typedef i2c_field<IC_COMP_PARAM_1, 7> HAS_DMA;
+    typedef i2c_field<IC_COMP_PARAM_1, 8, 8> RX_BUFFER_DEPTH;
+    typedef i2c_field<IC_COMP_PARAM_1, 16, 8> TX_BUFFER_DEPTH;
+};
+
+// Versione in ASCII, per esempio 0x3230312A = "201*" per la 2.01a
+struct IC_COMP_VERSION : i2c_register<IC_COMP_VERSION, I2C_COMP_VERSION> {};
+
+// Reset delle funzioni del blocco LPSS: il controller e il suo iDMA
+struct LPSS_RESETS : i2c_register<LPSS_RESETS, LPSS_PRIV_RESETS> {
+    typedef i2c_field<LPSS_RESETS, 0, 2> FUNC;     // 3 = fuori dal reset
+    typedef i2c_field<LPSS_RESETS, 2> IDMA;
+};
 
 // Funzioni di debug
 #if DEBUG
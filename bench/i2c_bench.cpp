@@ -0,0 +1,611 @@
+// Benchmark delle operazioni di I2CBus sul bus simulato.
+//
+// Ogni riga di output è un oggetto JSON con ops/s, latenze p50/p99/p999 (ns),
+// allocazioni sull'heap e chiamate al trasporto (syscall con i2c-dev) per
+// operazione. Ogni caso viene eseguito con e senza I2C_RDWR.
+//
+// Uso: i2c_bench [-n iterazioni] [-c clock_hz] [-o overhead_us] [-r] [-s] [-m] [-p] [-x]
+//   -r  bus in tempo reale (le latenze includono il tempo sul filo)
+//   -s  statistiche di I2CBus attive, per misurarne il costo
+//   -m  traffico misto: latenza delle letture urgenti mentre il bus è occupato da
+//       dump di 256 byte, in ordine di arrivo (I2CAsyncBus) e con I2CScheduler;
+//       sempre in tempo reale, al massimo 2000 campioni
+//   -p  campionamento periodico: BENCH_PERIODIC_TASKS task da 10 Hz a 2 kHz su due
+//       bus con I2CSampler per un secondo; ritardo di ogni campione rispetto alla
+//       sua scadenza e letture per transazione
+//   -x  scalabilità di I2CExecutor: da 1 a BENCH_EXECUTOR_BUSES bus in tempo
+//       reale, BENCH_EXECUTOR_READS letture per bus; tempo totale rispetto a un
+//       solo bus
+
+#include <OS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include "i2c.h"
+#include "i2c_async.h"
+#include "i2c_executor.h"
+#include "i2c_sampler.h"
+#include "i2c_scheduler.h"
+#include "i2c_sim.h"
+#include "i2c_transaction.h"
+
+#define BENCH_ADDRESS 0x50
+#define BENCH_DEFAULT_ITERATIONS 20000
+// Il traffico misto gira in tempo reale: meno campioni, uno ogni millisecondo
+#define BENCH_MIXED_MAX_SAMPLES 2000
+#define BENCH_MIXED_INTERVAL 1000
+#define BENCH_BULK_SIZE 256
+#define BENCH_BULK_CHUNK 32
+#define BENCH_PERIODIC_TASKS 2000
+#define BENCH_PERIODIC_BUSES 2
+#define BENCH_PERIODIC_DURATION 1000000
+#define BENCH_EXECUTOR_BUSES 4
+#define BENCH_EXECUTOR_READS 200
+#define BENCH_EXECUTOR_WORKERS 2
+
+// Conteggio delle allocazioni: sostituisce gli operatori globali
+static int64 sAllocations = 0;
+
+void* operator new(size_t size) {
+    atomic_add64(&sAllocations, 1);
+    void* pointer = malloc(size > 0 ? size : 1);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    atomic_add64(&sAllocations, 1);
+    void* pointer = malloc(size > 0 ? size : 1);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw() {
+    atomic_add64(&sAllocations, 1);
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw() {
+    atomic_add64(&sAllocations, 1);
+    return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* pointer) throw() {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) throw() {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) throw() {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) throw() {
+    free(pointer);
+}
+
+enum bench_op {
+    BENCH_WRITE,
+    BENCH_READ,
+    BENCH_WRITE_REGISTER,
+    BENCH_READ_REGISTER,
+    BENCH_WRITE_REGISTERS,
+    BENCH_READ_REGISTERS
+};
+
+static const char* kOpNames[] = {
+    "write",
+    "read",
+    "write_register",
+    "read_register",
+    "write_registers",
+    "read_registers"
+};
+
+static const size_t kSizes[] = { 1, 4, 16, 64, 255 };
+
+typedef struct {
+    uint32 iterations;
+    uint32 clock;
+    bigtime_t overhead;
+    bool realtime;
+    bool stats;
+    bool mixed;
+    bool periodic;
+    bool executor;
+} bench_options;
+
+// Stato del thread che tiene il bus occupato con i dump
+typedef struct {
+    I2CAsyncBus* fifo;
+    I2CScheduler* scheduler;
+    volatile bool stop;
+} bench_bulk_context;
+
+// Campioni dei task periodici: scritti solo dal thread del campionatore
+typedef struct {
+    nanotime_t* samples;
+    uint32 capacity;
+    uint32 count;
+} bench_periodic_context;
+
+// Letture dell'executor ancora da decodificare: l'ultima sveglia il bench
+typedef struct {
+    int32 remaining;
+    sem_id done;
+} bench_executor_context;
+
+static const uint32 kPeriodicRates[] = { 10, 20, 50, 100, 200, 500, 1000, 2000 };
+
+static int compare_samples(const void* a, const void* b) {
+    nanotime_t left = *static_cast<const nanotime_t*>(a);
+    nanotime_t right = *static_cast<const nanotime_t*>(b);
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+static nanotime_t percentile(const nanotime_t* sorted, uint32 count, uint32 per_mille) {
+    uint32 index = static_cast<uint32>((static_cast<uint64>(count) * per_mille) / 1000);
+    return sorted[index < count ? index : count - 1];
+}
+
+static status_t run_op(I2CBus& bus, bench_op op, uint8* buffer, size_t size) {
+    switch (op) {
+        case BENCH_WRITE:
+            return bus.write(BENCH_ADDRESS, buffer, size);
+        case BENCH_READ:
+            return bus.read(BENCH_ADDRESS, buffer, size);
+        case BENCH_WRITE_REGISTER:
+            return bus.write_register(BENCH_ADDRESS, 0x10, buffer[0]);
+        case BENCH_READ_REGISTER:
+            return bus.read_register(BENCH_ADDRESS, 0x10, buffer);
+        case BENCH_WRITE_REGISTERS:
+            return bus.write_registers(BENCH_ADDRESS, 0x00, buffer, size);
+        case BENCH_READ_REGISTERS:
+            return bus.read_registers(BENCH_ADDRESS, 0x00, buffer, size);
+    }
+    return B_BAD_VALUE;
+}
+
+static status_t run_case(const bench_options& options, bench_op op, size_t size, bool combined,
+                         nanotime_t* samples) {
+    I2CSimTransport transport(options.clock);
+    I2CSimRegisterDevice device;
+    transport.set_realtime(options.realtime);
+    transport.set_call_overhead(options.overhead);
+    transport.set_functionality(combined ? I2C_FUNC_I2C : 0);
+    transport.attach(BENCH_ADDRESS, &device);
+
+    I2CBus bus(&transport);
+    bus.enable_stats(options.stats);
+    status_t status = bus.init();
+    if (status != B_OK) {
+        return status;
+    }
+
+    uint8 buffer[256];
+    memset(buffer, 0xA5, sizeof(buffer));
+
+    // Un giro a vuoto per stabilizzare lo stato (indirizzo slave già impostato)
+    run_op(bus, op, buffer, size);
+
+    uint64 calls_before = bus.syscall_count();
+    uint64 bus_time_before = transport.bus_time_ns();
+    int64 allocations_before = atomic_get64(&sAllocations);
+    nanotime_t begin = system_time_nsecs();
+
+    for (uint32 i = 0; i < options.iterations; i++) {
+        nanotime_t start = system_time_nsecs();
+        status = run_op(bus, op, buffer, size);
+        samples[i] = system_time_nsecs() - start;
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    nanotime_t elapsed = system_time_nsecs() - begin;
+    int64 allocations = atomic_get64(&sAllocations) - allocations_before;
+    uint64 calls = bus.syscall_count() - calls_before;
+    uint64 bus_time = transport.bus_time_ns() - bus_time_before;
+
+    qsort(samples, options.iterations, sizeof(nanotime_t), compare_samples);
+
+    double iterations = options.iterations;
+    printf("{\"op\":\"%s\",\"size\":%zu,\"combined\":%s,\"clock_hz\":%" B_PRIu32
+           ",\"realtime\":%s,\"stats\":%s,\"iterations\":%" B_PRIu32 ",\"ops_per_sec\":%.1f"
+           ",\"p50_ns\":%" B_PRId64 ",\"p99_ns\":%" B_PRId64 ",\"p999_ns\":%" B_PRId64
+           ",\"allocs_per_op\":%.3f,\"syscalls_per_op\":%.3f,\"bus_ns_per_op\":%.1f}\n",
+           kOpNames[op], size, combined ? "true" : "false", options.clock,
+           options.realtime ? "true" : "false", options.stats ? "true" : "false",
+           options.iterations,
+           elapsed > 0 ? iterations * 1e9 / elapsed : 0.0,
+           percentile(samples, options.iterations, 500),
+           percentile(samples, options.iterations, 990),
+           percentile(samples, options.iterations, 999),
+           allocations / iterations, calls / iterations, bus_time / iterations);
+    return B_OK;
+}
+
+// Un dump è una serie di letture da BENCH_BULK_CHUNK byte: gruppi distinti, quindi
+// lo scheduler può inserire altro lavoro tra l'uno e l'altro
+static void build_dump(I2CTransaction& transaction, uint8* buffer) {
+    transaction.clear();
+    for (uint32 offset = 0; offset < BENCH_BULK_SIZE; offset += BENCH_BULK_CHUNK) {
+        transaction.add_read_registers(BENCH_ADDRESS, static_cast<uint8>(offset),
+                                       buffer + offset, BENCH_BULK_CHUNK);
+    }
+}
+
+static status_t submit_mixed(bench_bulk_context* context, I2CTransaction* transaction,
+                             i2c_priority priority, I2CAsyncFuture* future) {
+    if (context->scheduler != NULL) {
+        return context->scheduler->submit(transaction, priority, future);
+    }
+    return context->fifo->submit_transaction(transaction, future);
+}
+
+static status_t bulk_thread(void* data) {
+    bench_bulk_context* context = static_cast<bench_bulk_context*>(data);
+
+    // Due dump sempre in coda, così il bus non resta mai libero
+    I2CTransaction transactions[2];
+    I2CAsyncFuture futures[2];
+    uint8 buffers[2][BENCH_BULK_SIZE];
+    for (int i = 0; i < 2; i++) {
+        build_dump(transactions[i], buffers[i]);
+    }
+
+    while (!context->stop) {
+        for (int i = 0; i < 2; i++) {
+            submit_mixed(context, &transactions[i], I2C_PRIORITY_BULK, &futures[i]);
+        }
+        for (int i = 0; i < 2; i++) {
+            futures[i].wait();
+        }
+    }
+    return B_OK;
+}
+
+static status_t run_mixed(const bench_options& options, bool scheduled, nanotime_t* samples) {
+    I2CSimTransport transport(options.clock);
+    I2CSimRegisterDevice device;
+    transport.set_call_overhead(options.overhead);
+    transport.attach(BENCH_ADDRESS, &device);
+
+    I2CAsyncBus fifo(&transport);
+    I2CScheduler scheduler(&transport);
+    bench_bulk_context context;
+    context.fifo = scheduled ? NULL : &fifo;
+    context.scheduler = scheduled ? &scheduler : NULL;
+    context.stop = false;
+
+    status_t status = scheduled ? scheduler.init() : fifo.init();
+    if (status != B_OK) {
+        return status;
+    }
+
+    thread_id bulk = spawn_thread(bulk_thread, "bench bulk", B_NORMAL_PRIORITY, &context);
+    if (bulk < B_OK) {
+        return bulk;
+    }
+    resume_thread(bulk);
+
+    uint32 count = min_c(options.iterations, BENCH_MIXED_MAX_SAMPLES);
+    I2CTransaction transaction;
+    I2CAsyncFuture future;
+    uint8 buffer[2];
+    transaction.add_read_registers(BENCH_ADDRESS, 0x10, buffer, sizeof(buffer));
+
+    for (uint32 i = 0; i < count && status == B_OK; i++) {
+        snooze(BENCH_MIXED_INTERVAL);
+        nanotime_t start = system_time_nsecs();
+        status = submit_mixed(&context, &transaction, I2C_PRIORITY_URGENT, &future);
+        if (status == B_OK) {
+            status = future.wait();
+        }
+        samples[i] = system_time_nsecs() - start;
+    }
+
+    context.stop = true;
+    status_t result;
+    wait_for_thread(bulk, &result);
+    if (status != B_OK) {
+        return status;
+    }
+
+    int64 missed = scheduled ? scheduler.missed_deadlines() : 0;
+    qsort(samples, count, sizeof(nanotime_t), compare_samples);
+
+    printf("{\"op\":\"mixed_urgent_read\",\"scheduler\":%s,\"clock_hz\":%" B_PRIu32
+           ",\"iterations\":%" B_PRIu32 ",\"bulk_size\":%d,\"p50_ns\":%" B_PRId64
+           ",\"p99_ns\":%" B_PRId64 ",\"p999_ns\":%" B_PRId64
+           ",\"missed_deadlines\":%" B_PRId64 "}\n",
+           scheduled ? "true" : "false", options.clock, count, BENCH_BULK_SIZE,
+           percentile(samples, count, 500), percentile(samples, count, 990),
+           percentile(samples, count, 999), missed);
+    return B_OK;
+}
+
+static I2CSampleTask periodic_task(I2CSampler& sampler, int32 bus, bigtime_t period,
+                                   bench_periodic_context* context) {
+    I2CSamplePeriod timer(sampler, period);
+    uint8 data[2];
+    for (;;) {
+        co_await timer.next();
+        i2c_sample sample = co_await sampler.read_registers(bus, BENCH_ADDRESS, 0x10, data,
+                                                            sizeof(data));
+        if (sample.status == B_OK && context->count < context->capacity) {
+            context->samples[context->count++] = (sample.timestamp - timer.deadline()) * 1000;
+        }
+    }
+}
+
+static status_t run_periodic(const bench_options& options, nanotime_t* samples) {
+    I2CSimTransport transports[BENCH_PERIODIC_BUSES];
+    I2CSimRegisterDevice devices[BENCH_PERIODIC_BUSES];
+    I2CSampler sampler;
+    int32 buses[BENCH_PERIODIC_BUSES];
+    for (int i = 0; i < BENCH_PERIODIC_BUSES; i++) {
+        transports[i].set_speed(options.clock);
+        transports[i].set_realtime(options.realtime);
+        transports[i].set_call_overhead(options.overhead);
+        transports[i].attach(BENCH_ADDRESS, &devices[i]);
+        buses[i] = sampler.add_bus(&transports[i]);
+        if (buses[i] < B_OK) {
+            return buses[i];
+        }
+    }
+
+    bench_periodic_context context;
+    context.samples = samples;
+    context.capacity = options.iterations;
+    context.count = 0;
+
+    // Metà dei task alla frequenza più bassa, un quarto alla successiva e così
+    // via: molti sensori lenti e pochi veloci
+    uint32 rates = sizeof(kPeriodicRates) / sizeof(kPeriodicRates[0]);
+    for (uint32 i = 0; i < BENCH_PERIODIC_TASKS; i++) {
+        uint32 rate = min_c(static_cast<uint32>(__builtin_ctz(i / BENCH_PERIODIC_BUSES + 1)),
+                            rates - 1);
+        status_t status = sampler.spawn(periodic_task(sampler, buses[i % BENCH_PERIODIC_BUSES],
+            1000000 / kPeriodicRates[rate], &context));
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    status_t status = sampler.init();
+    if (status != B_OK) {
+        return status;
+    }
+    snooze(BENCH_PERIODIC_DURATION);
+    sampler.deinit();
+
+    uint32 count = context.count;
+    if (count == 0) {
+        return B_ERROR;
+    }
+    qsort(samples, count, sizeof(nanotime_t), compare_samples);
+
+    int64 batches = sampler.batch_count();
+    printf("{\"op\":\"periodic_sample\",\"tasks\":%d,\"buses\":%d,\"clock_hz\":%" B_PRIu32
+           ",\"realtime\":%s,\"samples\":%" B_PRId64 ",\"reads_per_batch\":%.1f"
+           ",\"p50_ns\":%" B_PRId64 ",\"p99_ns\":%" B_PRId64 ",\"p999_ns\":%" B_PRId64
+           ",\"max_wake_lateness_us\":%" B_PRId64 "}\n",
+           BENCH_PERIODIC_TASKS, BENCH_PERIODIC_BUSES, options.clock,
+           options.realtime ? "true" : "false", sampler.sample_count(),
+           batches > 0 ? static_cast<double>(sampler.sample_count()) / batches : 0.0,
+           percentile(samples, count, 500), percentile(samples, count, 990),
+           percentile(samples, count, 999), sampler.max_lateness());
+    return B_OK;
+}
+
+static void executor_decode(i2c_executor_job* job, void* cookie) {
+    bench_executor_context* context = static_cast<bench_executor_context*>(cookie);
+    if (atomic_add(&context->remaining, -1) == 1) {
+        release_sem(context->done);
+    }
+}
+
+// Le stesse letture per bus, con 'buses' bus in parallelo: se le corsie sono
+// davvero indipendenti il tempo totale resta quello di un bus solo
+static status_t run_executor_case(const bench_options& options, uint32 buses,
+                                  nanotime_t* elapsed) {
+    I2CSimTransport transports[BENCH_EXECUTOR_BUSES];
+    I2CSimRegisterDevice devices[BENCH_EXECUTOR_BUSES];
+    I2CExecutor executor(BENCH_EXECUTOR_WORKERS);
+    for (uint32 i = 0; i < buses; i++) {
+        transports[i].set_speed(options.clock);
+        transports[i].set_realtime(true);
+        // I bus dormono invece di girare a vuoto: con meno CPU che corsie il
+        // busy-wait misurerebbe la contesa della CPU, non il parallelismo dei bus
+        transports[i].set_spin_threshold(0);
+        transports[i].set_call_overhead(options.overhead);
+        transports[i].attach(BENCH_ADDRESS, &devices[i]);
+        int32 lane = executor.add_bus(&transports[i]);
+        if (lane < B_OK) {
+            return lane;
+        }
+    }
+
+    uint32 count = buses * BENCH_EXECUTOR_READS;
+    i2c_executor_job* jobs = new(std::nothrow) i2c_executor_job[count];
+    uint8* buffers = new(std::nothrow) uint8[count * 2];
+    bench_executor_context context;
+    context.remaining = count;
+    context.done = create_sem(0, "bench executor done");
+    status_t status = jobs == NULL || buffers == NULL ? B_NO_MEMORY
+        : context.done < B_OK ? context.done : executor.init();
+    if (status != B_OK) {
+        delete[] jobs;
+        delete[] buffers;
+        delete_sem(context.done);
+        return status;
+    }
+
+    for (uint32 i = 0; i < count; i++) {
+        memset(&jobs[i], 0, sizeof(jobs[i]));
+        jobs[i].request.op = I2C_ASYNC_READ_REGISTERS;
+        jobs[i].request.address = BENCH_ADDRESS;
+        jobs[i].request.reg = 0x10;
+        jobs[i].request.buffer = buffers + i * 2;
+        jobs[i].request.length = 2;
+        jobs[i].decode = executor_decode;
+        jobs[i].cookie = &context;
+    }
+
+    // Sottomissione alternata tra i bus: la coda piena di una corsia non ferma
+    // le altre più di una lettura
+    nanotime_t start = system_time_nsecs();
+    for (uint32 i = 0; i < BENCH_EXECUTOR_READS && status == B_OK; i++) {
+        for (uint32 bus = 0; bus < buses && status == B_OK; bus++) {
+            status = executor.submit(bus, &jobs[i * buses + bus]);
+        }
+    }
+    if (status == B_OK) {
+        status = acquire_sem(context.done);
+    }
+    *elapsed = system_time_nsecs() - start;
+
+    executor.deinit();
+    for (uint32 i = 0; status == B_OK && i < count; i++) {
+        status = jobs[i].status;
+    }
+    delete[] jobs;
+    delete[] buffers;
+    delete_sem(context.done);
+    return status;
+}
+
+static status_t run_executor(const bench_options& options) {
+    nanotime_t single = 0;
+    for (uint32 buses = 1; buses <= BENCH_EXECUTOR_BUSES; buses++) {
+        nanotime_t elapsed;
+        status_t status = run_executor_case(options, buses, &elapsed);
+        if (status != B_OK) {
+            return status;
+        }
+        if (buses == 1) {
+            single = elapsed;
+        }
+        printf("{\"op\":\"executor_scaling\",\"buses\":%" B_PRIu32 ",\"workers\":%d"
+               ",\"reads_per_bus\":%d,\"clock_hz\":%" B_PRIu32 ",\"wall_us\":%" B_PRId64
+               ",\"time_vs_one_bus\":%.2f,\"reads_per_s\":%.0f}\n",
+               buses, BENCH_EXECUTOR_WORKERS, BENCH_EXECUTOR_READS, options.clock,
+               elapsed / 1000, single > 0 ? static_cast<double>(elapsed) / single : 0.0,
+               elapsed > 0 ? buses * BENCH_EXECUTOR_READS * 1e9 / elapsed : 0.0);
+    }
+    return B_OK;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Uso: %s [-n iterazioni] [-c clock_hz] [-o overhead_us] [-r] [-s] [-m] [-p]"
+            " [-x]\n", name);
+}
+
+int main(int argc, char** argv) {
+    bench_options options;
+    options.iterations = BENCH_DEFAULT_ITERATIONS;
+    options.clock = 400000;
+    options.overhead = 0;
+    options.realtime = false;
+    options.stats = false;
+    options.mixed = false;
+    options.periodic = false;
+    options.executor = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            options.iterations = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            options.clock = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.overhead = strtoll(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            options.realtime = true;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            options.stats = true;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            options.mixed = true;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            options.periodic = true;
+        } else if (strcmp(argv[i], "-x") == 0) {
+            options.executor = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.iterations == 0 || options.clock == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    nanotime_t* samples = static_cast<nanotime_t*>(
+        malloc(options.iterations * sizeof(nanotime_t)));
+    if (samples == NULL) {
+        fprintf(stderr, "Memoria insufficiente per %" B_PRIu32 " campioni\n",
+                options.iterations);
+        return 1;
+    }
+
+    if (options.executor) {
+        status_t status = run_executor(options);
+        if (status != B_OK) {
+            fprintf(stderr, "Errore nell'executor: %s\n", strerror(status));
+        }
+        free(samples);
+        return status == B_OK ? 0 : 1;
+    }
+
+    if (options.periodic) {
+        status_t status = run_periodic(options, samples);
+        if (status != B_OK) {
+            fprintf(stderr, "Errore nel campionamento periodico: %s\n", strerror(status));
+        }
+        free(samples);
+        return status == B_OK ? 0 : 1;
+    }
+
+    if (options.mixed) {
+        for (int scheduled = 0; scheduled <= 1; scheduled++) {
+            status_t status = run_mixed(options, scheduled != 0, samples);
+            if (status != B_OK) {
+                fprintf(stderr, "Errore nel traffico misto: %s\n", strerror(status));
+                free(samples);
+                return 1;
+            }
+        }
+        free(samples);
+        return 0;
+    }
+
+    for (int op = BENCH_WRITE; op <= BENCH_READ_REGISTERS; op++) {
+        // Le operazioni a registro singolo hanno una dimensione fissa
+        bool sized = op != BENCH_WRITE_REGISTER && op != BENCH_READ_REGISTER;
+        size_t size_count = sized ? sizeof(kSizes) / sizeof(kSizes[0]) : 1;
+
+        for (size_t s = 0; s < size_count; s++) {
+            for (int combined = 1; combined >= 0; combined--) {
+                status_t status = run_case(options, static_cast<bench_op>(op), kSizes[s],
+                                           combined != 0, samples);
+                if (status != B_OK) {
+                    fprintf(stderr, "Errore in %s (%zu byte): %s\n", kOpNames[op],
+                            kSizes[s], strerror(status));
+                    free(samples);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    free(samples);
+    return 0;
+}
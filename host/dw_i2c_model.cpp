@@ -0,0 +1,790 @@
+#include "dw_i2c_model.h"
+#include "i2c_util.h"
+#include <string.h>
+
+#define DW_I2C_MODEL_MAX_CONTROLLERS 8
+
+// Registri privati LPSS letti da i2c_dma_init; sotto DW_LPSS_PRIVATE quelli
+// del controller, che non rispondono con la funzione nel reset
+#define DW_LPSS_PRIVATE      0x200
+#define DW_LPSS_CAPS         0x2FC
+#define DW_LPSS_CAPS_NO_IDMA (1 << 8)
+
+// Versione del componente: 2.01a, con il bus clear
+#define DW_COMP_VERSION      0x3230312A
+
+static DWI2CModel* sModels[DW_I2C_MODEL_MAX_CONTROLLERS];
+
+
+// #pragma mark - HostRegisterSlave
+
+
+HostRegisterSlave::HostRegisterSlave(nanotime_t stretch)
+    :
+    fPointer(0),
+    fFirstByte(false),
+    fWritten(0),
+    fWriteLimit(0),
+    fStretch(stretch)
+{
+    memset(fMemory, 0, sizeof(fMemory));
+}
+
+bool HostRegisterSlave::address(bool read) {
+    fFirstByte = !read;
+    fWritten = 0;
+    return true;
+}
+
+bool HostRegisterSlave::write(uint8 value) {
+    if (fWriteLimit != 0 && fWritten >= fWriteLimit) {
+        return false;
+    }
+    fWritten++;
+    if (fFirstByte) {
+        fPointer = value;
+        fFirstByte = false;
+    } else {
+        fMemory[fPointer++] = value;
+    }
+    return true;
+}
+
+uint8 HostRegisterSlave::read() {
+    return fMemory[fPointer++];
+}
+
+void HostRegisterSlave::stop() {
+    fFirstByte = false;
+}
+
+
+// #pragma mark - DWI2CModel
+
+
+DWI2CModel::DWI2CModel(uint8 irq, phys_addr_t bar, uint32 clock, uint32 fifo_depth, bool dma)
+    :
+    fIrq(irq),
+    fBar(bar),
+    fClock(clock),
+    fDepth(fifo_depth > DW_I2C_MODEL_MAX_DEPTH ? DW_I2C_MODEL_MAX_DEPTH : fifo_depth),
+    fHasDMA(dma),
+    fSlaveCount(0),
+    fTxHead(0),
+    fTxCount(0),
+    fRxHead(0),
+    fRxCount(0),
+    fOperation(OP_NONE),
+    fBusyUntil(0),
+    fCommand(0),
+    fAck(true),
+    fReadValue(0),
+    fStalled(false),
+    fTransaction(false),
+    fReading(false),
+    fSlave(NULL),
+    fPeriod(0),
+    fTenBit(false),
+    fRise(0),
+    fRaw(0),
+    fAbortSource(0),
+    fDisabling(false),
+    fAbortRequested(false),
+    fLine(false),
+    fBusBytes(0),
+    fFault(FAULT_NONE),
+    fStuck(FAULT_NONE),
+    fSdaNotRecovered(false),
+    fResetAccesses(0)
+{
+    memset(fRegisters, 0, sizeof(fRegisters));
+    memset(fSlaves, 0, sizeof(fSlaves));
+    memset(fDMA, 0, sizeof(fDMA));
+
+    // Valori di reset dei parametri di sintesi: APB a 32 bit, fino all'high speed
+    fRegisters[I2C_COMP_PARAM_1 / 4] = IC_COMP_PARAM_1::APB_DATA_WIDTH::set(2).value
+        | IC_COMP_PARAM_1::MAX_SPEED_MODE::set(IC_CON::SPEED_HIGH).value
+        | IC_COMP_PARAM_1::HAS_DMA::set(dma ? 1 : 0).value
+        | IC_COMP_PARAM_1::RX_BUFFER_DEPTH::set(fDepth - 1).value
+        | IC_COMP_PARAM_1::TX_BUFFER_DEPTH::set(fDepth - 1).value;
+    fRegisters[I2C_COMP_VERSION / 4] = DW_COMP_VERSION;
+    fRegisters[DW_LPSS_CAPS / 4] = dma ? 0 : DW_LPSS_CAPS_NO_IDMA;
+    // Il firmware lascia la funzione fuori dal reset
+    fRegisters[LPSS_PRIV_RESETS / 4] = LPSS_RESETS::FUNC::set(3).value;
+    fRegisters[I2C_SCL_STUCK_AT_LOW_TIMEOUT / 4] = 0xFFFFFFFF;
+    fRegisters[I2C_SDA_STUCK_AT_LOW_TIMEOUT / 4] = 0xFFFFFFFF;
+
+    for (int i = 0; i < DW_I2C_MODEL_MAX_CONTROLLERS; i++) {
+        if (sModels[i] == NULL) {
+            sModels[i] = this;
+            break;
+        }
+    }
+}
+
+DWI2CModel::~DWI2CModel() {
+    for (int i = 0; i < DW_I2C_MODEL_MAX_CONTROLLERS; i++) {
+        if (sModels[i] == this) {
+            sModels[i] = NULL;
+        }
+    }
+}
+
+DWI2CModel* DWI2CModel::find(phys_addr_t bar) {
+    for (int i = 0; i < DW_I2C_MODEL_MAX_CONTROLLERS; i++) {
+        if (sModels[i] != NULL && sModels[i]->fBar == bar) {
+            return sModels[i];
+        }
+    }
+    return NULL;
+}
+
+status_t DWI2CModel::attach(uint16 address, HostI2CSlave* slave, bool ten_bit) {
+    if (slave == NULL || address > (ten_bit ? 0x3FF : 0x7F)
+        || lookup_slave(address, ten_bit) != NULL) {
+        return B_BAD_VALUE;
+    }
+    if (fSlaveCount == DW_I2C_MODEL_MAX_SLAVES) {
+        return B_NO_MEMORY;
+    }
+    fSlaves[fSlaveCount].address = address;
+    fSlaves[fSlaveCount].ten_bit = ten_bit;
+    fSlaves[fSlaveCount].slave = slave;
+    fSlaveCount++;
+    return B_OK;
+}
+
+HostI2CSlave* DWI2CModel::lookup_slave(uint16 address, bool ten_bit) const {
+    for (uint32 i = 0; i < fSlaveCount; i++) {
+        if (fSlaves[i].address == address && fSlaves[i].ten_bit == ten_bit) {
+            return fSlaves[i].slave;
+        }
+    }
+    return NULL;
+}
+
+// Periodo di SCL dal databook: alto per HCNT + IC_*_SPKLEN + 7 cicli di ic_clk,
+// basso per LCNT + 1, più la salita di SCL che i contatori non vedono. Il fast
+// mode vale anche per il codice master che apre le transazioni high speed.
+nanotime_t DWI2CModel::scl_period(uint32 speed) const {
+    uint32 hcnt;
+    uint32 lcnt;
+    uint32 spklen;
+    if (speed == IC_CON::SPEED_STANDARD) {
+        hcnt = fRegisters[I2C_SS_SCL_HCNT / 4];
+        lcnt = fRegisters[I2C_SS_SCL_LCNT / 4];
+    } else if (speed == IC_CON::SPEED_HIGH) {
+        hcnt = fRegisters[I2C_HS_SCL_HCNT / 4];
+        lcnt = fRegisters[I2C_HS_SCL_LCNT / 4];
+    } else {
+        hcnt = fRegisters[I2C_FS_SCL_HCNT / 4];
+        lcnt = fRegisters[I2C_FS_SCL_LCNT / 4];
+    }
+    spklen = IC_FS_SPKLEN::SPKLEN::get(fRegisters[(speed == IC_CON::SPEED_HIGH
+        ? I2C_HS_SPKLEN : I2C_FS_SPKLEN) / 4]);
+    if (spklen == 0) {
+        spklen = 1;
+    }
+
+    // Il controller non accetta conteggi sotto i minimi
+    hcnt &= 0xFFFF;
+    lcnt &= 0xFFFF;
+    if (hcnt < spklen + 5) {
+        hcnt = spklen + 5;
+    }
+    if (lcnt < spklen + 7) {
+        lcnt = spklen + 7;
+    }
+    uint64 cycles = hcnt + spklen + 7 + lcnt + 1;
+    return (nanotime_t)((cycles * 1000000000ULL + fClock - 1) / fClock) + fRise;
+}
+
+uint32 DWI2CModel::scl_frequency() const {
+    nanotime_t period = scl_period(IC_CON::SPEED::get(fRegisters[I2C_CON / 4]));
+    return period > 0 ? (uint32)(1000000000LL / period) : 0;
+}
+
+// Il modo a 10 bit è sia in I2C_CON sia in I2C_TAR: basta uno dei due
+bool DWI2CModel::ten_bit_target() const {
+    return IC_CON::IC_10BITADDR_MASTER::is_set(fRegisters[I2C_CON / 4])
+        || IC_TAR::IC_10BITADDR_MASTER::is_set(fRegisters[I2C_TAR / 4]);
+}
+
+uint32 DWI2CModel::raw_status() const {
+    uint32 raw = fRaw;
+    uint32 con = fRegisters[I2C_CON / 4];
+    // Con TX_EMPTY_CTRL serve anche lo shift register vuoto
+    if (fTxCount <= fRegisters[I2C_TX_TL / 4]
+        && (!IC_CON::TX_EMPTY_CTRL::is_set(con) || fOperation == OP_NONE)) {
+        raw |= IC_RAW_INTR_STAT::TX_EMPTY::mask;
+    }
+    if (fRxCount > fRegisters[I2C_RX_TL / 4]) {
+        raw |= IC_RAW_INTR_STAT::RX_FULL::mask;
+    }
+    return raw;
+}
+
+// La linea è a livello: resta attiva finché un bit non mascherato è attivo
+void DWI2CModel::update_interrupt() {
+    if (fIrq == 0) {
+        return;
+    }
+    bool line = (raw_status() & fRegisters[I2C_INTR_MASK / 4]) != 0;
+    if (line != fLine) {
+        fLine = line;
+        host_set_interrupt_line(fIrq, line);
+    }
+}
+
+void DWI2CModel::flush() {
+    fTxCount = 0;
+    fRxCount = 0;
+}
+
+// Reset della funzione (LPSS_PRIV_RESETS.FUNC a 0): registri ai valori di
+// reset e bus libero. Il modello considera liberato anche lo slave bloccato;
+// su una scheda reale può servire il reset del dispositivo.
+void DWI2CModel::reset() {
+    uint32 param = fRegisters[I2C_COMP_PARAM_1 / 4];
+    uint32 caps = fRegisters[DW_LPSS_CAPS / 4];
+    uint32 resets = fRegisters[LPSS_PRIV_RESETS / 4];
+    memset(fRegisters, 0, sizeof(fRegisters));
+    fRegisters[I2C_COMP_PARAM_1 / 4] = param;
+    fRegisters[I2C_COMP_VERSION / 4] = DW_COMP_VERSION;
+    fRegisters[DW_LPSS_CAPS / 4] = caps;
+    fRegisters[LPSS_PRIV_RESETS / 4] = resets;
+    fRegisters[I2C_SCL_STUCK_AT_LOW_TIMEOUT / 4] = 0xFFFFFFFF;
+    fRegisters[I2C_SDA_STUCK_AT_LOW_TIMEOUT / 4] = 0xFFFFFFFF;
+
+    fTxHead = 0;
+    fRxHead = 0;
+    flush();
+    fOperation = OP_NONE;
+    fStalled = false;
+    fTransaction = false;
+    fSlave = NULL;
+    fRaw = 0;
+    fAbortSource = 0;
+    fDisabling = false;
+    fAbortRequested = false;
+    fFault = FAULT_NONE;
+    fStuck = FAULT_NONE;
+    fSdaNotRecovered = false;
+}
+
+// Bus clear: fino a nove impulsi di SCL finché lo slave non rilascia SDA, poi
+// uno STOP. Con SCL bloccato gli impulsi non escono e SDA resta basso.
+void DWI2CModel::start_bus_clear(nanotime_t when) {
+    fSdaNotRecovered = false;
+    if (fOperation != OP_STUCK && fOperation != OP_SDA_STUCK) {
+        // SDA non è bloccato: nulla da fare
+        fRegisters[I2C_ENABLE / 4] &= ~IC_ENABLE::SDA_STUCK_RECOVERY_ENABLE::mask;
+        return;
+    }
+    fOperation = OP_BUS_CLEAR;
+    fBusyUntil = when + 9 * fPeriod + fPeriod;
+}
+
+// Prossimo comando del TX FIFO a partire da 'when'. Con il FIFO vuoto e la
+// transazione aperta il master tiene SCL basso finché non arriva un comando.
+void DWI2CModel::start_next(nanotime_t when) {
+    if (fOperation != OP_NONE) {
+        return;
+    }
+    if (fDisabling) {
+        if (fTransaction) {
+            fOperation = OP_STOP;
+            fBusyUntil = when + fPeriod;
+        } else {
+            fDisabling = false;
+            flush();
+        }
+        return;
+    }
+    if (fTxCount == 0 || !IC_ENABLE::ENABLE::is_set(fRegisters[I2C_ENABLE / 4])) {
+        return;
+    }
+
+    uint32 command = fTx[fTxHead];
+    fTxHead = (fTxHead + 1) % DW_I2C_MODEL_MAX_DEPTH;
+    fTxCount--;
+
+    bool read = IC_DATA_CMD::CMD::is_set(command);
+    nanotime_t duration = 0;
+    // Un cambio di direzione senza RESTART richiesto lo genera il controller
+    if (!fTransaction || IC_DATA_CMD::RESTART::is_set(command) || read != fReading) {
+        if (!fTransaction) {
+            uint32 speed = IC_CON::SPEED::get(fRegisters[I2C_CON / 4]);
+            fPeriod = scl_period(speed);
+            fTenBit = ten_bit_target();
+            // High speed: START e codice master, senza ACK, in fast mode; il
+            // RESTART seguente passa alla velocità alta
+            if (speed == IC_CON::SPEED_HIGH) {
+                duration += 10 * scl_period(IC_CON::SPEED_FAST);
+            }
+        }
+        fRaw |= IC_RAW_INTR_STAT::START_DET::mask;
+        fTransaction = true;
+        fReading = read;
+        // START o RESTART, poi otto bit di indirizzo e l'ACK. A 10 bit gli
+        // indirizzi sono due; per leggere segue un RESTART con il primo byte
+        // in lettura.
+        duration += fPeriod + 9 * fPeriod;
+        if (fTenBit) {
+            duration += 9 * fPeriod;
+            if (read) {
+                duration += fPeriod + 9 * fPeriod;
+            }
+        }
+        fSlave = lookup_slave(IC_TAR::ADDRESS::get(fRegisters[I2C_TAR / 4]), fTenBit);
+        if (fFault == FAULT_ARBITRATION) {
+            fFault = FAULT_NONE;
+            fOperation = OP_ARBITRATION;
+            fCommand = command;
+            fBusyUntil = when + duration;
+            return;
+        }
+        if (fSlave == NULL || !fSlave->address(read)) {
+            fOperation = OP_ADDRESS_NACK;
+            fCommand = command;
+            fBusyUntil = when + duration;
+            return;
+        }
+    }
+
+    if (fFault == FAULT_SDA_STUCK || fFault == FAULT_SCL_STUCK) {
+        fStuck = fFault;
+        fFault = FAULT_NONE;
+        fOperation = OP_STUCK;
+        fCommand = command;
+        // Con il bus clear il master si accorge di SDA basso da solo. SCL
+        // bloccato non si modella: il suo timeout alza solo un interrupt.
+        if (fStuck == FAULT_SDA_STUCK
+            && IC_CON::BUS_CLEAR_FEATURE_CTRL::is_set(fRegisters[I2C_CON / 4])) {
+            uint64 cycles = fRegisters[I2C_SDA_STUCK_AT_LOW_TIMEOUT / 4];
+            fOperation = OP_SDA_STUCK;
+            fBusyUntil = when + static_cast<nanotime_t>(cycles * 1000000000 / fClock);
+        }
+        return;
+    }
+
+    duration += 9 * fPeriod + fSlave->stretch();
+    if (read) {
+        fReadValue = fSlave->read();
+    } else {
+        fAck = fSlave->write(IC_DATA_CMD::DAT::get(command));
+    }
+    if (IC_DATA_CMD::STOP::is_set(command)) {
+        duration += fPeriod;
+    }
+    fOperation = OP_BYTE;
+    fCommand = command;
+    fBusyUntil = when + duration;
+}
+
+void DWI2CModel::finish_stop() {
+    fTransaction = false;
+    fRaw |= IC_RAW_INTR_STAT::STOP_DET::mask;
+    if (fSlave != NULL) {
+        fSlave->stop();
+    }
+}
+
+// Il TX FIFO viene svuotato e resta vuoto fino alla lettura di I2C_CLR_TX_ABRT;
+// se la transazione era aperta segue uno STOP
+void DWI2CModel::abort(nanotime_t when, uint32 source) {
+    uint32 flushed = fTxCount > 0x1FF ? 0x1FF : fTxCount;
+    fAbortSource |= source | IC_TX_ABRT_SOURCE::TX_FLUSH_CNT::set(flushed).value;
+    fTxCount = 0;
+    fRaw |= IC_RAW_INTR_STAT::TX_ABRT::mask;
+    fAbortRequested = false;
+    fRegisters[I2C_ENABLE / 4] &= ~IC_ENABLE::ABORT::mask;
+    if (fTransaction) {
+        fOperation = OP_STOP;
+        fBusyUntil = when + fPeriod;
+    } else {
+        fOperation = OP_NONE;
+    }
+}
+
+void DWI2CModel::complete(nanotime_t when) {
+    switch (fOperation) {
+        case OP_ADDRESS_NACK:
+            abort(when, fTenBit ? IC_TX_ABRT_SOURCE::ABRT_10ADDR1_NOACK::mask
+                                : IC_TX_ABRT_SOURCE::ABRT_7B_ADDR_NOACK::mask);
+            return;
+
+        case OP_STOP:
+            fOperation = OP_NONE;
+            finish_stop();
+            start_next(when);
+            return;
+
+        case OP_ARBITRATION:
+            // Il bus torna libero con lo STOP dell'altro master
+            abort(when, IC_TX_ABRT_SOURCE::ARB_LOST::mask);
+            return;
+
+        case OP_BUS_CLEAR:
+            fRegisters[I2C_ENABLE / 4] &= ~IC_ENABLE::SDA_STUCK_RECOVERY_ENABLE::mask;
+            if (fStuck == FAULT_SCL_STUCK) {
+                fSdaNotRecovered = true;
+                fOperation = OP_STUCK;
+                return;
+            }
+            // SDA libero e STOP: il comando fermo e quelli accodati sono persi
+            fStuck = FAULT_NONE;
+            fTxCount = 0;
+            fAbortRequested = false;
+            fRegisters[I2C_ENABLE / 4] &= ~IC_ENABLE::ABORT::mask;
+            fOperation = OP_NONE;
+            finish_stop();
+            start_next(when);
+            return;
+
+        case OP_STUCK:
+            return;
+
+        case OP_SDA_STUCK:
+            // TX FIFO svuotato, ma lo STOP non può uscire: SDA resta basso fino
+            // al bus clear
+            abort(when, IC_TX_ABRT_SOURCE::ABRT_SDA_STUCK_AT_LOW::mask);
+            fOperation = OP_STUCK;
+            return;
+
+        case OP_BYTE:
+            if (IC_DATA_CMD::CMD::is_set(fCommand)) {
+                if (fRxCount == fDepth) {
+                    // RX_FIFO_FULL_HLD_CTRL: il bus attende la lettura di un byte
+                    if (IC_CON::RX_FIFO_FULL_HLD_CTRL::is_set(fRegisters[I2C_CON / 4])) {
+                        fStalled = true;
+                        return;
+                    }
+                    fRaw |= IC_RAW_INTR_STAT::RX_OVER::mask;
+                } else {
+                    fRx[(fRxHead + fRxCount) % DW_I2C_MODEL_MAX_DEPTH] = fReadValue;
+                    fRxCount++;
+                }
+            } else if (!fAck) {
+                abort(when, IC_TX_ABRT_SOURCE::ABRT_TXDATA_NOACK::mask);
+                return;
+            }
+            fBusBytes++;
+            fOperation = OP_NONE;
+            if (IC_DATA_CMD::STOP::is_set(fCommand)) {
+                finish_stop();
+            }
+            if (fAbortRequested) {
+                abort(when, IC_TX_ABRT_SOURCE::ABRT_USER_ABRT::mask);
+                return;
+            }
+            start_next(when);
+            return;
+
+        case OP_NONE:
+            return;
+    }
+}
+
+void DWI2CModel::advance(nanotime_t now) {
+    while (fOperation != OP_NONE && fOperation != OP_STUCK && !fStalled
+            && fBusyUntil <= now) {
+        nanotime_t when = fBusyUntil;
+        complete(when);
+        service_dma(when);
+    }
+    update_interrupt();
+}
+
+nanotime_t DWI2CModel::next_event() {
+    return fOperation != OP_NONE && fOperation != OP_STUCK && !fStalled ? fBusyUntil : -1;
+}
+
+// Richieste di handshake: TX con TXFLR <= DMA_TDLR, a burst di
+// I2C_DMA_TX_BURST parole; RX con RXFLR > DMA_RDLR. Il DMA non costa tempo.
+void DWI2CModel::service_dma(nanotime_t when) {
+    if (!fHasDMA) {
+        return;
+    }
+    uint32 control = fRegisters[I2C_DMA_CR / 4];
+
+    dma_channel& rx = fDMA[I2C_DMA_RX];
+    if (IC_DMA_CR::RDMAE::is_set(control) && rx.active) {
+        while (fRxCount > fRegisters[I2C_DMA_RDLR / 4] && rx.done < rx.count) {
+            rx.memory[rx.done++] = fRx[fRxHead];
+            fRxHead = (fRxHead + 1) % DW_I2C_MODEL_MAX_DEPTH;
+            fRxCount--;
+        }
+        if (fStalled && fRxCount < fDepth) {
+            fStalled = false;
+            complete(when);
+        }
+    }
+
+    dma_channel& tx = fDMA[I2C_DMA_TX];
+    if (IC_DMA_CR::TDMAE::is_set(control) && tx.active
+        && !IC_RAW_INTR_STAT::TX_ABRT::is_set(fRaw)
+        && IC_ENABLE::ENABLE::is_set(fRegisters[I2C_ENABLE / 4])) {
+        const uint32* words = (const uint32*)tx.memory;
+        while (tx.done < tx.count && fTxCount <= fRegisters[I2C_DMA_TDLR / 4]) {
+            for (uint32 i = 0; i < I2C_DMA_TX_BURST && tx.done < tx.count
+                    && fTxCount < fDepth; i++) {
+                fTx[(fTxHead + fTxCount) % DW_I2C_MODEL_MAX_DEPTH] = words[tx.done++];
+                fTxCount++;
+            }
+        }
+        start_next(when);
+    }
+}
+
+status_t DWI2CModel::dma_start(uint32 channel, phys_addr_t memory, size_t count) {
+    if (!fHasDMA || channel > I2C_DMA_RX) {
+        return B_BAD_VALUE;
+    }
+    // Per l'harness l'indirizzo fisico è quello virtuale (get_memory_map)
+    fDMA[channel].active = true;
+    fDMA[channel].memory = (uint8*)(addr_t)memory;
+    fDMA[channel].count = count;
+    fDMA[channel].done = 0;
+    service_dma(host_clock());
+    update_interrupt();
+    return B_OK;
+}
+
+status_t DWI2CModel::dma_status(uint32 channel) {
+    if (channel > I2C_DMA_RX) {
+        return B_BAD_VALUE;
+    }
+    return fDMA[channel].done == fDMA[channel].count ? B_OK : B_BUSY;
+}
+
+void DWI2CModel::dma_stop(uint32 channel) {
+    if (channel <= I2C_DMA_RX) {
+        fDMA[channel].active = false;
+    }
+}
+
+uint32 DWI2CModel::read_register(uint32 offset) {
+    switch (offset) {
+        case I2C_DATA_CMD: {
+            if (fRxCount == 0) {
+                fRaw |= IC_RAW_INTR_STAT::RX_UNDER::mask;
+                return 0;
+            }
+            uint8 value = fRx[fRxHead];
+            fRxHead = (fRxHead + 1) % DW_I2C_MODEL_MAX_DEPTH;
+            fRxCount--;
+            // Un byte letto sblocca la lettura ferma sul bus
+            if (fStalled) {
+                fStalled = false;
+                complete(host_clock());
+            }
+            return value;
+        }
+        case I2C_STATUS: {
+            bool active = fTransaction || fOperation != OP_NONE;
+            return (active ? IC_STATUS::ACTIVITY::mask | IC_STATUS::MST_ACTIVITY::mask : 0)
+                | (fTxCount < fDepth ? IC_STATUS::TFNF::mask : 0)
+                | (fTxCount == 0 ? IC_STATUS::TFE::mask : 0)
+                | (fRxCount > 0 ? IC_STATUS::RFNE::mask : 0)
+                | (fRxCount == fDepth ? IC_STATUS::RFF::mask : 0)
+                | (fSdaNotRecovered ? IC_STATUS::SDA_STUCK_NOT_RECOVERED::mask : 0);
+        }
+        case I2C_TXFLR:
+            return fTxCount;
+        case I2C_RXFLR:
+            return fRxCount;
+        case I2C_INTR_STAT:
+            return raw_status() & fRegisters[I2C_INTR_MASK / 4];
+        case I2C_RAW_INTR_STAT:
+            return raw_status();
+        case I2C_CLR_INTR:
+            fRaw = 0;
+            fAbortSource = 0;
+            return 0;
+        case I2C_CLR_RX_UNDER:
+            fRaw &= ~IC_RAW_INTR_STAT::RX_UNDER::mask;
+            return 0;
+        case I2C_CLR_RX_OVER:
+            fRaw &= ~IC_RAW_INTR_STAT::RX_OVER::mask;
+            return 0;
+        case I2C_CLR_TX_OVER:
+            fRaw &= ~IC_RAW_INTR_STAT::TX_OVER::mask;
+            return 0;
+        case I2C_CLR_RD_REQ:
+            fRaw &= ~IC_RAW_INTR_STAT::RD_REQ::mask;
+            return 0;
+        case I2C_CLR_TX_ABRT:
+            fRaw &= ~IC_RAW_INTR_STAT::TX_ABRT::mask;
+            fAbortSource = 0;
+            return 0;
+        case I2C_CLR_RX_DONE:
+            fRaw &= ~IC_RAW_INTR_STAT::RX_DONE::mask;
+            return 0;
+        case I2C_CLR_ACTIVITY:
+            fRaw &= ~IC_RAW_INTR_STAT::ACTIVITY::mask;
+            return 0;
+        case I2C_CLR_STOP_DET:
+            fRaw &= ~IC_RAW_INTR_STAT::STOP_DET::mask;
+            return 0;
+        case I2C_CLR_START_DET:
+            fRaw &= ~IC_RAW_INTR_STAT::START_DET::mask;
+            return 0;
+        case I2C_CLR_GEN_CALL:
+            fRaw &= ~IC_RAW_INTR_STAT::GEN_CALL::mask;
+            return 0;
+        case I2C_TX_ABRT_SOURCE:
+            return fAbortSource;
+        case I2C_ENABLE_STATUS:
+            return IC_ENABLE::ENABLE::is_set(fRegisters[I2C_ENABLE / 4]) || fDisabling
+                ? IC_ENABLE_STATUS::IC_EN::mask : 0;
+        default:
+            return offset < sizeof(fRegisters) ? fRegisters[offset / 4] : 0xFFFFFFFF;
+    }
+}
+
+void DWI2CModel::write_register(uint32 offset, uint32 value) {
+    nanotime_t now = host_clock();
+
+    switch (offset) {
+        case I2C_DATA_CMD:
+            // Spento o dopo un abort il TX FIFO non accetta comandi
+            if (!IC_ENABLE::ENABLE::is_set(fRegisters[I2C_ENABLE / 4])
+                || IC_RAW_INTR_STAT::TX_ABRT::is_set(fRaw)) {
+                break;
+            }
+            if (fTxCount == fDepth) {
+                fRaw |= IC_RAW_INTR_STAT::TX_OVER::mask;
+                break;
+            }
+            fTx[(fTxHead + fTxCount) % DW_I2C_MODEL_MAX_DEPTH] = value;
+            fTxCount++;
+            start_next(now);
+            break;
+
+        case I2C_ENABLE: {
+            bool wasEnabled = IC_ENABLE::ENABLE::is_set(fRegisters[I2C_ENABLE / 4]);
+            fRegisters[I2C_ENABLE / 4] = value;
+            if (IC_ENABLE::ABORT::is_set(value)) {
+                if (fOperation == OP_BYTE || fOperation == OP_STUCK
+                    || fOperation == OP_SDA_STUCK) {
+                    fAbortRequested = true;
+                } else if (fOperation == OP_NONE) {
+                    abort(now, IC_TX_ABRT_SOURCE::ABRT_USER_ABRT::mask);
+                } else {
+                    // Abort o STOP già in corso
+                    fRegisters[I2C_ENABLE / 4] &= ~IC_ENABLE::ABORT::mask;
+                }
+            }
+            // Spento: FIFO svuotati; se il bus è occupato il byte in corso
+            // finisce e segue uno STOP
+            if (wasEnabled && !IC_ENABLE::ENABLE::is_set(value)) {
+                flush();
+                if (fTransaction || fOperation != OP_NONE) {
+                    fDisabling = true;
+                    start_next(now);
+                }
+            } else if (!wasEnabled && IC_ENABLE::ENABLE::is_set(value)) {
+                // Riacceso prima di spegnersi: lo STOP non serve più
+                fDisabling = false;
+            }
+            if (IC_ENABLE::SDA_STUCK_RECOVERY_ENABLE::is_set(value)
+                && IC_ENABLE::ENABLE::is_set(value) && fOperation != OP_BUS_CLEAR) {
+                start_bus_clear(now);
+            }
+            break;
+        }
+
+        case LPSS_PRIV_RESETS:
+            fRegisters[offset / 4] = value;
+            if (LPSS_RESETS::FUNC::get(value) == 0) {
+                reset();
+            }
+            break;
+
+        case I2C_DMA_CR:
+        case I2C_DMA_TDLR:
+        case I2C_DMA_RDLR:
+            fRegisters[offset / 4] = value;
+            service_dma(now);
+            break;
+
+        // Registri in sola lettura
+        case I2C_STATUS:
+        case I2C_TXFLR:
+        case I2C_RXFLR:
+        case I2C_INTR_STAT:
+        case I2C_RAW_INTR_STAT:
+        case I2C_TX_ABRT_SOURCE:
+        case I2C_ENABLE_STATUS:
+        case I2C_COMP_PARAM_1:
+        case I2C_COMP_VERSION:
+        case DW_LPSS_CAPS:
+            break;
+
+        default:
+            if (offset >= I2C_CLR_INTR && offset <= I2C_CLR_GEN_CALL) {
+                break;
+            }
+            if (offset < sizeof(fRegisters)) {
+                fRegisters[offset / 4] = value;
+            }
+            break;
+    }
+}
+
+bool DWI2CModel::held_in_reset(uint32 offset) {
+    if (offset >= DW_LPSS_PRIVATE
+        || LPSS_RESETS::FUNC::get(fRegisters[LPSS_PRIV_RESETS / 4]) != 0) {
+        return false;
+    }
+    fResetAccesses++;
+    return true;
+}
+
+uint32 DWI2CModel::mmio_read(uint32 offset) {
+    // Funzione nel reset: il blocco del controller legge 0 e ignora le scritture
+    if (held_in_reset(offset)) {
+        return 0;
+    }
+    uint32 value = read_register(offset);
+    service_dma(host_clock());
+    update_interrupt();
+    return value;
+}
+
+void DWI2CModel::mmio_write(uint32 offset, uint32 value) {
+    if (held_in_reset(offset)) {
+        return;
+    }
+    write_register(offset, value);
+    update_interrupt();
+}
+
+
+// #pragma mark - canali DMA
+
+
+static status_t model_dma_start(i2c_device_info* device, uint32 channel, phys_addr_t memory,
+                                size_t count) {
+    DWI2CModel* model = DWI2CModel::find(device->base_addr);
+    return model != NULL ? model->dma_start(channel, memory, count) : B_NO_INIT;
+}
+
+static status_t model_dma_status(i2c_device_info* device, uint32 channel) {
+    DWI2CModel* model = DWI2CModel::find(device->base_addr);
+    return model != NULL ? model->dma_status(channel) : B_NO_INIT;
+}
+
+static void model_dma_stop(i2c_device_info* device, uint32 channel) {
+    DWI2CModel* model = DWI2CModel::find(device->base_addr);
+    if (model != NULL) {
+        model->dma_stop(channel);
+    }
+}
+
+const i2c_dma_ops gDWI2CModelDMAOps = {
+    model_dma_start,
+    model_dma_status,
+    model_dma_stop
+};
@@ -0,0 +1,200 @@
+#ifndef DW_I2C_MODEL_H
+#define DW_I2C_MODEL_H
+
+#include "host_kernel.h"
+#include "i2c_dma.h"
+
+// Modello a cicli approssimati del controller DesignWare descritto da
+// Driver/i2c_util.h: FIFO con le profondità reali, registri di interrupt e di
+// abort e tempi del bus ricavati dai conteggi *_SCL_HCNT/LCNT, da IC_*_SPKLEN,
+// dal clock del controller e dalla salita di SCL. Ogni byte occupa nove periodi
+// di SCL più l'eventuale clock stretching dello slave; START, RESTART e STOP un
+// periodo ciascuno. Sono modellati anche gli indirizzi a 10 bit e il codice
+// master delle transazioni high speed, il bus clear (SDA_STUCK_RECOVERY_ENABLE)
+// con l'abort per SDA bloccato oltre IC_SDA_STUCK_AT_LOW_TIMEOUT, e il reset
+// della funzione in LPSS_PRIV_RESETS, e si possono iniettare guasti
+// del bus per provare il recupero del driver. Con la funzione tenuta nel reset
+// i registri del controller leggono 0 e ignorano le scritture.
+//
+// Il driver lo usa senza modifiche attraverso host_mmio_read/write. Con il DMA
+// abilitato il modello dichiara l'interfaccia di handshake e fornisce dei
+// canali che sostituiscono quelli iDMA64 (gDWI2CModelDMAOps).
+
+#define DW_I2C_MODEL_MAX_SLAVES 4
+#define DW_I2C_MODEL_MAX_DEPTH  256
+
+// Slave attaccato al bus simulato
+class HostI2CSlave {
+public:
+    virtual ~HostI2CSlave() {}
+
+    // ACK dell'indirizzo dopo START o RESTART
+    virtual bool address(bool read) { return true; }
+    // ACK del byte scritto dal master
+    virtual bool write(uint8 value) = 0;
+    virtual uint8 read() = 0;
+    virtual void stop() {}
+    // Clock stretching prima del prossimo byte (ns)
+    virtual nanotime_t stretch() { return 0; }
+};
+
+// Slave a registri: il primo byte scritto dopo START è il registro, i seguenti
+// vengono scritti da lì in avanti e le letture proseguono dal registro corrente.
+// Può allungare il clock a ogni byte e rifiutare le scritture oltre un limite.
+class HostRegisterSlave : public HostI2CSlave {
+public:
+    HostRegisterSlave(nanotime_t stretch = 0);
+
+    uint8* memory() { return fMemory; }
+    // NACK dal byte scritto numero 'count' di ogni transazione in poi (0: mai)
+    void set_write_limit(uint32 count) { fWriteLimit = count; }
+    void set_stretch(nanotime_t stretch) { fStretch = stretch; }
+
+    bool address(bool read) override;
+    bool write(uint8 value) override;
+    uint8 read() override;
+    void stop() override;
+    nanotime_t stretch() override { return fStretch; }
+
+private:
+    uint8 fMemory[256];
+    uint8 fPointer;
+    bool fFirstByte;
+    uint32 fWritten;
+    uint32 fWriteLimit;
+    nanotime_t fStretch;
+};
+
+class DWI2CModel : public HostMMIODevice {
+public:
+    enum fault {
+        FAULT_NONE,
+        FAULT_ARBITRATION,  // un altro master vince l'arbitraggio del prossimo indirizzo
+        FAULT_SDA_STUCK,    // lo slave si ferma nel prossimo byte tenendo SDA basso:
+                            // lo libera il bus clear
+        FAULT_SCL_STUCK,    // lo slave si ferma nel prossimo byte tenendo SCL basso:
+                            // il bus clear non basta, serve il reset del controller
+    };
+
+    // 'bar' identifica il controller per i canali DMA; 'clock' è ic_clk in Hz
+    DWI2CModel(uint8 irq, phys_addr_t bar, uint32 clock, uint32 fifo_depth, bool dma);
+    ~DWI2CModel();
+
+    status_t attach(uint16 address, HostI2CSlave* slave, bool ten_bit = false);
+    // Tempo di salita di SCL sulla scheda simulata (ns), aggiunto a ogni periodo
+    void set_scl_rise_time(nanotime_t rise) { fRise = rise; }
+    // Guasto sul prossimo trasferimento; uno alla volta
+    void inject_fault(fault kind) { fFault = kind; }
+
+    // Frequenza di SCL con la configurazione attuale di I2C_CON e dei conteggi
+    uint32 scl_frequency() const;
+    // Byte trasferiti sul bus (indirizzi esclusi) dall'ultimo azzeramento
+    uint64 bus_bytes() const { return fBusBytes; }
+    void reset_bus_bytes() { fBusBytes = 0; }
+    // Accessi ai registri del controller con la funzione nel reset
+    uint32 reset_accesses() const { return fResetAccesses; }
+
+    uint32 mmio_read(uint32 offset) override;
+    void mmio_write(uint32 offset, uint32 value) override;
+    void advance(nanotime_t now) override;
+    nanotime_t next_event() override;
+
+    static DWI2CModel* find(phys_addr_t bar);
+
+    // Canali DMA del modello, chiamati tramite gDWI2CModelDMAOps
+    status_t dma_start(uint32 channel, phys_addr_t memory, size_t count);
+    status_t dma_status(uint32 channel);
+    void dma_stop(uint32 channel);
+
+private:
+    enum operation {
+        OP_NONE,
+        OP_BYTE,            // byte in corso sul bus
+        OP_ADDRESS_NACK,    // indirizzo senza ACK: abort alla fine della fase
+        OP_STOP,            // STOP dopo un abort o uno spegnimento
+        OP_ARBITRATION,     // indirizzo che perde l'arbitraggio
+        OP_STUCK,           // byte fermo per un guasto: non finisce da solo
+        OP_SDA_STUCK,       // SDA fermo: abort allo scadere del suo timeout
+        OP_BUS_CLEAR,       // impulsi di SCL del bus clear e STOP
+    };
+
+    typedef struct {
+        bool active;
+        uint8* memory;
+        size_t count;
+        size_t done;
+    } dma_channel;
+
+    uint32 read_register(uint32 offset);
+    void write_register(uint32 offset, uint32 value);
+
+    nanotime_t scl_period(uint32 speed) const;
+    bool ten_bit_target() const;
+    uint32 raw_status() const;
+    void update_interrupt();
+
+    void start_next(nanotime_t when);
+    void complete(nanotime_t when);
+    void abort(nanotime_t when, uint32 source);
+    void finish_stop();
+    void flush();
+    void start_bus_clear(nanotime_t when);
+    void reset();
+    bool held_in_reset(uint32 offset);
+    void service_dma(nanotime_t when);
+    HostI2CSlave* lookup_slave(uint16 address, bool ten_bit) const;
+
+    uint8 fIrq;
+    phys_addr_t fBar;
+    uint32 fClock;
+    uint32 fDepth;
+    bool fHasDMA;
+    uint32 fRegisters[0x1000 / 4];
+
+    struct {
+        uint16 address;
+        bool ten_bit;
+        HostI2CSlave* slave;
+    } fSlaves[DW_I2C_MODEL_MAX_SLAVES];
+    uint32 fSlaveCount;
+
+    uint32 fTx[DW_I2C_MODEL_MAX_DEPTH];
+    uint32 fTxHead;
+    uint32 fTxCount;
+    uint8 fRx[DW_I2C_MODEL_MAX_DEPTH];
+    uint32 fRxHead;
+    uint32 fRxCount;
+
+    // Stato del bus
+    operation fOperation;
+    nanotime_t fBusyUntil;      // fine dell'operazione in corso
+    uint32 fCommand;            // comando dell'operazione in corso
+    bool fAck;                  // esito del byte scritto in corso
+    uint8 fReadValue;           // byte letto in corso
+    bool fStalled;              // lettura ferma: RX FIFO pieno
+    bool fTransaction;          // START inviato, STOP non ancora
+    bool fReading;              // direzione dell'ultimo indirizzo inviato
+    HostI2CSlave* fSlave;
+    nanotime_t fPeriod;         // periodo di SCL fissato allo START
+    bool fTenBit;               // indirizzo a 10 bit, fissato allo START
+    nanotime_t fRise;
+
+    uint32 fRaw;                // bit di interrupt che si azzerano con i clear
+    uint32 fAbortSource;
+    bool fDisabling;            // ENABLE azzerato con il bus occupato
+    bool fAbortRequested;       // ENABLE.ABORT durante un byte
+    bool fLine;                 // livello della linea di interrupt
+    uint64 fBusBytes;
+
+    fault fFault;               // guasto iniettato, in attesa del trasferimento
+    fault fStuck;               // guasto che tiene fermo il bus
+    bool fSdaNotRecovered;      // IC_STATUS.SDA_STUCK_NOT_RECOVERED
+    uint32 fResetAccesses;
+
+    dma_channel fDMA[2];
+};
+
+// Da assegnare a device->dma_ops dopo probe_i2c_devices
+extern const i2c_dma_ops gDWI2CModelDMAOps;
+
+#endif // DW_I2C_MODEL_H
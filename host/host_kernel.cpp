@@ -0,0 +1,722 @@
+#include "host_kernel.h"
+#include <drivers/module.h>
+#include <drivers/device_manager.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HOST_PCI_MAX     16
+#define HOST_AREA_MAX    64
+#define HOST_SEM_MAX     64
+#define HOST_HANDLER_MAX 32
+#define HOST_NODE_MAX    32
+#define HOST_IRQ_MAX     256
+// Chiamate consecutive agli handler senza che la linea si spenga
+#define HOST_STORM_LIMIT 100000
+
+typedef struct {
+    pci_info info;
+    HostMMIODevice* device;
+    phys_addr_t bar;
+    size_t bar_size;
+} host_pci_function;
+
+// Area: memoria vera (create_area) o finestra sui registri di un dispositivo
+// (map_physical_memory); gli indirizzi della finestra servono solo come chiave
+typedef struct {
+    bool used;
+    uint8* address;
+    size_t size;
+    phys_addr_t physical;
+    HostMMIODevice* device;     // NULL: memoria
+    phys_addr_t bar;
+} host_area;
+
+typedef struct {
+    bool used;
+    int32 count;
+} host_sem;
+
+typedef struct {
+    int32 irq;
+    interrupt_handler handler;
+    void* data;
+} host_handler;
+
+struct device_node {
+    char name[64];
+    device_node* parent;
+};
+
+static nanotime_t sNow = 0;
+static nanotime_t sMMIOReadCost = 0;
+static nanotime_t sMMIOWriteCost = 0;
+static bool sVerbose = false;
+static host_counters sCounters;
+
+static host_pci_function sPCIFunctions[HOST_PCI_MAX];
+static uint32 sPCICount = 0;
+
+static host_area sAreas[HOST_AREA_MAX];
+static host_area* sLastMapping = NULL;     // ultima finestra usata da host_mmio_*
+
+static host_sem sSems[HOST_SEM_MAX];
+
+static host_handler sHandlers[HOST_HANDLER_MAX];
+static uint32 sHandlerCount = 0;
+static bool sPending[HOST_IRQ_MAX];
+static bool sLevel[HOST_IRQ_MAX];
+static bool sAnyPending = false;
+static bool sInterruptsDisabled = false;
+static bool sInInterrupt = false;
+
+static device_node sNodes[HOST_NODE_MAX];
+static uint32 sNodeCount = 0;
+static uint32 sNodesUnregistered = 0;
+
+
+// #pragma mark - orologio virtuale e interrupt
+
+
+static void deliver_interrupts() {
+    if (sInterruptsDisabled || sInInterrupt) {
+        return;
+    }
+
+    // Gli handler girano con gli interrupt disabilitati, come nel kernel; una
+    // linea a livello ancora attiva dopo gli handler li richiama
+    uint32 calls = 0;
+    while (sAnyPending) {
+        sAnyPending = false;
+        for (uint32 irq = 0; irq < HOST_IRQ_MAX; irq++) {
+            if (!sPending[irq] && !sLevel[irq]) {
+                continue;
+            }
+            if (++calls > HOST_STORM_LIMIT) {
+                fprintf(stderr, "host: interrupt %" B_PRIu32 " sempre attivo\n", irq);
+                abort();
+            }
+            sPending[irq] = false;
+            sInInterrupt = true;
+            sInterruptsDisabled = true;
+            for (uint32 i = 0; i < sHandlerCount; i++) {
+                if (sHandlers[i].irq == (int32)irq) {
+                    sCounters.interrupts++;
+                    sHandlers[i].handler(sHandlers[i].data);
+                }
+            }
+            sInterruptsDisabled = false;
+            sInInterrupt = false;
+            if (sLevel[irq]) {
+                sAnyPending = true;
+            }
+        }
+    }
+}
+
+static nanotime_t next_device_event() {
+    nanotime_t next = -1;
+    for (uint32 i = 0; i < sPCICount; i++) {
+        nanotime_t event = sPCIFunctions[i].device->next_event();
+        if (event >= 0 && (next < 0 || event < next)) {
+            next = event;
+        }
+    }
+    return next;
+}
+
+static void advance_devices() {
+    uint64 start = host_cycles();
+    for (uint32 i = 0; i < sPCICount; i++) {
+        sPCIFunctions[i].device->advance(sNow);
+    }
+    sCounters.device_cycles += host_cycles() - start;
+}
+
+nanotime_t host_clock() {
+    return sNow;
+}
+
+void host_clock_advance_to(nanotime_t when) {
+    for (;;) {
+        nanotime_t next = next_device_event();
+        if (next < 0 || next > when) {
+            break;
+        }
+        // Un evento già passato non deve bloccare l'orologio
+        if (next <= sNow) {
+            next = sNow + 1;
+            if (next > when) {
+                break;
+            }
+        }
+        sNow = next;
+        advance_devices();
+        deliver_interrupts();
+    }
+    if (when > sNow) {
+        sNow = when;
+    }
+    advance_devices();
+    deliver_interrupts();
+}
+
+void host_set_mmio_cost(nanotime_t read_cost, nanotime_t write_cost) {
+    sMMIOReadCost = read_cost;
+    sMMIOWriteCost = write_cost;
+}
+
+void host_raise_interrupt(uint8 irq) {
+    sPending[irq] = true;
+    sAnyPending = true;
+}
+
+void host_set_interrupt_line(uint8 irq, bool asserted) {
+    sLevel[irq] = asserted;
+    if (asserted) {
+        sAnyPending = true;
+    }
+}
+
+cpu_status disable_interrupts() {
+    cpu_status previous = sInterruptsDisabled ? 0 : 1;
+    sInterruptsDisabled = true;
+    return previous;
+}
+
+void restore_interrupts(cpu_status status) {
+    sInterruptsDisabled = status == 0;
+    deliver_interrupts();
+}
+
+void acquire_spinlock(spinlock* lock) {
+    // Un solo thread: un lock già preso non verrebbe mai rilasciato
+    if (lock->lock != 0) {
+        fprintf(stderr, "host: spinlock %p già preso\n", lock);
+        abort();
+    }
+    lock->lock = 1;
+}
+
+void release_spinlock(spinlock* lock) {
+    lock->lock = 0;
+}
+
+status_t install_io_interrupt_handler(int32 interrupt, interrupt_handler handler, void* data,
+                                      uint32 flags) {
+    if (interrupt < 0 || interrupt >= HOST_IRQ_MAX || handler == NULL) {
+        return B_BAD_VALUE;
+    }
+    if (sHandlerCount == HOST_HANDLER_MAX) {
+        return B_NO_MEMORY;
+    }
+    sHandlers[sHandlerCount].irq = interrupt;
+    sHandlers[sHandlerCount].handler = handler;
+    sHandlers[sHandlerCount].data = data;
+    sHandlerCount++;
+    return B_OK;
+}
+
+status_t remove_io_interrupt_handler(int32 interrupt, interrupt_handler handler, void* data) {
+    for (uint32 i = 0; i < sHandlerCount; i++) {
+        if (sHandlers[i].irq == interrupt && sHandlers[i].handler == handler
+            && sHandlers[i].data == data) {
+            sHandlers[i] = sHandlers[--sHandlerCount];
+            return B_OK;
+        }
+    }
+    return B_BAD_VALUE;
+}
+
+
+// #pragma mark - tempo
+
+
+bigtime_t system_time() {
+    return sNow / 1000;
+}
+
+nanotime_t system_time_nsecs() {
+    return sNow;
+}
+
+status_t snooze(bigtime_t amount) {
+    sCounters.snoozes++;
+    sCounters.snoozed += amount * 1000;
+    host_clock_advance_to(sNow + amount * 1000);
+    return B_OK;
+}
+
+status_t snooze_until(bigtime_t time, int timeBase) {
+    if (time * 1000 > sNow) {
+        return snooze(time - sNow / 1000);
+    }
+    return B_OK;
+}
+
+void spin(bigtime_t microseconds) {
+    snooze(microseconds);
+}
+
+nanotime_t host_real_time() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (nanotime_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+uint64 host_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return host_real_time();
+#endif
+}
+
+
+// #pragma mark - semafori
+
+
+static host_sem* lookup_sem(sem_id sem) {
+    if (sem < 1 || sem > HOST_SEM_MAX || !sSems[sem - 1].used) {
+        return NULL;
+    }
+    return &sSems[sem - 1];
+}
+
+sem_id create_sem(int32 count, const char* name) {
+    for (int32 i = 0; i < HOST_SEM_MAX; i++) {
+        if (!sSems[i].used) {
+            sSems[i].used = true;
+            sSems[i].count = count;
+            return i + 1;
+        }
+    }
+    return B_NO_MORE_SEMS;
+}
+
+status_t delete_sem(sem_id sem) {
+    host_sem* entry = lookup_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+    entry->used = false;
+    return B_OK;
+}
+
+status_t acquire_sem(sem_id sem) {
+    return acquire_sem_etc(sem, 1, 0, 0);
+}
+
+// Con un solo thread il semaforo può essere rilasciato solo da un handler: si
+// fa avanzare l'orologio di evento in evento fino al rilascio o al timeout
+status_t acquire_sem_etc(sem_id sem, int32 count, uint32 flags, bigtime_t timeout) {
+    host_sem* entry = lookup_sem(sem);
+    if (entry == NULL || count < 1) {
+        return B_BAD_SEM_ID;
+    }
+
+    nanotime_t deadline = -1;
+    if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout != B_INFINITE_TIMEOUT) {
+        deadline = sNow + timeout * 1000;
+    } else if ((flags & B_ABSOLUTE_TIMEOUT) != 0 && timeout != B_INFINITE_TIMEOUT) {
+        deadline = timeout * 1000;
+    }
+
+    if (entry->count < count) {
+        sCounters.sem_waits++;
+    }
+    while (entry->count < count) {
+        if (deadline >= 0 && sNow >= deadline) {
+            return (flags & B_RELATIVE_TIMEOUT) != 0 && timeout == 0
+                ? B_WOULD_BLOCK : B_TIMED_OUT;
+        }
+        nanotime_t next = next_device_event();
+        if (next < 0) {
+            if (deadline < 0) {
+                fprintf(stderr, "host: attesa senza fine sul semaforo %" B_PRId32 "\n", sem);
+                return B_INTERRUPTED;
+            }
+            next = deadline;
+        } else if (deadline >= 0 && next > deadline) {
+            next = deadline;
+        }
+        host_clock_advance_to(next > sNow ? next : sNow + 1);
+    }
+
+    entry->count -= count;
+    return B_OK;
+}
+
+status_t release_sem(sem_id sem) {
+    return release_sem_etc(sem, 1, 0);
+}
+
+status_t release_sem_etc(sem_id sem, int32 count, uint32 flags) {
+    host_sem* entry = lookup_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+    entry->count += count;
+    return B_OK;
+}
+
+status_t get_sem_count(sem_id sem, int32* count) {
+    host_sem* entry = lookup_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+    *count = entry->count;
+    return B_OK;
+}
+
+
+// #pragma mark - thread
+
+
+thread_id spawn_kernel_thread(thread_func function, const char* name, int32 priority,
+                              void* data) {
+    return B_NO_MORE_THREADS;
+}
+
+status_t resume_thread(thread_id thread) {
+    return B_BAD_THREAD_ID;
+}
+
+status_t wait_for_thread(thread_id thread, status_t* returnValue) {
+    return B_BAD_THREAD_ID;
+}
+
+
+// #pragma mark - aree e memoria fisica
+
+
+static area_id add_area(uint8* address, size_t size, phys_addr_t physical,
+                        HostMMIODevice* device, phys_addr_t bar) {
+    for (int32 i = 0; i < HOST_AREA_MAX; i++) {
+        if (!sAreas[i].used) {
+            sAreas[i].used = true;
+            sAreas[i].address = address;
+            sAreas[i].size = size;
+            sAreas[i].physical = physical;
+            sAreas[i].device = device;
+            sAreas[i].bar = bar;
+            return i + 1;
+        }
+    }
+    return B_NO_MEMORY;
+}
+
+static size_t page_align(size_t size) {
+    return (size + B_PAGE_SIZE - 1) & ~(size_t)(B_PAGE_SIZE - 1);
+}
+
+// L'indirizzo fisico della memoria è quello virtuale: un modello di DMA può
+// accedere al bounce buffer direttamente
+area_id create_area(const char* name, void** address, uint32 addressSpec, size_t size,
+                    uint32 lock, uint32 protection) {
+    if (address == NULL || size == 0) {
+        return B_BAD_VALUE;
+    }
+    size = page_align(size);
+    uint8* memory = (uint8*)aligned_alloc(B_PAGE_SIZE, size);
+    if (memory == NULL) {
+        return B_NO_MEMORY;
+    }
+    memset(memory, 0, size);
+
+    area_id area = add_area(memory, size, (phys_addr_t)memory, NULL, 0);
+    if (area < B_OK) {
+        free(memory);
+        return area;
+    }
+    *address = memory;
+    return area;
+}
+
+status_t delete_area(area_id area) {
+    if (area < 1 || area > HOST_AREA_MAX || !sAreas[area - 1].used) {
+        return B_BAD_VALUE;
+    }
+    host_area& entry = sAreas[area - 1];
+    if (sLastMapping == &entry) {
+        sLastMapping = NULL;
+    }
+    free(entry.address);
+    entry.used = false;
+    return B_OK;
+}
+
+area_id map_physical_memory(const char* name, phys_addr_t physicalAddress, size_t size,
+                            uint32 flags, uint32 protection, void** _mappedAddress) {
+    if (_mappedAddress == NULL || size == 0) {
+        return B_BAD_VALUE;
+    }
+
+    for (uint32 i = 0; i < sPCICount; i++) {
+        host_pci_function& function = sPCIFunctions[i];
+        if (physicalAddress < function.bar
+            || physicalAddress + size > function.bar + function.bar_size) {
+            continue;
+        }
+
+        // Memoria mai letta: riserva solo un intervallo di indirizzi unico
+        size = page_align(size);
+        uint8* window = (uint8*)aligned_alloc(B_PAGE_SIZE, size);
+        if (window == NULL) {
+            return B_NO_MEMORY;
+        }
+        area_id area = add_area(window, size, physicalAddress, function.device, function.bar);
+        if (area < B_OK) {
+            free(window);
+            return area;
+        }
+        *_mappedAddress = window;
+        return area;
+    }
+    return B_BAD_ADDRESS;
+}
+
+status_t get_memory_map(const void* address, size_t numBytes, physical_entry* table,
+                        int32 numEntries) {
+    if (table == NULL || numEntries < 1) {
+        return B_BAD_VALUE;
+    }
+    table[0].address = (phys_addr_t)address;
+    table[0].size = numBytes;
+    if (numEntries > 1) {
+        table[1].address = 0;
+        table[1].size = 0;
+    }
+    return B_OK;
+}
+
+static host_area* lookup_mapping(volatile void* address) {
+    uint8* pointer = (uint8*)address;
+    if (sLastMapping != NULL && pointer >= sLastMapping->address
+        && pointer < sLastMapping->address + sLastMapping->size) {
+        return sLastMapping;
+    }
+    for (int32 i = 0; i < HOST_AREA_MAX; i++) {
+        host_area& entry = sAreas[i];
+        if (entry.used && entry.device != NULL && pointer >= entry.address
+            && pointer < entry.address + entry.size) {
+            sLastMapping = &entry;
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+uint32 host_mmio_read(volatile void* address) {
+    host_area* mapping = lookup_mapping(address);
+    if (mapping == NULL) {
+        fprintf(stderr, "host: lettura fuori dai registri mappati (%p)\n", address);
+        abort();
+    }
+    sCounters.mmio_reads++;
+    uint32 offset = (uint8*)address - mapping->address + (mapping->physical - mapping->bar);
+    uint64 start = host_cycles();
+    uint32 value = mapping->device->mmio_read(offset);
+    sCounters.device_cycles += host_cycles() - start;
+    if (sMMIOReadCost > 0) {
+        host_clock_advance_to(sNow + sMMIOReadCost);
+    } else {
+        deliver_interrupts();
+    }
+    return value;
+}
+
+void host_mmio_write(volatile void* address, uint32 value) {
+    host_area* mapping = lookup_mapping(address);
+    if (mapping == NULL) {
+        fprintf(stderr, "host: scrittura fuori dai registri mappati (%p)\n", address);
+        abort();
+    }
+    sCounters.mmio_writes++;
+    uint32 offset = (uint8*)address - mapping->address + (mapping->physical - mapping->bar);
+    uint64 start = host_cycles();
+    mapping->device->mmio_write(offset, value);
+    sCounters.device_cycles += host_cycles() - start;
+    if (sMMIOWriteCost > 0) {
+        host_clock_advance_to(sNow + sMMIOWriteCost);
+    } else {
+        deliver_interrupts();
+    }
+}
+
+
+// #pragma mark - bus PCI simulato
+
+
+status_t host_pci_add(uint16 vendor_id, uint16 device_id, uint8 irq, phys_addr_t bar,
+                      size_t bar_size, HostMMIODevice* device) {
+    if (device == NULL || bar_size == 0) {
+        return B_BAD_VALUE;
+    }
+    if (sPCICount == HOST_PCI_MAX) {
+        return B_NO_MEMORY;
+    }
+
+    host_pci_function& function = sPCIFunctions[sPCICount];
+    memset(&function.info, 0, sizeof(pci_info));
+    function.info.vendor_id = vendor_id;
+    function.info.device_id = device_id;
+    function.info.device = sPCICount;
+    function.info.class_base = 0x0C;    // bus seriale
+    function.info.class_sub = 0x80;
+    function.info.u.h0.base_registers[0] = bar;
+    function.info.u.h0.base_registers_pci[0] = bar;
+    function.info.u.h0.base_register_sizes[0] = bar_size;
+    function.info.u.h0.interrupt_line = irq;
+    function.info.u.h0.interrupt_pin = irq != 0 ? 1 : 0;
+    function.device = device;
+    function.bar = bar;
+    function.bar_size = bar_size;
+    sPCICount++;
+    return B_OK;
+}
+
+void host_pci_clear() {
+    sPCICount = 0;
+    memset(sPending, 0, sizeof(sPending));
+    memset(sLevel, 0, sizeof(sLevel));
+}
+
+static status_t pci_get_nth_pci_info(long index, pci_info* info) {
+    if (index < 0 || (uint32)index >= sPCICount || info == NULL) {
+        return B_ERROR;
+    }
+    *info = sPCIFunctions[index].info;
+    return B_OK;
+}
+
+static uint32 pci_read_pci_config(uint8 bus, uint8 device, uint8 function, uint16 offset,
+                                  uint8 size) {
+    return 0xFFFFFFFF;
+}
+
+static void pci_write_pci_config(uint8 bus, uint8 device, uint8 function, uint16 offset,
+                                 uint8 size, uint32 value) {
+}
+
+static pci_module_info sPCIModule = {
+    { B_PCI_MODULE_NAME, 0, NULL },
+    pci_get_nth_pci_info,
+    pci_read_pci_config,
+    pci_write_pci_config
+};
+
+
+// #pragma mark - device manager
+
+
+static status_t dm_rescan_node(device_node* node) {
+    return B_OK;
+}
+
+static status_t dm_register_node(device_node* parent, const char* moduleName,
+                                 const device_attr* attrs, const io_resource* ioResources,
+                                 device_node** _node) {
+    if (sNodeCount == HOST_NODE_MAX) {
+        return B_NO_MEMORY;
+    }
+
+    device_node* node = &sNodes[sNodeCount];
+    snprintf(node->name, sizeof(node->name), "%s", moduleName != NULL ? moduleName : "");
+    for (const device_attr* attr = attrs; attr != NULL && attr->name != NULL; attr++) {
+        if (strcmp(attr->name, B_DEVICE_PRETTY_NAME) == 0 && attr->type == B_STRING_TYPE) {
+            snprintf(node->name, sizeof(node->name), "%s", attr->value.string);
+        }
+    }
+    node->parent = parent;
+    sNodeCount++;
+    if (_node != NULL) {
+        *_node = node;
+    }
+    return B_OK;
+}
+
+static status_t dm_unregister_node(device_node* node) {
+    if (node == NULL) {
+        return B_BAD_VALUE;
+    }
+    sNodesUnregistered++;
+    return B_OK;
+}
+
+static device_manager_info sDeviceManager = {
+    { B_DEVICE_MANAGER_MODULE_NAME, 0, NULL },
+    dm_rescan_node,
+    dm_register_node,
+    dm_unregister_node
+};
+
+uint32 host_node_count() {
+    return sNodeCount;
+}
+
+const char* host_node_name(uint32 index) {
+    return index < sNodeCount ? sNodes[index].name : NULL;
+}
+
+uint32 host_unregistered_node_count() {
+    return sNodesUnregistered;
+}
+
+
+// #pragma mark - moduli e varie
+
+
+status_t get_module(const char* path, module_info** _info) {
+    if (path == NULL || _info == NULL) {
+        return B_BAD_VALUE;
+    }
+    if (strcmp(path, B_PCI_MODULE_NAME) == 0) {
+        *_info = &sPCIModule.binfo;
+        return B_OK;
+    }
+    if (strcmp(path, B_DEVICE_MANAGER_MODULE_NAME) == 0) {
+        *_info = &sDeviceManager.info;
+        return B_OK;
+    }
+    return B_ENTRY_NOT_FOUND;
+}
+
+status_t put_module(const char* path) {
+    return B_OK;
+}
+
+status_t user_memcpy(void* to, const void* from, size_t size) {
+    if ((to == NULL || from == NULL) && size > 0) {
+        return B_BAD_ADDRESS;
+    }
+    memcpy(to, from, size);
+    return B_OK;
+}
+
+void dprintf(const char* format, ...) {
+    if (!sVerbose) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+void host_set_verbose(bool verbose) {
+    sVerbose = verbose;
+}
+
+const host_counters& host_get_counters() {
+    return sCounters;
+}
+
+void host_reset_counters() {
+    memset(&sCounters, 0, sizeof(sCounters));
+}
@@ -0,0 +1,81 @@
+#ifndef HOST_KERNEL_H
+#define HOST_KERNEL_H
+
+#include <OS.h>
+#include <KernelExport.h>
+#include <PCI.h>
+
+// Harness host: esegue il codice di Driver/ su Linux sopra lo shim delle API
+// del kernel di Haiku (shim/). Tutto avviene in un solo thread e il tempo è un
+// orologio virtuale in nanosecondi: snooze(), spin() e le attese sui semafori
+// lo fanno avanzare fino al prossimo evento dei dispositivi simulati, quindi
+// ogni esecuzione è deterministica e non dorme mai davvero.
+//
+// I registri dei dispositivi PCI simulati non sono memoria: con I2C_HOST_MMIO
+// gli accessori di i2c_util.h chiamano host_mmio_read()/host_mmio_write(), che
+// li inoltrano al dispositivo a cui è mappato l'indirizzo.
+
+// Dispositivo simulato dietro il BAR 0 di una funzione PCI
+class HostMMIODevice {
+public:
+    virtual ~HostMMIODevice() {}
+
+    virtual uint32 mmio_read(uint32 offset) = 0;
+    virtual void mmio_write(uint32 offset, uint32 value) = 0;
+
+    // Porta lo stato del dispositivo all'istante 'now' dell'orologio virtuale
+    virtual void advance(nanotime_t now) {}
+    // Prossimo istante in cui il dispositivo cambia stato da solo, -1 se nessuno
+    virtual nanotime_t next_event() { return -1; }
+};
+
+// Contatori dell'harness, azzerati da host_reset_counters()
+typedef struct {
+    uint64 mmio_reads;
+    uint64 mmio_writes;
+    uint64 interrupts;          // chiamate agli handler
+    uint64 snoozes;             // snooze() e spin()
+    nanotime_t snoozed;         // tempo virtuale passato in snooze() e spin()
+    uint64 sem_waits;           // acquire_sem_etc() che hanno dovuto attendere
+    uint64 device_cycles;       // host_cycles() spesi nei dispositivi simulati
+} host_counters;
+
+// Orologio virtuale
+nanotime_t host_clock();
+// Fa avanzare l'orologio fino a 'when', fermandosi a ogni evento dei dispositivi
+void host_clock_advance_to(nanotime_t when);
+// Tempo virtuale consumato da ogni accesso ai registri (latenza del bus)
+void host_set_mmio_cost(nanotime_t read_cost, nanotime_t write_cost);
+
+// Bus PCI simulato: una funzione con il dispositivo dietro il BAR 0. Il
+// dispositivo resta del chiamante.
+status_t host_pci_add(uint16 vendor_id, uint16 device_id, uint8 irq, phys_addr_t bar,
+                      size_t bar_size, HostMMIODevice* device);
+void host_pci_clear();
+
+// Il dispositivo segnala l'interrupt: gli handler vengono chiamati subito se
+// gli interrupt sono abilitati, altrimenti alla riabilitazione
+void host_raise_interrupt(uint8 irq);
+// Linea a livello: gli handler vengono richiamati finché resta attiva
+void host_set_interrupt_line(uint8 irq, bool asserted);
+
+// Nodi registrati nel device manager
+uint32 host_node_count();
+const char* host_node_name(uint32 index);
+uint32 host_unregistered_node_count();
+
+// dprintf del driver su stderr (attivo) o scartato
+void host_set_verbose(bool verbose);
+
+const host_counters& host_get_counters();
+void host_reset_counters();
+
+// Orologio reale, per misurare il costo in CPU del codice del driver
+nanotime_t host_real_time();
+// Cicli della CPU (TSC su x86, altrimenti nanosecondi)
+uint64 host_cycles();
+
+uint32 host_mmio_read(volatile void* address);
+void host_mmio_write(volatile void* address, uint32 value);
+
+#endif // HOST_KERNEL_H
@@ -0,0 +1,867 @@
+// Harness host del driver: esegue il codice di Driver/ su Linux sopra lo shim
+// delle API del kernel (host_kernel.h) e misura i percorsi caldi.
+//
+// Il bus PCI simulato contiene due controller Tiger Lake, "i2c/0" e "i2c/1",
+// ciascuno con una memoria a registri (0x50); dietro il primo c'è anche il
+// touchpad (0x2C). I casi girano sul primo, la verifica dei dati su entrambi. Ogni riga di output
+// è un oggetto JSON con il costo reale in CPU del driver (ns/op e cicli per
+// byte, esclusi i dispositivi simulati), il tempo virtuale, i byte al secondo
+// sul bus e gli accessi ai registri e gli interrupt per operazione. Ogni caso
+// viene eseguito a polling (nessuna linea di interrupt), a interrupt e, sul
+// modello, con il DMA. Dopo l'inizializzazione del touchpad si misura la
+// ripresa dall'autosospensione; sul modello seguono i guasti del bus iniettati
+// e il livello di recupero usato dal driver.
+//
+// Uso: i2c_host [-n iterazioni] [-m] [-f velocità_hz] [-r salita_ns]
+//               [-k ic_clk_hz] [-s stretch_ns] [-l lettura_ns] [-L scrittura_ns] [-v]
+//   -m  modello DesignWare a cicli approssimati (dw_i2c_model.h) invece del
+//       controller ideale, che esegue ogni comando appena scritto
+//   -f  velocità del bus chiesta con i2c_controller_set_config (default 400 kHz)
+//   -r  tempo di salita di SCL, dato al driver e al modello (default 100 ns)
+//   -k  clock del controller nel modello (default 216 MHz come Tiger Lake)
+//   -s  clock stretching degli slave a ogni byte
+//   -l  latenza di una lettura dei registri nel modello (default 300 ns)
+//   -L  latenza di una scrittura, postata (default 30 ns)
+//   -v  dprintf del driver su stderr
+
+#include <OS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dw_i2c_model.h"
+#include "host_kernel.h"
+#include "i2c_controller.h"
+#include "i2c_device.h"
+#include "i2c_touchpad.h"
+#include "i2c_util.h"
+
+#define HOST_DEFAULT_ITERATIONS 20000
+#define HOST_MODEL_ITERATIONS   200
+#define HOST_MODEL_CLOCK        216000000
+#define HOST_MODEL_READ_COST    300
+#define HOST_MODEL_WRITE_COST   30
+#define HOST_SCL_RISE_TIME      100
+#define HOST_BAR_BASE  0xfe000000
+#define HOST_BAR_SIZE  0x1000
+#define HOST_IRQ       27
+#define HOST_MEMORY_ADDRESS   0x50
+#define HOST_TOUCHPAD_ADDRESS 0x2C
+#define HOST_ABSENT_ADDRESS   0x51
+#define HOST_MEMORY_ADDRESS_10BIT 0x250  // la stessa memoria, a 10 bit (solo modello)
+#define HOST_SLAVE_COUNT 2
+#define HOST_TOUCHPAD_COMMAND_REGISTER 0x22
+#define HOST_TOUCHPAD_INPUT_REGISTER   0x70
+#define HOST_TOUCHPAD_INPUT_LENGTH     16
+#define HOST_AUTOSUSPEND_DELAY 50000    // µs, tempo virtuale
+#define HOST_CONTROLLER_COUNT 2
+
+// Controller ideale: ogni comando viene eseguito appena scritto, i FIFO non si
+// riempiono mai e gli slave rispondono sempre. Misura solo il costo del driver,
+// senza tempi del bus.
+class IdealController : public HostMMIODevice {
+public:
+    IdealController(uint8 irq) : fIrq(irq) {
+        memset(fRegisters, 0, sizeof(fRegisters));
+        memset(fSlaves, 0, sizeof(fSlaves));
+        fRxHead = fRxCount = 0;
+        fRaw = 0;
+        fAbortSource = 0;
+        fInTransaction = false;
+        fFirstByte = false;
+        fSlave = NULL;
+        // FIFO da 64 voci, nessun DMA, fino all'high speed
+        fRegisters[I2C_COMP_PARAM_1 / 4] = IC_COMP_PARAM_1::TX_BUFFER_DEPTH::set(63).value
+            | IC_COMP_PARAM_1::RX_BUFFER_DEPTH::set(63).value
+            | IC_COMP_PARAM_1::MAX_SPEED_MODE::set(IC_CON::SPEED_HIGH).value;
+    }
+
+    // Slave a registri: il primo byte scritto dopo START è il registro, i
+    // successivi vengono scritti da lì in avanti; le letture proseguono dal
+    // registro corrente
+    uint8* add_slave(uint8 address) {
+        for (int i = 0; i < HOST_SLAVE_COUNT; i++) {
+            if (!fSlaves[i].present) {
+                fSlaves[i].present = true;
+                fSlaves[i].address = address;
+                return fSlaves[i].memory;
+            }
+        }
+        return NULL;
+    }
+
+    uint32 mmio_read(uint32 offset) override {
+        switch (offset) {
+            case I2C_DATA_CMD: {
+                if (fRxCount == 0) {
+                    return 0;
+                }
+                uint8 value = fRx[fRxHead];
+                fRxHead = (fRxHead + 1) % sizeof(fRx);
+                fRxCount--;
+                return value;
+            }
+            case I2C_STATUS:
+                return IC_STATUS::TFNF::mask | IC_STATUS::TFE::mask
+                    | (fRxCount > 0 ? IC_STATUS::RFNE::mask : 0);
+            case I2C_TXFLR:
+                return 0;
+            case I2C_RXFLR:
+                return fRxCount;
+            case I2C_RAW_INTR_STAT:
+                return raw_status();
+            case I2C_INTR_STAT:
+                return raw_status() & fRegisters[I2C_INTR_MASK / 4];
+            case I2C_CLR_INTR:
+                fRaw = 0;
+                fAbortSource = 0;
+                return 0;
+            case I2C_CLR_TX_ABRT:
+                fRaw &= ~IC_RAW_INTR_STAT::TX_ABRT::mask;
+                fAbortSource = 0;
+                return 0;
+            case I2C_CLR_STOP_DET:
+                fRaw &= ~IC_RAW_INTR_STAT::STOP_DET::mask;
+                return 0;
+            case I2C_TX_ABRT_SOURCE:
+                return fAbortSource;
+            case I2C_ENABLE_STATUS:
+                return fRegisters[I2C_ENABLE / 4] & IC_ENABLE::ENABLE::mask;
+            default:
+                return offset < HOST_BAR_SIZE ? fRegisters[offset / 4] : 0xFFFFFFFF;
+        }
+    }
+
+    void mmio_write(uint32 offset, uint32 value) override {
+        switch (offset) {
+            case I2C_DATA_CMD:
+                command(value);
+                break;
+            case I2C_ENABLE:
+                if (IC_ENABLE::ABORT::is_set(value)) {
+                    abort_transfer(1 << 16);    // ABRT_USER_ABRT
+                    value &= ~IC_ENABLE::ABORT::mask;
+                }
+                if (!IC_ENABLE::ENABLE::is_set(value)) {
+                    fRxCount = 0;
+                    fInTransaction = false;
+                }
+                fRegisters[offset / 4] = value;
+                break;
+            default:
+                if (offset < HOST_BAR_SIZE) {
+                    fRegisters[offset / 4] = value;
+                }
+                break;
+        }
+        if (fIrq != 0 && (raw_status() & fRegisters[I2C_INTR_MASK / 4]) != 0) {
+            host_raise_interrupt(fIrq);
+        }
+    }
+
+private:
+    typedef struct {
+        bool present;
+        uint8 address;
+        uint8 pointer;
+        uint8 memory[256];
+    } slave;
+
+    uint32 raw_status() const {
+        // TX FIFO sempre vuoto; RX_FULL sopra la soglia di I2C_RX_TL
+        uint32 raw = fRaw | IC_RAW_INTR_STAT::TX_EMPTY::mask;
+        if (fRxCount > fRegisters[I2C_RX_TL / 4]) {
+            raw |= IC_RAW_INTR_STAT::RX_FULL::mask;
+        }
+        return raw;
+    }
+
+    void abort_transfer(uint32 source) {
+        fAbortSource = source;
+        fRaw |= IC_RAW_INTR_STAT::TX_ABRT::mask | IC_RAW_INTR_STAT::STOP_DET::mask;
+        fInTransaction = false;
+    }
+
+    void command(uint32 value) {
+        // Dopo un abort il TX FIFO resta vuoto fino a I2C_CLR_TX_ABRT
+        if (!IC_ENABLE::ENABLE::is_set(fRegisters[I2C_ENABLE / 4]) || fAbortSource != 0) {
+            return;
+        }
+
+        if (!fInTransaction || IC_DATA_CMD::RESTART::is_set(value)) {
+            uint32 target = IC_TAR::ADDRESS::get(fRegisters[I2C_TAR / 4]);
+            fSlave = NULL;
+            for (int i = 0; i < HOST_SLAVE_COUNT; i++) {
+                if (fSlaves[i].present && fSlaves[i].address == target) {
+                    fSlave = &fSlaves[i];
+                }
+            }
+            if (fSlave == NULL) {
+                abort_transfer(IC_TX_ABRT_SOURCE::ABRT_7B_ADDR_NOACK::mask);
+                return;
+            }
+            fInTransaction = true;
+            fFirstByte = true;
+        }
+
+        if (IC_DATA_CMD::CMD::is_set(value)) {
+            if (fRxCount < sizeof(fRx)) {
+                fRx[(fRxHead + fRxCount) % sizeof(fRx)] = fSlave->memory[fSlave->pointer++];
+                fRxCount++;
+            }
+        } else if (fFirstByte) {
+            fSlave->pointer = IC_DATA_CMD::DAT::get(value);
+        } else {
+            fSlave->memory[fSlave->pointer++] = IC_DATA_CMD::DAT::get(value);
+        }
+        fFirstByte = false;
+
+        if (IC_DATA_CMD::STOP::is_set(value)) {
+            fInTransaction = false;
+            fRaw |= IC_RAW_INTR_STAT::STOP_DET::mask;
+        }
+    }
+
+    uint8 fIrq;
+    uint32 fRegisters[HOST_BAR_SIZE / 4];
+    slave fSlaves[HOST_SLAVE_COUNT];
+    slave* fSlave;              // slave della transazione in corso
+    bool fInTransaction;
+    bool fFirstByte;
+    uint8 fRx[256];
+    uint32 fRxHead;
+    uint32 fRxCount;
+    uint32 fRaw;                // STOP_DET e TX_ABRT in attesa di clear
+    uint32 fAbortSource;
+};
+
+// Strategie di trasferimento misurate
+enum host_mode {
+    HOST_MODE_POLLED,       // nessuna linea di interrupt
+    HOST_MODE_INTERRUPT,
+    HOST_MODE_DMA,          // interrupt e canali DMA del modello
+};
+
+static const char* const kModeNames[] = { "polled", "interrupt", "dma" };
+
+typedef struct {
+    uint32 iterations;
+    host_mode mode;
+    bool model;             // modello DesignWare invece del controller ideale
+    uint32 speed;           // velocità del bus (Hz)
+    uint16 rise;            // salita di SCL (ns)
+    uint32 clock;           // ic_clk del modello (Hz)
+    nanotime_t stretch;     // clock stretching dello slave a ogni byte (ns)
+    nanotime_t read_cost;   // latenza di una lettura dei registri (ns)
+    nanotime_t write_cost;
+} host_options;
+
+typedef status_t (*host_operation)(i2c_device_info* device, uint8* buffer, size_t length);
+
+static status_t op_read_register(i2c_device_info* device, uint8* buffer, size_t length) {
+    return i2c_read_register(device, HOST_MEMORY_ADDRESS, 0x00, buffer, length);
+}
+
+static status_t op_write_register(i2c_device_info* device, uint8* buffer, size_t length) {
+    return i2c_write_register(device, HOST_MEMORY_ADDRESS, 0x00, buffer, length);
+}
+
+// Due coppie scrittura/lettura in una sola transazione
+static status_t op_device_transfer(i2c_device_info* device, uint8* buffer, size_t length) {
+    uint8 registers[2] = { 0x00, 0x80 };
+    i2c_transfer_info transfers[2] = {
+        { &registers[0], 1, buffer, length },
+        { &registers[1], 1, buffer + length, length }
+    };
+    return i2c_device_transfer(device, transfers, 2);
+}
+
+// Lettura da un indirizzo senza slave: costo del NACK
+static status_t op_read_absent(i2c_device_info* device, uint8* buffer, size_t length) {
+    return i2c_read_register(device, HOST_ABSENT_ADDRESS, 0x00, buffer, length);
+}
+
+static const struct {
+    const char* name;
+    host_operation operation;
+    uint32 payload;         // byte di dati per byte di 'size'
+    status_t expected;
+} kOperations[] = {
+    { "read_register", op_read_register, 1, B_OK },
+    { "write_register", op_write_register, 1, B_OK },
+    { "device_transfer", op_device_transfer, 2, B_OK },
+    { "read_absent", op_read_absent, 0, B_DEVICE_NOT_FOUND },
+};
+
+static const size_t kSizes[] = { 1, 4, 16, 64, 255 };
+
+// Scrittura e rilettura attraverso il driver: i dati devono tornare uguali.
+// Sul modello la rilettura si ripete con l'indirizzo a 10 bit.
+static status_t verify_transfers(i2c_device_info* device, bool ten_bit) {
+    uint8 written[128];
+    uint8 read[128];
+    for (size_t i = 0; i < sizeof(written); i++) {
+        written[i] = (uint8)(0xA5 ^ i);
+    }
+    status_t status = i2c_write_register(device, HOST_MEMORY_ADDRESS, 0x10, written,
+                                         sizeof(written));
+    if (status == B_OK) {
+        status = i2c_read_register(device, HOST_MEMORY_ADDRESS, 0x10, read, sizeof(read));
+    }
+    if (status == B_OK && memcmp(written, read, sizeof(read)) != 0) {
+        status = B_BAD_DATA;
+    }
+    if (status != B_OK || !ten_bit) {
+        return status;
+    }
+
+    uint8 reg = 0x10;
+    memset(read, 0, sizeof(read));
+    i2c_message msgs[2] = {
+        { HOST_MEMORY_ADDRESS_10BIT, I2C_MESSAGE_TEN_BIT, 1, &reg },
+        { HOST_MEMORY_ADDRESS_10BIT, I2C_MESSAGE_TEN_BIT | I2C_MESSAGE_READ, 16, read }
+    };
+    status = i2c_transfer(device, msgs, 2);
+    if (status == B_OK && memcmp(written, read, 16) != 0) {
+        status = B_BAD_DATA;
+    }
+    return status;
+}
+
+static status_t run_case(const host_options& options, i2c_device_info* device,
+                         uint32 scl, int op, size_t size) {
+    uint8 buffer[512];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8)i;
+    }
+
+    host_reset_counters();
+    nanotime_t virtualStart = host_clock();
+    nanotime_t realStart = host_real_time();
+    uint64 cyclesStart = host_cycles();
+    for (uint32 i = 0; i < options.iterations; i++) {
+        status_t status = kOperations[op].operation(device, buffer, size);
+        if (status != kOperations[op].expected) {
+            return status != B_OK ? status : B_ERROR;
+        }
+    }
+    uint64 cycles = host_cycles() - cyclesStart;
+    nanotime_t realTime = host_real_time() - realStart;
+    nanotime_t virtualTime = host_clock() - virtualStart;
+
+    // Cicli del driver e dello shim: quelli dei dispositivi simulati sono esclusi
+    const host_counters& counters = host_get_counters();
+    double n = options.iterations;
+    double bytes = (double)kOperations[op].payload * size * n;
+    double driverCycles = (double)(cycles - counters.device_cycles);
+    printf("{\"op\":\"%s\",\"size\":%zu,\"mode\":\"%s\",\"bus\":\"%s\",\"scl_hz\":%" B_PRIu32
+           ",\"real_ns_per_op\":%.1f,\"virtual_us_per_op\":%.3f,\"bytes_per_s\":%.0f,"
+           "\"cpu_cycles_per_op\":%.0f,\"cpu_cycles_per_byte\":%.1f,"
+           "\"mmio_reads_per_op\":%.2f,\"mmio_writes_per_op\":%.2f,\"irq_per_op\":%.2f,"
+           "\"sem_waits_per_op\":%.2f,\"snoozes_per_op\":%.2f}\n",
+           kOperations[op].name, size, kModeNames[options.mode],
+           options.model ? "dw" : "ideal", scl, realTime / n, virtualTime / n / 1000.0,
+           virtualTime > 0 ? bytes * 1e9 / virtualTime : 0.0, driverCycles / n,
+           bytes > 0 ? driverCycles / bytes : 0.0, counters.mmio_reads / n,
+           counters.mmio_writes / n, counters.interrupts / n, counters.sem_waits / n,
+           counters.snoozes / n);
+    return B_OK;
+}
+
+// Inizializzazione del touchpad: reset, descrittore HID, accensione, descrittore
+// del report e registrazione del nodo; una volta sola, comprende i 100 ms di
+// attesa del reset
+static status_t run_touchpad(const host_options& options, i2c_device_info* device) {
+    status_t status = i2c_device_init(device, HOST_TOUCHPAD_ADDRESS);
+    if (status != B_OK) {
+        return status;
+    }
+
+    uint32 nodes = host_node_count();
+    host_reset_counters();
+    nanotime_t virtualStart = host_clock();
+    nanotime_t realStart = host_real_time();
+    status = init_touchpad(device);
+    nanotime_t realTime = host_real_time() - realStart;
+    nanotime_t virtualTime = host_clock() - virtualStart;
+    if (status != B_OK) {
+        return status;
+    }
+    if (host_node_count() != nodes + 1) {
+        return B_ERROR;
+    }
+
+    const host_counters& counters = host_get_counters();
+    printf("{\"op\":\"init_touchpad\",\"mode\":\"%s\",\"bus\":\"%s\",\"node\":\"%s\","
+           "\"real_ns\":%" B_PRId64 ",\"virtual_us\":%.3f,\"snoozed_us\":%.3f,"
+           "\"mmio_reads\":%" B_PRIu64 ",\"mmio_writes\":%" B_PRIu64 ",\"irq\":%" B_PRIu64 "}\n",
+           kModeNames[options.mode], options.model ? "dw" : "ideal", host_node_name(nodes),
+           realTime, virtualTime / 1000.0, counters.snoozed / 1000.0, counters.mmio_reads,
+           counters.mmio_writes, counters.interrupts);
+    return B_OK;
+}
+
+// Descrittore HID del touchpad simulato al registro 0x01, descrittore del report
+// al registro 0x23, report di input al registro 0x70
+static void setup_touchpad(uint8* memory) {
+    hid_descriptor desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.wHIDDescLength = sizeof(hid_descriptor);
+    desc.bcdVersion = 0x0100;
+    desc.wReportDescLength = 64;
+    desc.wReportDescRegister = 0x23;
+    desc.wInputRegister = HOST_TOUCHPAD_INPUT_REGISTER;
+    desc.wMaxInputLength = HOST_TOUCHPAD_INPUT_LENGTH;
+    desc.wCommandRegister = HOST_TOUCHPAD_COMMAND_REGISTER;
+    desc.wDataRegister = 0x23;
+    memcpy(memory + 0x01, &desc, sizeof(desc));
+    for (int i = 0; i < 64; i++) {
+        memory[0x23 + i] = (uint8)(0x05 + i);
+    }
+}
+
+// Autosospensione e ripresa del touchpad. Il thread di autosospensione non
+// gira nello shim: touchpad_autosuspend si chiama da qui. Il touchpad deve
+// andare in SLEEP solo dopo il ritardo, con il controller nel reset; la prima
+// lettura deve riattivare entrambi e consegnare il report in attesa entro
+// TOUCHPAD_RESUME_LATENCY_MAX, senza che il driver tocchi il controller nel
+// reset e con la stessa temporizzazione di SCL.
+static status_t run_power(const host_options& options, i2c_device_info* device,
+                          uint8* touchpad, DWI2CModel* model) {
+    bigtime_t delay = HOST_AUTOSUSPEND_DELAY;
+    status_t status = touchpad_control(device, TOUCHPAD_IOCTL_SET_AUTOSUSPEND, &delay,
+                                       sizeof(delay));
+    if (status != B_OK) {
+        return status;
+    }
+    uint32 resetAccesses = model != NULL ? model->reset_accesses() : 0;
+    uint32 scl = model != NULL ? model->scl_frequency() : 0;
+
+    // Prima del ritardo il touchpad resta acceso
+    bigtime_t remaining = touchpad_autosuspend(device);
+    if (remaining <= 0 || remaining > delay || device->suspended) {
+        return B_ERROR;
+    }
+    snooze(remaining);
+    if (touchpad_autosuspend(device) != B_INFINITE_TIMEOUT || !device->suspended
+        || !device->touchpad_sleeping
+        || touchpad[HOST_TOUCHPAD_COMMAND_REGISTER] != HID_POWER_SLEEP) {
+        return B_ERROR;
+    }
+
+    // Report in attesa: lunghezza su due byte, compresa, poi i dati
+    static const uint8 kReport[] = { 6, 0, 0x11, 0x22, 0x33, 0x44 };
+    memcpy(touchpad + HOST_TOUCHPAD_INPUT_REGISTER, kReport, sizeof(kReport));
+
+    host_reset_counters();
+    nanotime_t start = host_clock();
+    uint8 report[HOST_TOUCHPAD_INPUT_LENGTH];
+    size_t length = sizeof(report);
+    status = touchpad_read(device, 0, report, &length);
+    nanotime_t virtualTime = host_clock() - start;
+    if (status != B_OK) {
+        return status;
+    }
+    if (length != sizeof(kReport) - 2 || memcmp(report, kReport + 2, length) != 0
+        || device->suspended || device->touchpad_sleeping
+        || touchpad[HOST_TOUCHPAD_COMMAND_REGISTER] != HID_POWER_ON) {
+        return B_BAD_DATA;
+    }
+    if (model != NULL && (model->reset_accesses() != resetAccesses
+            || model->scl_frequency() != scl)) {
+        return B_ERROR;
+    }
+    // Il limite vale dai 100 kHz in su
+    bool bounded = device->resume_latency <= TOUCHPAD_RESUME_LATENCY_MAX;
+    if (!bounded && options.speed >= I2C_SPEED_STANDARD) {
+        fprintf(stderr, "Ripresa del touchpad in %" B_PRId64 " µs\n", device->resume_latency);
+        return B_TIMED_OUT;
+    }
+
+    const host_counters& counters = host_get_counters();
+    printf("{\"op\":\"resume_touchpad\",\"mode\":\"%s\",\"bus\":\"%s\","
+           "\"autosuspend_us\":%" B_PRId64 ",\"resume_latency_us\":%" B_PRId64
+           ",\"bound_us\":%d,\"virtual_us\":%.3f,\"mmio_reads\":%" B_PRIu64
+           ",\"mmio_writes\":%" B_PRIu64 ",\"irq\":%" B_PRIu64 ",\"suspends\":%" B_PRIu32
+           ",\"resumes\":%" B_PRIu32 "}\n",
+           kModeNames[options.mode], options.model ? "dw" : "ideal", delay,
+           device->resume_latency, TOUCHPAD_RESUME_LATENCY_MAX, virtualTime / 1000.0,
+           counters.mmio_reads, counters.mmio_writes, counters.interrupts, device->suspends,
+           device->resumes);
+
+    // Dopo la ripresa il bus deve funzionare come prima
+    return verify_transfers(device, model != NULL);
+}
+
+// Ritardo di autosospensione impostato sul controller. Solo il touchpad lo
+// applica: su un controller senza touchpad il ritardo resta senza effetto.
+static status_t run_autosuspend(const host_options& options, i2c_device_info* device,
+                                i2c_device_info* other) {
+    bigtime_t previous = device->autosuspend_delay;
+    bigtime_t delay = HOST_AUTOSUSPEND_DELAY;
+    if (i2c_controller_set_autosuspend(device, -1) != B_BAD_VALUE
+        || i2c_controller_set_autosuspend(NULL, delay) != B_BAD_VALUE
+        || device->autosuspend_delay != previous) {
+        return B_ERROR;
+    }
+
+    // Con ritardo 0 il touchpad non si sospende mai
+    status_t status = i2c_controller_set_autosuspend(device, 0);
+    if (status != B_OK) {
+        return status;
+    }
+    snooze(2 * delay);
+    if (touchpad_autosuspend(device) != B_INFINITE_TIMEOUT || device->suspended
+        || device->touchpad_sleeping) {
+        return B_ERROR;
+    }
+
+    // Un trasferimento a metà del ritardo lo fa ripartire
+    status = i2c_controller_set_autosuspend(device, delay);
+    if (status != B_OK) {
+        return status;
+    }
+    snooze(delay / 2);
+    status = verify_transfers(device, false);
+    if (status != B_OK) {
+        return status;
+    }
+    bigtime_t refreshed = touchpad_autosuspend(device);
+    if (refreshed <= delay / 2 || refreshed > delay || device->suspended) {
+        return B_ERROR;
+    }
+    snooze(refreshed - 1);
+    if (touchpad_autosuspend(device) != 1 || device->suspended || device->touchpad_sleeping) {
+        return B_ERROR;
+    }
+
+    // Senza touchpad nessuno confronta l'inattività con il ritardo
+    status = i2c_controller_set_autosuspend(other, delay);
+    if (status != B_OK) {
+        return status;
+    }
+    snooze(2 * delay);
+    if (touchpad_autosuspend(other) != B_INFINITE_TIMEOUT || other->suspended) {
+        return B_ERROR;
+    }
+    i2c_controller_set_autosuspend(other, 0);
+
+    printf("{\"op\":\"autosuspend\",\"mode\":\"%s\",\"bus\":\"%s\","
+           "\"delay_us\":%" B_PRId64 ",\"refreshed_us\":%" B_PRId64
+           ",\"without_touchpad\":\"%s\"}\n",
+           kModeNames[options.mode], options.model ? "dw" : "ideal", delay, refreshed,
+           other->suspended ? "suspended" : "active");
+
+    return i2c_controller_set_autosuspend(device, previous);
+}
+
+// Configurazione del bus e verifica di un controller
+static status_t setup_controller(const host_options& options, i2c_device_info* device,
+                                 bool model) {
+    if (device == NULL) {
+        return B_NAME_NOT_FOUND;
+    }
+
+    // Il driver deve conoscere il clock del modello per calcolare i conteggi
+    if (model) {
+        device->clock_rate = options.clock;
+    }
+    i2c_controller_config config;
+    config.speed = options.speed;
+    config.addressing_mode = I2C_ADDRESSING_7BIT;
+    config.duty_cycle = 0;
+    config.scl_rise_time = options.rise;
+    config.scl_fall_time = 0;
+    status_t status = i2c_controller_set_config(device, &config);
+    if (status != B_OK) {
+        fprintf(stderr, "Velocità del bus non accettata\n");
+        return status;
+    }
+
+    // I canali iDMA64 non sono simulati: il modello li sostituisce
+    if (options.mode == HOST_MODE_DMA) {
+        if (device->dma_ops == NULL) {
+            fprintf(stderr, "DMA non inizializzato\n");
+            return B_NOT_SUPPORTED;
+        }
+        device->dma_ops = &gDWI2CModelDMAOps;
+    }
+
+    status = verify_transfers(device, model);
+    if (status != B_OK) {
+        fprintf(stderr, "Verifica dei trasferimenti fallita\n");
+    }
+    return status;
+}
+
+// Guasti iniettati nel modello: il trasferimento colpito deve finire con
+// 'expected' e il successivo deve riuscire. Il livello di recupero usato si
+// legge dai contatori del driver. SDA bloccato lo rileva il controller
+// (IC_SDA_STUCK_AT_LOW_TIMEOUT), quindi prima del timeout del trasferimento.
+static const struct {
+    const char* name;
+    DWI2CModel::fault fault;
+    status_t expected;
+    bool before_timeout;
+} kFaults[] = {
+    { "arbitration_lost", DWI2CModel::FAULT_ARBITRATION, B_OK, true },
+    { "sda_stuck", DWI2CModel::FAULT_SDA_STUCK, B_BUSY, true },
+    { "scl_stuck", DWI2CModel::FAULT_SCL_STUCK, B_TIMED_OUT, false },
+};
+
+static status_t run_recovery(const host_options& options, i2c_device_info* device,
+                             DWI2CModel* model) {
+    uint8 buffer[16];
+    for (size_t i = 0; i < sizeof(kFaults) / sizeof(kFaults[0]); i++) {
+        uint32 retries = device->retries;
+        uint32 flushes = device->flushes;
+        uint32 busClears = device->bus_clears;
+        uint32 reinits = device->reinits;
+
+        model->inject_fault(kFaults[i].fault);
+        nanotime_t start = host_clock();
+        status_t status = i2c_read_register(device, HOST_MEMORY_ADDRESS, 0x00, buffer,
+                                            sizeof(buffer));
+        nanotime_t failure = host_clock() - start;
+        if (status != kFaults[i].expected) {
+            return status != B_OK ? status : B_ERROR;
+        }
+        if (kFaults[i].before_timeout && failure >= I2C_TRANSFER_TIMEOUT * 1000) {
+            fprintf(stderr, "recover_%s: guasto rilevato solo al timeout\n", kFaults[i].name);
+            return B_TIMED_OUT;
+        }
+        status_t faultStatus = status;
+
+        // Dopo il recupero il bus deve funzionare subito
+        start = host_clock();
+        status = verify_transfers(device, false);
+        nanotime_t next = host_clock() - start;
+        if (status != B_OK) {
+            return status;
+        }
+
+        printf("{\"op\":\"recover_%s\",\"mode\":\"%s\",\"bus\":\"dw\",\"status\":%" B_PRId32
+               ",\"virtual_us\":%.3f,\"next_transfer_us\":%.3f,\"retries\":%" B_PRIu32
+               ",\"flushes\":%" B_PRIu32 ",\"bus_clears\":%" B_PRIu32 ",\"reinits\":%" B_PRIu32
+               "}\n", kFaults[i].name, kModeNames[options.mode], faultStatus, failure / 1000.0,
+               next / 1000.0, device->retries - retries, device->flushes - flushes,
+               device->bus_clears - busClears, device->reinits - reinits);
+    }
+    return B_OK;
+}
+
+// Casi di una strategia su controller già registrati nel bus PCI simulato
+static status_t run_cases(const host_options& options, uint8* touchpad, DWI2CModel* model) {
+    status_t status = probe_i2c_devices();
+    if (status != B_OK) {
+        fprintf(stderr, "Nessun controller inizializzato: %" B_PRId32 "\n", status);
+        return status;
+    }
+    // Entrambi i controller, raggiunti per nome, devono funzionare
+    for (uint32 index = 0; index < HOST_CONTROLLER_COUNT; index++) {
+        char name[16];
+        snprintf(name, sizeof(name), I2C_CONTROLLER_NAME_PREFIX "%" B_PRIu32, index);
+        status = setup_controller(options, find_i2c_device(name), model != NULL);
+        if (status != B_OK) {
+            fprintf(stderr, "Controller %s: %" B_PRId32 "\n", name, status);
+            free_i2c_devices();
+            return status;
+        }
+    }
+    if (find_i2c_device(I2C_CONTROLLER_NAME_PREFIX "2") != NULL
+        || find_i2c_device("i2c/00") != NULL || find_i2c_device(NULL) != NULL) {
+        fprintf(stderr, "find_i2c_device accetta nomi non validi\n");
+        free_i2c_devices();
+        return B_ERROR;
+    }
+
+    // i2c_device_transfer usa l'indirizzo dello slave del dispositivo
+    i2c_device_info* device = find_i2c_device(I2C_CONTROLLER_NAME_PREFIX "0");
+    i2c_device_init(device, HOST_MEMORY_ADDRESS);
+
+    uint32 scl = model != NULL ? model->scl_frequency() : 0;
+    for (size_t op = 0; op < sizeof(kOperations) / sizeof(kOperations[0]); op++) {
+        for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+            status = run_case(options, device, scl, op, kSizes[i]);
+            if (status != B_OK) {
+                fprintf(stderr, "Errore in %s (%zu byte): %" B_PRId32 "\n",
+                        kOperations[op].name, kSizes[i], status);
+                free_i2c_devices();
+                return status;
+            }
+        }
+    }
+
+    status = run_touchpad(options, device);
+    if (status != B_OK) {
+        fprintf(stderr, "Errore nell'inizializzazione del touchpad: %" B_PRId32 "\n", status);
+    }
+
+    if (status == B_OK) {
+        status = run_power(options, device, touchpad, model);
+        if (status != B_OK) {
+            fprintf(stderr, "Ripresa del touchpad fallita: %" B_PRId32 "\n", status);
+        }
+    }
+
+    if (status == B_OK) {
+        status = run_autosuspend(options, device,
+                                 find_i2c_device(I2C_CONTROLLER_NAME_PREFIX "1"));
+        if (status != B_OK) {
+            fprintf(stderr, "Autosospensione del controller errata: %" B_PRId32 "\n", status);
+        }
+    }
+
+    if (status == B_OK && model != NULL) {
+        status = run_recovery(options, device, model);
+        if (status != B_OK) {
+            fprintf(stderr, "Recupero dopo un guasto fallito: %" B_PRId32 "\n", status);
+        }
+    }
+
+    // Come uninit_driver: prima i touchpad, anche sui controller che non ne
+    // hanno, poi i controller
+    for (uint32 index = 0; index < HOST_CONTROLLER_COUNT; index++) {
+        char name[16];
+        snprintf(name, sizeof(name), I2C_CONTROLLER_NAME_PREFIX "%" B_PRIu32, index);
+        i2c_device_info* controller = find_i2c_device(name);
+        bool published = controller->touchpad_node != NULL;
+        uint32 unregistered = host_unregistered_node_count();
+        uninit_touchpad(controller);
+        if (controller->pm_lock >= B_OK || controller->pm_sem >= B_OK) {
+            fprintf(stderr, "Semafori del touchpad di %s non rilasciati\n", name);
+            status = B_ERROR;
+        }
+        if (controller->touchpad_node != NULL
+            || host_unregistered_node_count() != unregistered + (published ? 1 : 0)) {
+            fprintf(stderr, "Nodo del touchpad di %s non rimosso\n", name);
+            status = B_ERROR;
+        }
+    }
+    free_i2c_devices();
+    return status;
+}
+
+static status_t run_ideal(const host_options& options) {
+    // Senza linea di interrupt il driver resta a polling
+    uint8 irq = options.mode != HOST_MODE_POLLED ? HOST_IRQ : 0;
+    IdealController controller0(irq);
+    IdealController controller1(irq + (irq != 0 ? 1 : 0));
+    if (controller0.add_slave(HOST_MEMORY_ADDRESS) == NULL
+        || controller1.add_slave(HOST_MEMORY_ADDRESS) == NULL) {
+        return B_NO_MEMORY;
+    }
+    uint8* touchpad = controller0.add_slave(HOST_TOUCHPAD_ADDRESS);
+    if (touchpad == NULL) {
+        return B_NO_MEMORY;
+    }
+    setup_touchpad(touchpad);
+
+    host_pci_clear();
+    host_pci_add(INTEL_VENDOR_ID, TIGER_LAKE_I2C_CONTROLLER_0, irq, HOST_BAR_BASE,
+                 HOST_BAR_SIZE, &controller0);
+    host_pci_add(INTEL_VENDOR_ID, TIGER_LAKE_I2C_CONTROLLER_1, irq + (irq != 0 ? 1 : 0),
+                 HOST_BAR_BASE + HOST_BAR_SIZE, HOST_BAR_SIZE, &controller1);
+
+    status_t status = run_cases(options, touchpad, NULL);
+    host_pci_clear();
+    return status;
+}
+
+static status_t run_model(const host_options& options) {
+    uint8 irq = options.mode != HOST_MODE_POLLED ? HOST_IRQ : 0;
+    bool dma = options.mode == HOST_MODE_DMA;
+    DWI2CModel controller0(irq, HOST_BAR_BASE, options.clock, I2C_TIGER_LAKE_FIFO_DEPTH, dma);
+    DWI2CModel controller1(irq + (irq != 0 ? 1 : 0), HOST_BAR_BASE + HOST_BAR_SIZE,
+                           options.clock, I2C_TIGER_LAKE_FIFO_DEPTH, dma);
+    HostRegisterSlave memory(options.stretch);
+    HostRegisterSlave memory1(options.stretch);
+    HostRegisterSlave touchpad(options.stretch);
+    setup_touchpad(touchpad.memory());
+    controller0.attach(HOST_MEMORY_ADDRESS, &memory);
+    controller0.attach(HOST_MEMORY_ADDRESS_10BIT, &memory, true);
+    controller1.attach(HOST_MEMORY_ADDRESS, &memory1);
+    controller1.attach(HOST_MEMORY_ADDRESS_10BIT, &memory1, true);
+    controller0.attach(HOST_TOUCHPAD_ADDRESS, &touchpad);
+    controller0.set_scl_rise_time(options.rise);
+    controller1.set_scl_rise_time(options.rise);
+
+    host_pci_clear();
+    host_pci_add(INTEL_VENDOR_ID, TIGER_LAKE_I2C_CONTROLLER_0, irq, HOST_BAR_BASE,
+                 HOST_BAR_SIZE, &controller0);
+    host_pci_add(INTEL_VENDOR_ID, TIGER_LAKE_I2C_CONTROLLER_1, irq + (irq != 0 ? 1 : 0),
+                 HOST_BAR_BASE + HOST_BAR_SIZE, HOST_BAR_SIZE, &controller1);
+    host_set_mmio_cost(options.read_cost, options.write_cost);
+
+    status_t status = run_cases(options, touchpad.memory(), &controller0);
+    host_set_mmio_cost(0, 0);
+    host_pci_clear();
+    return status;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Uso: %s [-n iterazioni] [-m] [-f velocità_hz] [-r salita_ns] "
+            "[-k ic_clk_hz] [-s stretch_ns] [-l lettura_ns] [-L scrittura_ns] [-v]\n", name);
+}
+
+int main(int argc, char** argv) {
+    host_options options;
+    options.iterations = 0;
+    options.mode = HOST_MODE_POLLED;
+    options.model = false;
+    options.speed = I2C_SPEED_DEFAULT;
+    options.rise = HOST_SCL_RISE_TIME;
+    options.clock = HOST_MODEL_CLOCK;
+    options.stretch = 0;
+    options.read_cost = HOST_MODEL_READ_COST;
+    options.write_cost = HOST_MODEL_WRITE_COST;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            options.iterations = strtoul(argv[++i], NULL, 0);
+            if (options.iterations == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            options.model = true;
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            options.speed = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            options.rise = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            options.clock = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            options.stretch = strtoll(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            options.read_cost = strtoll(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+            options.write_cost = strtoll(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            host_set_verbose(true);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.clock == 0 || options.stretch < 0 || options.read_cost < 0
+        || options.write_cost < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    // Sul modello i trasferimenti durano quanto sul bus vero: meno iterazioni
+    if (options.iterations == 0) {
+        options.iterations = options.model ? HOST_MODEL_ITERATIONS : HOST_DEFAULT_ITERATIONS;
+    }
+
+    // Il DMA c'è solo sul modello
+    int modes = options.model ? HOST_MODE_DMA : HOST_MODE_INTERRUPT;
+    for (int mode = HOST_MODE_POLLED; mode <= modes; mode++) {
+        options.mode = (host_mode)mode;
+        status_t status = options.model ? run_model(options) : run_ideal(options);
+        if (status != B_OK) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef _DRIVERS_DRIVERS_H
+#define _DRIVERS_DRIVERS_H
+
+// Shim per l'harness host: hook dei dispositivi e codici ioctl
+
+#include <OS.h>
+
+typedef status_t (*device_open_hook)(const char* name, uint32 flags, void** cookie);
+typedef status_t (*device_close_hook)(void* cookie);
+typedef status_t (*device_free_hook)(void* cookie);
+typedef status_t (*device_control_hook)(void* cookie, uint32 op, void* data, size_t len);
+typedef status_t (*device_read_hook)(void* cookie, off_t position, void* data,
+                                     size_t* numBytes);
+typedef status_t (*device_write_hook)(void* cookie, off_t position, const void* data,
+                                      size_t* numBytes);
+typedef status_t (*device_select_hook)(void* cookie, uint8 event, uint32 ref, void* sync);
+typedef status_t (*device_deselect_hook)(void* cookie, uint8 event, void* sync);
+
+typedef struct {
+    device_open_hook open;
+    device_close_hook close;
+    device_free_hook free;
+    device_control_hook control;
+    device_read_hook read;
+    device_write_hook write;
+    device_select_hook select;
+    device_deselect_hook deselect;
+} device_hooks;
+
+#define B_CUR_DRIVER_API_VERSION 2
+#define B_DEVICE_OP_CODES_END 9999
+
+#endif // _DRIVERS_DRIVERS_H
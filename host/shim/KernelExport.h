@@ -0,0 +1,58 @@
+#ifndef _KERNEL_EXPORT_H
+#define _KERNEL_EXPORT_H
+
+// Shim per l'harness host: interrupt, spinlock e memoria fisica simulati da
+// host_kernel.cpp. Un solo thread: disable_interrupts() rimanda gli interrupt
+// sollevati dai dispositivi a restore_interrupts().
+
+#include <OS.h>
+
+typedef int32 (*interrupt_handler)(void* data);
+
+#define B_UNHANDLED_INTERRUPT 0
+#define B_HANDLED_INTERRUPT   1
+#define B_INVOKE_SCHEDULER    2
+
+typedef int32 cpu_status;
+
+typedef struct {
+    int32 lock;
+} spinlock;
+
+#define B_SPINLOCK_INITIALIZER { 0 }
+#define B_INITIALIZE_SPINLOCK(spinlock) ((spinlock)->lock = 0)
+
+// Tipo di memoria di map_physical_memory
+#define B_MTR_UC 0x10000000
+
+typedef struct {
+    phys_addr_t address;
+    phys_size_t size;
+} physical_entry;
+
+// Senza extern "C": convive con dprintf(int, const char*, ...) di <stdio.h>
+void dprintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+void spin(bigtime_t microseconds);
+
+// Sempre B_NO_MORE_THREADS: il driver deve funzionare anche senza i suoi thread
+thread_id spawn_kernel_thread(thread_func function, const char* name, int32 priority,
+                              void* data);
+// Nessuno spazio utente: una copia semplice
+status_t user_memcpy(void* to, const void* from, size_t size);
+
+cpu_status disable_interrupts();
+void restore_interrupts(cpu_status status);
+void acquire_spinlock(spinlock* lock);
+void release_spinlock(spinlock* lock);
+
+status_t install_io_interrupt_handler(int32 interrupt, interrupt_handler handler, void* data,
+                                      uint32 flags);
+status_t remove_io_interrupt_handler(int32 interrupt, interrupt_handler handler, void* data);
+
+area_id map_physical_memory(const char* name, phys_addr_t physicalAddress, size_t size,
+                            uint32 flags, uint32 protection, void** _mappedAddress);
+status_t get_memory_map(const void* address, size_t numBytes, physical_entry* table,
+                        int32 numEntries);
+
+#endif // _KERNEL_EXPORT_H
@@ -0,0 +1,60 @@
+#ifndef _OS_H
+#define _OS_H
+
+// Shim per l'harness host. Il tempo è quello dell'orologio virtuale
+// (host_kernel.h): snooze() lo fa avanzare invece di dormire. C'è un solo
+// thread: i thread del driver non vengono creati.
+
+#include <SupportDefs.h>
+
+#define B_PAGE_SIZE 4096
+#define B_INFINITE_TIMEOUT INT64_MAX
+
+typedef int32 area_id;
+typedef int32 sem_id;
+typedef int32 thread_id;
+
+// Specifiche di indirizzo, blocco e protezione delle aree
+#define B_ANY_ADDRESS        1
+#define B_ANY_KERNEL_ADDRESS 4
+#define B_NO_LOCK            0
+#define B_FULL_LOCK          2
+#define B_CONTIGUOUS         3
+#define B_READ_AREA          1
+#define B_WRITE_AREA         2
+#define B_KERNEL_READ_AREA   16
+#define B_KERNEL_WRITE_AREA  32
+
+// Flag dei semafori
+#define B_CAN_INTERRUPT      1
+#define B_DO_NOT_RESCHEDULE  2
+#define B_RELATIVE_TIMEOUT   8
+#define B_ABSOLUTE_TIMEOUT   16
+
+// Priorità dei thread
+#define B_LOW_PRIORITY       5
+#define B_NORMAL_PRIORITY    10
+
+typedef status_t (*thread_func)(void* data);
+
+area_id create_area(const char* name, void** address, uint32 addressSpec, size_t size,
+                    uint32 lock, uint32 protection);
+status_t delete_area(area_id area);
+
+sem_id create_sem(int32 count, const char* name);
+status_t delete_sem(sem_id sem);
+status_t acquire_sem(sem_id sem);
+status_t acquire_sem_etc(sem_id sem, int32 count, uint32 flags, bigtime_t timeout);
+status_t release_sem(sem_id sem);
+status_t release_sem_etc(sem_id sem, int32 count, uint32 flags);
+status_t get_sem_count(sem_id sem, int32* count);
+
+status_t resume_thread(thread_id thread);
+status_t wait_for_thread(thread_id thread, status_t* returnValue);
+
+bigtime_t system_time();
+nanotime_t system_time_nsecs();
+status_t snooze(bigtime_t amount);
+status_t snooze_until(bigtime_t time, int timeBase);
+
+#endif // _OS_H
@@ -0,0 +1,56 @@
+#ifndef _PCI_H
+#define _PCI_H
+
+// Shim per l'harness host: i dispositivi elencati sono quelli registrati con
+// host_pci_add()
+
+#include <OS.h>
+#include <drivers/module.h>
+
+typedef struct pci_info {
+    uint16 vendor_id;
+    uint16 device_id;
+    uint8 bus;
+    uint8 device;
+    uint8 function;
+    uint8 revision;
+    uint8 class_api;
+    uint8 class_sub;
+    uint8 class_base;
+    uint8 line_size;
+    uint8 latency;
+    uint8 header_type;
+    uint8 bist;
+    uint8 reserved;
+    union {
+        struct {
+            uint32 cardbus_cis;
+            uint16 subsystem_id;
+            uint16 subsystem_vendor_id;
+            uint32 rom_base;
+            uint32 rom_base_pci;
+            uint32 rom_size;
+            uint32 base_registers[6];
+            uint32 base_registers_pci[6];
+            uint32 base_register_sizes[6];
+            uint8 base_register_flags[6];
+            uint8 interrupt_line;
+            uint8 interrupt_pin;
+            uint8 min_grant;
+            uint8 max_latency;
+        } h0;
+    } u;
+} pci_info;
+
+typedef struct pci_module_info {
+    module_info binfo;
+    status_t (*get_nth_pci_info)(long index, pci_info* info);
+    uint32 (*read_pci_config)(uint8 bus, uint8 device, uint8 function, uint16 offset,
+                              uint8 size);
+    void (*write_pci_config)(uint8 bus, uint8 device, uint8 function, uint16 offset,
+                             uint8 size, uint32 value);
+} pci_module_info;
+
+#define B_PCI_MODULE_NAME "bus_managers/pci/v1"
+
+#endif // _PCI_H
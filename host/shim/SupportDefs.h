@@ -0,0 +1,45 @@
+#ifndef _SUPPORT_DEFS_H
+#define _SUPPORT_DEFS_H
+
+// Shim per l'harness host: solo i tipi e le macro usati da Driver/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <Errors.h>
+
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+typedef int32 status_t;
+typedef int64 bigtime_t;
+typedef int64 nanotime_t;
+typedef uint32 type_code;
+
+typedef unsigned long addr_t;
+typedef unsigned long phys_addr_t;
+typedef unsigned long phys_size_t;
+
+#define B_PRId32 PRId32
+#define B_PRIu32 PRIu32
+#define B_PRIx32 PRIx32
+#define B_PRId64 PRId64
+#define B_PRIu64 PRIu64
+#define B_PRIx64 PRIx64
+
+// Restituisce il valore precedente, come nel kernel
+static inline int32 atomic_add(int32* value, int32 addValue) {
+    return __atomic_fetch_add(value, addValue, __ATOMIC_SEQ_CST);
+}
+
+#define min_c(a, b) ((a) > (b) ? (b) : (a))
+#define max_c(a, b) ((a) > (b) ? (a) : (b))
+
+#endif // _SUPPORT_DEFS_H
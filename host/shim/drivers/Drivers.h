@@ -0,0 +1 @@
+#include "../Drivers.h"
@@ -0,0 +1 @@
+#include "../KernelExport.h"
@@ -0,0 +1 @@
+#include "../PCI.h"
@@ -0,0 +1,55 @@
+#ifndef _DEVICE_MANAGER_H
+#define _DEVICE_MANAGER_H
+
+// Shim per l'harness host: register_node() registra il nodo in memoria, senza
+// caricare driver figli; i nodi registrati si contano con host_node_count()
+
+#include <OS.h>
+#include <drivers/module.h>
+
+typedef struct device_node device_node;
+
+#define B_STRING_TYPE 'CSTR'
+#define B_UINT8_TYPE  'UBYT'
+#define B_UINT16_TYPE 'USHT'
+#define B_UINT32_TYPE 'ULNG'
+#define B_UINT64_TYPE 'ULLG'
+#define B_RAW_TYPE    'RAWT'
+
+typedef struct {
+    const char* name;
+    type_code type;
+    union {
+        uint8 ui8;
+        uint16 ui16;
+        uint32 ui32;
+        uint64 ui64;
+        const char* string;
+        struct {
+            const void* data;
+            size_t length;
+        } raw;
+    } value;
+} device_attr;
+
+typedef struct {
+    uint32 type;
+    uint64 base;
+    uint64 length;
+} io_resource;
+
+#define B_DEVICE_PRETTY_NAME "device/pretty name"
+#define B_DEVICE_UNIQUE_ID   "device/unique id"
+
+typedef struct device_manager_info {
+    module_info info;
+    status_t (*rescan_node)(device_node* node);
+    status_t (*register_node)(device_node* parent, const char* moduleName,
+                              const device_attr* attrs, const io_resource* ioResources,
+                              device_node** _node);
+    status_t (*unregister_node)(device_node* node);
+} device_manager_info;
+
+#define B_DEVICE_MANAGER_MODULE_NAME "system/device_manager/v1"
+
+#endif // _DEVICE_MANAGER_H
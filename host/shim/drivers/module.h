@@ -0,0 +1,21 @@
+#ifndef _MODULE_H
+#define _MODULE_H
+
+// Shim per l'harness host: i moduli disponibili sono quelli di host_kernel.cpp
+// (bus PCI simulato e device manager)
+
+#include <OS.h>
+
+typedef struct module_info {
+    const char* name;
+    uint32 flags;
+    status_t (*std_ops)(int32 op, ...);
+} module_info;
+
+#define B_MODULE_INIT   1
+#define B_MODULE_UNINIT 2
+
+status_t get_module(const char* path, module_info** _info);
+status_t put_module(const char* path);
+
+#endif // _MODULE_H
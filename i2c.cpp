@@ -1,19 +1,32 @@
 #include "i2c.h"
+#include "i2c_capture.h"
+#include "i2c_transaction.h"
+#include "i2c_transport.h"
 #include <stdio.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <errno.h>
 #include <string.h>
-#include <sys/ioctl.h>
+#include <new>
 
 I2CBus::I2CBus(int bus_number)
-    : f_bus_number(bus_number), f_initialized(false), f_speed(100000), f_fd(-1) {
+    : f_bus_number(bus_number), f_initialized(false), f_speed(100000),
+      f_transport(new(std::nothrow) I2CDevTransport(bus_number)), f_owns_transport(true),
+      f_combined(false), f_functionality(0), f_slave_address(-1), f_syscalls(0), f_stats_enabled(false),
+      f_capture(NULL) {
+}
+
+I2CBus::I2CBus(I2CTransport* transport)
+    : f_bus_number(-1), f_initialized(false), f_speed(100000),
+      f_transport(transport), f_owns_transport(false),
+      f_combined(false), f_functionality(0), f_slave_address(-1), f_syscalls(0), f_stats_enabled(false),
+      f_capture(NULL) {
 }
 
 I2CBus::~I2CBus() {
     if (f_initialized) {
         deinit();
     }
+    if (f_owns_transport) {
+        delete f_transport;
+    }
 }
 
 status_t I2CBus::init() {
@@ -39,34 +52,96 @@ status_t I2CBus::deinit() {
 }
 
 status_t I2CBus::open_bus() {
-    char path[20];
-    snprintf(path, sizeof(path), "/dev/i2c-%d", f_bus_number);
-    f_fd = open(path, O_RDWR);
-    if (f_fd < 0) {
-        fprintf(stderr, "Errore nell'aprire %s: %s\n", path, strerror(errno));
-        return B_IO_ERROR;
+    if (f_transport == NULL) {
+        return B_NO_MEMORY;
+    }
+
+    f_syscalls++;
+    status_t status = f_transport->open();
+    if (status != B_OK) {
+        return status;
+    }
+
+    f_slave_address = -1;
+    f_syscalls++;
+    f_functionality = f_transport->functionality();
+    f_combined = (f_functionality & I2C_FUNC_I2C) != 0;
+
+    uint32 speed = f_transport->speed();
+    if (speed > 0) {
+        f_speed = speed;
+    }
+    if (f_capture != NULL) {
+        f_capture->set_adapter(f_functionality, f_speed);
     }
     return B_OK;
 }
 
 void I2CBus::close_bus() {
-    if (f_fd >= 0) {
-        close(f_fd);
-        f_fd = -1;
-    }
+    f_transport->close();
+    f_slave_address = -1;
+    f_combined = false;
+    f_functionality = 0;
 }
 
 status_t I2CBus::set_slave_address(uint8 address) {
-    // Passiamo l'indirizzo di 'address' invece di 'address' direttamente
-    if (ioctl(f_fd, I2C_SLAVE, (void*)(uintptr_t)address) < 0) {
-        fprintf(stderr, "Errore nel settare l'indirizzo slave: %s\n", strerror(errno));
-        return B_IO_ERROR;
+    // L'indirizzo resta impostato sul trasporto: evitiamo la chiamata se non cambia
+    if (f_slave_address == address) {
+        return B_OK;
     }
-    return B_OK;
+
+    nanotime_t start = f_stats_enabled ? system_time_nsecs() : 0;
+    f_syscalls++;
+    status_t status = f_transport->set_address(address);
+    f_slave_address = status == B_OK ? address : -1;
+    if (f_stats_enabled) {
+        f_stats.record_call(system_time_nsecs() - start);
+    }
+    return status;
 }
 
-status_t I2CBus::write(uint8 address, const uint8* data, size_t length) {
-    if (!f_initialized || f_fd < 0) {
+status_t I2CBus::combined_transfer(uint8 address, const uint8* write_data, size_t write_length,
+                                   uint8* read_buffer, size_t read_length) {
+    if (write_length > 0xFFFF || read_length > 0xFFFF) {
+        return B_BAD_VALUE;
+    }
+
+    // Puntatore e dati in un'unica transazione: START, scrittura, RESTART, lettura, STOP
+    struct i2c_msg msgs[2];
+    msgs[0].addr = address;
+    msgs[0].flags = 0;
+    msgs[0].len = static_cast<uint16>(write_length);
+    msgs[0].buf = const_cast<uint8*>(write_data);
+    msgs[1].addr = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = static_cast<uint16>(read_length);
+    msgs[1].buf = read_buffer;
+
+    return transfer_messages(msgs, 2);
+}
+
+status_t I2CBus::transfer_messages(struct i2c_msg* msgs, uint32 count) {
+    nanotime_t start = timing() ? system_time_nsecs() : 0;
+    f_syscalls++;
+    status_t status = f_transport->transfer(msgs, count);
+    if (f_capture != NULL) {
+        // Anche B_NOT_SUPPORTED: il replay deve portare I2CBus sullo stesso percorso
+        f_capture->record(I2C_CAPTURE_TRANSFER, msgs, count, status, start,
+                          system_time_nsecs());
+    }
+    if (status == B_NOT_SUPPORTED) {
+        // L'adattatore non gestisce messaggi combinati: si passa al percorso classico
+        f_combined = false;
+        return status;
+    }
+    if (f_stats_enabled) {
+        f_stats.record_transfer(msgs, count, status, system_time_nsecs() - start);
+    }
+    return status;
+}
+
+status_t I2CBus::smbus_transfer(uint8 address, struct i2c_smbus_ioctl_data& data) {
+    if (!f_initialized) {
         return B_NO_INIT;
     }
 
@@ -75,17 +150,158 @@ status_t I2CBus::write(uint8 address, const uint8* data, size_t length) {
         return status;
     }
 
-    ssize_t bytes_written = ::write(f_fd, data, length);
-    if (bytes_written != static_cast<ssize_t>(length)) {
-        fprintf(stderr, "Errore nella scrittura dei dati: %s\n", strerror(errno));
-        return B_IO_ERROR;
+    // Solo la quick passa di qui: per statistiche e cattura è un messaggio vuoto.
+    // B_NOT_SUPPORTED riguarda I2C_SMBUS, non I2C_RDWR: f_combined non cambia
+    nanotime_t start = timing() ? system_time_nsecs() : 0;
+    f_syscalls++;
+    status = f_transport->smbus(&data);
+
+    struct i2c_msg msg;
+    msg.addr = address;
+    msg.flags = data.read_write == I2C_SMBUS_READ ? I2C_M_RD : 0;
+    msg.len = 0;
+    msg.buf = NULL;
+    if (f_capture != NULL) {
+        f_capture->record(I2C_CAPTURE_QUICK, &msg, 1, status, start, system_time_nsecs());
+    }
+    if (f_stats_enabled) {
+        f_stats.record_transfer(&msg, 1, status, system_time_nsecs() - start);
+    }
+    return status;
+}
+
+void I2CBus::record(uint8 address, uint16 flags, uint8* buffer, size_t length,
+                    status_t status, nanotime_t start) {
+    nanotime_t end = system_time_nsecs();
+    struct i2c_msg msg;
+    msg.addr = address;
+    msg.flags = flags;
+    msg.len = static_cast<uint16>(length > 0xFFFF ? 0xFFFF : length);
+    msg.buf = buffer;
+    if (f_stats_enabled) {
+        f_stats.record_transfer(&msg, 1, status, end - start);
+    }
+    if (f_capture != NULL) {
+        f_capture->record((flags & I2C_M_RD) != 0 ? I2C_CAPTURE_READ : I2C_CAPTURE_WRITE,
+                          &msg, 1, status, start, end);
+    }
+}
+
+void I2CBus::set_capture(I2CCapture* capture) {
+    f_capture = capture;
+    if (f_capture != NULL && f_initialized) {
+        f_capture->set_adapter(f_functionality, f_speed);
+    }
+}
+
+status_t I2CBus::execute_message(const struct i2c_msg& msg) {
+    if (msg.flags & I2C_M_RD) {
+        return read(static_cast<uint8>(msg.addr), msg.buf, msg.len);
+    }
+    return write(static_cast<uint8>(msg.addr), msg.buf, msg.len);
+}
+
+status_t I2CBus::submit(I2CTransaction& transaction) {
+    return submit(transaction, 0, transaction.f_count);
+}
+
+status_t I2CBus::submit(I2CTransaction& transaction, uint32 first, uint32 end) {
+    if (!f_initialized) {
+        return B_NO_INIT;
+    }
+    if (first > end || end > transaction.f_count) {
+        return B_BAD_INDEX;
+    }
+    if ((first < transaction.f_count && transaction.f_group[first] != first)
+        || (end < transaction.f_count && transaction.f_group[end] != end)) {
+        // Un gruppo non si divide: perderebbe il repeated start
+        return B_BAD_VALUE;
+    }
+
+    uint32 count = end;
+    uint32 start = first;
+
+    while (f_combined && start < count) {
+        // Impacchetta gruppi interi finché stanno in una sola ioctl. Tra due
+        // gruppi della stessa ioctl il bus vede un RESTART e non uno STOP:
+        // l'ioctl si chiude dopo ogni gruppo con una scrittura vera, così ciò
+        // che lo STOP conferma (es. la pagina di una EEPROM) non va perso.
+        uint32 chunk_end = transaction.group_end(start);
+        uint32 last = start;
+        uint32 groups = 1;
+        while (chunk_end < count && transaction.group_is_idempotent(last)) {
+            uint32 next = transaction.group_end(chunk_end);
+            if (next - start > I2C_RDWR_IOCTL_MAX_MSGS) {
+                break;
+            }
+            last = chunk_end;
+            chunk_end = next;
+            groups++;
+        }
+
+        status_t status = transfer_messages(&transaction.f_msgs[start], chunk_end - start);
+        if (status == B_NOT_SUPPORTED) {
+            break;
+        }
+
+        if (status == B_OK || groups == 1) {
+            for (uint32 i = start; i < chunk_end; i++) {
+                transaction.f_status[i] = status;
+            }
+        } else {
+            // Il kernel non indica quale messaggio è fallito: si ripetono uno alla
+            // volta i gruppi di sola lettura. L'unico gruppo con scrittura può
+            // essere l'ultimo e non viene ripetuto: se le letture riescono è lui
+            // ad aver fallito e prende l'esito dell'ioctl, altrimenti il suo
+            // esito resta indeterminato (B_IO_ERROR).
+            bool reads_ok = true;
+            for (uint32 group = start; group < chunk_end; ) {
+                uint32 group_end = transaction.group_end(group);
+                status_t group_status;
+                if (transaction.group_is_idempotent(group)) {
+                    group_status = transfer_messages(&transaction.f_msgs[group],
+                                                     group_end - group);
+                    if (group_status == B_NOT_SUPPORTED) {
+                        group_status = B_IO_ERROR;
+                    }
+                    reads_ok = reads_ok && group_status == B_OK;
+                } else {
+                    group_status = reads_ok ? status : B_IO_ERROR;
+                }
+                for (uint32 i = group; i < group_end; i++) {
+                    transaction.f_status[i] = group_status;
+                }
+                group = group_end;
+            }
+        }
+        start = chunk_end;
+    }
+
+    // Percorso classico: un messaggio alla volta, con STOP tra i messaggi
+    while (start < count) {
+        uint32 group_end = transaction.group_end(start);
+        status_t status = B_OK;
+        for (uint32 i = start; i < group_end; i++) {
+            // Se un messaggio del gruppo fallisce i successivi non vengono inviati
+            transaction.f_status[i] = status == B_OK
+                ? execute_message(transaction.f_msgs[i]) : B_CANCELED;
+            if (status == B_OK) {
+                status = transaction.f_status[i];
+            }
+        }
+        start = group_end;
     }
 
+    for (uint32 i = first; i < count; i++) {
+        if (transaction.f_status[i] != B_OK) {
+            return transaction.f_status[i];
+        }
+    }
     return B_OK;
 }
 
-status_t I2CBus::read(uint8 address, uint8* buffer, size_t length) {
-    if (!f_initialized || f_fd < 0) {
+status_t I2CBus::write(uint8 address, const uint8* data, size_t length) {
+    if (!f_initialized) {
         return B_NO_INIT;
     }
 
@@ -94,13 +310,32 @@ status_t I2CBus::read(uint8 address, uint8* buffer, size_t length) {
         return status;
     }
 
-    ssize_t bytes_read = ::read(f_fd, buffer, length);
-    if (bytes_read != static_cast<ssize_t>(length)) {
-        fprintf(stderr, "Errore nella lettura dei dati: %s\n", strerror(errno));
-        return B_IO_ERROR;
+    nanotime_t start = timing() ? system_time_nsecs() : 0;
+    f_syscalls++;
+    status = f_transport->write(data, length);
+    if (timing()) {
+        record(address, 0, const_cast<uint8*>(data), length, status, start);
+    }
+    return status;
+}
+
+status_t I2CBus::read(uint8 address, uint8* buffer, size_t length) {
+    if (!f_initialized) {
+        return B_NO_INIT;
     }
 
-    return B_OK;
+    status_t status = set_slave_address(address);
+    if (status != B_OK) {
+        return status;
+    }
+
+    nanotime_t start = timing() ? system_time_nsecs() : 0;
+    f_syscalls++;
+    status = f_transport->read(buffer, length);
+    if (timing()) {
+        record(address, I2C_M_RD, buffer, length, status, start);
+    }
+    return status;
 }
 
 status_t I2CBus::set_speed(uint32 speed) {
@@ -108,12 +343,27 @@ status_t I2CBus::set_speed(uint32 speed) {
         return B_NO_INIT;
     }
 
-    f_speed = speed;
-    
-    // Nota: l'implementazione effettiva potrebbe richiedere un ioctl specifico di Haiku
-    // per impostare la velocità del bus
+    status_t status = f_transport->set_speed(speed);
+    if (status == B_NOT_SUPPORTED) {
+        // Il backend i2c-dev non ha un ioctl per la velocità: se il clock reale è
+        // noto resta quello, altrimenti il valore viene solo memorizzato
+        if (f_transport->speed() > 0) {
+            return B_NOT_SUPPORTED;
+        }
+        status = B_OK;
+    }
+    if (status == B_OK) {
+        f_speed = speed;
+    }
+    return status;
+}
 
-    return B_OK;
+nanotime_t I2CBus::wire_time(const struct i2c_msg* msgs, uint32 count) const {
+    uint64 bits = 1;  // STOP
+    for (uint32 i = 0; i < count; i++) {
+        bits += 1 + 9 + 9 * uint64(msgs[i].len);
+    }
+    return static_cast<nanotime_t>(bits * 1000000000ULL / (f_speed > 0 ? f_speed : 100000));
 }
 
 status_t I2CBus::write_register(uint8 address, uint8 reg, uint8 data) {
@@ -122,11 +372,7 @@ status_t I2CBus::write_register(uint8 address, uint8 reg, uint8 data) {
 }
 
 status_t I2CBus::read_register(uint8 address, uint8 reg, uint8* data) {
-    status_t status = write(address, &reg, 1);
-    if (status != B_OK) {
-        return status;
-    }
-    return read(address, data, 1);
+    return read_registers(address, reg, data, 1);
 }
 
 status_t I2CBus::write_registers(uint8 address, uint8 reg, const uint8* data, size_t length) {
@@ -140,6 +386,18 @@ status_t I2CBus::write_registers(uint8 address, uint8 reg, const uint8* data, si
 }
 
 status_t I2CBus::read_registers(uint8 address, uint8 reg, uint8* data, size_t length) {
+    if (!f_initialized) {
+        return B_NO_INIT;
+    }
+
+    if (f_combined) {
+        status_t status = combined_transfer(address, &reg, 1, data, length);
+        if (status != B_NOT_SUPPORTED) {
+            return status;
+        }
+    }
+
+    // Fallback: scrittura del puntatore e lettura separate (con STOP in mezzo)
     status_t status = write(address, &reg, 1);
     if (status != B_OK) {
         return status;
@@ -147,4 +405,4 @@ status_t I2CBus::read_registers(uint8 address, uint8 reg, uint8* data, size_t le
     return read(address, data, length);
 }
 
-// La funzione transfer è stata rimossa
+// La funzione transfer è stata rimossa
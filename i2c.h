@@ -3,13 +3,65 @@
 
 #include <OS.h>
 #include <stdint.h>
+#include "i2c_stats.h"
 
 // Definizioni delle costanti I2C
 #define I2C_SLAVE 0x0703
+#define I2C_FUNCS 0x0705
+#define I2C_RDWR  0x0707
+#define I2C_SMBUS 0x0720
+
+#define I2C_FUNC_I2C 0x00000001
+#define I2C_FUNC_SMBUS_PEC             0x00000008
+#define I2C_FUNC_SMBUS_BLOCK_PROC_CALL 0x00000020
+#define I2C_FUNC_SMBUS_QUICK           0x00010000
+#define I2C_FUNC_SMBUS_READ_BLOCK_DATA 0x01000000
+
+#define I2C_M_RD       0x0001
+#define I2C_M_RECV_LEN 0x0400  // la lunghezza arriva nel primo byte letto (SMBus block)
+#define I2C_RDWR_IOCTL_MAX_MSGS 42
+
+// Campi di i2c_smbus_ioctl_data
+#define I2C_SMBUS_WRITE 0
+#define I2C_SMBUS_READ  1
+#define I2C_SMBUS_QUICK 0
+
+// Messaggio per I2C_RDWR (stesso layout dell'ABI i2c-dev)
+struct i2c_msg {
+    uint16 addr;
+    uint16 flags;
+    uint16 len;
+    uint8* buf;
+};
+
+struct i2c_rdwr_ioctl_data {
+    struct i2c_msg* msgs;
+    uint32 nmsgs;
+};
+
+// Comando per I2C_SMBUS (stesso layout dell'ABI i2c-dev). Serve solo la quick,
+// che non ha dati: i2c_smbus_data resta incompleta
+union i2c_smbus_data;
+
+struct i2c_smbus_ioctl_data {
+    uint8 read_write;
+    uint8 command;
+    uint32 size;
+    union i2c_smbus_data* data;
+};
+
+class I2CCapture;
+class I2CSMBus;
+class I2CTransaction;
+class I2CTransport;
 
 class I2CBus {
 public:
+    // Bus reale /dev/i2c-N
     I2CBus(int bus_number);
+    // Bus su un trasporto qualsiasi (per esempio I2CSimTransport); il trasporto
+    // resta del chiamante e deve sopravvivere al bus
+    I2CBus(I2CTransport* transport);
     ~I2CBus();
 
     status_t init();
@@ -18,7 +70,15 @@ public:
     status_t write(uint8 address, const uint8* data, size_t length);
     status_t read(uint8 address, uint8* buffer, size_t length);
 
+    // Se l'adattatore non permette di cambiare il clock e ne conosce il valore
+    // effettivo restituisce B_NOT_SUPPORTED; se non lo conosce il valore viene
+    // solo memorizzato e usato per le stime di wire_time()
     status_t set_speed(uint32 speed);
+    uint32 speed() const { return f_speed; }
+
+    // Tempo stimato sul filo dei messaggi alla velocità corrente: START o
+    // RESTART e indirizzo per ogni messaggio, 9 bit per byte, uno STOP finale
+    nanotime_t wire_time(const struct i2c_msg* msgs, uint32 count) const;
 
     status_t write_register(uint8 address, uint8 reg, uint8 data);
     status_t read_register(uint8 address, uint8 reg, uint8* data);
@@ -26,15 +86,55 @@ public:
     status_t write_registers(uint8 address, uint8 reg, const uint8* data, size_t length);
     status_t read_registers(uint8 address, uint8 reg, uint8* data, size_t length);
 
+    // Esegue tutti i messaggi accodati; lo stato del singolo messaggio è in
+    // transaction.status(). Restituisce il primo errore incontrato.
+    status_t submit(I2CTransaction& transaction);
+    // Solo i messaggi [first, end); i limiti devono cadere tra un gruppo e l'altro
+    status_t submit(I2CTransaction& transaction, uint32 first, uint32 end);
+
+    // true se l'adattatore accetta I2C_RDWR (scrittura + lettura con repeated start)
+    bool supports_combined() const { return f_combined; }
+    // Bit I2C_FUNC_* dichiarati dall'adattatore all'apertura
+    uint32 functionality() const { return f_functionality; }
+    // Numero di chiamate al trasporto (con i2c-dev una syscall ciascuna)
+    uint64 syscall_count() const { return f_syscalls; }
+
+    // Statistiche di esercizio (disattivate per default)
+    void enable_stats(bool enable) { f_stats_enabled = enable; }
+    void get_stats(i2c_bus_stats* stats) const { f_stats.snapshot(stats); }
+    void reset_stats() { f_stats.reset(); }
+
+    // Registra ogni chiamata al trasporto (NULL per smettere). La cattura resta
+    // del chiamante e deve sopravvivere al bus o essere staccata prima.
+    void set_capture(I2CCapture* capture);
+
 private:
     int f_bus_number;
     bool f_initialized;
     uint32 f_speed;
-    int f_fd;
+    I2CTransport* f_transport;
+    bool f_owns_transport;
+    bool f_combined;
+    uint32 f_functionality;
+    int f_slave_address;
+    uint64 f_syscalls;
+    bool f_stats_enabled;
+    I2CBusStats f_stats;
+    I2CCapture* f_capture;
 
     status_t open_bus();
     void close_bus();
     status_t set_slave_address(uint8 address);
+    status_t transfer_messages(struct i2c_msg* msgs, uint32 count);
+    status_t execute_message(const struct i2c_msg& msg);
+    status_t smbus_transfer(uint8 address, struct i2c_smbus_ioctl_data& data);
+    void record(uint8 address, uint16 flags, uint8* buffer, size_t length, status_t status,
+                nanotime_t start);
+    bool timing() const { return f_stats_enabled || f_capture != NULL; }
+    status_t combined_transfer(uint8 address, const uint8* write_data, size_t write_length,
+                               uint8* read_buffer, size_t read_length);
+
+    friend class I2CSMBus;
 };
 
-#endif  // I2C_H
+#endif  // I2C_H
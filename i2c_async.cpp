@@ -0,0 +1,335 @@
+#include "i2c_async.h"
+#include "i2c_transaction.h"
+#include <stdio.h>
+#include <string.h>
+#include <new>
+
+I2CAsyncFuture::I2CAsyncFuture()
+    : f_sem(create_sem(0, "i2c async future")), f_status(B_NO_INIT) {
+}
+
+I2CAsyncFuture::~I2CAsyncFuture() {
+    if (f_sem >= B_OK) {
+        delete_sem(f_sem);
+    }
+}
+
+status_t I2CAsyncFuture::wait(bigtime_t timeout) {
+    if (f_sem < B_OK) {
+        return f_sem;
+    }
+
+    status_t status;
+    if (timeout == B_INFINITE_TIMEOUT) {
+        status = acquire_sem(f_sem);
+    } else {
+        status = acquire_sem_etc(f_sem, 1, B_RELATIVE_TIMEOUT, timeout);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+    return f_status;
+}
+
+void I2CAsyncFuture::complete(status_t status) {
+    f_status = status;
+    release_sem(f_sem);
+}
+
+I2CAsyncBus::I2CAsyncBus(int bus_number, uint32 queue_size)
+    : f_bus(bus_number), f_initialized(false), f_stopping(false),
+      f_queue(NULL), f_queue_size(queue_size > 0 ? queue_size : 1), f_head(0), f_tail(0),
+      f_free_sem(-1), f_pending_sem(-1), f_lock_count(0), f_lock_sem(-1), f_worker(-1) {
+}
+
+I2CAsyncBus::I2CAsyncBus(I2CTransport* transport, uint32 queue_size)
+    : f_bus(transport), f_initialized(false), f_stopping(false),
+      f_queue(NULL), f_queue_size(queue_size > 0 ? queue_size : 1), f_head(0), f_tail(0),
+      f_free_sem(-1), f_pending_sem(-1), f_lock_count(0), f_lock_sem(-1), f_worker(-1) {
+}
+
+I2CAsyncBus::~I2CAsyncBus() {
+    if (f_initialized) {
+        deinit();
+    }
+}
+
+status_t I2CAsyncBus::init() {
+    if (f_initialized) {
+        return B_OK;
+    }
+
+    status_t status = f_bus.init();
+    if (status != B_OK) {
+        return status;
+    }
+
+    f_queue = new(std::nothrow) i2c_async_request[f_queue_size];
+    f_free_sem = create_sem(f_queue_size, "i2c async free");
+    f_pending_sem = create_sem(0, "i2c async pending");
+    f_lock_sem = create_sem(0, "i2c async lock");
+    if (f_queue == NULL || f_free_sem < B_OK || f_pending_sem < B_OK || f_lock_sem < B_OK) {
+        status = f_queue == NULL ? B_NO_MEMORY : B_NO_MORE_SEMS;
+        goto err;
+    }
+
+    f_head = f_tail = 0;
+    f_stopping = false;
+    f_worker = spawn_thread(worker_thread, "i2c async worker", B_DISPLAY_PRIORITY, this);
+    if (f_worker < B_OK) {
+        status = f_worker;
+        goto err;
+    }
+    resume_thread(f_worker);
+
+    f_initialized = true;
+    return B_OK;
+
+err:
+    fprintf(stderr, "Errore nell'avviare il bus asincrono: %s\n", strerror(status));
+    delete_sem(f_free_sem);
+    delete_sem(f_pending_sem);
+    delete_sem(f_lock_sem);
+    delete[] f_queue;
+    f_queue = NULL;
+    f_bus.deinit();
+    return status;
+}
+
+status_t I2CAsyncBus::deinit() {
+    if (!f_initialized) {
+        return B_OK;
+    }
+
+    // f_stopping cambia sotto il lock dei produttori: chi accoda dopo lo vede e
+    // rinuncia, quindi l'uscita è l'ultima richiesta della coda e quelle già
+    // accodate vengono eseguite
+    lock();
+    f_stopping = true;
+    unlock();
+    i2c_async_request quit;
+    memset(&quit, 0, sizeof(quit));
+    quit.op = I2C_ASYNC_QUIT;
+    enqueue(quit, B_INFINITE_TIMEOUT);
+
+    status_t result;
+    wait_for_thread(f_worker, &result);
+
+    // Se il thread è uscito prima dell'uscita in coda nessuno resta in attesa
+    while (f_head != f_tail) {
+        i2c_async_request& request = f_queue[f_head];
+        f_head = (f_head + 1) % f_queue_size;
+        if (request.op != I2C_ASYNC_QUIT) {
+            finish(request, B_CANCELED);
+        }
+    }
+
+    delete_sem(f_free_sem);
+    delete_sem(f_pending_sem);
+    delete_sem(f_lock_sem);
+    delete[] f_queue;
+    f_queue = NULL;
+
+    f_bus.deinit();
+    f_initialized = false;
+    return B_OK;
+}
+
+void I2CAsyncBus::lock() {
+    if (atomic_add(&f_lock_count, 1) > 0) {
+        acquire_sem(f_lock_sem);
+    }
+}
+
+void I2CAsyncBus::unlock() {
+    if (atomic_add(&f_lock_count, -1) > 1) {
+        release_sem(f_lock_sem);
+    }
+}
+
+status_t I2CAsyncBus::enqueue(const i2c_async_request& request, bigtime_t timeout) {
+    // Contropressione: si attende uno slot libero
+    status_t status;
+    if (timeout == B_INFINITE_TIMEOUT) {
+        status = acquire_sem(f_free_sem);
+    } else {
+        status = acquire_sem_etc(f_free_sem, 1, B_RELATIVE_TIMEOUT, timeout);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    // Controllo e inserimento sotto lo stesso lock: dopo l'uscita nulla entra
+    // più in coda, e una richiesta accettata viene sempre completata
+    lock();
+    if (f_stopping && request.op != I2C_ASYNC_QUIT) {
+        unlock();
+        release_sem(f_free_sem);
+        return B_NO_INIT;
+    }
+    f_queue[f_tail] = request;
+    f_tail = (f_tail + 1) % f_queue_size;
+    unlock();
+
+    release_sem(f_pending_sem);
+    return B_OK;
+}
+
+status_t I2CAsyncBus::submit(const i2c_async_request& request, bigtime_t timeout) {
+    if (!f_initialized || f_stopping) {
+        return B_NO_INIT;
+    }
+    if (request.op == I2C_ASYNC_QUIT) {
+        return B_BAD_VALUE;
+    }
+
+    if (request.future != NULL) {
+        request.future->f_status = B_BUSY;
+    }
+    return enqueue(request, timeout);
+}
+
+status_t I2CAsyncBus::write(uint8 address, const uint8* data, size_t length,
+                            I2CAsyncFuture* future) {
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_WRITE;
+    request.address = address;
+    request.data = data;
+    request.length = length;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::read(uint8 address, uint8* buffer, size_t length,
+                           I2CAsyncFuture* future) {
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_READ;
+    request.address = address;
+    request.buffer = buffer;
+    request.length = length;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::write_register(uint8 address, uint8 reg, uint8 data,
+                                     I2CAsyncFuture* future) {
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_WRITE_REGISTER;
+    request.address = address;
+    request.reg = reg;
+    request.value = data;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::read_register(uint8 address, uint8 reg, uint8* data,
+                                    I2CAsyncFuture* future) {
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_READ_REGISTER;
+    request.address = address;
+    request.reg = reg;
+    request.buffer = data;
+    request.length = 1;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::write_registers(uint8 address, uint8 reg, const uint8* data,
+                                      size_t length, I2CAsyncFuture* future) {
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_WRITE_REGISTERS;
+    request.address = address;
+    request.reg = reg;
+    request.data = data;
+    request.length = length;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::read_registers(uint8 address, uint8 reg, uint8* data, size_t length,
+                                     I2CAsyncFuture* future) {
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_READ_REGISTERS;
+    request.address = address;
+    request.reg = reg;
+    request.buffer = data;
+    request.length = length;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::submit_transaction(I2CTransaction* transaction, I2CAsyncFuture* future) {
+    if (transaction == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    i2c_async_request request;
+    memset(&request, 0, sizeof(request));
+    request.op = I2C_ASYNC_TRANSACTION;
+    request.transaction = transaction;
+    request.future = future;
+    return submit(request);
+}
+
+status_t I2CAsyncBus::worker_thread(void* data) {
+    static_cast<I2CAsyncBus*>(data)->worker_loop();
+    return B_OK;
+}
+
+void I2CAsyncBus::worker_loop() {
+    while (true) {
+        if (acquire_sem(f_pending_sem) != B_OK) {
+            break;
+        }
+
+        // Unico consumatore: la testa della coda è solo di questo thread
+        i2c_async_request request = f_queue[f_head];
+        f_head = (f_head + 1) % f_queue_size;
+        release_sem(f_free_sem);
+
+        if (request.op == I2C_ASYNC_QUIT) {
+            break;
+        }
+
+        finish(request, i2c_execute_request(f_bus, request));
+    }
+}
+
+void I2CAsyncBus::finish(i2c_async_request& request, status_t status) {
+    request.status = status;
+    if (request.callback != NULL) {
+        request.callback(&request, request.cookie);
+    }
+    if (request.future != NULL) {
+        request.future->complete(status);
+    }
+}
+
+status_t i2c_execute_request(I2CBus& bus, const i2c_async_request& request) {
+    switch (request.op) {
+        case I2C_ASYNC_WRITE:
+            return bus.write(request.address, request.data, request.length);
+        case I2C_ASYNC_READ:
+            return bus.read(request.address, request.buffer, request.length);
+        case I2C_ASYNC_WRITE_REGISTER:
+            return bus.write_register(request.address, request.reg, request.value);
+        case I2C_ASYNC_READ_REGISTER:
+            return bus.read_register(request.address, request.reg, request.buffer);
+        case I2C_ASYNC_WRITE_REGISTERS:
+            return bus.write_registers(request.address, request.reg, request.data,
+                                      request.length);
+        case I2C_ASYNC_READ_REGISTERS:
+            return bus.read_registers(request.address, request.reg, request.buffer,
+                                     request.length);
+        case I2C_ASYNC_TRANSACTION:
+            return bus.submit(*request.transaction);
+        default:
+            return B_BAD_VALUE;
+    }
+}
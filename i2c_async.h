@@ -0,0 +1,129 @@
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+
+class I2CTransaction;
+class I2CAsyncFuture;
+
+// Dimensione predefinita della coda di sottomissione
+#define I2C_ASYNC_DEFAULT_QUEUE_SIZE 64
+
+enum i2c_async_op {
+    I2C_ASYNC_WRITE,
+    I2C_ASYNC_READ,
+    I2C_ASYNC_WRITE_REGISTER,
+    I2C_ASYNC_READ_REGISTER,
+    I2C_ASYNC_WRITE_REGISTERS,
+    I2C_ASYNC_READ_REGISTERS,
+    I2C_ASYNC_TRANSACTION,
+    I2C_ASYNC_QUIT  // uso interno
+};
+
+struct i2c_async_request;
+
+// Chiamata dal thread del bus al termine della richiesta: deve essere breve
+typedef void (*i2c_async_callback)(const struct i2c_async_request* request, void* cookie);
+
+// Richiesta asincrona. Viene copiata nella coda, ma i buffer (data, buffer,
+// transaction) appartengono al chiamante e devono restare validi fino al completamento.
+struct i2c_async_request {
+    i2c_async_op op;
+    uint8 address;
+    uint8 reg;
+    uint8 value;            // dato per I2C_ASYNC_WRITE_REGISTER
+    const uint8* data;      // sorgente per le scritture
+    uint8* buffer;          // destinazione per le letture
+    size_t length;
+    I2CTransaction* transaction;
+
+    i2c_async_callback callback;
+    void* cookie;
+    I2CAsyncFuture* future;
+
+    status_t status;        // valorizzato al completamento
+};
+
+// Esegue la richiesta sul bus in modo sincrono (callback e future esclusi)
+status_t i2c_execute_request(I2CBus& bus, const i2c_async_request& request);
+
+// Attesa del risultato di una richiesta. Riutilizzabile: un semaforo per future,
+// non uno per richiesta. Un timeout di wait() non annulla la richiesta: il
+// thread del bus completerà comunque la future più tardi. Finché la richiesta
+// non è completata la future non va distrutta (il completamento scriverebbe in
+// memoria liberata) né riusata (la wait() successiva tornerebbe subito con
+// l'esito vecchio): dopo un B_TIMED_OUT si attende di nuovo. Vale anche per le
+// future passate a I2CScheduler e I2CExecutor.
+class I2CAsyncFuture {
+public:
+    I2CAsyncFuture();
+    ~I2CAsyncFuture();
+
+    status_t wait(bigtime_t timeout = B_INFINITE_TIMEOUT);
+    status_t status() const { return f_status; }
+
+private:
+    friend class I2CAsyncBus;
+    friend class I2CExecutor;
+    friend class I2CScheduler;
+
+    sem_id f_sem;
+    volatile status_t f_status;
+
+    void complete(status_t status);
+};
+
+// Front end asincrono: un thread dedicato possiede l'I2CBus (e quindi il suo
+// descrittore) ed esegue in ordine le richieste di una coda limitata. Quando la
+// coda è piena submit() attende fino a 'timeout' (0 = B_WOULD_BLOCK immediato).
+// Dopo deinit() submit() restituisce B_NO_INIT; una richiesta accettata viene
+// sempre completata, con B_CANCELED se il thread non ha potuto eseguirla.
+class I2CAsyncBus {
+public:
+    I2CAsyncBus(int bus_number, uint32 queue_size = I2C_ASYNC_DEFAULT_QUEUE_SIZE);
+    I2CAsyncBus(I2CTransport* transport, uint32 queue_size = I2C_ASYNC_DEFAULT_QUEUE_SIZE);
+    ~I2CAsyncBus();
+
+    status_t init();
+    status_t deinit();
+
+    status_t submit(const i2c_async_request& request, bigtime_t timeout = B_INFINITE_TIMEOUT);
+
+    status_t write(uint8 address, const uint8* data, size_t length, I2CAsyncFuture* future);
+    status_t read(uint8 address, uint8* buffer, size_t length, I2CAsyncFuture* future);
+    status_t write_register(uint8 address, uint8 reg, uint8 data, I2CAsyncFuture* future);
+    status_t read_register(uint8 address, uint8 reg, uint8* data, I2CAsyncFuture* future);
+    status_t write_registers(uint8 address, uint8 reg, const uint8* data, size_t length,
+                             I2CAsyncFuture* future);
+    status_t read_registers(uint8 address, uint8 reg, uint8* data, size_t length,
+                            I2CAsyncFuture* future);
+    status_t submit_transaction(I2CTransaction* transaction, I2CAsyncFuture* future);
+
+private:
+    I2CBus f_bus;
+    bool f_initialized;
+    volatile bool f_stopping;
+
+    i2c_async_request* f_queue;
+    uint32 f_queue_size;
+    uint32 f_head;
+    uint32 f_tail;
+
+    sem_id f_free_sem;      // slot liberi (contropressione)
+    sem_id f_pending_sem;   // richieste in attesa
+    int32 f_lock_count;     // benaphore per i produttori
+    sem_id f_lock_sem;
+    thread_id f_worker;
+
+    status_t enqueue(const i2c_async_request& request, bigtime_t timeout);
+    void lock();
+    void unlock();
+
+    static void finish(i2c_async_request& request, status_t status);
+    static status_t worker_thread(void* data);
+    void worker_loop();
+};
+
+#endif  // I2C_ASYNC_H
@@ -0,0 +1,157 @@
+#include "i2c_capture.h"
+#include "i2c.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static inline uint32 align8(uint64 size) {
+    return static_cast<uint32>((size + 7) & ~static_cast<uint64>(7));
+}
+
+I2CCapture::I2CCapture()
+    : f_header(NULL), f_ring(NULL), f_mapped_size(0), f_epoch(0) {
+}
+
+I2CCapture::~I2CCapture() {
+    close();
+}
+
+status_t I2CCapture::open(const char* path, size_t capacity) {
+    if (path == NULL || capacity < 2 * sizeof(i2c_capture_record)) {
+        return B_BAD_VALUE;
+    }
+    close();
+
+    capacity &= ~static_cast<size_t>(7);
+    size_t size = sizeof(i2c_capture_header) + capacity;
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        int error = errno;
+        fprintf(stderr, "Errore nel creare %s: %s\n", path, strerror(error));
+        return B_IO_ERROR;
+    }
+
+    // Il file viene dimensionato una volta: le scritture successive sono solo
+    // accessi alla memoria mappata
+    void* address = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        fprintf(stderr, "Errore nel mappare %s: %s\n", path, strerror(error));
+        return B_IO_ERROR;
+    }
+
+    f_header = static_cast<i2c_capture_header*>(address);
+    f_ring = static_cast<uint8*>(address) + sizeof(i2c_capture_header);
+    f_mapped_size = size;
+    f_epoch = system_time_nsecs();
+
+    memset(f_header, 0, sizeof(i2c_capture_header));
+    f_header->magic = I2C_CAPTURE_MAGIC;
+    f_header->version = I2C_CAPTURE_VERSION;
+    f_header->capacity = capacity;
+    return B_OK;
+}
+
+void I2CCapture::close() {
+    if (f_header == NULL) {
+        return;
+    }
+
+    // msync non serve: il kernel scrive le pagine sporche anche dopo munmap
+    munmap(f_header, f_mapped_size);
+    f_header = NULL;
+    f_ring = NULL;
+    f_mapped_size = 0;
+}
+
+void I2CCapture::set_adapter(uint32 functionality, uint32 speed) {
+    if (f_header != NULL) {
+        f_header->functionality = functionality;
+        f_header->speed = speed;
+    }
+}
+
+uint8* I2CCapture::reserve(uint32 size) {
+    // Con record fino a metà anello il padding e il record stanno sempre insieme
+    uint64 capacity = f_header->capacity;
+    if (size > capacity / 2) {
+        return NULL;
+    }
+
+    // Un record non attraversa mai la fine dell'anello: il resto diventa padding
+    uint64 offset = f_header->head % capacity;
+    uint64 padding = offset + size > capacity ? capacity - offset : 0;
+
+    // Si liberano i record più vecchi finché c'è spazio
+    while (f_header->head + padding + size - f_header->tail > capacity) {
+        const i2c_capture_record* oldest = reinterpret_cast<const i2c_capture_record*>(
+            f_ring + f_header->tail % capacity);
+        if (oldest->type != I2C_CAPTURE_PAD) {
+            f_header->dropped++;
+        }
+        f_header->tail += oldest->size;
+    }
+
+    if (padding > 0) {
+        i2c_capture_record* pad = reinterpret_cast<i2c_capture_record*>(f_ring + offset);
+        pad->size = static_cast<uint32>(padding);
+        pad->type = I2C_CAPTURE_PAD;
+        pad->count = 0;
+        f_header->head += padding;
+    }
+
+    uint8* record = f_ring + f_header->head % capacity;
+    f_header->head += size;
+    return record;
+}
+
+void I2CCapture::record(uint16 type, const struct i2c_msg* msgs, uint32 count,
+                        status_t status, nanotime_t start, nanotime_t end) {
+    if (f_header == NULL || count > 0xFFFF) {
+        return;
+    }
+
+    uint64 payload = 0;
+    for (uint32 i = 0; i < count; i++) {
+        payload += msgs[i].len;
+    }
+    uint64 size = sizeof(i2c_capture_record) + count * sizeof(i2c_capture_message) + payload;
+
+    uint8* data = size <= 0xFFFFFFF8 ? reserve(align8(size)) : NULL;
+    if (data == NULL) {
+        f_header->dropped++;
+        return;
+    }
+
+    i2c_capture_record* record = reinterpret_cast<i2c_capture_record*>(data);
+    record->size = align8(size);
+    record->type = type;
+    record->count = static_cast<uint16>(count);
+    record->timestamp = start - f_epoch;
+    record->duration = end - start;
+    record->status = status;
+    record->reserved = 0;
+
+    i2c_capture_message* message = reinterpret_cast<i2c_capture_message*>(record + 1);
+    uint8* payload_data = reinterpret_cast<uint8*>(message + count);
+    for (uint32 i = 0; i < count; i++) {
+        message[i].addr = msgs[i].addr;
+        message[i].flags = msgs[i].flags;
+        message[i].len = msgs[i].len;
+        message[i].reserved = 0;
+        if (msgs[i].len > 0 && msgs[i].buf != NULL) {
+            memcpy(payload_data, msgs[i].buf, msgs[i].len);
+        }
+        payload_data += msgs[i].len;
+    }
+
+    f_header->records++;
+}
@@ -0,0 +1,87 @@
+#ifndef I2C_CAPTURE_H
+#define I2C_CAPTURE_H
+
+#include <OS.h>
+#include <stdint.h>
+
+struct i2c_msg;
+
+#define I2C_CAPTURE_MAGIC   0x50414349  // "ICAP"
+#define I2C_CAPTURE_VERSION 1
+
+// Tipo di record: una chiamata al trasporto
+enum {
+    I2C_CAPTURE_PAD = 0,        // spazio inutilizzato fino alla fine dell'anello
+    I2C_CAPTURE_TRANSFER,       // transfer(): messaggi con repeated start
+    I2C_CAPTURE_READ,           // read() sull'indirizzo corrente
+    I2C_CAPTURE_WRITE,          // write() sull'indirizzo corrente
+    I2C_CAPTURE_QUICK           // smbus(): quick, un messaggio vuoto
+};
+
+// Intestazione del file, seguita dall'anello dei record. head e tail sono
+// posizioni crescenti: l'offset nell'anello è posizione % capacity.
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint64 capacity;        // byte dell'anello, multiplo di 8
+    uint64 head;            // dove va scritto il prossimo record
+    uint64 tail;            // record più vecchio ancora presente
+    uint64 records;         // record scritti in totale
+    uint64 dropped;         // record sovrascritti o troppo grandi per l'anello
+    uint32 functionality;   // dell'adattatore catturato, per il replay
+    uint32 speed;
+    uint8 reserved[8];
+} i2c_capture_header;
+
+// Record a lunghezza variabile, allineato a 8 byte: intestazione, 'count'
+// descrittori di messaggio, poi i dati di tutti i messaggi uno dopo l'altro
+// (scritti per le scritture, ricevuti per le letture)
+typedef struct {
+    uint32 size;
+    uint16 type;
+    uint16 count;
+    int64 timestamp;        // ns dall'apertura della cattura
+    int64 duration;         // ns trascorsi nella chiamata
+    int32 status;
+    uint32 reserved;
+} i2c_capture_record;
+
+typedef struct {
+    uint16 addr;
+    uint16 flags;
+    uint16 len;
+    uint16 reserved;
+} i2c_capture_message;
+
+// Registrazione delle transazioni di un I2CBus in un file ad anello mappato in
+// memoria. record() copia i dati nella mappatura senza formattazione e senza
+// chiamate di sistema; quando l'anello è pieno i record più vecchi vengono
+// sovrascritti. Un solo scrittore alla volta (lo stesso vincolo di I2CBus).
+class I2CCapture {
+public:
+    I2CCapture();
+    ~I2CCapture();
+
+    // Crea (o tronca) il file con un anello di 'capacity' byte
+    status_t open(const char* path, size_t capacity);
+    void close();
+    bool is_open() const { return f_header != NULL; }
+
+    void set_adapter(uint32 functionality, uint32 speed);
+
+    void record(uint16 type, const struct i2c_msg* msgs, uint32 count, status_t status,
+                nanotime_t start, nanotime_t end);
+
+    uint64 record_count() const { return f_header != NULL ? f_header->records : 0; }
+    uint64 dropped() const { return f_header != NULL ? f_header->dropped : 0; }
+
+private:
+    i2c_capture_header* f_header;
+    uint8* f_ring;
+    size_t f_mapped_size;
+    nanotime_t f_epoch;
+
+    uint8* reserve(uint32 size);
+};
+
+#endif  // I2C_CAPTURE_H
@@ -0,0 +1,258 @@
+#include "i2c_executor.h"
+#include <stdio.h>
+#include <string.h>
+#include <new>
+
+I2CExecutor::I2CExecutor(uint32 worker_count)
+    : f_lane_count(0), f_workers(NULL),
+      f_worker_count(worker_count == 0 ? 1
+          : worker_count > I2C_EXECUTOR_MAX_WORKERS ? I2C_EXECUTOR_MAX_WORKERS : worker_count),
+      f_next_worker(0), f_work_sem(-1), f_quit(false), f_initialized(false) {
+    memset(f_lanes, 0, sizeof(f_lanes));
+}
+
+I2CExecutor::~I2CExecutor() {
+    deinit();
+    for (uint32 i = 0; i < f_lane_count; i++) {
+        delete f_lanes[i];
+    }
+}
+
+int32 I2CExecutor::add_bus(int bus_number) {
+    if (f_initialized) {
+        return B_NOT_ALLOWED;
+    }
+    if (f_lane_count >= I2C_EXECUTOR_MAX_LANES) {
+        return B_NO_MEMORY;
+    }
+
+    I2CAsyncBus* lane = new(std::nothrow) I2CAsyncBus(bus_number);
+    if (lane == NULL) {
+        return B_NO_MEMORY;
+    }
+    f_lanes[f_lane_count] = lane;
+    return f_lane_count++;
+}
+
+int32 I2CExecutor::add_bus(I2CTransport* transport) {
+    if (f_initialized) {
+        return B_NOT_ALLOWED;
+    }
+    if (f_lane_count >= I2C_EXECUTOR_MAX_LANES) {
+        return B_NO_MEMORY;
+    }
+
+    I2CAsyncBus* lane = new(std::nothrow) I2CAsyncBus(transport);
+    if (lane == NULL) {
+        return B_NO_MEMORY;
+    }
+    f_lanes[f_lane_count] = lane;
+    return f_lane_count++;
+}
+
+status_t I2CExecutor::init() {
+    if (f_initialized) {
+        return B_OK;
+    }
+
+    f_workers = new(std::nothrow) worker[f_worker_count];
+    f_work_sem = create_sem(0, "i2c executor work");
+    if (f_workers == NULL || f_work_sem < B_OK) {
+        delete[] f_workers;
+        f_workers = NULL;
+        delete_sem(f_work_sem);
+        return B_NO_MEMORY;
+    }
+
+    f_quit = false;
+    uint32 started = 0;
+    status_t status = B_OK;
+    for (; started < f_worker_count; started++) {
+        worker* w = &f_workers[started];
+        w->head = 0;
+        w->count = 0;
+        w->lock_count = 0;
+        w->lock_sem = create_sem(0, "i2c executor deque");
+        w->executor = this;
+        w->index = started;
+        w->thread = w->lock_sem < B_OK ? w->lock_sem
+            : spawn_thread(worker_thread, "i2c executor worker", B_NORMAL_PRIORITY, w);
+        if (w->thread < B_OK) {
+            status = w->thread;
+            delete_sem(w->lock_sem);
+            break;
+        }
+        resume_thread(w->thread);
+    }
+
+    for (uint32 i = 0; status == B_OK && i < f_lane_count; i++) {
+        status = f_lanes[i]->init();
+    }
+
+    if (status != B_OK) {
+        fprintf(stderr, "Errore nell'avviare l'executor: %s\n", strerror(status));
+        for (uint32 i = 0; i < f_lane_count; i++) {
+            f_lanes[i]->deinit();
+        }
+        f_quit = true;
+        release_sem_etc(f_work_sem, started, 0);
+        for (uint32 i = 0; i < started; i++) {
+            wait_for_thread(f_workers[i].thread, &status);
+            delete_sem(f_workers[i].lock_sem);
+        }
+        delete_sem(f_work_sem);
+        delete[] f_workers;
+        f_workers = NULL;
+        return status;
+    }
+
+    f_initialized = true;
+    return B_OK;
+}
+
+status_t I2CExecutor::deinit() {
+    if (!f_initialized) {
+        return B_OK;
+    }
+
+    // Prima si svuotano le corsie, poi il pool termina le decodifiche rimaste
+    for (uint32 i = 0; i < f_lane_count; i++) {
+        f_lanes[i]->deinit();
+    }
+
+    f_quit = true;
+    release_sem_etc(f_work_sem, f_worker_count, 0);
+    for (uint32 i = 0; i < f_worker_count; i++) {
+        status_t result;
+        wait_for_thread(f_workers[i].thread, &result);
+        delete_sem(f_workers[i].lock_sem);
+    }
+
+    delete_sem(f_work_sem);
+    delete[] f_workers;
+    f_workers = NULL;
+    f_initialized = false;
+    return B_OK;
+}
+
+status_t I2CExecutor::submit(uint32 lane, i2c_executor_job* job, bigtime_t timeout) {
+    if (!f_initialized) {
+        return B_NO_INIT;
+    }
+    if (lane >= f_lane_count || job == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    job->executor = this;
+    job->status = B_BUSY;
+    job->request.callback = transfer_done;
+    job->request.cookie = job;
+    job->request.future = NULL;
+    if (job->future != NULL) {
+        job->future->f_status = B_BUSY;
+    }
+    return f_lanes[lane]->submit(job->request, timeout);
+}
+
+void I2CExecutor::transfer_done(const struct i2c_async_request* request, void* cookie) {
+    // Gira sul thread della corsia: qui solo il passaggio al pool
+    i2c_executor_job* job = static_cast<i2c_executor_job*>(cookie);
+    job->status = request->status;
+
+    if (job->decode == NULL) {
+        job->executor->finish(job);
+        return;
+    }
+    if (!job->executor->push(job)) {
+        // Pool saturo: si decodifica sulla corsia (contropressione sul bus)
+        job->decode(job, job->cookie);
+        job->executor->finish(job);
+    }
+}
+
+void I2CExecutor::finish(i2c_executor_job* job) {
+    if (job->future != NULL) {
+        job->future->complete(job->status);
+    }
+}
+
+void I2CExecutor::lock(worker* w) {
+    if (atomic_add(&w->lock_count, 1) > 0) {
+        acquire_sem(w->lock_sem);
+    }
+}
+
+void I2CExecutor::unlock(worker* w) {
+    if (atomic_add(&w->lock_count, -1) > 1) {
+        release_sem(w->lock_sem);
+    }
+}
+
+bool I2CExecutor::push(i2c_executor_job* job) {
+    // Distribuzione a rotazione; il furto di lavoro bilancia il resto
+    uint32 first = static_cast<uint32>(atomic_add(&f_next_worker, 1)) % f_worker_count;
+    for (uint32 i = 0; i < f_worker_count; i++) {
+        worker* w = &f_workers[(first + i) % f_worker_count];
+        lock(w);
+        if (w->count < I2C_EXECUTOR_DEQUE_SIZE) {
+            w->jobs[(w->head + w->count) % I2C_EXECUTOR_DEQUE_SIZE] = job;
+            w->count++;
+            unlock(w);
+            release_sem(f_work_sem);
+            return true;
+        }
+        unlock(w);
+    }
+    return false;
+}
+
+i2c_executor_job* I2CExecutor::pop(worker* self) {
+    // Il proprietario prende l'ultimo inserito (dati ancora in cache)
+    i2c_executor_job* job = NULL;
+    lock(self);
+    if (self->count > 0) {
+        self->count--;
+        job = self->jobs[(self->head + self->count) % I2C_EXECUTOR_DEQUE_SIZE];
+    }
+    unlock(self);
+    return job;
+}
+
+i2c_executor_job* I2CExecutor::steal(worker* victim) {
+    // Il ladro prende il più vecchio, dal lato opposto al proprietario
+    i2c_executor_job* job = NULL;
+    lock(victim);
+    if (victim->count > 0) {
+        job = victim->jobs[victim->head];
+        victim->head = (victim->head + 1) % I2C_EXECUTOR_DEQUE_SIZE;
+        victim->count--;
+    }
+    unlock(victim);
+    return job;
+}
+
+status_t I2CExecutor::worker_thread(void* data) {
+    worker* self = static_cast<worker*>(data);
+    self->executor->worker_loop(self);
+    return B_OK;
+}
+
+void I2CExecutor::worker_loop(worker* self) {
+    while (acquire_sem(f_work_sem) == B_OK) {
+        // Ogni unità del semaforo corrisponde a un lavoro in qualche coda: se un
+        // altro worker ce lo ha sottratto, ne esiste comunque un altro da cercare
+        i2c_executor_job* job = NULL;
+        while (job == NULL) {
+            job = pop(self);
+            for (uint32 i = 1; job == NULL && i < f_worker_count; i++) {
+                job = steal(&f_workers[(self->index + i) % f_worker_count]);
+            }
+            if (job == NULL && f_quit) {
+                return;
+            }
+        }
+
+        job->decode(job, job->cookie);
+        finish(job);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef I2C_EXECUTOR_H
+#define I2C_EXECUTOR_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c_async.h"
+
+#define I2C_EXECUTOR_MAX_LANES 16
+#define I2C_EXECUTOR_MAX_WORKERS 32
+// Capacità della coda di decodifica di ogni worker
+#define I2C_EXECUTOR_DEQUE_SIZE 256
+
+struct i2c_executor_job;
+class I2CExecutor;
+
+// Elaborazione lato CPU del risultato di un trasferimento (eseguita dal pool)
+typedef void (*i2c_decode_func)(struct i2c_executor_job* job, void* cookie);
+
+// Lavoro dell'executor: un trasferimento sulla corsia del bus seguito da una
+// decodifica opzionale. Appartiene al chiamante e deve restare valido fino al
+// completamento (future completata o decode terminata).
+struct i2c_executor_job {
+    i2c_async_request request;  // callback, cookie e future sono dell'executor
+    i2c_decode_func decode;
+    void* cookie;
+    I2CAsyncFuture* future;     // completata dopo la decodifica (vedi I2CAsyncFuture)
+    status_t status;            // esito del trasferimento
+
+    I2CExecutor* executor;      // uso interno
+};
+
+// Esegue trasferimenti su più bus in parallelo: ogni bus ha una corsia seriale
+// (un I2CAsyncBus con il proprio thread), mentre le decodifiche vanno a un pool di
+// worker con code locali e furto di lavoro, così i bus restano sempre occupati.
+class I2CExecutor {
+public:
+    I2CExecutor(uint32 worker_count = 2);
+    ~I2CExecutor();
+
+    // Da chiamare prima di init(); restituiscono l'indice della corsia
+    int32 add_bus(int bus_number);
+    int32 add_bus(I2CTransport* transport);
+
+    status_t init();
+    status_t deinit();
+
+    status_t submit(uint32 lane, i2c_executor_job* job, bigtime_t timeout = B_INFINITE_TIMEOUT);
+
+    uint32 lane_count() const { return f_lane_count; }
+
+private:
+    struct worker {
+        i2c_executor_job* jobs[I2C_EXECUTOR_DEQUE_SIZE];
+        uint32 head;            // lato dei furti (FIFO)
+        uint32 count;
+        int32 lock_count;       // benaphore
+        sem_id lock_sem;
+        thread_id thread;
+        I2CExecutor* executor;
+        uint32 index;
+    };
+
+    I2CAsyncBus* f_lanes[I2C_EXECUTOR_MAX_LANES];
+    uint32 f_lane_count;
+
+    worker* f_workers;
+    uint32 f_worker_count;
+    int32 f_next_worker;
+    sem_id f_work_sem;          // un'unità per ogni decodifica in coda
+    volatile bool f_quit;
+    bool f_initialized;
+
+    static void transfer_done(const struct i2c_async_request* request, void* cookie);
+    static status_t worker_thread(void* data);
+    void worker_loop(worker* self);
+
+    bool push(i2c_executor_job* job);
+    i2c_executor_job* pop(worker* self);
+    i2c_executor_job* steal(worker* victim);
+    void finish(i2c_executor_job* job);
+
+    static void lock(worker* w);
+    static void unlock(worker* w);
+};
+
+#endif  // I2C_EXECUTOR_H
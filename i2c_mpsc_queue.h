@@ -0,0 +1,72 @@
+#ifndef I2C_MPSC_QUEUE_H
+#define I2C_MPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+// Nodo intrusivo: le strutture accodate lo ereditano
+struct i2c_mpsc_node {
+    std::atomic<i2c_mpsc_node*> next;
+};
+
+// Coda senza lock a più produttori e un solo consumatore (algoritmo di Vyukov).
+// push() è wait-free: uno scambio atomico e una store. pop() può restituire NULL
+// per un istante mentre un produttore sta completando il collegamento: chi sa che
+// un elemento è presente (per esempio tramite un semaforo) deve riprovare.
+class I2CMPSCQueue {
+public:
+    I2CMPSCQueue()
+        : f_head(&f_stub), f_tail(&f_stub) {
+        f_stub.next.store(NULL, std::memory_order_relaxed);
+    }
+
+    void push(i2c_mpsc_node* node) {
+        node->next.store(NULL, std::memory_order_relaxed);
+        i2c_mpsc_node* previous = f_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Solo dal thread consumatore
+    i2c_mpsc_node* pop() {
+        i2c_mpsc_node* tail = f_tail;
+        i2c_mpsc_node* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &f_stub) {
+            if (next == NULL) {
+                return NULL;
+            }
+            f_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != NULL) {
+            f_tail = next;
+            return tail;
+        }
+
+        if (tail != f_head.load(std::memory_order_acquire)) {
+            // Un produttore non ha ancora collegato il suo nodo
+            return NULL;
+        }
+
+        // Ultimo elemento: si rimette lo stub in coda per poterlo staccare
+        push(&f_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != NULL) {
+            f_tail = next;
+            return tail;
+        }
+        return NULL;
+    }
+
+private:
+    std::atomic<i2c_mpsc_node*> f_head;   // lato produttori
+    i2c_mpsc_node* f_tail;                // lato consumatore
+    i2c_mpsc_node f_stub;
+
+    I2CMPSCQueue(const I2CMPSCQueue&);
+    I2CMPSCQueue& operator=(const I2CMPSCQueue&);
+};
+
+#endif  // I2C_MPSC_QUEUE_H
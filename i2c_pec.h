@@ -0,0 +1,23 @@
+#ifndef I2C_PEC_H
+#define I2C_PEC_H
+
+#include <OS.h>
+#include <stddef.h>
+
+// Packet Error Code SMBus: CRC-8 con polinomio x^8 + x^2 + x + 1 (0x07), valore
+// iniziale 0, calcolato su tutti i byte della transazione compresi quelli di
+// indirizzo. Usato sia dalla libreria sia dal driver: niente dipendenze oltre OS.h.
+extern const uint8 kI2CPecTable[4][256];
+
+uint8 i2c_pec_update(uint8 crc, const uint8* data, size_t length);
+
+static inline uint8 i2c_pec_byte(uint8 crc, uint8 value) {
+    return kI2CPecTable[0][crc ^ value];
+}
+
+// Byte di indirizzo come appare sul filo: indirizzo a 7 bit e bit R/W
+static inline uint8 i2c_pec_address(uint8 crc, uint8 address, bool read) {
+    return i2c_pec_byte(crc, static_cast<uint8>((address << 1) | (read ? 1 : 0)));
+}
+
+#endif  // I2C_PEC_H
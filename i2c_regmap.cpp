@@ -0,0 +1,212 @@
+#include "i2c_regmap.h"
+#include <string.h>
+
+// Registri puliti tollerati all'interno di una corsa sporca in sync(): riscriverli
+// costa meno di una nuova transazione (START, indirizzo e puntatore)
+#define I2C_REGMAP_MAX_GAP 2
+
+I2CRegmap::I2CRegmap(I2CBus* bus, const i2c_regmap_config& config)
+    : f_bus(bus), f_config(config) {
+    memset(f_volatile, 0, sizeof(f_volatile));
+    memset(f_readable, 0xFF, sizeof(f_readable));
+    memset(f_writable, 0xFF, sizeof(f_writable));
+
+    mark_ranges(f_volatile, config.volatile_ranges, config.volatile_count, true);
+    mark_ranges(f_writable, config.read_only_ranges, config.read_only_count, false);
+    mark_ranges(f_readable, config.write_only_ranges, config.write_only_count, false);
+
+    invalidate();
+}
+
+void I2CRegmap::mark_ranges(uint32* map, const i2c_reg_range* ranges, uint32 count,
+                            bool value) {
+    if (ranges == NULL) {
+        return;
+    }
+
+    for (uint32 i = 0; i < count; i++) {
+        for (uint32 reg = ranges[i].first; reg <= ranges[i].last; reg++) {
+            if (value) {
+                set(map, reg);
+            } else {
+                clear(map, reg);
+            }
+        }
+    }
+}
+
+void I2CRegmap::invalidate() {
+    memset(f_cache, 0, sizeof(f_cache));
+    memset(f_valid, 0, sizeof(f_valid));
+    memset(f_dirty, 0, sizeof(f_dirty));
+
+    // I valori di default valgono finché il dispositivo non viene modificato
+    if (f_config.defaults == NULL) {
+        return;
+    }
+    for (uint32 i = 0; i < f_config.default_count; i++) {
+        uint8 reg = f_config.defaults[i].reg;
+        if (cacheable(reg)) {
+            f_cache[reg] = f_config.defaults[i].value;
+            set(f_valid, reg);
+        }
+    }
+}
+
+bool I2CRegmap::is_dirty() const {
+    for (uint32 i = 0; i < I2C_REGMAP_SIZE / 32; i++) {
+        if (f_dirty[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+status_t I2CRegmap::read(uint8 reg, uint8* value) {
+    return read_block(reg, value, 1);
+}
+
+status_t I2CRegmap::read_block(uint8 reg, uint8* data, size_t length) {
+    if (data == NULL || !in_range(reg, length)) {
+        return B_BAD_VALUE;
+    }
+
+    // Intervallo minimo da leggere dal bus
+    int32 first = -1;
+    int32 last = -1;
+    for (uint32 i = 0; i < length; i++) {
+        uint32 r = reg + i;
+        bool cached = cacheable(r) && test(f_valid, r);
+        if (!test(f_readable, r) && !cached) {
+            return B_NOT_ALLOWED;
+        }
+        if (!cached) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+        }
+    }
+
+    if (first >= 0) {
+        status_t status = f_bus->read_registers(f_config.address, reg + first, data + first,
+                                                last - first + 1);
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    for (uint32 i = 0; i < length; i++) {
+        uint32 r = reg + i;
+        bool from_wire = first >= 0 && i >= static_cast<uint32>(first)
+            && i <= static_cast<uint32>(last);
+        if (!from_wire || !test(f_readable, r) || test(f_dirty, r)) {
+            // In cache il valore più recente (scrittura non ancora sincronizzata)
+            data[i] = f_cache[r];
+        } else if (cacheable(r)) {
+            f_cache[r] = data[i];
+            set(f_valid, r);
+        }
+    }
+
+    return B_OK;
+}
+
+status_t I2CRegmap::write(uint8 reg, uint8 value) {
+    return write_block(reg, &value, 1);
+}
+
+status_t I2CRegmap::write_block(uint8 reg, const uint8* data, size_t length) {
+    if (data == NULL || !in_range(reg, length)) {
+        return B_BAD_VALUE;
+    }
+
+    bool has_volatile = false;
+    for (uint32 i = 0; i < length; i++) {
+        if (!test(f_writable, reg + i)) {
+            return B_NOT_ALLOWED;
+        }
+        has_volatile |= !cacheable(reg + i);
+    }
+
+    // I registri volatili vanno sempre scritti subito
+    bool to_wire = f_config.cache_mode == I2C_REGMAP_WRITE_THROUGH || has_volatile;
+    if (to_wire) {
+        status_t status = f_bus->write_registers(f_config.address, reg, data, length);
+        if (status != B_OK) {
+            return status;
+        }
+    }
+
+    for (uint32 i = 0; i < length; i++) {
+        uint32 r = reg + i;
+        if (!cacheable(r)) {
+            continue;
+        }
+        f_cache[r] = data[i];
+        set(f_valid, r);
+        if (to_wire) {
+            clear(f_dirty, r);
+        } else {
+            set(f_dirty, r);
+        }
+    }
+
+    return B_OK;
+}
+
+status_t I2CRegmap::update_bits(uint8 reg, uint8 mask, uint8 value) {
+    uint8 old_value;
+    status_t status = read(reg, &old_value);
+    if (status != B_OK) {
+        return status;
+    }
+
+    uint8 new_value = (old_value & ~mask) | (value & mask);
+    if (new_value == old_value && cacheable(reg)) {
+        return B_OK;
+    }
+    return write(reg, new_value);
+}
+
+status_t I2CRegmap::sync() {
+    status_t result = B_OK;
+    uint32 reg = 0;
+
+    while (reg <= f_config.max_register) {
+        if (!test(f_dirty, reg)) {
+            reg++;
+            continue;
+        }
+
+        // Estende la corsa sporca, inglobando brevi buchi di registri puliti
+        // ma noti e scrivibili
+        uint32 start = reg;
+        uint32 end = reg + 1;
+        uint32 scan = end;
+        while (scan <= f_config.max_register) {
+            if (test(f_dirty, scan)) {
+                end = ++scan;
+                continue;
+            }
+            if (scan - end >= I2C_REGMAP_MAX_GAP || !test(f_valid, scan)
+                || !test(f_writable, scan) || !cacheable(scan)) {
+                break;
+            }
+            scan++;
+        }
+
+        status_t status = f_bus->write_registers(f_config.address, start, &f_cache[start],
+                                                 end - start);
+        if (status == B_OK) {
+            for (uint32 r = start; r < end; r++) {
+                clear(f_dirty, r);
+            }
+        } else if (result == B_OK) {
+            result = status;
+        }
+        reg = end;
+    }
+
+    return result;
+}
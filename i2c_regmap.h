@@ -0,0 +1,98 @@
+#ifndef I2C_REGMAP_H
+#define I2C_REGMAP_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+
+// Numero di registri indirizzabili con un puntatore a 8 bit
+#define I2C_REGMAP_SIZE 256
+
+// Intervallo di registri, estremi inclusi
+typedef struct {
+    uint8 first;
+    uint8 last;
+} i2c_reg_range;
+
+// Valore del registro dopo il reset del dispositivo
+typedef struct {
+    uint8 reg;
+    uint8 value;
+} i2c_reg_default;
+
+typedef enum {
+    I2C_REGMAP_WRITE_THROUGH,   // ogni scrittura va subito sul bus
+    I2C_REGMAP_WRITE_BACK       // le scritture restano in cache fino a sync()
+} i2c_regmap_cache_mode;
+
+// Descrizione della mappa dei registri di un dispositivo
+typedef struct {
+    uint8 address;
+    uint8 max_register;
+
+    const i2c_reg_range* volatile_ranges;    // mai serviti dalla cache
+    uint32 volatile_count;
+    const i2c_reg_range* read_only_ranges;
+    uint32 read_only_count;
+    const i2c_reg_range* write_only_ranges;
+    uint32 write_only_count;
+    const i2c_reg_default* defaults;
+    uint32 default_count;
+
+    i2c_regmap_cache_mode cache_mode;
+} i2c_regmap_config;
+
+// Cache dei registri sopra I2CBus: le letture dei registri non volatili già noti
+// non toccano il bus; in modalità write-back le scritture vengono accumulate e
+// sync() le invia raggruppando i registri sporchi contigui in scritture a blocchi.
+class I2CRegmap {
+public:
+    I2CRegmap(I2CBus* bus, const i2c_regmap_config& config);
+
+    status_t read(uint8 reg, uint8* value);
+    status_t read_block(uint8 reg, uint8* data, size_t length);
+
+    status_t write(uint8 reg, uint8 value);
+    status_t write_block(uint8 reg, const uint8* data, size_t length);
+
+    // Read-modify-write; nessun accesso al bus se il valore non cambia
+    status_t update_bits(uint8 reg, uint8 mask, uint8 value);
+
+    // Invia tutte le scritture in sospeso (solo write-back)
+    status_t sync();
+
+    // Dimentica i valori in cache (per esempio dopo un reset del dispositivo).
+    // Le scritture non ancora sincronizzate vengono perse.
+    void invalidate();
+
+    void set_cache_mode(i2c_regmap_cache_mode mode) { f_config.cache_mode = mode; }
+    bool is_dirty() const;
+
+private:
+    I2CBus* f_bus;
+    i2c_regmap_config f_config;
+
+    uint8 f_cache[I2C_REGMAP_SIZE];
+
+    // Bitmap da un bit per registro
+    uint32 f_valid[I2C_REGMAP_SIZE / 32];
+    uint32 f_dirty[I2C_REGMAP_SIZE / 32];
+    uint32 f_volatile[I2C_REGMAP_SIZE / 32];
+    uint32 f_readable[I2C_REGMAP_SIZE / 32];
+    uint32 f_writable[I2C_REGMAP_SIZE / 32];
+
+    static bool test(const uint32* map, uint32 reg) {
+        return (map[reg >> 5] & (1u << (reg & 31))) != 0;
+    }
+    static void set(uint32* map, uint32 reg) { map[reg >> 5] |= 1u << (reg & 31); }
+    static void clear(uint32* map, uint32 reg) { map[reg >> 5] &= ~(1u << (reg & 31)); }
+    static void mark_ranges(uint32* map, const i2c_reg_range* ranges, uint32 count,
+                            bool value);
+
+    bool in_range(uint8 reg, size_t length) const {
+        return length > 0 && reg + length - 1 <= f_config.max_register;
+    }
+    bool cacheable(uint32 reg) const { return !test(f_volatile, reg); }
+};
+
+#endif  // I2C_REGMAP_H
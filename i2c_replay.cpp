@@ -0,0 +1,231 @@
+#include "i2c_replay.h"
+#include "i2c.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Sotto questa soglia (ns) l'attesa avviene in busy-wait: snooze non è abbastanza preciso
+#define I2C_REPLAY_SPIN_THRESHOLD 200000
+
+I2CReplayTransport::I2CReplayTransport(const char* path, bool realtime)
+    : f_path(path != NULL ? strdup(path) : NULL), f_realtime(realtime), f_header(NULL),
+      f_ring(NULL), f_mapped_size(0), f_position(0), f_address(0), f_base(-1),
+      f_replayed(0), f_mismatches(0) {
+}
+
+I2CReplayTransport::~I2CReplayTransport() {
+    close();
+    free(f_path);
+}
+
+status_t I2CReplayTransport::open() {
+    if (f_path == NULL) {
+        return B_NO_MEMORY;
+    }
+    close();
+
+    int fd = ::open(f_path, O_RDONLY);
+    if (fd < 0) {
+        int error = errno;
+        fprintf(stderr, "Errore nell'aprire %s: %s\n", f_path, strerror(error));
+        return B_IO_ERROR;
+    }
+
+    struct stat st;
+    void* address = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(i2c_capture_header)) {
+        address = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        fprintf(stderr, "Errore nel mappare %s\n", f_path);
+        return B_IO_ERROR;
+    }
+
+    const i2c_capture_header* header = static_cast<const i2c_capture_header*>(address);
+    if (header->magic != I2C_CAPTURE_MAGIC || header->version != I2C_CAPTURE_VERSION
+        || header->capacity == 0 || header->capacity % 8 != 0
+        || header->capacity + sizeof(i2c_capture_header) > static_cast<uint64>(st.st_size)
+        || header->tail % 8 != 0 || header->tail > header->head
+        || header->head - header->tail > header->capacity) {
+        fprintf(stderr, "%s non è una cattura valida\n", f_path);
+        munmap(address, st.st_size);
+        return B_BAD_DATA;
+    }
+
+    f_header = header;
+    f_ring = static_cast<const uint8*>(address) + sizeof(i2c_capture_header);
+    f_mapped_size = st.st_size;
+    f_position = header->tail;
+    f_base = -1;
+    f_replayed = 0;
+    f_mismatches = 0;
+    return B_OK;
+}
+
+void I2CReplayTransport::close() {
+    if (f_header != NULL) {
+        munmap(const_cast<i2c_capture_header*>(f_header), f_mapped_size);
+        f_header = NULL;
+        f_ring = NULL;
+        f_mapped_size = 0;
+    }
+}
+
+uint32 I2CReplayTransport::functionality() {
+    return f_header != NULL ? f_header->functionality : 0;
+}
+
+uint32 I2CReplayTransport::speed() {
+    return f_header != NULL ? f_header->speed : 0;
+}
+
+status_t I2CReplayTransport::set_address(uint8 address) {
+    // Non registrato: l'indirizzo compare nei record di read() e write()
+    f_address = address;
+    return B_OK;
+}
+
+bool I2CReplayTransport::at_end() const {
+    return f_header == NULL || f_position >= f_header->head;
+}
+
+status_t I2CReplayTransport::next_record(const i2c_capture_record** _record) {
+    // La dimensione viene dal file: prima di avanzare si verifica che il record
+    // sia allineato, resti nell'anello e nella parte scritta, e contenga i
+    // descrittori e i dati che dichiara. Il padding occupa almeno size, type e
+    // count (8 byte), un record vero almeno la propria intestazione.
+    uint64 capacity = f_header->capacity;
+    while (f_position < f_header->head) {
+        uint64 offset = f_position % capacity;
+        const i2c_capture_record* record = reinterpret_cast<const i2c_capture_record*>(
+            f_ring + offset);
+        uint64 size = record->size;
+        bool pad = record->type == I2C_CAPTURE_PAD;
+        bool valid = size >= (pad ? 8 : sizeof(i2c_capture_record)) && size % 8 == 0
+            && offset + size <= capacity && f_position + size <= f_header->head;
+        if (valid && !pad) {
+            uint64 used = sizeof(i2c_capture_record)
+                + static_cast<uint64>(record->count) * sizeof(i2c_capture_message);
+            const i2c_capture_message* message
+                = reinterpret_cast<const i2c_capture_message*>(record + 1);
+            for (uint32 i = 0; used <= size && i < record->count; i++) {
+                used += message[i].len;
+            }
+            valid = used <= size;
+        }
+        if (!valid) {
+            // Record corrotto: il replay si ferma qui
+            f_position = f_header->head;
+            return B_BAD_DATA;
+        }
+
+        f_position += size;
+        if (!pad) {
+            *_record = record;
+            return B_OK;
+        }
+    }
+    return B_ENTRY_NOT_FOUND;
+}
+
+void I2CReplayTransport::wait_until(nanotime_t deadline) {
+    nanotime_t remaining = deadline - system_time_nsecs();
+    if (remaining > I2C_REPLAY_SPIN_THRESHOLD) {
+        snooze((remaining - I2C_REPLAY_SPIN_THRESHOLD) / 1000);
+    }
+    while (system_time_nsecs() < deadline) {
+    }
+}
+
+status_t I2CReplayTransport::replay(uint16 type, struct i2c_msg* msgs, uint32 count) {
+    if (f_header == NULL) {
+        return B_NO_INIT;
+    }
+
+    const i2c_capture_record* record;
+    status_t status = next_record(&record);
+    if (status != B_OK) {
+        return status;
+    }
+
+    const i2c_capture_message* message = reinterpret_cast<const i2c_capture_message*>(record + 1);
+    bool match = record->type == type && record->count == count;
+    for (uint32 i = 0; match && i < count; i++) {
+        match = message[i].addr == msgs[i].addr && message[i].flags == msgs[i].flags
+            && message[i].len == msgs[i].len;
+    }
+    if (!match) {
+        f_mismatches++;
+        return B_MISMATCHED_VALUES;
+    }
+
+    const uint8* payload = reinterpret_cast<const uint8*>(message + count);
+    for (uint32 i = 0; i < count; i++) {
+        if ((msgs[i].flags & I2C_M_RD) != 0 && msgs[i].len > 0) {
+            memcpy(msgs[i].buf, payload, msgs[i].len);
+        }
+        payload += message[i].len;
+    }
+
+    if (f_realtime) {
+        // La prima chiamata fissa l'origine: le successive mantengono gli
+        // intervalli della cattura, pause comprese
+        if (f_base < 0) {
+            f_base = system_time_nsecs() - record->timestamp;
+        }
+        wait_until(f_base + record->timestamp + record->duration);
+    }
+
+    f_replayed++;
+    return record->status;
+}
+
+status_t I2CReplayTransport::read(uint8* buffer, size_t length) {
+    if (length > 0xFFFF) {
+        return B_BAD_VALUE;
+    }
+
+    struct i2c_msg msg;
+    msg.addr = f_address;
+    msg.flags = I2C_M_RD;
+    msg.len = static_cast<uint16>(length);
+    msg.buf = buffer;
+    return replay(I2C_CAPTURE_READ, &msg, 1);
+}
+
+status_t I2CReplayTransport::write(const uint8* data, size_t length) {
+    if (length > 0xFFFF) {
+        return B_BAD_VALUE;
+    }
+
+    struct i2c_msg msg;
+    msg.addr = f_address;
+    msg.flags = 0;
+    msg.len = static_cast<uint16>(length);
+    msg.buf = const_cast<uint8*>(data);
+    return replay(I2C_CAPTURE_WRITE, &msg, 1);
+}
+
+status_t I2CReplayTransport::transfer(struct i2c_msg* msgs, uint32 count) {
+    return replay(I2C_CAPTURE_TRANSFER, msgs, count);
+}
+
+status_t I2CReplayTransport::smbus(struct i2c_smbus_ioctl_data* data) {
+    // Solo la quick viene catturata
+    if (data->size != I2C_SMBUS_QUICK) {
+        return B_NOT_SUPPORTED;
+    }
+
+    struct i2c_msg msg;
+    msg.addr = f_address;
+    msg.flags = data->read_write == I2C_SMBUS_READ ? I2C_M_RD : 0;
+    msg.len = 0;
+    msg.buf = NULL;
+    return replay(I2C_CAPTURE_QUICK, &msg, 1);
+}
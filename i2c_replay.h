@@ -0,0 +1,60 @@
+#ifndef I2C_REPLAY_H
+#define I2C_REPLAY_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c_capture.h"
+#include "i2c_transport.h"
+
+// Bus virtuale che ripropone una cattura di I2CCapture. Ogni chiamata consuma il
+// record successivo: tipo, indirizzi, flag e lunghezze devono coincidere con
+// quelli registrati (i dati scritti non vengono confrontati), le letture
+// ricevono i dati catturati e lo stato restituito è quello originale.
+//
+// In modalità realtime ogni chiamata termina allo stesso istante relativo della
+// cattura, a partire dalla prima chiamata; altrimenti il replay procede alla
+// massima velocità. A fine cattura le chiamate restituiscono B_ENTRY_NOT_FOUND,
+// in caso di divergenza B_MISMATCHED_VALUES. Un record la cui dimensione non è
+// coerente con l'anello o con il proprio contenuto restituisce B_BAD_DATA e
+// ferma il replay.
+class I2CReplayTransport : public I2CTransport {
+public:
+    I2CReplayTransport(const char* path, bool realtime = true);
+    virtual ~I2CReplayTransport();
+
+    void set_realtime(bool realtime) { f_realtime = realtime; }
+
+    // Record riproposti e chiamate che non corrispondevano alla cattura
+    uint64 replayed() const { return f_replayed; }
+    uint64 mismatches() const { return f_mismatches; }
+    // Record non ancora consumati
+    bool at_end() const;
+
+    virtual status_t open();
+    virtual void close();
+    virtual uint32 functionality();
+    virtual uint32 speed();
+    virtual status_t set_address(uint8 address);
+    virtual status_t read(uint8* buffer, size_t length);
+    virtual status_t write(const uint8* data, size_t length);
+    virtual status_t transfer(struct i2c_msg* msgs, uint32 count);
+    virtual status_t smbus(struct i2c_smbus_ioctl_data* data);
+
+private:
+    char* f_path;
+    bool f_realtime;
+    const i2c_capture_header* f_header;
+    const uint8* f_ring;
+    size_t f_mapped_size;
+    uint64 f_position;
+    uint8 f_address;
+    nanotime_t f_base;      // istante del replay che corrisponde al tempo 0 della cattura
+    uint64 f_replayed;
+    uint64 f_mismatches;
+
+    status_t next_record(const i2c_capture_record** _record);
+    status_t replay(uint16 type, struct i2c_msg* msgs, uint32 count);
+    void wait_until(nanotime_t deadline);
+};
+
+#endif  // I2C_REPLAY_H
@@ -0,0 +1,428 @@
+#include "i2c_sampler.h"
+#include <stdio.h>
+#include <string.h>
+
+void I2CSampleSleep::await_suspend(std::coroutine_handle<> handle) {
+    f_sampler->push_timer(f_when, handle);
+}
+
+I2CSampleRead::I2CSampleRead(I2CSampler* sampler, int32 bus, uint8 address, uint8 reg,
+                             uint8* buffer, size_t length, status_t status)
+    : f_sampler(sampler), f_bus(bus), f_address(address), f_reg(reg), f_buffer(buffer),
+      f_length(length), f_handle(), f_next(NULL), f_index(-1) {
+    f_sample.status = status;
+    f_sample.timestamp = 0;
+}
+
+void I2CSampleRead::await_suspend(std::coroutine_handle<> handle) {
+    f_handle = handle;
+    f_sampler->enqueue_read(this);
+}
+
+I2CSamplePeriod::I2CSamplePeriod(I2CSampler& sampler, bigtime_t period, bigtime_t phase)
+    : f_sampler(sampler), f_period(period > 0 ? period : 1),
+      f_phase(phase % (period > 0 ? period : 1)), f_deadline(0), f_overruns(0) {
+}
+
+I2CSampleSleep I2CSamplePeriod::next() {
+    bigtime_t now = system_time();
+    if (f_deadline == 0) {
+        // Primo punto della griglia non ancora passato
+        bigtime_t elapsed = now - f_sampler.epoch() - f_phase;
+        bigtime_t periods = elapsed > 0 ? (elapsed + f_period - 1) / f_period : 0;
+        f_deadline = f_sampler.epoch() + f_phase + periods * f_period;
+    } else {
+        f_deadline += f_period;
+        if (f_deadline + f_period <= now) {
+            // Si resta sulla griglia: le letture restano allineate agli altri task
+            bigtime_t missed = (now - f_deadline) / f_period;
+            f_deadline += missed * f_period;
+            f_overruns += static_cast<uint32>(missed);
+        }
+    }
+    return f_sampler.wait_until(f_deadline);
+}
+
+I2CSampler::I2CSampler(uint32 max_tasks)
+    : f_bus_count(0), f_initialized(false), f_stopping(false), f_epoch(system_time()),
+      f_timers(NULL), f_timer_count(0), f_sequence(0),
+      f_max_tasks(max_tasks > 0 ? max_tasks : 1), f_inbox(NULL), f_inbox_count(0),
+      f_lock_count(0), f_lock_sem(-1), f_task_count(0), f_wake_sem(-1), f_worker(-1),
+      f_samples(0), f_batches(0), f_max_lateness(0) {
+    memset(f_buses, 0, sizeof(f_buses));
+
+    f_timers = new(std::nothrow) timer[f_max_tasks];
+    f_inbox = new(std::nothrow) std::coroutine_handle<>[f_max_tasks];
+    f_lock_sem = create_sem(0, "i2c sampler lock");
+}
+
+I2CSampler::~I2CSampler() {
+    if (f_initialized) {
+        deinit();
+    }
+    destroy_tasks();
+
+    for (uint32 i = 0; i < f_bus_count; i++) {
+        delete f_buses[i].bus;
+    }
+    delete_sem(f_lock_sem);
+    delete[] f_timers;
+    delete[] f_inbox;
+}
+
+int32 I2CSampler::add_entry(I2CBus* bus) {
+    if (bus == NULL) {
+        return B_NO_MEMORY;
+    }
+    if (f_initialized || f_bus_count == I2C_SAMPLER_MAX_BUSES) {
+        delete bus;
+        return f_initialized ? B_NOT_ALLOWED : B_NO_MEMORY;
+    }
+
+    bus_entry& entry = f_buses[f_bus_count];
+    entry.bus = bus;
+    entry.head = NULL;
+    entry.tail = NULL;
+    return f_bus_count++;
+}
+
+int32 I2CSampler::add_bus(int bus_number) {
+    return add_entry(new(std::nothrow) I2CBus(bus_number));
+}
+
+int32 I2CSampler::add_bus(I2CTransport* transport) {
+    if (transport == NULL) {
+        return B_BAD_VALUE;
+    }
+    return add_entry(new(std::nothrow) I2CBus(transport));
+}
+
+status_t I2CSampler::init(int32 priority) {
+    if (f_initialized) {
+        return B_OK;
+    }
+    if (f_timers == NULL || f_inbox == NULL) {
+        return B_NO_MEMORY;
+    }
+    if (f_lock_sem < B_OK) {
+        return B_NO_MORE_SEMS;
+    }
+
+    uint32 opened = 0;
+    status_t status = B_OK;
+    for (; opened < f_bus_count; opened++) {
+        status = f_buses[opened].bus->init();
+        if (status != B_OK) {
+            goto err;
+        }
+    }
+
+    f_wake_sem = create_sem(0, "i2c sampler wake");
+    if (f_wake_sem < B_OK) {
+        status = B_NO_MORE_SEMS;
+        goto err;
+    }
+
+    f_stopping = false;
+    f_worker = spawn_thread(worker_thread, "i2c sampler", priority, this);
+    if (f_worker < B_OK) {
+        status = f_worker;
+        goto err;
+    }
+    resume_thread(f_worker);
+
+    f_initialized = true;
+    return B_OK;
+
+err:
+    fprintf(stderr, "Errore nell'avviare il campionatore: %s\n", strerror(status));
+    delete_sem(f_wake_sem);
+    f_wake_sem = -1;
+    while (opened > 0) {
+        f_buses[--opened].bus->deinit();
+    }
+    return status;
+}
+
+status_t I2CSampler::deinit() {
+    if (!f_initialized) {
+        return B_OK;
+    }
+
+    f_stopping = true;
+    release_sem(f_wake_sem);
+
+    status_t result;
+    wait_for_thread(f_worker, &result);
+    f_worker = -1;
+    delete_sem(f_wake_sem);
+    f_wake_sem = -1;
+
+    destroy_tasks();
+    for (uint32 i = 0; i < f_bus_count; i++) {
+        f_buses[i].bus->deinit();
+    }
+    f_initialized = false;
+    return B_OK;
+}
+
+void I2CSampler::lock() {
+    if (atomic_add(&f_lock_count, 1) > 0) {
+        acquire_sem(f_lock_sem);
+    }
+}
+
+void I2CSampler::unlock() {
+    if (atomic_add(&f_lock_count, -1) > 1) {
+        release_sem(f_lock_sem);
+    }
+}
+
+status_t I2CSampler::spawn(I2CSampleTask task) {
+    if (!task.f_handle) {
+        return B_NO_MEMORY;
+    }
+    if (f_timers == NULL || f_inbox == NULL || f_lock_sem < B_OK) {
+        return B_NO_INIT;
+    }
+
+    // Ogni task occupa al più un timer: con max_tasks task il heap non si riempie
+    if (atomic_add(&f_task_count, 1) >= static_cast<int32>(f_max_tasks)) {
+        atomic_add(&f_task_count, -1);
+        return B_WOULD_BLOCK;
+    }
+
+    lock();
+    f_inbox[f_inbox_count++] = task.release();
+    unlock();
+
+    if (f_wake_sem >= B_OK) {
+        release_sem_etc(f_wake_sem, 1, B_DO_NOT_RESCHEDULE);
+    }
+    return B_OK;
+}
+
+I2CSampleRead I2CSampler::read_registers(int32 bus, uint8 address, uint8 reg, uint8* buffer,
+                                         size_t length) {
+    status_t status = B_OK;
+    if (bus < 0 || static_cast<uint32>(bus) >= f_bus_count) {
+        status = B_BAD_INDEX;
+    } else if (buffer == NULL || length == 0 || length > 0xFFFF) {
+        status = B_BAD_VALUE;
+    }
+    return I2CSampleRead(this, bus, address, reg, buffer, length, status);
+}
+
+void I2CSampler::reset_stats() {
+    atomic_set64(&f_samples, 0);
+    atomic_set64(&f_batches, 0);
+    atomic_set64(&f_max_lateness, 0);
+}
+
+static inline bool timer_before(bigtime_t when, uint64 sequence, bigtime_t other_when,
+                                uint64 other_sequence) {
+    return when < other_when || (when == other_when && sequence < other_sequence);
+}
+
+void I2CSampler::push_timer(bigtime_t when, std::coroutine_handle<> handle) {
+    uint32 index = f_timer_count++;
+    uint64 sequence = f_sequence++;
+    while (index > 0) {
+        uint32 parent = (index - 1) / 2;
+        if (!timer_before(when, sequence, f_timers[parent].when, f_timers[parent].sequence)) {
+            break;
+        }
+        f_timers[index] = f_timers[parent];
+        index = parent;
+    }
+    f_timers[index].when = when;
+    f_timers[index].sequence = sequence;
+    f_timers[index].handle = handle;
+}
+
+void I2CSampler::pop_timer() {
+    timer last = f_timers[--f_timer_count];
+    uint32 index = 0;
+    for (;;) {
+        uint32 child = 2 * index + 1;
+        if (child >= f_timer_count) {
+            break;
+        }
+        if (child + 1 < f_timer_count
+            && timer_before(f_timers[child + 1].when, f_timers[child + 1].sequence,
+                            f_timers[child].when, f_timers[child].sequence)) {
+            child++;
+        }
+        if (!timer_before(f_timers[child].when, f_timers[child].sequence,
+                          last.when, last.sequence)) {
+            break;
+        }
+        f_timers[index] = f_timers[child];
+        index = child;
+    }
+    if (f_timer_count > 0) {
+        f_timers[index] = last;
+    }
+}
+
+void I2CSampler::enqueue_read(I2CSampleRead* read) {
+    bus_entry& entry = f_buses[read->f_bus];
+    read->f_next = NULL;
+    if (entry.tail != NULL) {
+        entry.tail->f_next = read;
+    } else {
+        entry.head = read;
+    }
+    entry.tail = read;
+}
+
+void I2CSampler::resume(std::coroutine_handle<> handle) {
+    handle.resume();
+    if (handle.done()) {
+        handle.destroy();
+        atomic_add(&f_task_count, -1);
+    }
+}
+
+void I2CSampler::take_inbox() {
+    bigtime_t now = system_time();
+    lock();
+    for (uint32 i = 0; i < f_inbox_count; i++) {
+        push_timer(now, f_inbox[i]);
+    }
+    f_inbox_count = 0;
+    unlock();
+}
+
+void I2CSampler::run_timers() {
+    // I timer inseriti durante il giro (un task che attende un istante già
+    // passato) aspettano il giro successivo, dopo l'invio delle letture
+    bigtime_t now = system_time();
+    uint64 first_new = f_sequence;
+    bigtime_t lateness = 0;
+
+    while (f_timer_count > 0 && f_timers[0].when <= now && f_timers[0].sequence < first_new) {
+        timer current = f_timers[0];
+        pop_timer();
+        if (now - current.when > lateness) {
+            lateness = now - current.when;
+        }
+        resume(current.handle);
+    }
+
+    if (lateness > atomic_get64(&f_max_lateness)) {
+        atomic_set64(&f_max_lateness, lateness);
+    }
+}
+
+bool I2CSampler::flush_bus(bus_entry& entry) {
+    if (entry.head == NULL) {
+        return false;
+    }
+
+    // Le letture riprese possono accodarne altre: si stacca al più un lotto
+    // e si lascia il resto per il giro successivo
+    I2CSampleRead* batch = entry.head;
+    I2CSampleRead* last = batch;
+    f_transaction.clear();
+    last->f_index = f_transaction.add_read_registers(last->f_address, last->f_reg,
+                                                     last->f_buffer, last->f_length);
+    for (uint32 count = 1; count < I2C_SAMPLER_BATCH_MAX && last->f_next != NULL; count++) {
+        last = last->f_next;
+        last->f_index = f_transaction.add_read_registers(last->f_address, last->f_reg,
+                                                         last->f_buffer, last->f_length);
+    }
+    entry.head = last->f_next;
+    if (entry.head == NULL) {
+        entry.tail = NULL;
+    }
+    last->f_next = NULL;
+
+    bigtime_t start = system_time();
+    entry.bus->submit(f_transaction);
+    bigtime_t end = system_time();
+
+    // Timestamp di ogni lettura: inizio della transazione più il tempo sul filo
+    // fino alla sua fine, senza superare la fine della transazione
+    struct i2c_msg msgs[2];
+    msgs[0].len = 1;
+    msgs[0].buf = NULL;
+    msgs[1].buf = NULL;
+    nanotime_t wire = 0;
+    int64 samples = 0;
+    for (I2CSampleRead* read = batch; read != NULL; read = read->f_next) {
+        msgs[1].len = static_cast<uint16>(read->f_length);
+        wire += entry.bus->wire_time(msgs, 2);
+        bigtime_t timestamp = start + wire / 1000;
+        read->f_sample.timestamp = timestamp < end ? timestamp : end;
+        read->f_sample.status = read->f_index >= 0
+            ? f_transaction.status(read->f_index) : read->f_index;
+        samples++;
+    }
+    atomic_add64(&f_samples, samples);
+    atomic_add64(&f_batches, 1);
+
+    I2CSampleRead* read = batch;
+    while (read != NULL) {
+        // Il task ripreso può distruggere l'awaiter insieme al suo frame
+        I2CSampleRead* next = read->f_next;
+        resume(read->f_handle);
+        read = next;
+    }
+    return true;
+}
+
+void I2CSampler::destroy_tasks() {
+    for (uint32 i = 0; i < f_bus_count; i++) {
+        I2CSampleRead* read = f_buses[i].head;
+        while (read != NULL) {
+            I2CSampleRead* next = read->f_next;
+            read->f_handle.destroy();
+            read = next;
+        }
+        f_buses[i].head = NULL;
+        f_buses[i].tail = NULL;
+    }
+
+    for (uint32 i = 0; i < f_timer_count; i++) {
+        f_timers[i].handle.destroy();
+    }
+    f_timer_count = 0;
+
+    for (uint32 i = 0; i < f_inbox_count; i++) {
+        f_inbox[i].destroy();
+    }
+    f_inbox_count = 0;
+    atomic_set(&f_task_count, 0);
+}
+
+status_t I2CSampler::worker_thread(void* data) {
+    static_cast<I2CSampler*>(data)->worker_loop();
+    return B_OK;
+}
+
+void I2CSampler::worker_loop() {
+    while (!f_stopping) {
+        take_inbox();
+        run_timers();
+
+        // Un lotto per bus a ogni passata, finché i task ripresi chiedono letture
+        bool pending = true;
+        while (pending && !f_stopping) {
+            pending = false;
+            for (uint32 i = 0; i < f_bus_count; i++) {
+                pending |= flush_bus(f_buses[i]);
+            }
+        }
+
+        // Attesa fino alla prossima scadenza; spawn() e deinit() la interrompono
+        if (f_timer_count > 0) {
+            bigtime_t next = f_timers[0].when;
+            if (next > system_time()) {
+                acquire_sem_etc(f_wake_sem, 1, B_ABSOLUTE_TIMEOUT, next);
+            }
+        } else {
+            acquire_sem(f_wake_sem);
+        }
+    }
+}
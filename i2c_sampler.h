@@ -0,0 +1,264 @@
+#ifndef I2C_SAMPLER_H
+#define I2C_SAMPLER_H
+
+#include <OS.h>
+#include <stdint.h>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include "i2c.h"
+#include "i2c_transaction.h"
+
+// Richiede C++20 (coroutine): -std=c++20
+
+// Bus gestiti da un campionatore
+#define I2C_SAMPLER_MAX_BUSES 8
+// Task attivi contemporaneamente (dimensione della coda dei timer)
+#define I2C_SAMPLER_DEFAULT_MAX_TASKS 4096
+// Letture per transazione: ognuna occupa due messaggi (registro + dati)
+#define I2C_SAMPLER_BATCH_MAX (I2C_TRANSACTION_MAX_MESSAGES / 2)
+
+class I2CSampler;
+class I2CTransport;
+
+// Esito di una lettura: timestamp è l'istante (system_time()) stimato in cui
+// la lettura è terminata sul filo, ricavato dalla velocità del bus
+struct i2c_sample {
+    status_t status;
+    bigtime_t timestamp;
+};
+
+// Coroutine di campionamento. Parte sospesa e viene eseguita solo dal thread
+// del campionatore a cui è consegnata con spawn(); termina con co_return.
+// Se il frame non può essere allocato il task è vuoto e spawn() restituisce
+// B_NO_MEMORY.
+class I2CSampleTask {
+public:
+    struct promise_type {
+        I2CSampleTask get_return_object() noexcept {
+            return I2CSampleTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        static I2CSampleTask get_return_object_on_allocation_failure() noexcept {
+            return I2CSampleTask();
+        }
+        static void* operator new(size_t size) noexcept {
+            return ::operator new(size, std::nothrow);
+        }
+        static void operator delete(void* pointer) noexcept {
+            ::operator delete(pointer);
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        // Il frame viene distrutto dal campionatore quando il task termina
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    I2CSampleTask() : f_handle() {}
+    I2CSampleTask(I2CSampleTask&& other) noexcept : f_handle(other.f_handle) {
+        other.f_handle = nullptr;
+    }
+    ~I2CSampleTask() {
+        if (f_handle) {
+            f_handle.destroy();
+        }
+    }
+
+    I2CSampleTask(const I2CSampleTask&) = delete;
+    I2CSampleTask& operator=(const I2CSampleTask&) = delete;
+
+private:
+    friend class I2CSampler;
+
+    std::coroutine_handle<promise_type> f_handle;
+
+    explicit I2CSampleTask(std::coroutine_handle<promise_type> handle) : f_handle(handle) {}
+
+    std::coroutine_handle<> release() {
+        std::coroutine_handle<> handle = f_handle;
+        f_handle = nullptr;
+        return handle;
+    }
+};
+
+// co_await sampler.wait_until(t): riprende il task all'istante t
+class I2CSampleSleep {
+public:
+    I2CSampleSleep(I2CSampler* sampler, bigtime_t when) : f_sampler(sampler), f_when(when) {}
+
+    // Sospende sempre, anche se t è già passato: un task in ritardo non
+    // monopolizza il thread
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+
+private:
+    I2CSampler* f_sampler;
+    bigtime_t f_when;
+};
+
+// co_await sampler.read_registers(...): la lettura viene accodata e inviata
+// insieme alle altre dello stesso bus dovute nello stesso istante
+class I2CSampleRead {
+public:
+    bool await_ready() const noexcept { return f_sample.status != B_OK; }
+    void await_suspend(std::coroutine_handle<> handle);
+    i2c_sample await_resume() const noexcept { return f_sample; }
+
+private:
+    friend class I2CSampler;
+
+    I2CSampler* f_sampler;
+    int32 f_bus;
+    uint8 f_address;
+    uint8 f_reg;
+    uint8* f_buffer;
+    size_t f_length;
+    i2c_sample f_sample;
+    std::coroutine_handle<> f_handle;
+    I2CSampleRead* f_next;      // coda delle letture del bus
+    int32 f_index;              // messaggio di lettura nella transazione
+
+    I2CSampleRead(I2CSampler* sampler, int32 bus, uint8 address, uint8 reg, uint8* buffer,
+                  size_t length, status_t status);
+};
+
+// Scadenze periodiche senza deriva: ogni scadenza è la precedente più il
+// periodo, non l'istante del risveglio più il periodo. Le scadenze sono
+// allineate a una griglia comune del campionatore, quindi task con periodi
+// multipli l'uno dell'altro si risvegliano insieme e le loro letture finiscono
+// nella stessa transazione. I periodi ormai persi vengono saltati e contati.
+class I2CSamplePeriod {
+public:
+    I2CSamplePeriod(I2CSampler& sampler, bigtime_t period, bigtime_t phase = 0);
+
+    // co_await period.next()
+    I2CSampleSleep next();
+
+    // Scadenza corrente, riferimento per il campione appena letto
+    bigtime_t deadline() const { return f_deadline; }
+    uint32 overruns() const { return f_overruns; }
+
+private:
+    I2CSampler& f_sampler;
+    bigtime_t f_period;
+    bigtime_t f_phase;
+    bigtime_t f_deadline;   // 0 = prima scadenza non ancora calcolata
+    uint32 f_overruns;
+};
+
+// Campionatore periodico: un thread esegue migliaia di task di campionamento
+// scritti come coroutine. Il thread risveglia i task scaduti, raccoglie le
+// letture che chiedono, le invia con una transazione per bus (I2CBus::submit)
+// e riprende i task con il dato e il suo timestamp. I bus appartengono al
+// campionatore e vengono usati solo dal suo thread; per sfruttare due thread
+// (per esempio due bus lenti in parallelo) si usano due campionatori.
+//
+//   I2CSampleTask sample_temperature(I2CSampler& sampler, int32 bus) {
+//       I2CSamplePeriod period(sampler, 10000);     // 100 Hz
+//       uint8 data[2];
+//       for (;;) {
+//           co_await period.next();
+//           i2c_sample sample = co_await sampler.read_registers(bus, 0x48, 0x00, data, 2);
+//           ...
+//       }
+//   }
+//
+// I task non devono bloccare: ogni attesa passa da wait_until() o
+// read_registers().
+class I2CSampler {
+public:
+    I2CSampler(uint32 max_tasks = I2C_SAMPLER_DEFAULT_MAX_TASKS);
+    ~I2CSampler();
+
+    // Solo prima di init(); restituiscono l'indice del bus o un errore
+    int32 add_bus(int bus_number);
+    // Il trasporto resta del chiamante e deve sopravvivere al campionatore
+    int32 add_bus(I2CTransport* transport);
+
+    status_t init(int32 priority = B_URGENT_DISPLAY_PRIORITY);
+    // Distrugge i task ancora attivi; non va chiamata da un task
+    status_t deinit();
+
+    // Consegna un task, anche da altri thread e prima di init(); parte alla
+    // prossima iterazione del thread. B_WOULD_BLOCK se ci sono già max_tasks task.
+    status_t spawn(I2CSampleTask task);
+
+    // Awaitable, da usare solo nei task di questo campionatore
+    I2CSampleSleep wait_until(bigtime_t when) { return I2CSampleSleep(this, when); }
+    I2CSampleRead read_registers(int32 bus, uint8 address, uint8 reg, uint8* buffer,
+                                 size_t length);
+
+    // Origine della griglia delle scadenze periodiche
+    bigtime_t epoch() const { return f_epoch; }
+
+    int32 task_count() { return atomic_get(&f_task_count); }
+    int64 sample_count() { return atomic_get64(&f_samples); }
+    int64 batch_count() { return atomic_get64(&f_batches); }
+    // Ritardo massimo di un risveglio rispetto alla scadenza
+    bigtime_t max_lateness() { return atomic_get64(&f_max_lateness); }
+    void reset_stats();
+
+private:
+    friend class I2CSampleSleep;
+    friend class I2CSampleRead;
+
+    struct timer {
+        bigtime_t when;
+        uint64 sequence;    // a parità di istante, ordine di inserimento
+        std::coroutine_handle<> handle;
+    };
+
+    struct bus_entry {
+        I2CBus* bus;
+        I2CSampleRead* head;    // letture in attesa, in ordine di arrivo
+        I2CSampleRead* tail;
+    };
+
+    bus_entry f_buses[I2C_SAMPLER_MAX_BUSES];
+    uint32 f_bus_count;
+    bool f_initialized;
+    volatile bool f_stopping;
+    bigtime_t f_epoch;
+
+    // Min-heap dei task sospesi su un timer, usato solo dal thread
+    timer* f_timers;
+    uint32 f_timer_count;
+    uint64 f_sequence;
+    uint32 f_max_tasks;
+
+    // Task consegnati e non ancora presi dal thread, protetti dal benaphore
+    std::coroutine_handle<>* f_inbox;
+    uint32 f_inbox_count;
+    int32 f_lock_count;
+    sem_id f_lock_sem;
+
+    int32 f_task_count;
+    sem_id f_wake_sem;
+    thread_id f_worker;
+    I2CTransaction f_transaction;
+
+    int64 f_samples;
+    int64 f_batches;
+    int64 f_max_lateness;
+
+    int32 add_entry(I2CBus* bus);
+    void lock();
+    void unlock();
+
+    void push_timer(bigtime_t when, std::coroutine_handle<> handle);
+    void pop_timer();
+    void enqueue_read(I2CSampleRead* read);
+
+    void resume(std::coroutine_handle<> handle);
+    void take_inbox();
+    void run_timers();
+    bool flush_bus(bus_entry& entry);
+    void destroy_tasks();
+
+    static status_t worker_thread(void* data);
+    void worker_loop();
+};
+
+#endif  // I2C_SAMPLER_H
@@ -0,0 +1,252 @@
+#include "i2c_scan.h"
+#include "i2c_smbus.h"
+#include "i2c_transaction.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <new>
+
+static inline bool bitmap_test(const uint32* bitmap, uint8 address) {
+    return (bitmap[address / 32] & (1u << (address % 32))) != 0;
+}
+
+static inline void bitmap_set(uint32* bitmap, uint8 address) {
+    bitmap[address / 32] |= 1u << (address % 32);
+}
+
+I2CScanner::I2CScanner()
+    : f_count(0) {
+    memset(f_buses, 0, sizeof(f_buses));
+}
+
+I2CScanner::~I2CScanner() {
+    for (uint32 i = 0; i < f_count; i++) {
+        delete f_buses[i].bus;
+    }
+}
+
+int32 I2CScanner::add_entry(I2CBus* bus, int32 id) {
+    if (bus == NULL) {
+        return B_NO_MEMORY;
+    }
+    if (f_count == I2C_SCAN_MAX_BUSES) {
+        delete bus;
+        return B_NO_MEMORY;
+    }
+
+    bus_entry& entry = f_buses[f_count];
+    memset(&entry, 0, sizeof(entry));
+    entry.bus = bus;
+    entry.id = id;
+    entry.thread = -1;
+    return f_count++;
+}
+
+int32 I2CScanner::add_bus(int bus_number) {
+    return add_entry(new(std::nothrow) I2CBus(bus_number), bus_number);
+}
+
+int32 I2CScanner::add_bus(I2CTransport* transport, int32 id) {
+    if (transport == NULL) {
+        return B_BAD_VALUE;
+    }
+    return add_entry(new(std::nothrow) I2CBus(transport), id);
+}
+
+status_t I2CScanner::probe(I2CBus& bus, uint8 address, bool quick) {
+    // Come i2cdetect: una quick write può cambiare lo stato di alcune EEPROM
+    // (0x50-0x5F) e dei dispositivi a 0x30-0x37, lì si legge un byte
+    bool eeprom = (address >= 0x30 && address <= 0x37) || (address >= 0x50 && address <= 0x5F);
+    if (quick && !eeprom) {
+        I2CSMBus smbus(&bus);
+        return smbus.quick(address, false);
+    }
+
+    // Un solo messaggio: con I2C_RDWR basta una chiamata, senza I2C_SLAVE
+    uint8 value;
+    I2CTransaction transaction;
+    transaction.add_read(address, &value, 1);
+    return bus.submit(transaction);
+}
+
+void I2CScanner::scan_bus(bus_entry* entry) {
+    entry->probes = 0;
+    entry->status = entry->bus->init();
+    if (entry->status != B_OK) {
+        return;
+    }
+
+    bool quick = (entry->bus->functionality() & I2C_FUNC_SMBUS_QUICK) != 0;
+    uint32 candidates[4];
+    memcpy(candidates, entry->present, sizeof(candidates));
+    memset(entry->present, 0, sizeof(entry->present));
+
+    for (uint8 address = I2C_SCAN_FIRST_ADDRESS; address <= I2C_SCAN_LAST_ADDRESS; address++) {
+        if (entry->cached && !bitmap_test(candidates, address)) {
+            continue;
+        }
+        entry->probes++;
+        if (probe(*entry->bus, address, quick) == B_OK) {
+            bitmap_set(entry->present, address);
+        }
+    }
+
+    entry->bus->deinit();
+}
+
+status_t I2CScanner::scan_thread(void* data) {
+    scan_bus(static_cast<bus_entry*>(data));
+    return B_OK;
+}
+
+status_t I2CScanner::run() {
+    // Un thread per bus: i bus sono indipendenti, il tempo totale è quello del
+    // bus più lento. Se il thread non parte il bus viene sondato qui.
+    for (uint32 i = 0; i < f_count; i++) {
+        bus_entry& entry = f_buses[i];
+        entry.thread = f_count > 1
+            ? spawn_thread(scan_thread, "i2c scan", B_NORMAL_PRIORITY, &entry) : -1;
+        if (entry.thread >= B_OK) {
+            resume_thread(entry.thread);
+        } else {
+            scan_bus(&entry);
+        }
+    }
+
+    status_t status = B_OK;
+    for (uint32 i = 0; i < f_count; i++) {
+        bus_entry& entry = f_buses[i];
+        if (entry.thread >= B_OK) {
+            status_t result;
+            wait_for_thread(entry.thread, &result);
+            entry.thread = -1;
+        }
+        // Il risultato della cache non vale più: la prossima scansione è completa
+        entry.cached = false;
+        if (entry.status != B_OK && status == B_OK) {
+            status = entry.status;
+        }
+    }
+    return status;
+}
+
+status_t I2CScanner::scan() {
+    for (uint32 i = 0; i < f_count; i++) {
+        f_buses[i].cached = false;
+    }
+    return run();
+}
+
+status_t I2CScanner::discover(const char* cache_path) {
+    if (cache_path == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    // Senza cache (o con una cache non valida) tutti i bus vengono sondati per intero
+    load_cache(cache_path);
+
+    status_t status = run();
+    if (status != B_OK) {
+        return status;
+    }
+    return save_cache(cache_path);
+}
+
+status_t I2CScanner::load_cache(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return B_ENTRY_NOT_FOUND;
+    }
+
+    i2c_scan_cache_header header;
+    i2c_scan_cache_entry entries[I2C_SCAN_MAX_BUSES];
+    status_t status = B_OK;
+    ssize_t bytes_read = ::read(fd, &header, sizeof(header));
+    if (bytes_read != sizeof(header) || header.magic != I2C_SCAN_CACHE_MAGIC
+        || header.version != I2C_SCAN_CACHE_VERSION || header.count > I2C_SCAN_MAX_BUSES) {
+        status = B_BAD_DATA;
+    } else {
+        ssize_t size = header.count * sizeof(i2c_scan_cache_entry);
+        if (::read(fd, entries, size) != size) {
+            status = B_BAD_DATA;
+        }
+    }
+    ::close(fd);
+    if (status != B_OK) {
+        return status;
+    }
+
+    for (uint32 i = 0; i < f_count; i++) {
+        bus_entry& entry = f_buses[i];
+        for (uint32 j = 0; j < header.count; j++) {
+            if (entries[j].id == entry.id) {
+                memcpy(entry.present, entries[j].present, sizeof(entry.present));
+                entry.cached = true;
+                break;
+            }
+        }
+    }
+    return B_OK;
+}
+
+status_t I2CScanner::save_cache(const char* path) const {
+    i2c_scan_cache_header header;
+    header.magic = I2C_SCAN_CACHE_MAGIC;
+    header.version = I2C_SCAN_CACHE_VERSION;
+    header.count = f_count;
+
+    i2c_scan_cache_entry entries[I2C_SCAN_MAX_BUSES];
+    for (uint32 i = 0; i < f_count; i++) {
+        entries[i].id = f_buses[i].id;
+        memcpy(entries[i].present, f_buses[i].present, sizeof(entries[i].present));
+    }
+
+    // Scrittura su un file temporaneo e rename: un'interruzione non lascia mai
+    // una cache a metà
+    char temporary[PATH_MAX];
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary)) {
+        return B_NAME_TOO_LONG;
+    }
+
+    int fd = ::open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        int error = errno;
+        fprintf(stderr, "Errore nel creare %s: %s\n", temporary, strerror(error));
+        return B_IO_ERROR;
+    }
+
+    ssize_t size = f_count * sizeof(i2c_scan_cache_entry);
+    bool written = ::write(fd, &header, sizeof(header)) == sizeof(header)
+        && ::write(fd, entries, size) == size;
+    ::close(fd);
+    if (!written || rename(temporary, path) != 0) {
+        int error = errno;
+        fprintf(stderr, "Errore nel salvare %s: %s\n", path, strerror(error));
+        unlink(temporary);
+        return B_IO_ERROR;
+    }
+    return B_OK;
+}
+
+bool I2CScanner::is_present(uint32 index, uint8 address) const {
+    return index < f_count && address <= 0x7F && bitmap_test(f_buses[index].present, address);
+}
+
+uint32 I2CScanner::device_count(uint32 index) const {
+    if (index >= f_count) {
+        return 0;
+    }
+
+    uint32 count = 0;
+    for (int i = 0; i < 4; i++) {
+        count += __builtin_popcount(f_buses[index].present[i]);
+    }
+    return count;
+}
+
+uint32 I2CScanner::probe_count(uint32 index) const {
+    return index < f_count ? f_buses[index].probes : 0;
+}
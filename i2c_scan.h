@@ -0,0 +1,85 @@
+#ifndef I2C_SCAN_H
+#define I2C_SCAN_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+
+// Indirizzi a 7 bit sondati (gli altri sono riservati dalla specifica)
+#define I2C_SCAN_FIRST_ADDRESS 0x08
+#define I2C_SCAN_LAST_ADDRESS  0x77
+#define I2C_SCAN_MAX_BUSES     16
+
+// File di cache: un'intestazione e 20 byte per bus (identificativo e bitmap dei
+// 128 indirizzi), nell'ordine dei byte della macchina che l'ha scritto
+#define I2C_SCAN_CACHE_MAGIC   0x54433249  // "I2CT"
+#define I2C_SCAN_CACHE_VERSION 1
+
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 count;
+} i2c_scan_cache_header;
+
+typedef struct {
+    int32 id;
+    uint32 present[4];
+} i2c_scan_cache_entry;
+
+// Rilevamento dei dispositivi su uno o più bus. Ogni indirizzo viene sondato con
+// l'operazione più economica: una quick write se l'adattatore la supporta
+// (tranne negli intervalli delle EEPROM, come fa i2cdetect), altrimenti la
+// lettura di un byte. I bus vengono sondati in parallelo, un thread ciascuno.
+//
+// discover() usa la cache su disco: per i bus già noti sonda solo gli indirizzi
+// salvati, quindi il costo cresce con il numero di dispositivi e non con lo
+// spazio degli indirizzi. Un dispositivo aggiunto dopo il salvataggio compare
+// solo con una scan() completa.
+class I2CScanner {
+public:
+    I2CScanner();
+    ~I2CScanner();
+
+    // Restituisce l'indice del bus (o un errore negativo)
+    int32 add_bus(int bus_number);
+    // Il trasporto resta del chiamante; id identifica il bus nella cache
+    int32 add_bus(I2CTransport* transport, int32 id);
+
+    // Scansione completa di tutti i bus
+    status_t scan();
+    // Avvio rapido dalla cache, con scansione completa dei bus non presenti;
+    // al termine la cache viene riscritta
+    status_t discover(const char* cache_path);
+
+    status_t load_cache(const char* path);
+    status_t save_cache(const char* path) const;
+
+    uint32 bus_count() const { return f_count; }
+    bool is_present(uint32 index, uint8 address) const;
+    uint32 device_count(uint32 index) const;
+    // Sonde inviate sul bus nell'ultima scan() o discover()
+    uint32 probe_count(uint32 index) const;
+
+private:
+    struct bus_entry {
+        I2CBus* bus;
+        int32 id;
+        bool cached;            // present[] viene dalla cache
+        uint32 present[4];
+        uint32 probes;
+        status_t status;
+        thread_id thread;
+    };
+
+    bus_entry f_buses[I2C_SCAN_MAX_BUSES];
+    uint32 f_count;
+
+    int32 add_entry(I2CBus* bus, int32 id);
+    status_t run();
+
+    static status_t scan_thread(void* data);
+    static void scan_bus(bus_entry* entry);
+    static status_t probe(I2CBus& bus, uint8 address, bool quick);
+};
+
+#endif  // I2C_SCAN_H
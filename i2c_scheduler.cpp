@@ -0,0 +1,286 @@
+#include "i2c_scheduler.h"
+#include "i2c_transaction.h"
+#include <stdio.h>
+#include <string.h>
+#include <new>
+
+static const bigtime_t kDefaultDeadline[] = {
+    I2C_SCHEDULER_URGENT_DEADLINE,
+    I2C_SCHEDULER_NORMAL_DEADLINE,
+    I2C_SCHEDULER_BULK_DEADLINE
+};
+
+I2CScheduler::I2CScheduler(int bus_number, uint32 queue_size)
+    : f_bus(bus_number), f_initialized(false), f_stopping(false),
+      f_jobs(NULL), f_queue_size(queue_size > 0 ? queue_size : 1), f_sequence(0),
+      f_slice(I2C_SCHEDULER_DEFAULT_SLICE), f_pending_speed(0), f_missed(0),
+      f_free_sem(-1), f_pending_sem(-1), f_lock_count(0), f_lock_sem(-1), f_worker(-1) {
+}
+
+I2CScheduler::I2CScheduler(I2CTransport* transport, uint32 queue_size)
+    : f_bus(transport), f_initialized(false), f_stopping(false),
+      f_jobs(NULL), f_queue_size(queue_size > 0 ? queue_size : 1), f_sequence(0),
+      f_slice(I2C_SCHEDULER_DEFAULT_SLICE), f_pending_speed(0), f_missed(0),
+      f_free_sem(-1), f_pending_sem(-1), f_lock_count(0), f_lock_sem(-1), f_worker(-1) {
+}
+
+I2CScheduler::~I2CScheduler() {
+    if (f_initialized) {
+        deinit();
+    }
+}
+
+status_t I2CScheduler::init() {
+    if (f_initialized) {
+        return B_OK;
+    }
+
+    status_t status = f_bus.init();
+    if (status != B_OK) {
+        return status;
+    }
+
+    f_jobs = new(std::nothrow) job[f_queue_size];
+    f_free_sem = create_sem(f_queue_size, "i2c scheduler free");
+    f_pending_sem = create_sem(0, "i2c scheduler pending");
+    f_lock_sem = create_sem(0, "i2c scheduler lock");
+    if (f_jobs == NULL || f_free_sem < B_OK || f_pending_sem < B_OK || f_lock_sem < B_OK) {
+        status = f_jobs == NULL ? B_NO_MEMORY : B_NO_MORE_SEMS;
+        goto err;
+    }
+
+    memset(f_jobs, 0, f_queue_size * sizeof(job));
+    f_stopping = false;
+    f_worker = spawn_thread(worker_thread, "i2c scheduler", B_DISPLAY_PRIORITY, this);
+    if (f_worker < B_OK) {
+        status = f_worker;
+        goto err;
+    }
+    resume_thread(f_worker);
+
+    f_initialized = true;
+    return B_OK;
+
+err:
+    fprintf(stderr, "Errore nell'avviare lo scheduler del bus: %s\n", strerror(status));
+    delete_sem(f_free_sem);
+    delete_sem(f_pending_sem);
+    delete_sem(f_lock_sem);
+    delete[] f_jobs;
+    f_jobs = NULL;
+    f_bus.deinit();
+    return status;
+}
+
+status_t I2CScheduler::deinit() {
+    if (!f_initialized) {
+        return B_OK;
+    }
+
+    // f_stopping cambia sotto il lock dei produttori: chi accoda dopo lo vede e
+    // rinuncia. L'unità in più fa uscire il thread dopo aver completato i lavori
+    // in coda
+    lock();
+    f_stopping = true;
+    unlock();
+    release_sem(f_pending_sem);
+
+    status_t result;
+    wait_for_thread(f_worker, &result);
+
+    // Se il thread è uscito prima di un lavoro accodato nessuno resta in attesa
+    for (uint32 i = 0; i < f_queue_size; i++) {
+        if (f_jobs[i].used) {
+            f_jobs[i].used = false;
+            if (f_jobs[i].future != NULL) {
+                f_jobs[i].future->complete(B_CANCELED);
+            }
+        }
+    }
+
+    delete_sem(f_free_sem);
+    delete_sem(f_pending_sem);
+    delete_sem(f_lock_sem);
+    delete[] f_jobs;
+    f_jobs = NULL;
+
+    f_bus.deinit();
+    f_initialized = false;
+    return B_OK;
+}
+
+void I2CScheduler::lock() {
+    if (atomic_add(&f_lock_count, 1) > 0) {
+        acquire_sem(f_lock_sem);
+    }
+}
+
+void I2CScheduler::unlock() {
+    if (atomic_add(&f_lock_count, -1) > 1) {
+        release_sem(f_lock_sem);
+    }
+}
+
+status_t I2CScheduler::submit(I2CTransaction* transaction, i2c_priority priority,
+                              I2CAsyncFuture* future, bigtime_t deadline,
+                              bigtime_t timeout) {
+    if (!f_initialized || f_stopping) {
+        return B_NO_INIT;
+    }
+    if (transaction == NULL || priority < I2C_PRIORITY_URGENT
+        || priority > I2C_PRIORITY_BULK) {
+        return B_BAD_VALUE;
+    }
+
+    if (deadline == 0) {
+        deadline = system_time() + kDefaultDeadline[priority];
+    }
+
+    // Contropressione: si attende uno slot libero
+    status_t status;
+    if (timeout == B_INFINITE_TIMEOUT) {
+        status = acquire_sem(f_free_sem);
+    } else {
+        status = acquire_sem_etc(f_free_sem, 1, B_RELATIVE_TIMEOUT, timeout);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    // Controllo e inserimento sotto lo stesso lock: dopo deinit nulla entra più
+    // in coda, e un lavoro accettato viene sempre completato
+    lock();
+    if (f_stopping) {
+        unlock();
+        release_sem(f_free_sem);
+        return B_NO_INIT;
+    }
+    if (future != NULL) {
+        future->f_status = B_BUSY;
+    }
+    // Il semaforo garantisce che almeno uno slot sia libero
+    job* slot = f_jobs;
+    while (slot->used) {
+        slot++;
+    }
+    slot->transaction = transaction;
+    slot->future = future;
+    slot->deadline = deadline;
+    slot->sequence = f_sequence++;
+    slot->next = 0;
+    slot->status = B_OK;
+    slot->priority = priority;
+    slot->used = true;
+    unlock();
+
+    release_sem(f_pending_sem);
+    return B_OK;
+}
+
+status_t I2CScheduler::set_speed(uint32 speed) {
+    if (speed == 0 || speed > 0x7FFFFFFF) {
+        return B_BAD_VALUE;
+    }
+    atomic_set(&f_pending_speed, static_cast<int32>(speed));
+    return B_OK;
+}
+
+I2CScheduler::job* I2CScheduler::pick() {
+    // La coda è corta (queue_size slot): una scansione lineare costa meno di un
+    // heap da mantenere ogni volta che una fetta lascia il lavoro in coda
+    job* best = NULL;
+    for (uint32 i = 0; i < f_queue_size; i++) {
+        job* candidate = &f_jobs[i];
+        if (!candidate->used) {
+            continue;
+        }
+        if (best == NULL || candidate->deadline < best->deadline
+            || (candidate->deadline == best->deadline
+                && (candidate->priority < best->priority
+                    || (candidate->priority == best->priority
+                        && candidate->sequence < best->sequence)))) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+uint32 I2CScheduler::slice_end(const job& current) {
+    I2CTransaction& transaction = *current.transaction;
+    uint32 count = transaction.f_count;
+
+    // Almeno un gruppo intero, poi altri gruppi finché restano nella fetta
+    nanotime_t budget = atomic_get64(&f_slice) * 1000;
+    uint32 end = transaction.group_end(current.next);
+    nanotime_t used = f_bus.wire_time(&transaction.f_msgs[current.next], end - current.next);
+    while (end < count) {
+        uint32 next = transaction.group_end(end);
+        nanotime_t more = f_bus.wire_time(&transaction.f_msgs[end], next - end);
+        if (used + more > budget) {
+            break;
+        }
+        used += more;
+        end = next;
+    }
+    return end;
+}
+
+status_t I2CScheduler::worker_thread(void* data) {
+    static_cast<I2CScheduler*>(data)->worker_loop();
+    return B_OK;
+}
+
+void I2CScheduler::worker_loop() {
+    // Ogni unità di f_pending_sem corrisponde a un lavoro in coda: il thread ne
+    // prende una e la restituisce completando un lavoro, anche se non quello che
+    // aveva in testa quando l'ha presa
+    while (acquire_sem(f_pending_sem) == B_OK) {
+        while (true) {
+            int32 speed = atomic_get_and_set(&f_pending_speed, 0);
+            if (speed > 0) {
+                f_bus.set_speed(static_cast<uint32>(speed));
+            }
+
+            lock();
+            job* current = pick();
+            unlock();
+            if (current == NULL) {
+                // Solo l'unità di uscita non ha un lavoro associato
+                if (f_stopping) {
+                    return;
+                }
+                break;
+            }
+
+            // Solo questo thread modifica un lavoro già accodato: niente lock
+            uint32 count = current->transaction->f_count;
+            if (current->next < count) {
+                uint32 end = slice_end(*current);
+                status_t status = f_bus.submit(*current->transaction, current->next, end);
+                if (status != B_OK && current->status == B_OK) {
+                    current->status = status;
+                }
+                current->next = end;
+                if (end < count) {
+                    continue;
+                }
+            }
+
+            if (system_time() > current->deadline) {
+                atomic_add64(&f_missed, 1);
+            }
+
+            I2CAsyncFuture* future = current->future;
+            status_t status = current->status;
+            lock();
+            current->used = false;
+            unlock();
+            release_sem(f_free_sem);
+
+            if (future != NULL) {
+                future->complete(status);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef I2C_SCHEDULER_H
+#define I2C_SCHEDULER_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+#include "i2c_async.h"
+
+class I2CTransaction;
+
+enum i2c_priority {
+    I2C_PRIORITY_URGENT,    // letture interattive (touch, eventi)
+    I2C_PRIORITY_NORMAL,
+    I2C_PRIORITY_BULK       // dump e aggiornamenti di firmware
+};
+
+// Scadenza predefinita di ogni classe, in µs dalla sottomissione
+#define I2C_SCHEDULER_URGENT_DEADLINE 2000
+#define I2C_SCHEDULER_NORMAL_DEADLINE 50000
+#define I2C_SCHEDULER_BULK_DEADLINE   1000000
+
+// Tempo sul filo massimo (µs) di una fetta di transazione prima di ricontrollare la coda
+#define I2C_SCHEDULER_DEFAULT_SLICE 1000
+
+// Front end asincrono che ordina le transazioni per scadenza (earliest deadline
+// first) invece che per arrivo. La classe di priorità fissa la scadenza
+// predefinita; una scadenza esplicita la sostituisce. A parità di scadenza passa
+// la classe più urgente, poi l'ordine di arrivo. Le transazioni lunghe vengono
+// eseguite a fette di al più 'slice' µs sul filo, stimati dalla velocità del bus,
+// spezzandole tra un gruppo di messaggi e l'altro: una lettura urgente attende al
+// massimo una fetta. Anche il lavoro meno urgente arriva prima o poi a scadenza,
+// quindi non resta mai escluso. Dopo deinit() submit() restituisce B_NO_INIT;
+// un lavoro accettato viene sempre completato, con B_CANCELED se il thread non
+// ha potuto eseguirlo.
+class I2CScheduler {
+public:
+    I2CScheduler(int bus_number, uint32 queue_size = I2C_ASYNC_DEFAULT_QUEUE_SIZE);
+    I2CScheduler(I2CTransport* transport, uint32 queue_size = I2C_ASYNC_DEFAULT_QUEUE_SIZE);
+    ~I2CScheduler();
+
+    status_t init();
+    status_t deinit();
+
+    // La transazione e la future appartengono al chiamante e restano in uso fino
+    // al completamento della future, anche dopo un timeout di wait().
+    // deadline è un istante assoluto di system_time() (0 = predefinita della classe).
+    status_t submit(I2CTransaction* transaction, i2c_priority priority,
+                    I2CAsyncFuture* future, bigtime_t deadline = 0,
+                    bigtime_t timeout = B_INFINITE_TIMEOUT);
+
+    // Applicata dal thread del bus prima della fetta successiva
+    status_t set_speed(uint32 speed);
+    void set_slice(bigtime_t slice) { atomic_set64(&f_slice, slice > 0 ? slice : 1); }
+
+    // Transazioni completate dopo la propria scadenza
+    int64 missed_deadlines() { return atomic_get64(&f_missed); }
+
+private:
+    struct job {
+        I2CTransaction* transaction;
+        I2CAsyncFuture* future;
+        bigtime_t deadline;
+        uint64 sequence;    // ordine di arrivo, a parità di scadenza
+        uint32 next;        // primo messaggio non ancora inviato
+        status_t status;    // primo errore incontrato
+        i2c_priority priority;
+        bool used;
+    };
+
+    I2CBus f_bus;
+    bool f_initialized;
+    volatile bool f_stopping;
+
+    job* f_jobs;
+    uint32 f_queue_size;
+    uint64 f_sequence;
+    int64 f_slice;          // µs, letto dal thread del bus
+    int32 f_pending_speed;  // 0 = nessun cambio in sospeso
+    int64 f_missed;
+
+    sem_id f_free_sem;      // slot liberi (contropressione)
+    sem_id f_pending_sem;   // transazioni da completare
+    int32 f_lock_count;     // benaphore sulla tabella dei lavori
+    sem_id f_lock_sem;
+    thread_id f_worker;
+
+    void lock();
+    void unlock();
+    job* pick();
+    uint32 slice_end(const job& current);
+
+    static status_t worker_thread(void* data);
+    void worker_loop();
+};
+
+#endif  // I2C_SCHEDULER_H
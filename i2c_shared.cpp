@@ -0,0 +1,242 @@
+#include "i2c_shared.h"
+#include "i2c_transaction.h"
+#include <stdio.h>
+#include <string.h>
+
+// Semaforo di attesa del thread chiamante, creato al primo uso
+struct thread_wait_sem {
+    sem_id sem;
+
+    thread_wait_sem() : sem(create_sem(0, "i2c shared wait")) {}
+    ~thread_wait_sem() {
+        if (sem >= B_OK) {
+            delete_sem(sem);
+        }
+    }
+};
+
+static thread_local thread_wait_sem sWaitSem;
+
+I2CSharedBus::I2CSharedBus(int bus_number)
+    : f_bus(bus_number), f_pending_sem(-1), f_consumer(-1), f_running(false), f_stopping(0),
+      f_producers(0), f_initialized(false) {
+}
+
+I2CSharedBus::I2CSharedBus(I2CTransport* transport)
+    : f_bus(transport), f_pending_sem(-1), f_consumer(-1), f_running(false), f_stopping(0),
+      f_producers(0), f_initialized(false) {
+}
+
+I2CSharedBus::~I2CSharedBus() {
+    if (f_initialized) {
+        deinit();
+    }
+}
+
+status_t I2CSharedBus::init() {
+    if (f_initialized) {
+        return B_OK;
+    }
+
+    status_t status = f_bus.init();
+    if (status != B_OK) {
+        return status;
+    }
+
+    f_pending_sem = create_sem(0, "i2c shared pending");
+    if (f_pending_sem < B_OK) {
+        f_bus.deinit();
+        return f_pending_sem;
+    }
+
+    f_running = true;
+    atomic_set(&f_stopping, 0);
+    f_consumer = spawn_thread(consumer_thread, "i2c shared consumer", B_DISPLAY_PRIORITY,
+                              this);
+    if (f_consumer < B_OK) {
+        fprintf(stderr, "Errore nell'avviare il bus condiviso: %s\n", strerror(f_consumer));
+        f_running = false;
+        delete_sem(f_pending_sem);
+        f_bus.deinit();
+        return f_consumer;
+    }
+    resume_thread(f_consumer);
+
+    f_initialized = true;
+    return B_OK;
+}
+
+status_t I2CSharedBus::deinit() {
+    if (!f_initialized) {
+        return B_OK;
+    }
+
+    // Prima si chiude l'ingresso e si attende chi sta già accodando: l'unità
+    // di uscita arriva dopo l'ultimo nodo, e le richieste già accodate vengono
+    // completate prima dell'uscita
+    atomic_set(&f_stopping, 1);
+    while (atomic_get(&f_producers) != 0) {
+        snooze(I2C_SHARED_POP_DELAY);
+    }
+    f_running = false;
+    release_sem(f_pending_sem);
+
+    status_t result;
+    wait_for_thread(f_consumer, &result);
+
+    // Se il consumatore è uscito prima del tempo nessuno resta in attesa
+    i2c_mpsc_node* node;
+    while ((node = f_queue.pop()) != NULL) {
+        request* current = static_cast<request*>(node);
+        current->status = B_CANCELED;
+        release_sem(current->done);
+    }
+    delete_sem(f_pending_sem);
+
+    f_bus.deinit();
+    f_initialized = false;
+    return B_OK;
+}
+
+status_t I2CSharedBus::execute(i2c_async_request& op) {
+    if (!f_initialized) {
+        return B_NO_INIT;
+    }
+    if (sWaitSem.sem < B_OK) {
+        return sWaitSem.sem;
+    }
+
+    request node;
+    node.op = op;
+    node.done = sWaitSem.sem;
+    node.status = B_BUSY;
+
+    // Il contatore fa da lock senza bloccare: deinit() imposta f_stopping e
+    // attende che scenda a zero, quindi un nodo accodato è sempre visto dal
+    // consumatore o dal drenaggio finale
+    atomic_add(&f_producers, 1);
+    if (atomic_get(&f_stopping) != 0) {
+        atomic_add(&f_producers, -1);
+        return B_NO_INIT;
+    }
+    f_queue.push(&node);
+    release_sem(f_pending_sem);
+    atomic_add(&f_producers, -1);
+
+    // Il nodo vive sullo stack: si esce solo dopo il completamento
+    status_t status;
+    do {
+        status = acquire_sem(node.done);
+    } while (status == B_INTERRUPTED);
+
+    return status == B_OK ? node.status : status;
+}
+
+status_t I2CSharedBus::consumer_thread(void* data) {
+    static_cast<I2CSharedBus*>(data)->consumer_loop();
+    return B_OK;
+}
+
+void I2CSharedBus::consumer_loop() {
+    while (acquire_sem(f_pending_sem) == B_OK) {
+        i2c_mpsc_node* node = f_queue.pop();
+        if (node == NULL) {
+            if (!f_running) {
+                // Unità di uscita: la coda è vuota, si può terminare
+                break;
+            }
+            node = wait_pop();
+        }
+
+        request* current = static_cast<request*>(node);
+        current->status = i2c_execute_request(f_bus, current->op);
+        release_sem(current->done);
+    }
+}
+
+// Il semaforo garantisce un nodo, ma un produttore può essere tra lo scambio
+// e il collegamento: qualche tentativo a vuoto, poi si cede la CPU tra uno e
+// l'altro invece di girare
+i2c_mpsc_node* I2CSharedBus::wait_pop() {
+    for (uint32 spins = 0;; spins++) {
+        i2c_mpsc_node* node = f_queue.pop();
+        if (node != NULL) {
+            return node;
+        }
+        if (spins >= I2C_SHARED_POP_SPINS) {
+            snooze(I2C_SHARED_POP_DELAY);
+        }
+    }
+}
+
+status_t I2CSharedBus::write(uint8 address, const uint8* data, size_t length) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_WRITE;
+    op.address = address;
+    op.data = data;
+    op.length = length;
+    return execute(op);
+}
+
+status_t I2CSharedBus::read(uint8 address, uint8* buffer, size_t length) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_READ;
+    op.address = address;
+    op.buffer = buffer;
+    op.length = length;
+    return execute(op);
+}
+
+status_t I2CSharedBus::write_register(uint8 address, uint8 reg, uint8 data) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_WRITE_REGISTER;
+    op.address = address;
+    op.reg = reg;
+    op.value = data;
+    return execute(op);
+}
+
+status_t I2CSharedBus::read_register(uint8 address, uint8 reg, uint8* data) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_READ_REGISTER;
+    op.address = address;
+    op.reg = reg;
+    op.buffer = data;
+    op.length = 1;
+    return execute(op);
+}
+
+status_t I2CSharedBus::write_registers(uint8 address, uint8 reg, const uint8* data,
+                                       size_t length) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_WRITE_REGISTERS;
+    op.address = address;
+    op.reg = reg;
+    op.data = data;
+    op.length = length;
+    return execute(op);
+}
+
+status_t I2CSharedBus::read_registers(uint8 address, uint8 reg, uint8* data, size_t length) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_READ_REGISTERS;
+    op.address = address;
+    op.reg = reg;
+    op.buffer = data;
+    op.length = length;
+    return execute(op);
+}
+
+status_t I2CSharedBus::submit(I2CTransaction& transaction) {
+    i2c_async_request op;
+    memset(&op, 0, sizeof(op));
+    op.op = I2C_ASYNC_TRANSACTION;
+    op.transaction = &transaction;
+    return execute(op);
+}
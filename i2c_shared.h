@@ -0,0 +1,68 @@
+#ifndef I2C_SHARED_H
+#define I2C_SHARED_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+#include "i2c_async.h"
+#include "i2c_mpsc_queue.h"
+
+// Tentativi a vuoto del consumatore prima di cedere la CPU, e pausa tra un
+// tentativo e l'altro (µs) mentre un produttore completa il collegamento
+#define I2C_SHARED_POP_SPINS 64
+#define I2C_SHARED_POP_DELAY 10
+
+// I2CBus condivisibile tra thread. Ogni chiamata diventa una richiesta accodata
+// senza lock in una coda MPSC; un unico thread consumatore le esegue una alla
+// volta, per intero (cambio di indirizzo e trasferimento non si mescolano mai
+// con quelli di altri thread). Il chiamante attende sul proprio semaforo di
+// thread: nessun produttore resta bloccato su un lock durante un trasferimento.
+// Dopo deinit() le chiamate restituiscono B_NO_INIT; le richieste rimaste in
+// coda all'uscita del consumatore vengono completate con B_CANCELED.
+class I2CSharedBus {
+public:
+    I2CSharedBus(int bus_number);
+    I2CSharedBus(I2CTransport* transport);
+    ~I2CSharedBus();
+
+    status_t init();
+    status_t deinit();
+
+    status_t write(uint8 address, const uint8* data, size_t length);
+    status_t read(uint8 address, uint8* buffer, size_t length);
+
+    status_t write_register(uint8 address, uint8 reg, uint8 data);
+    status_t read_register(uint8 address, uint8 reg, uint8* data);
+
+    status_t write_registers(uint8 address, uint8 reg, const uint8* data, size_t length);
+    status_t read_registers(uint8 address, uint8 reg, uint8* data, size_t length);
+
+    status_t submit(I2CTransaction& transaction);
+
+    // Le statistiche sono già atomiche: lettura diretta
+    void get_stats(i2c_bus_stats* stats) const { f_bus.get_stats(stats); }
+
+private:
+    struct request : i2c_mpsc_node {
+        i2c_async_request op;
+        sem_id done;
+        status_t status;
+    };
+
+    I2CBus f_bus;
+    I2CMPSCQueue f_queue;
+    sem_id f_pending_sem;
+    thread_id f_consumer;
+    volatile bool f_running;
+    int32 f_stopping;           // impostato da deinit(), letto dai produttori
+    int32 f_producers;          // produttori tra il controllo e l'accodamento
+    bool f_initialized;
+
+    status_t execute(i2c_async_request& op);
+
+    i2c_mpsc_node* wait_pop();
+    static status_t consumer_thread(void* data);
+    void consumer_loop();
+};
+
+#endif  // I2C_SHARED_H
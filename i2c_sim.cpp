@@ -0,0 +1,292 @@
+#include "i2c_sim.h"
+#include "i2c.h"
+#include <string.h>
+
+// Bit per byte sul filo: 8 di dati più ACK/NACK
+#define I2C_SIM_BITS_PER_BYTE 9
+// Sotto questa soglia (µs) l'attesa avviene in busy-wait: snooze non è abbastanza preciso
+#define I2C_SIM_DEFAULT_SPIN_THRESHOLD 200
+// Dati massimi di un blocco SMBus letto con I2C_M_RECV_LEN
+#define I2C_SIM_BLOCK_MAX 32
+
+I2CSimRegisterDevice::I2CSimRegisterDevice()
+    : f_pointer(0), f_pointer_pending(false), f_fail_count(0), f_stretch(0),
+      f_read_hook(NULL), f_read_cookie(NULL), f_write_hook(NULL), f_write_cookie(NULL) {
+    memset(f_registers, 0, sizeof(f_registers));
+}
+
+void I2CSimRegisterDevice::set_read_hook(i2c_sim_read_hook hook, void* cookie) {
+    f_read_hook = hook;
+    f_read_cookie = cookie;
+}
+
+void I2CSimRegisterDevice::set_write_hook(i2c_sim_write_hook hook, void* cookie) {
+    f_write_hook = hook;
+    f_write_cookie = cookie;
+}
+
+bool I2CSimRegisterDevice::start(bool read) {
+    if (f_fail_count > 0) {
+        f_fail_count--;
+        return false;
+    }
+    // Il primo byte di ogni scrittura è il puntatore al registro
+    f_pointer_pending = !read;
+    return true;
+}
+
+bool I2CSimRegisterDevice::write_byte(uint8 value) {
+    if (f_pointer_pending) {
+        f_pointer = value;
+        f_pointer_pending = false;
+        return true;
+    }
+
+    f_registers[f_pointer] = value;
+    if (f_write_hook != NULL) {
+        f_write_hook(f_write_cookie, f_pointer, value);
+    }
+    f_pointer++;
+    return true;
+}
+
+uint8 I2CSimRegisterDevice::read_byte() {
+    uint8 value = f_registers[f_pointer];
+    if (f_read_hook != NULL) {
+        value = f_read_hook(f_read_cookie, f_pointer, value);
+    }
+    f_pointer++;
+    return value;
+}
+
+I2CSimTransport::I2CSimTransport(uint32 clock_hz)
+    : f_clock(clock_hz > 0 ? clock_hz : 100000),
+      f_functionality(I2C_FUNC_I2C | I2C_FUNC_SMBUS_QUICK | I2C_FUNC_SMBUS_READ_BLOCK_DATA
+                      | I2C_FUNC_SMBUS_BLOCK_PROC_CALL),
+      f_realtime(true), f_open(false), f_call_overhead(0),
+      f_spin_threshold(I2C_SIM_DEFAULT_SPIN_THRESHOLD), f_address(0),
+      f_bus_time_ns(0), f_calls(0) {
+    memset(f_devices, 0, sizeof(f_devices));
+}
+
+I2CSimTransport::~I2CSimTransport() {
+}
+
+status_t I2CSimTransport::attach(uint8 address, I2CSimDevice* device) {
+    if (address > 0x7F || device == NULL) {
+        return B_BAD_VALUE;
+    }
+    if (f_devices[address] != NULL) {
+        return B_BUSY;
+    }
+    f_devices[address] = device;
+    return B_OK;
+}
+
+void I2CSimTransport::detach(uint8 address) {
+    if (address <= 0x7F) {
+        f_devices[address] = NULL;
+    }
+}
+
+status_t I2CSimTransport::open() {
+    f_open = true;
+    return B_OK;
+}
+
+void I2CSimTransport::close() {
+    f_open = false;
+}
+
+uint32 I2CSimTransport::functionality() {
+    return f_functionality;
+}
+
+status_t I2CSimTransport::set_address(uint8 address) {
+    if (address > 0x7F) {
+        return B_BAD_VALUE;
+    }
+
+    bigtime_t begin = system_time();
+    f_calls++;
+    f_address = address;
+    account(begin, 0);
+    return B_OK;
+}
+
+status_t I2CSimTransport::set_speed(uint32 speed) {
+    if (speed == 0) {
+        return B_BAD_VALUE;
+    }
+    f_clock = speed;
+    return B_OK;
+}
+
+status_t I2CSimTransport::run_message(const struct i2c_msg& msg, uint64* bits,
+                                      I2CSimDevice** last) {
+    bool read = (msg.flags & I2C_M_RD) != 0;
+
+    // START (o RESTART) e byte di indirizzo
+    *bits += 1 + I2C_SIM_BITS_PER_BYTE;
+    I2CSimDevice* device = msg.addr <= 0x7F ? f_devices[msg.addr] : NULL;
+    if (device == NULL || !device->start(read)) {
+        return B_DEVICE_NOT_FOUND;
+    }
+    *last = device;
+
+    uint32 length = msg.len;
+    uint32 extra = 0;
+    if (read && (msg.flags & I2C_M_RECV_LEN) != 0) {
+        // Come i2c-dev: buf[0] = byte da leggere oltre ai dati, len = capienza
+        extra = msg.buf[0];
+        if (extra < 1 || msg.len < extra + I2C_SIM_BLOCK_MAX) {
+            return B_BAD_VALUE;
+        }
+        length = extra;
+    }
+
+    uint32 stretch = device->stretch_bits();
+    for (uint32 i = 0; i < length; i++) {
+        *bits += I2C_SIM_BITS_PER_BYTE + stretch;
+        if (read) {
+            msg.buf[i] = device->read_byte();
+            if (i == 0 && extra > 0) {
+                // Il primo byte è il conteggio del blocco SMBus
+                if (msg.buf[0] == 0 || msg.buf[0] > I2C_SIM_BLOCK_MAX) {
+                    return B_BAD_DATA;
+                }
+                length += msg.buf[0];
+            }
+        } else if (!device->write_byte(msg.buf[i])) {
+            return B_DEVICE_NOT_FOUND;
+        }
+    }
+    return B_OK;
+}
+
+void I2CSimTransport::account(bigtime_t begin, uint64 bits) {
+    uint64 ns = bits * 1000000000ULL / f_clock;
+    f_bus_time_ns += ns;
+
+    if (!f_realtime) {
+        return;
+    }
+
+    // La chiamata termina quando sarebbe terminata sul filo
+    bigtime_t deadline = begin + f_call_overhead + static_cast<bigtime_t>(ns / 1000);
+    bigtime_t remaining = deadline - system_time();
+    if (remaining > f_spin_threshold) {
+        snooze(remaining - f_spin_threshold);
+    }
+    while (system_time() < deadline) {
+    }
+}
+
+status_t I2CSimTransport::transfer(struct i2c_msg* msgs, uint32 count) {
+    if (!f_open) {
+        return B_NO_INIT;
+    }
+    if ((f_functionality & I2C_FUNC_I2C) == 0) {
+        return B_NOT_SUPPORTED;
+    }
+
+    bigtime_t begin = system_time();
+    f_calls++;
+
+    uint64 bits = 0;
+    I2CSimDevice* last = NULL;
+    status_t status = B_OK;
+    for (uint32 i = 0; i < count && status == B_OK; i++) {
+        status = run_message(msgs[i], &bits, &last);
+    }
+
+    // STOP
+    bits++;
+    if (last != NULL) {
+        last->stop();
+    }
+    account(begin, bits);
+    return status;
+}
+
+status_t I2CSimTransport::smbus(struct i2c_smbus_ioctl_data* data) {
+    if (!f_open) {
+        return B_NO_INIT;
+    }
+    if ((f_functionality & I2C_FUNC_SMBUS_QUICK) == 0 || data->size != I2C_SMBUS_QUICK) {
+        return B_NOT_SUPPORTED;
+    }
+
+    // Quick: START, byte di indirizzo con il bit R/W, STOP
+    struct i2c_msg msg;
+    msg.addr = f_address;
+    msg.flags = data->read_write == I2C_SMBUS_READ ? I2C_M_RD : 0;
+    msg.len = 0;
+    msg.buf = NULL;
+
+    bigtime_t begin = system_time();
+    f_calls++;
+
+    uint64 bits = 1;  // STOP
+    I2CSimDevice* last = NULL;
+    status_t status = run_message(msg, &bits, &last);
+    if (last != NULL) {
+        last->stop();
+    }
+    account(begin, bits);
+    return status;
+}
+
+status_t I2CSimTransport::read(uint8* buffer, size_t length) {
+    if (!f_open) {
+        return B_NO_INIT;
+    }
+    if (length > 0xFFFF) {
+        return B_BAD_VALUE;
+    }
+
+    struct i2c_msg msg;
+    msg.addr = f_address;
+    msg.flags = I2C_M_RD;
+    msg.len = static_cast<uint16>(length);
+    msg.buf = buffer;
+
+    bigtime_t begin = system_time();
+    f_calls++;
+
+    uint64 bits = 1;  // STOP
+    I2CSimDevice* last = NULL;
+    status_t status = run_message(msg, &bits, &last);
+    if (last != NULL) {
+        last->stop();
+    }
+    account(begin, bits);
+    return status;
+}
+
+status_t I2CSimTransport::write(const uint8* data, size_t length) {
+    if (!f_open) {
+        return B_NO_INIT;
+    }
+    if (length > 0xFFFF) {
+        return B_BAD_VALUE;
+    }
+
+    struct i2c_msg msg;
+    msg.addr = f_address;
+    msg.flags = 0;
+    msg.len = static_cast<uint16>(length);
+    msg.buf = const_cast<uint8*>(data);
+
+    bigtime_t begin = system_time();
+    f_calls++;
+
+    uint64 bits = 1;  // STOP
+    I2CSimDevice* last = NULL;
+    status_t status = run_message(msg, &bits, &last);
+    if (last != NULL) {
+        last->stop();
+    }
+    account(begin, bits);
+    return status;
+}
@@ -0,0 +1,118 @@
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c_transport.h"
+
+// Modello di un dispositivo collegato al bus simulato. Ogni messaggio indirizzato
+// al dispositivo chiama start(), poi write_byte()/read_byte() per ogni byte e
+// infine stop() (solo alla fine della transazione, non sui repeated start).
+class I2CSimDevice {
+public:
+    virtual ~I2CSimDevice() {}
+
+    // false = NACK dell'indirizzo
+    virtual bool start(bool read) { return true; }
+    // false = NACK del byte
+    virtual bool write_byte(uint8 value) = 0;
+    virtual uint8 read_byte() = 0;
+    virtual void stop() {}
+
+    // Cicli di clock stretching aggiunti a ogni byte
+    virtual uint32 stretch_bits() { return 0; }
+};
+
+// Generatore di valori per i registri dinamici (sensori, contatori, FIFO)
+typedef uint8 (*i2c_sim_read_hook)(void* cookie, uint8 reg, uint8 stored_value);
+typedef void (*i2c_sim_write_hook)(void* cookie, uint8 reg, uint8 value);
+
+// Dispositivo a registri con puntatore auto-incrementante: il primo byte scritto
+// seleziona il registro, i successivi lo scrivono; le letture partono dal puntatore.
+class I2CSimRegisterDevice : public I2CSimDevice {
+public:
+    I2CSimRegisterDevice();
+
+    void set_register(uint8 reg, uint8 value) { f_registers[reg] = value; }
+    uint8 get_register(uint8 reg) const { return f_registers[reg]; }
+
+    void set_read_hook(i2c_sim_read_hook hook, void* cookie);
+    void set_write_hook(i2c_sim_write_hook hook, void* cookie);
+
+    // Iniezione di guasti: NACK dell'indirizzo ai prossimi 'count' start
+    void fail_next(uint32 count) { f_fail_count = count; }
+    void set_stretch_bits(uint32 bits) { f_stretch = bits; }
+
+    virtual bool start(bool read);
+    virtual bool write_byte(uint8 value);
+    virtual uint8 read_byte();
+    virtual uint32 stretch_bits() { return f_stretch; }
+
+private:
+    uint8 f_registers[256];
+    uint8 f_pointer;
+    bool f_pointer_pending;
+    uint32 f_fail_count;
+    uint32 f_stretch;
+
+    i2c_sim_read_hook f_read_hook;
+    void* f_read_cookie;
+    i2c_sim_write_hook f_write_hook;
+    void* f_write_cookie;
+};
+
+// Bus simulato in processo. Il tempo di ogni transazione è calcolato dal clock
+// del bus (9 bit per byte più START/STOP) e, in modalità realtime, la chiamata
+// dura davvero quanto sul filo; altrimenti il tempo viene solo contabilizzato.
+class I2CSimTransport : public I2CTransport {
+public:
+    I2CSimTransport(uint32 clock_hz = 100000);
+    virtual ~I2CSimTransport();
+
+    // Il dispositivo resta del chiamante
+    status_t attach(uint8 address, I2CSimDevice* device);
+    void detach(uint8 address);
+
+    void set_realtime(bool realtime) { f_realtime = realtime; }
+    // Costo fisso di ogni chiamata, per modellare l'overhead della syscall
+    void set_call_overhead(bigtime_t overhead) { f_call_overhead = overhead; }
+    // In realtime le ultime 'threshold' µs di ogni chiamata sono in busy-wait
+    // (predefinito 200), per la precisione. Con 0 la chiamata dorme soltanto e
+    // non occupa una CPU mentre il bus è occupato.
+    void set_spin_threshold(bigtime_t threshold) { f_spin_threshold = threshold; }
+    void set_functionality(uint32 functionality) { f_functionality = functionality; }
+
+    uint32 clock() const { return f_clock; }
+    // Tempo di bus trascorso in nanosecondi
+    uint64 bus_time_ns() const { return f_bus_time_ns; }
+    uint64 call_count() const { return f_calls; }
+
+    virtual status_t open();
+    virtual void close();
+    virtual uint32 functionality();
+    virtual status_t set_address(uint8 address);
+    virtual status_t read(uint8* buffer, size_t length);
+    virtual status_t write(const uint8* data, size_t length);
+    virtual status_t transfer(struct i2c_msg* msgs, uint32 count);
+    virtual status_t smbus(struct i2c_smbus_ioctl_data* data);
+    virtual status_t set_speed(uint32 speed);
+    virtual uint32 speed() { return f_clock; }
+
+private:
+    I2CSimDevice* f_devices[128];
+    uint32 f_clock;
+    uint32 f_functionality;
+    bool f_realtime;
+    bool f_open;
+    bigtime_t f_call_overhead;
+    bigtime_t f_spin_threshold;
+    uint8 f_address;
+
+    uint64 f_bus_time_ns;
+    uint64 f_calls;
+
+    status_t run_message(const struct i2c_msg& msg, uint64* bits, I2CSimDevice** last);
+    void account(bigtime_t begin, uint64 bits);
+};
+
+#endif  // I2C_SIM_H
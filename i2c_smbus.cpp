@@ -0,0 +1,242 @@
+#include "i2c_smbus.h"
+#include "i2c_pec.h"
+#include <string.h>
+
+I2CSMBus::I2CSMBus(I2CBus* bus)
+    : f_bus(bus), f_pec(false) {
+}
+
+status_t I2CSMBus::write_message(uint8 address, uint8* buffer, size_t length) {
+    // Il buffer ha sempre un byte libero in coda per il PEC
+    if (f_pec) {
+        buffer[length] = i2c_pec_update(i2c_pec_address(0, address, false), buffer, length);
+        length++;
+    }
+    return f_bus->write(address, buffer, length);
+}
+
+status_t I2CSMBus::command_read(uint8 address, const uint8* command, size_t command_length,
+                                uint8* buffer, size_t length, size_t* block_length) {
+    if (!f_bus->f_initialized) {
+        return B_NO_INIT;
+    }
+
+    bool block = block_length != NULL;
+    if (!block && length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+
+    // Conteggio, dati e PEC
+    uint8 received[1 + I2C_SMBUS_BLOCK_MAX + 1];
+    status_t status = B_NOT_SUPPORTED;
+
+    if (f_bus->f_combined
+        && (!block || (f_bus->f_functionality & I2C_FUNC_SMBUS_READ_BLOCK_DATA) != 0)) {
+        struct i2c_msg msgs[2];
+        msgs[0].addr = address;
+        msgs[0].flags = 0;
+        msgs[0].len = static_cast<uint16>(command_length);
+        msgs[0].buf = const_cast<uint8*>(command);
+        msgs[1].addr = address;
+        msgs[1].flags = I2C_M_RD;
+        msgs[1].buf = received;
+        if (block) {
+            // Contratto di i2c-dev: buf[0] indica quanti byte leggere oltre ai dati
+            // (conteggio ed eventuale PEC), len la capienza del buffer
+            msgs[1].flags |= I2C_M_RECV_LEN;
+            received[0] = f_pec ? 2 : 1;
+            msgs[1].len = received[0] + I2C_SMBUS_BLOCK_MAX;
+        } else {
+            msgs[1].len = static_cast<uint16>(length + (f_pec ? 1 : 0));
+        }
+        status = f_bus->transfer_messages(msgs, 2);
+    }
+
+    if (status == B_NOT_SUPPORTED) {
+        // Senza RESTART il PEC del dispositivo non copre la transazione intera e
+        // la lunghezza di un blocco non è nota prima della lettura
+        if (f_pec || block) {
+            return B_NOT_SUPPORTED;
+        }
+        status = f_bus->write(address, command, command_length);
+        if (status != B_OK) {
+            return status;
+        }
+        return f_bus->read(address, buffer, length);
+    }
+    if (status != B_OK) {
+        return status;
+    }
+
+    size_t offset = 0;
+    if (block) {
+        length = received[0];
+        if (length == 0 || length > I2C_SMBUS_BLOCK_MAX) {
+            return B_BAD_DATA;
+        }
+        offset = 1;
+    }
+
+    if (f_pec) {
+        uint8 crc = i2c_pec_address(0, address, false);
+        crc = i2c_pec_update(crc, command, command_length);
+        crc = i2c_pec_address(crc, address, true);
+        crc = i2c_pec_update(crc, received, offset + length);
+        if (crc != received[offset + length]) {
+            return B_BAD_DATA;
+        }
+    }
+
+    memcpy(buffer, received + offset, length);
+    if (block) {
+        *block_length = length;
+    }
+    return B_OK;
+}
+
+status_t I2CSMBus::quick(uint8 address, bool read) {
+    if (!f_bus->f_initialized) {
+        return B_NO_INIT;
+    }
+
+    // Mai come messaggio I2C vuoto: gli adattatori con I2C_AQ_NO_ZERO_LEN (per
+    // esempio DesignWare) lo rifiutano con EOPNOTSUPP, che spegnerebbe anche il
+    // percorso combinato per tutte le altre operazioni
+    if ((f_bus->f_functionality & I2C_FUNC_SMBUS_QUICK) == 0) {
+        return B_NOT_SUPPORTED;
+    }
+
+    struct i2c_smbus_ioctl_data data;
+    data.read_write = read ? I2C_SMBUS_READ : I2C_SMBUS_WRITE;
+    data.command = 0;
+    data.size = I2C_SMBUS_QUICK;
+    data.data = NULL;
+    return f_bus->smbus_transfer(address, data);
+}
+
+status_t I2CSMBus::receive_byte(uint8 address, uint8* value) {
+    if (value == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 received[2];
+    status_t status = f_bus->read(address, received, f_pec ? 2 : 1);
+    if (status != B_OK) {
+        return status;
+    }
+    if (f_pec && i2c_pec_byte(i2c_pec_address(0, address, true), received[0]) != received[1]) {
+        return B_BAD_DATA;
+    }
+
+    *value = received[0];
+    return B_OK;
+}
+
+status_t I2CSMBus::send_byte(uint8 address, uint8 value) {
+    uint8 buffer[2] = {value};
+    return write_message(address, buffer, 1);
+}
+
+status_t I2CSMBus::read_byte_data(uint8 address, uint8 command, uint8* value) {
+    if (value == NULL) {
+        return B_BAD_VALUE;
+    }
+    return command_read(address, &command, 1, value, 1, NULL);
+}
+
+status_t I2CSMBus::write_byte_data(uint8 address, uint8 command, uint8 value) {
+    uint8 buffer[3] = {command, value};
+    return write_message(address, buffer, 2);
+}
+
+status_t I2CSMBus::read_word_data(uint8 address, uint8 command, uint16* value) {
+    if (value == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 data[2];
+    status_t status = command_read(address, &command, 1, data, 2, NULL);
+    if (status == B_OK) {
+        *value = static_cast<uint16>(data[0] | (data[1] << 8));
+    }
+    return status;
+}
+
+status_t I2CSMBus::write_word_data(uint8 address, uint8 command, uint16 value) {
+    uint8 buffer[4] = {command, static_cast<uint8>(value), static_cast<uint8>(value >> 8)};
+    return write_message(address, buffer, 3);
+}
+
+status_t I2CSMBus::process_call(uint8 address, uint8 command, uint16 value, uint16* result) {
+    if (result == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[3] = {command, static_cast<uint8>(value), static_cast<uint8>(value >> 8)};
+    uint8 data[2];
+    status_t status = command_read(address, buffer, 3, data, 2, NULL);
+    if (status == B_OK) {
+        *result = static_cast<uint16>(data[0] | (data[1] << 8));
+    }
+    return status;
+}
+
+status_t I2CSMBus::read_block_data(uint8 address, uint8 command, uint8* buffer,
+                                   size_t* length) {
+    if (buffer == NULL || length == NULL) {
+        return B_BAD_VALUE;
+    }
+    return command_read(address, &command, 1, buffer, 0, length);
+}
+
+status_t I2CSMBus::write_block_data(uint8 address, uint8 command, const uint8* data,
+                                    size_t length) {
+    if ((data == NULL && length > 0) || length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+
+    // Comando, conteggio, dati e PEC
+    uint8 buffer[2 + I2C_SMBUS_BLOCK_MAX + 1];
+    buffer[0] = command;
+    buffer[1] = static_cast<uint8>(length);
+    if (length > 0) {
+        memcpy(buffer + 2, data, length);
+    }
+    return write_message(address, buffer, length + 2);
+}
+
+status_t I2CSMBus::block_process_call(uint8 address, uint8 command, const uint8* data,
+                                      size_t length, uint8* buffer, size_t* read_length) {
+    if ((data == NULL && length > 0) || length > I2C_SMBUS_BLOCK_MAX
+        || buffer == NULL || read_length == NULL) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 request[2 + I2C_SMBUS_BLOCK_MAX];
+    request[0] = command;
+    request[1] = static_cast<uint8>(length);
+    if (length > 0) {
+        memcpy(request + 2, data, length);
+    }
+    return command_read(address, request, length + 2, buffer, 0, read_length);
+}
+
+status_t I2CSMBus::read_i2c_block_data(uint8 address, uint8 command, uint8* buffer,
+                                       size_t length) {
+    if (buffer == NULL || length == 0 || length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+    return f_bus->read_registers(address, command, buffer, length);
+}
+
+status_t I2CSMBus::write_i2c_block_data(uint8 address, uint8 command, const uint8* data,
+                                        size_t length) {
+    if (data == NULL || length == 0 || length > I2C_SMBUS_BLOCK_MAX) {
+        return B_BAD_VALUE;
+    }
+
+    uint8 buffer[1 + I2C_SMBUS_BLOCK_MAX];
+    buffer[0] = command;
+    memcpy(buffer + 1, data, length);
+    return f_bus->write(address, buffer, length + 1);
+}
@@ -0,0 +1,58 @@
+#ifndef I2C_SMBUS_H
+#define I2C_SMBUS_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+
+// Lunghezza massima dei dati di un blocco SMBus (conteggio escluso)
+#define I2C_SMBUS_BLOCK_MAX 32
+
+// Protocollo SMBus sopra I2CBus. Le letture con codice di comando usano una sola
+// transazione combinata (scrittura, RESTART, lettura); le letture a blocco usano
+// I2C_M_RECV_LEN, così il conteggio inviato dal dispositivo decide quanti byte
+// leggere. Con il PEC attivo ogni transazione porta il CRC-8 e una lettura con
+// PEC errato restituisce B_BAD_DATA. I blocchi I2C non hanno PEC (come in Linux).
+class I2CSMBus {
+public:
+    I2CSMBus(I2CBus* bus);
+
+    void set_pec(bool enable) { f_pec = enable; }
+    bool pec() const { return f_pec; }
+
+    // Solo il byte di indirizzo: utile per rilevare un dispositivo. Usa
+    // I2C_SMBUS; B_NOT_SUPPORTED senza I2C_FUNC_SMBUS_QUICK
+    status_t quick(uint8 address, bool read);
+
+    status_t receive_byte(uint8 address, uint8* value);
+    status_t send_byte(uint8 address, uint8 value);
+
+    status_t read_byte_data(uint8 address, uint8 command, uint8* value);
+    status_t write_byte_data(uint8 address, uint8 command, uint8 value);
+
+    // Le word SMBus sono little endian
+    status_t read_word_data(uint8 address, uint8 command, uint16* value);
+    status_t write_word_data(uint8 address, uint8 command, uint16 value);
+    status_t process_call(uint8 address, uint8 command, uint16 value, uint16* result);
+
+    // buffer deve contenere I2C_SMBUS_BLOCK_MAX byte; *length riceve il conteggio
+    status_t read_block_data(uint8 address, uint8 command, uint8* buffer, size_t* length);
+    status_t write_block_data(uint8 address, uint8 command, const uint8* data, size_t length);
+    status_t block_process_call(uint8 address, uint8 command, const uint8* data,
+                                size_t length, uint8* buffer, size_t* read_length);
+
+    // Blocco I2C a lunghezza fissa (massimo I2C_SMBUS_BLOCK_MAX byte)
+    status_t read_i2c_block_data(uint8 address, uint8 command, uint8* buffer, size_t length);
+    status_t write_i2c_block_data(uint8 address, uint8 command, const uint8* data,
+                                  size_t length);
+
+private:
+    I2CBus* f_bus;
+    bool f_pec;
+
+    status_t write_message(uint8 address, uint8* buffer, size_t length);
+    status_t command_read(uint8 address, const uint8* command, size_t command_length,
+                          uint8* buffer, size_t length, size_t* block_length);
+};
+
+#endif  // I2C_SMBUS_H
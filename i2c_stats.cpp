@@ -0,0 +1,79 @@
+#include "i2c_stats.h"
+#include "i2c.h"
+#include <string.h>
+
+I2CBusStats::I2CBusStats() {
+    memset(&f_stats, 0, sizeof(f_stats));
+}
+
+void I2CBusStats::reset() {
+    int64* counters = reinterpret_cast<int64*>(&f_stats);
+    for (size_t i = 0; i < sizeof(f_stats) / sizeof(int64); i++) {
+        atomic_set64(&counters[i], 0);
+    }
+}
+
+void I2CBusStats::snapshot(i2c_bus_stats* stats) const {
+    int64* counters = const_cast<int64*>(reinterpret_cast<const int64*>(&f_stats));
+    int64* out = reinterpret_cast<int64*>(stats);
+    for (size_t i = 0; i < sizeof(f_stats) / sizeof(int64); i++) {
+        out[i] = atomic_get64(&counters[i]);
+    }
+}
+
+uint32 I2CBusStats::bucket(nanotime_t elapsed) {
+    if (elapsed <= 1) {
+        return 0;
+    }
+    uint32 index = 63 - __builtin_clzll(static_cast<uint64>(elapsed));
+    return index < I2C_STATS_HISTOGRAM_BUCKETS ? index : I2C_STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+void I2CBusStats::account_status(i2c_counters* counters, status_t status) {
+    if (status == B_OK) {
+        return;
+    }
+    // NACK dello slave (ENXIO su i2c-dev)
+    if (status == B_DEVICE_NOT_FOUND) {
+        atomic_add64(&counters->nacks, 1);
+    } else {
+        atomic_add64(&counters->io_errors, 1);
+    }
+}
+
+void I2CBusStats::record_transfer(const struct i2c_msg* msgs, uint32 count, status_t status,
+                                  nanotime_t elapsed) {
+    int64 bytes_out = 0;
+    int64 bytes_in = 0;
+    bool single_address = true;
+
+    for (uint32 i = 0; i < count; i++) {
+        i2c_counters* counters = &f_stats.address[msgs[i].addr & 0x7F];
+        if (msgs[i].flags & I2C_M_RD) {
+            bytes_in += msgs[i].len;
+            atomic_add64(&counters->bytes_in, msgs[i].len);
+        } else {
+            bytes_out += msgs[i].len;
+            atomic_add64(&counters->bytes_out, msgs[i].len);
+        }
+        atomic_add64(&counters->transactions, 1);
+        single_address &= msgs[i].addr == msgs[0].addr;
+    }
+
+    if (count > 0 && single_address) {
+        i2c_counters* counters = &f_stats.address[msgs[0].addr & 0x7F];
+        atomic_add64(&counters->kernel_ns, elapsed);
+        account_status(counters, status);
+    }
+
+    atomic_add64(&f_stats.bus.transactions, 1);
+    atomic_add64(&f_stats.bus.bytes_out, bytes_out);
+    atomic_add64(&f_stats.bus.bytes_in, bytes_in);
+    atomic_add64(&f_stats.bus.kernel_ns, elapsed);
+    account_status(&f_stats.bus, status);
+    atomic_add64(&f_stats.latency[bucket(elapsed)], 1);
+}
+
+void I2CBusStats::record_call(nanotime_t elapsed) {
+    atomic_add64(&f_stats.bus.kernel_ns, elapsed);
+}
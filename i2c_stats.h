@@ -0,0 +1,53 @@
+#ifndef I2C_STATS_H
+#define I2C_STATS_H
+
+#include <OS.h>
+#include <stdint.h>
+
+struct i2c_msg;
+
+// Bucket dell'istogramma: il bucket i conta le latenze in [2^i, 2^(i+1)) ns
+#define I2C_STATS_HISTOGRAM_BUCKETS 40
+#define I2C_STATS_ADDRESSES 128
+
+typedef struct {
+    int64 transactions;     // per indirizzo: messaggi indirizzati allo slave
+    int64 bytes_out;
+    int64 bytes_in;
+    int64 nacks;
+    int64 io_errors;
+    int64 kernel_ns;        // tempo trascorso nelle chiamate al trasporto
+} i2c_counters;
+
+typedef struct {
+    i2c_counters bus;
+    i2c_counters address[I2C_STATS_ADDRESSES];
+    int64 latency[I2C_STATS_HISTOGRAM_BUCKETS];
+} i2c_bus_stats;
+
+// Contatori di un bus. Gli aggiornamenti sono solo incrementi atomici, senza lock;
+// snapshot() legge ogni contatore atomicamente ma non l'insieme, quindi i valori
+// possono essere di istanti diversi di poche transazioni.
+class I2CBusStats {
+public:
+    I2CBusStats();
+
+    void reset();
+    void snapshot(i2c_bus_stats* stats) const;
+
+    // Una chiamata al trasporto che trasferisce dati. Gli errori vengono
+    // attribuiti all'indirizzo solo se la chiamata ne coinvolge uno soltanto.
+    void record_transfer(const struct i2c_msg* msgs, uint32 count, status_t status,
+                         nanotime_t elapsed);
+    // Una chiamata senza dati (per esempio il cambio di indirizzo slave)
+    void record_call(nanotime_t elapsed);
+
+    static uint32 bucket(nanotime_t elapsed);
+
+private:
+    i2c_bus_stats f_stats;
+
+    static void account_status(i2c_counters* counters, status_t status);
+};
+
+#endif  // I2C_STATS_H
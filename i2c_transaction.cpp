@@ -0,0 +1,92 @@
+#include "i2c_transaction.h"
+
+I2CTransaction::I2CTransaction()
+    : f_count(0) {
+}
+
+void I2CTransaction::clear() {
+    f_count = 0;
+}
+
+int32 I2CTransaction::append(uint8 address, uint16 flags, uint8* buffer, size_t length,
+                             bool new_group) {
+    if (f_count >= I2C_TRANSACTION_MAX_MESSAGES) {
+        return B_NO_MEMORY;
+    }
+    if (length > 0xFFFF || (buffer == NULL && length > 0)) {
+        return B_BAD_VALUE;
+    }
+
+    uint32 index = f_count++;
+    f_msgs[index].addr = address;
+    f_msgs[index].flags = flags;
+    f_msgs[index].len = static_cast<uint16>(length);
+    f_msgs[index].buf = buffer;
+    f_status[index] = B_NO_INIT;  // non ancora eseguito
+    f_group[index] = new_group ? index : f_group[index - 1];
+    return static_cast<int32>(index);
+}
+
+int32 I2CTransaction::add_write(uint8 address, const uint8* data, size_t length) {
+    return append(address, 0, const_cast<uint8*>(data), length, true);
+}
+
+int32 I2CTransaction::add_read(uint8 address, uint8* buffer, size_t length) {
+    return append(address, I2C_M_RD, buffer, length, true);
+}
+
+int32 I2CTransaction::add_write_read(uint8 address, const uint8* data, size_t write_length,
+                                     uint8* buffer, size_t read_length) {
+    if (f_count + 2 > I2C_TRANSACTION_MAX_MESSAGES) {
+        return B_NO_MEMORY;
+    }
+
+    int32 index = append(address, 0, const_cast<uint8*>(data), write_length, true);
+    if (index < 0) {
+        return index;
+    }
+
+    int32 read_index = append(address, I2C_M_RD, buffer, read_length, false);
+    if (read_index < 0) {
+        f_count--;
+    }
+    return read_index;
+}
+
+int32 I2CTransaction::add_read_registers(uint8 address, uint8 reg, uint8* buffer, size_t length) {
+    if (f_count >= I2C_TRANSACTION_MAX_MESSAGES) {
+        return B_NO_MEMORY;
+    }
+
+    // Il registro viene conservato nello slot del messaggio di scrittura
+    f_registers[f_count] = reg;
+    return add_write_read(address, &f_registers[f_count], 1, buffer, length);
+}
+
+status_t I2CTransaction::status(int32 index) const {
+    if (index < 0 || static_cast<uint32>(index) >= f_count) {
+        return B_BAD_INDEX;
+    }
+    return f_status[index];
+}
+
+uint32 I2CTransaction::group_end(uint32 start) const {
+    uint32 end = start + 1;
+    while (end < f_count && f_group[end] == start) {
+        end++;
+    }
+    return end;
+}
+
+bool I2CTransaction::group_is_idempotent(uint32 start) const {
+    // Un gruppo si può ripetere senza effetti collaterali se ogni scrittura è
+    // solo il puntatore di una lettura successiva nello stesso gruppo
+    uint32 end = group_end(start);
+    for (uint32 i = start; i < end; i++) {
+        if ((f_msgs[i].flags & I2C_M_RD) == 0
+            && (i + 1 >= end || (f_msgs[i + 1].flags & I2C_M_RD) == 0)) {
+            return false;
+        }
+    }
+    return true;
+}
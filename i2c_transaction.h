@@ -0,0 +1,59 @@
+#ifndef I2C_TRANSACTION_H
+#define I2C_TRANSACTION_H
+
+#include <OS.h>
+#include <stdint.h>
+#include "i2c.h"
+
+// Numero massimo di messaggi accodabili in una transazione
+#define I2C_TRANSACTION_MAX_MESSAGES 128
+
+// Raccoglie letture e scritture verso uno o più indirizzi e le invia al bus
+// con il minor numero possibile di chiamate al kernel (vedi I2CBus::submit).
+// I buffer appartengono al chiamante e devono restare validi fino al submit.
+// Ogni add_* restituisce l'indice del messaggio (o un errore negativo), da usare
+// con status() per conoscere l'esito del singolo messaggio.
+//
+// Dentro un gruppo i messaggi sono separati da un repeated start. Due gruppi
+// nella stessa chiamata I2C_RDWR sono separati anch'essi da un RESTART e non da
+// uno STOP: per questo un gruppo ne segue un altro nella stessa chiamata solo
+// se il primo è di sola lettura (la scrittura del puntatore di registro di
+// add_write_read conta come lettura). Dopo un gruppo con una scrittura vera la
+// chiamata si chiude, così una add_read che lo segue non diventa una lettura
+// combinata. Senza I2C_RDWR ogni messaggio ha il suo STOP.
+class I2CTransaction {
+public:
+    I2CTransaction();
+
+    void clear();
+
+    int32 add_write(uint8 address, const uint8* data, size_t length);
+    int32 add_read(uint8 address, uint8* buffer, size_t length);
+
+    // Scrittura seguita da lettura con repeated start: i due messaggi formano
+    // un gruppo atomico. Restituisce l'indice del messaggio di lettura.
+    int32 add_write_read(uint8 address, const uint8* data, size_t write_length,
+                         uint8* buffer, size_t read_length);
+    int32 add_read_registers(uint8 address, uint8 reg, uint8* buffer, size_t length);
+
+    uint32 message_count() const { return f_count; }
+    status_t status(int32 index) const;
+
+private:
+    friend class I2CBus;
+    friend class I2CScheduler;
+
+    struct i2c_msg f_msgs[I2C_TRANSACTION_MAX_MESSAGES];
+    status_t f_status[I2C_TRANSACTION_MAX_MESSAGES];
+    // Indice del primo messaggio del gruppo a cui appartiene ogni messaggio
+    uint32 f_group[I2C_TRANSACTION_MAX_MESSAGES];
+    // Byte di registro per add_read_registers (il chiamante non fornisce un buffer)
+    uint8 f_registers[I2C_TRANSACTION_MAX_MESSAGES];
+    uint32 f_count;
+
+    int32 append(uint8 address, uint16 flags, uint8* buffer, size_t length, bool new_group);
+    uint32 group_end(uint32 start) const;
+    bool group_is_idempotent(uint32 start) const;
+};
+
+#endif  // I2C_TRANSACTION_H
@@ -0,0 +1,153 @@
+#include "i2c_transport.h"
+#include "i2c.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+// Un NACK dello slave arriva come ENXIO (o EREMOTEIO su Linux). Non viene
+// stampato: durante una scansione è l'esito normale per gli indirizzi liberi.
+static status_t io_error(int error) {
+#ifdef EREMOTEIO
+    if (error == EREMOTEIO) {
+        return B_DEVICE_NOT_FOUND;
+    }
+#endif
+    return error == ENXIO ? B_DEVICE_NOT_FOUND : B_IO_ERROR;
+}
+
+I2CDevTransport::I2CDevTransport(int bus_number)
+    : f_bus_number(bus_number), f_fd(-1) {
+}
+
+I2CDevTransport::~I2CDevTransport() {
+    close();
+}
+
+status_t I2CDevTransport::open() {
+    char path[20];
+    snprintf(path, sizeof(path), "/dev/i2c-%d", f_bus_number);
+    f_fd = ::open(path, O_RDWR);
+    if (f_fd < 0) {
+        fprintf(stderr, "Errore nell'aprire %s: %s\n", path, strerror(errno));
+        return B_IO_ERROR;
+    }
+    return B_OK;
+}
+
+void I2CDevTransport::close() {
+    if (f_fd >= 0) {
+        ::close(f_fd);
+        f_fd = -1;
+    }
+}
+
+uint32 I2CDevTransport::functionality() {
+    // Se I2C_FUNCS non è disponibile si assume un adattatore senza I2C_RDWR
+    unsigned long funcs = 0;
+    if (ioctl(f_fd, I2C_FUNCS, &funcs) < 0) {
+        return 0;
+    }
+    return static_cast<uint32>(funcs);
+}
+
+status_t I2CDevTransport::set_address(uint8 address) {
+    // Passiamo l'indirizzo di 'address' invece di 'address' direttamente
+    if (ioctl(f_fd, I2C_SLAVE, (void*)(uintptr_t)address) < 0) {
+        fprintf(stderr, "Errore nel settare l'indirizzo slave: %s\n", strerror(errno));
+        return B_IO_ERROR;
+    }
+    return B_OK;
+}
+
+status_t I2CDevTransport::read(uint8* buffer, size_t length) {
+    ssize_t bytes_read = ::read(f_fd, buffer, length);
+    if (bytes_read != static_cast<ssize_t>(length)) {
+        int error = errno;
+        status_t status = io_error(error);
+        if (status != B_DEVICE_NOT_FOUND) {
+            fprintf(stderr, "Errore nella lettura dei dati: %s\n", strerror(error));
+        }
+        return status;
+    }
+    return B_OK;
+}
+
+status_t I2CDevTransport::write(const uint8* data, size_t length) {
+    ssize_t bytes_written = ::write(f_fd, data, length);
+    if (bytes_written != static_cast<ssize_t>(length)) {
+        int error = errno;
+        status_t status = io_error(error);
+        if (status != B_DEVICE_NOT_FOUND) {
+            fprintf(stderr, "Errore nella scrittura dei dati: %s\n", strerror(error));
+        }
+        return status;
+    }
+    return B_OK;
+}
+
+status_t I2CDevTransport::transfer(struct i2c_msg* msgs, uint32 count) {
+    struct i2c_rdwr_ioctl_data rdwr;
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = count;
+
+    if (ioctl(f_fd, I2C_RDWR, &rdwr) < 0) {
+        int error = errno;
+        // Solo l'assenza di I2C_RDWR è B_NOT_SUPPORTED: I2CBus passerebbe per
+        // sempre al percorso classico. EINVAL è una richiesta rifiutata (troppi
+        // byte, I2C_M_RECV_LEN non valido) e torna al chiamante.
+        if (error == EOPNOTSUPP || error == ENOTTY) {
+            return B_NOT_SUPPORTED;
+        }
+        if (error == EINVAL) {
+            return B_BAD_VALUE;
+        }
+        status_t status = io_error(error);
+        if (status != B_DEVICE_NOT_FOUND) {
+            fprintf(stderr, "Errore nella transazione combinata: %s\n", strerror(error));
+        }
+        return status;
+    }
+    return B_OK;
+}
+
+status_t I2CDevTransport::smbus(struct i2c_smbus_ioctl_data* data) {
+    if (ioctl(f_fd, I2C_SMBUS, data) < 0) {
+        int error = errno;
+        if (error == EOPNOTSUPP || error == ENOTTY) {
+            return B_NOT_SUPPORTED;
+        }
+        if (error == EINVAL) {
+            return B_BAD_VALUE;
+        }
+        status_t status = io_error(error);
+        if (status != B_DEVICE_NOT_FOUND) {
+            fprintf(stderr, "Errore nel comando SMBus: %s\n", strerror(error));
+        }
+        return status;
+    }
+    return B_OK;
+}
+
+uint32 I2CDevTransport::speed() {
+    // i2c-dev non permette di cambiare il clock, ma l'adattatore descritto dal
+    // device tree ne espone il valore (u32 big endian)
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/bus/i2c/devices/i2c-%d/of_node/clock-frequency",
+             f_bus_number);
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    uint8 value[4];
+    ssize_t bytes_read = ::read(fd, value, sizeof(value));
+    ::close(fd);
+    if (bytes_read != sizeof(value)) {
+        return 0;
+    }
+    return (uint32(value[0]) << 24) | (uint32(value[1]) << 16) | (uint32(value[2]) << 8)
+        | value[3];
+}
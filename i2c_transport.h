@@ -0,0 +1,62 @@
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <OS.h>
+#include <stdint.h>
+
+struct i2c_msg;
+struct i2c_smbus_ioctl_data;
+
+// Backend di trasporto sotto I2CBus. Ogni metodo corrisponde a una chiamata al
+// kernel nel backend i2c-dev: I2CBus li conta come syscall.
+class I2CTransport {
+public:
+    virtual ~I2CTransport() {}
+
+    virtual status_t open() = 0;
+    virtual void close() = 0;
+
+    // Maschera I2C_FUNC_* dell'adattatore (0 se sconosciuta)
+    virtual uint32 functionality() = 0;
+
+    // Indirizzo usato da read() e write()
+    virtual status_t set_address(uint8 address) = 0;
+    virtual status_t read(uint8* buffer, size_t length) = 0;
+    virtual status_t write(const uint8* data, size_t length) = 0;
+
+    // Messaggi con repeated start in un'unica transazione. B_NOT_SUPPORTED solo
+    // se l'adattatore non li gestisce affatto; B_BAD_VALUE se rifiuta questi
+    // messaggi (lunghezze o flag).
+    virtual status_t transfer(struct i2c_msg* msgs, uint32 count) = 0;
+
+    // Comando SMBus (I2C_SMBUS) all'indirizzo corrente; B_NOT_SUPPORTED se il
+    // trasporto non lo gestisce
+    virtual status_t smbus(struct i2c_smbus_ioctl_data* data) { return B_NOT_SUPPORTED; }
+
+    virtual status_t set_speed(uint32 speed) { return B_NOT_SUPPORTED; }
+    // Clock effettivo del bus in Hz (0 se sconosciuto)
+    virtual uint32 speed() { return 0; }
+};
+
+// Backend /dev/i2c-N (interfaccia i2c-dev)
+class I2CDevTransport : public I2CTransport {
+public:
+    I2CDevTransport(int bus_number);
+    virtual ~I2CDevTransport();
+
+    virtual status_t open();
+    virtual void close();
+    virtual uint32 functionality();
+    virtual status_t set_address(uint8 address);
+    virtual status_t read(uint8* buffer, size_t length);
+    virtual status_t write(const uint8* data, size_t length);
+    virtual status_t transfer(struct i2c_msg* msgs, uint32 count);
+    virtual status_t smbus(struct i2c_smbus_ioctl_data* data);
+    virtual uint32 speed();
+
+private:
+    int f_bus_number;
+    int f_fd;
+};
+
+#endif  // I2C_TRANSPORT_H
@@ -0,0 +1,318 @@
+// API del kernel di Haiku usate dalla libreria, sopra i thread POSIX. Basta
+// per la libreria e per bench/i2c_bench: niente team, segnali né nomi.
+
+#include <OS.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define LINUX_SEM_MAX    16384
+#define LINUX_THREAD_MAX 256
+
+// Un id vecchio non trova il semaforo che ha riusato lo slot: l'id salvato
+// nello slot non corrisponde
+typedef struct {
+    sem_id id;                  // -1: libero
+    int32 count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} linux_sem;
+
+typedef enum {
+    LINUX_THREAD_FREE,
+    LINUX_THREAD_SPAWNED,       // creato, in attesa di resume_thread
+    LINUX_THREAD_RUNNING
+} linux_thread_state;
+
+typedef struct {
+    thread_id id;
+    linux_thread_state state;
+    pthread_t thread;
+    thread_func function;
+    void* data;
+    status_t result;
+} linux_thread;
+
+static linux_sem sSems[LINUX_SEM_MAX];
+static linux_thread sThreads[LINUX_THREAD_MAX];
+static pthread_mutex_t sTableLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t sInitOnce = PTHREAD_ONCE_INIT;
+static int32 sNextSem = 0;
+static int32 sNextThread = 0;
+
+
+static void init_tables() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    for (int32 i = 0; i < LINUX_SEM_MAX; i++) {
+        sSems[i].id = -1;
+        pthread_mutex_init(&sSems[i].lock, NULL);
+        pthread_cond_init(&sSems[i].cond, &attr);
+    }
+    pthread_condattr_destroy(&attr);
+    for (int32 i = 0; i < LINUX_THREAD_MAX; i++) {
+        sThreads[i].id = -1;
+        sThreads[i].state = LINUX_THREAD_FREE;
+    }
+}
+
+// Gli id crescono e ricominciano da 0 prima di traboccare; lo slot è l'id
+// modulo la dimensione della tabella
+static int32 next_id(int32 id) {
+    return id + 1 < INT32_MAX - LINUX_SEM_MAX ? id + 1 : 0;
+}
+
+static timespec to_timespec(bigtime_t time) {
+    timespec spec;
+    spec.tv_sec = time / 1000000;
+    spec.tv_nsec = (time % 1000000) * 1000;
+    return spec;
+}
+
+
+// #pragma mark - tempo
+
+
+bigtime_t system_time() {
+    return system_time_nsecs() / 1000;
+}
+
+nanotime_t system_time_nsecs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (nanotime_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+status_t snooze(bigtime_t amount) {
+    if (amount <= 0) {
+        return B_OK;
+    }
+    return snooze_until(system_time() + amount, B_SYSTEM_TIMEBASE);
+}
+
+status_t snooze_until(bigtime_t time, int timeBase) {
+    timespec until = to_timespec(time);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+    return B_OK;
+}
+
+
+// #pragma mark - semafori
+
+
+// Restituisce il semaforo con il suo mutex preso, NULL se l'id non è valido
+static linux_sem* lock_sem(sem_id sem) {
+    if (sem < 0) {
+        return NULL;
+    }
+    pthread_once(&sInitOnce, init_tables);
+    linux_sem* entry = &sSems[sem % LINUX_SEM_MAX];
+    pthread_mutex_lock(&entry->lock);
+    if (entry->id != sem) {
+        pthread_mutex_unlock(&entry->lock);
+        return NULL;
+    }
+    return entry;
+}
+
+sem_id create_sem(int32 count, const char* name) {
+    if (count < 0) {
+        return B_BAD_VALUE;
+    }
+    pthread_once(&sInitOnce, init_tables);
+    pthread_mutex_lock(&sTableLock);
+    for (int32 i = 0; i < LINUX_SEM_MAX; i++) {
+        int32 slot = (sNextSem + i) % LINUX_SEM_MAX;
+        linux_sem* entry = &sSems[slot];
+        pthread_mutex_lock(&entry->lock);
+        if (entry->id < 0) {
+            entry->id = sNextSem + i;
+            entry->count = count;
+            pthread_mutex_unlock(&entry->lock);
+            sNextSem = next_id(entry->id);
+            pthread_mutex_unlock(&sTableLock);
+            return entry->id;
+        }
+        pthread_mutex_unlock(&entry->lock);
+    }
+    pthread_mutex_unlock(&sTableLock);
+    return B_NO_MORE_SEMS;
+}
+
+// Chi aspetta si sveglia e riceve B_BAD_SEM_ID
+status_t delete_sem(sem_id sem) {
+    linux_sem* entry = lock_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+    entry->id = -1;
+    pthread_cond_broadcast(&entry->cond);
+    pthread_mutex_unlock(&entry->lock);
+    return B_OK;
+}
+
+status_t acquire_sem(sem_id sem) {
+    return acquire_sem_etc(sem, 1, 0, 0);
+}
+
+status_t acquire_sem_etc(sem_id sem, int32 count, uint32 flags, bigtime_t timeout) {
+    if (count < 1) {
+        return B_BAD_VALUE;
+    }
+    linux_sem* entry = lock_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+
+    bigtime_t deadline = -1;
+    if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout != B_INFINITE_TIMEOUT) {
+        deadline = timeout > 0 ? system_time() + timeout : 0;
+    } else if ((flags & B_ABSOLUTE_TIMEOUT) != 0 && timeout != B_INFINITE_TIMEOUT) {
+        deadline = timeout;
+    }
+
+    status_t status = B_OK;
+    while (entry->id == sem && entry->count < count) {
+        if (deadline == 0 && (flags & B_RELATIVE_TIMEOUT) != 0) {
+            status = B_WOULD_BLOCK;
+            break;
+        }
+        if (deadline < 0) {
+            pthread_cond_wait(&entry->cond, &entry->lock);
+        } else {
+            timespec until = to_timespec(deadline);
+            if (pthread_cond_timedwait(&entry->cond, &entry->lock, &until) == ETIMEDOUT
+                && entry->id == sem && entry->count < count) {
+                status = B_TIMED_OUT;
+                break;
+            }
+        }
+    }
+    if (status == B_OK) {
+        if (entry->id != sem) {
+            status = B_BAD_SEM_ID;
+        } else {
+            entry->count -= count;
+        }
+    }
+    pthread_mutex_unlock(&entry->lock);
+    return status;
+}
+
+status_t release_sem(sem_id sem) {
+    return release_sem_etc(sem, 1, 0);
+}
+
+status_t release_sem_etc(sem_id sem, int32 count, uint32 flags) {
+    if (count < 1) {
+        return B_BAD_VALUE;
+    }
+    linux_sem* entry = lock_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+    entry->count += count;
+    pthread_cond_broadcast(&entry->cond);
+    pthread_mutex_unlock(&entry->lock);
+    return B_OK;
+}
+
+status_t get_sem_count(sem_id sem, int32* count) {
+    linux_sem* entry = lock_sem(sem);
+    if (entry == NULL) {
+        return B_BAD_SEM_ID;
+    }
+    *count = entry->count;
+    pthread_mutex_unlock(&entry->lock);
+    return B_OK;
+}
+
+
+// #pragma mark - thread
+
+
+static void* thread_entry(void* data) {
+    linux_thread* thread = (linux_thread*)data;
+    thread->result = thread->function(thread->data);
+    return NULL;
+}
+
+// Come in Haiku il thread nasce sospeso e parte con resume_thread
+thread_id spawn_thread(thread_func function, const char* name, int32 priority, void* data) {
+    if (function == NULL) {
+        return B_BAD_VALUE;
+    }
+    pthread_once(&sInitOnce, init_tables);
+    pthread_mutex_lock(&sTableLock);
+    for (int32 i = 0; i < LINUX_THREAD_MAX; i++) {
+        int32 slot = (sNextThread + i) % LINUX_THREAD_MAX;
+        linux_thread* thread = &sThreads[slot];
+        if (thread->state == LINUX_THREAD_FREE) {
+            thread->id = sNextThread + i;
+            thread->state = LINUX_THREAD_SPAWNED;
+            thread->function = function;
+            thread->data = data;
+            thread->result = B_OK;
+            sNextThread = next_id(thread->id);
+            pthread_mutex_unlock(&sTableLock);
+            return thread->id;
+        }
+    }
+    pthread_mutex_unlock(&sTableLock);
+    return B_NO_MORE_THREADS;
+}
+
+static linux_thread* lookup_thread(thread_id id) {
+    if (id < 0) {
+        return NULL;
+    }
+    linux_thread* thread = &sThreads[id % LINUX_THREAD_MAX];
+    return thread->state != LINUX_THREAD_FREE && thread->id == id ? thread : NULL;
+}
+
+// Da chiamare con sTableLock preso
+static status_t start_thread(linux_thread* thread) {
+    if (thread->state != LINUX_THREAD_SPAWNED) {
+        return B_OK;
+    }
+    if (pthread_create(&thread->thread, NULL, thread_entry, thread) != 0) {
+        return B_NO_MORE_THREADS;
+    }
+    thread->state = LINUX_THREAD_RUNNING;
+    return B_OK;
+}
+
+status_t resume_thread(thread_id id) {
+    pthread_once(&sInitOnce, init_tables);
+    pthread_mutex_lock(&sTableLock);
+    linux_thread* thread = lookup_thread(id);
+    status_t status = thread != NULL ? start_thread(thread) : B_BAD_THREAD_ID;
+    pthread_mutex_unlock(&sTableLock);
+    return status;
+}
+
+// Un thread mai avviato parte ora, come in Haiku. Un solo thread può
+// aspettarne un altro: lo slot si libera all'uscita
+status_t wait_for_thread(thread_id id, status_t* returnValue) {
+    pthread_once(&sInitOnce, init_tables);
+    pthread_mutex_lock(&sTableLock);
+    linux_thread* thread = lookup_thread(id);
+    status_t status = thread != NULL ? start_thread(thread) : B_BAD_THREAD_ID;
+    pthread_mutex_unlock(&sTableLock);
+    if (status != B_OK) {
+        return status;
+    }
+
+    pthread_join(thread->thread, NULL);
+    if (returnValue != NULL) {
+        *returnValue = thread->result;
+    }
+    pthread_mutex_lock(&sTableLock);
+    thread->id = -1;
+    thread->state = LINUX_THREAD_FREE;
+    pthread_mutex_unlock(&sTableLock);
+    return B_OK;
+}
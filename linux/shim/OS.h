@@ -0,0 +1,55 @@
+#ifndef _OS_H
+#define _OS_H
+
+// Shim per la build Linux della libreria (os_linux.cpp): semafori e thread di
+// Haiku sopra i thread POSIX, tempo da CLOCK_MONOTONIC. A differenza dello
+// shim dell'harness host il tempo è reale e i thread sono veri. Le priorità
+// sono accettate ma ignorate.
+
+#include <SupportDefs.h>
+
+#define B_OS_NAME_LENGTH 32
+#define B_INFINITE_TIMEOUT INT64_MAX
+
+typedef int32 sem_id;
+typedef int32 thread_id;
+
+// Flag dei semafori
+#define B_CAN_INTERRUPT      1
+#define B_DO_NOT_RESCHEDULE  2
+#define B_RELATIVE_TIMEOUT   8
+#define B_ABSOLUTE_TIMEOUT   16
+
+// Priorità dei thread
+#define B_IDLE_PRIORITY              0
+#define B_LOWEST_ACTIVE_PRIORITY     1
+#define B_LOW_PRIORITY               5
+#define B_NORMAL_PRIORITY            10
+#define B_DISPLAY_PRIORITY           15
+#define B_URGENT_DISPLAY_PRIORITY    20
+#define B_REAL_TIME_DISPLAY_PRIORITY 100
+#define B_URGENT_PRIORITY            110
+#define B_REAL_TIME_PRIORITY         120
+
+#define B_SYSTEM_TIMEBASE 0
+
+typedef status_t (*thread_func)(void* data);
+
+sem_id create_sem(int32 count, const char* name);
+status_t delete_sem(sem_id sem);
+status_t acquire_sem(sem_id sem);
+status_t acquire_sem_etc(sem_id sem, int32 count, uint32 flags, bigtime_t timeout);
+status_t release_sem(sem_id sem);
+status_t release_sem_etc(sem_id sem, int32 count, uint32 flags);
+status_t get_sem_count(sem_id sem, int32* count);
+
+thread_id spawn_thread(thread_func function, const char* name, int32 priority, void* data);
+status_t resume_thread(thread_id thread);
+status_t wait_for_thread(thread_id thread, status_t* returnValue);
+
+bigtime_t system_time();
+nanotime_t system_time_nsecs();
+status_t snooze(bigtime_t amount);
+status_t snooze_until(bigtime_t time, int timeBase);
+
+#endif // _OS_H
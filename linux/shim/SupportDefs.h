@@ -0,0 +1,92 @@
+#ifndef _SUPPORT_DEFS_H
+#define _SUPPORT_DEFS_H
+
+// Shim per la build Linux della libreria: tipi, macro e operazioni atomiche
+// dello spazio utente di Haiku. I codici di errore sono quelli dello shim
+// dell'harness host (host/shim/Errors.h).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <Errors.h>
+
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+typedef int32 status_t;
+typedef int64 bigtime_t;
+typedef int64 nanotime_t;
+typedef uint32 type_code;
+
+#define B_PRId32 PRId32
+#define B_PRIu32 PRIu32
+#define B_PRIx32 PRIx32
+#define B_PRId64 PRId64
+#define B_PRIu64 PRIu64
+#define B_PRIx64 PRIx64
+
+// Come in Haiku restituiscono il valore precedente e sono sequenzialmente
+// consistenti
+static inline void atomic_set(int32* value, int32 newValue) {
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int32 atomic_get_and_set(int32* value, int32 newValue) {
+    return __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int32 atomic_test_and_set(int32* value, int32 newValue, int32 testAgainst) {
+    __atomic_compare_exchange_n(value, &testAgainst, newValue, false, __ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST);
+    return testAgainst;
+}
+
+static inline int32 atomic_add(int32* value, int32 addValue) {
+    return __atomic_fetch_add(value, addValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int32 atomic_and(int32* value, int32 andValue) {
+    return __atomic_fetch_and(value, andValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int32 atomic_or(int32* value, int32 orValue) {
+    return __atomic_fetch_or(value, orValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int32 atomic_get(int32* value) {
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+static inline void atomic_set64(int64* value, int64 newValue) {
+    __atomic_store_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int64 atomic_get_and_set64(int64* value, int64 newValue) {
+    return __atomic_exchange_n(value, newValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int64 atomic_test_and_set64(int64* value, int64 newValue, int64 testAgainst) {
+    __atomic_compare_exchange_n(value, &testAgainst, newValue, false, __ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST);
+    return testAgainst;
+}
+
+static inline int64 atomic_add64(int64* value, int64 addValue) {
+    return __atomic_fetch_add(value, addValue, __ATOMIC_SEQ_CST);
+}
+
+static inline int64 atomic_get64(int64* value) {
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+#define min_c(a, b) ((a) > (b) ? (b) : (a))
+#define max_c(a, b) ((a) > (b) ? (a) : (b))
+
+#endif // _SUPPORT_DEFS_H